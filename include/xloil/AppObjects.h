@@ -220,6 +220,8 @@ namespace xloil
 
     ExcelObj value(row_t i, col_t j) const final override;
 
+    ExcelObj value(int fromRow, int fromCol, int toRow, int toCol) const final override;
+
     void set(const ExcelObj& value) final override;
 
     std::wstring formula() final override;
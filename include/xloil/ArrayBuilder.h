@@ -2,35 +2,53 @@
 
 #include <xloil/ExcelObj.h>
 #include <cassert>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace xloil
 {
   namespace detail
   {
+    /// <summary>
+    /// Allocates from the string store of an ArrayBuilderAlloc. Copies of 
+    /// this allocator, such as those held by PStrings, share the position
+    /// of the next free character.
+    /// </summary>
     struct ArrayBuilderCharAllocator
     {
       ArrayBuilderCharAllocator()
       {}
 
-      ArrayBuilderCharAllocator(wchar_t* data, size_t size)
-        : _stringData(data)
+      ArrayBuilderCharAllocator(wchar_t** next, size_t size)
+        : _stringData(next)
 #ifdef _DEBUG
-        , _endStringData(data + size)
+        , _endStringData(*next + size)
 #endif
       {}
       constexpr wchar_t* allocate(size_t n)
       {
 #ifdef _DEBUG
-        if (_stringData + n > _endStringData)
+        if (*_stringData + n > _endStringData)
           throw std::runtime_error("ExcelArrayBuilder: string data buffer exhausted");
 #endif
-        auto ptr = _stringData;
-        _stringData += n;
+        auto ptr = *_stringData;
+        *_stringData += n;
         return ptr;
       }
       constexpr void deallocate(wchar_t*, size_t) { }
+
+      /// <summary>
+      /// Returns the space to the store if it was the last allocation
+      /// </summary>
+      void reclaim(wchar_t* ptr, size_t n)
+      {
+        if (ptr + n == *_stringData)
+          *_stringData = ptr;
+      }
     private:
-      wchar_t* _stringData;
+      wchar_t** _stringData;
 #ifdef _DEBUG
       const wchar_t* _endStringData;
 #endif
@@ -41,15 +59,22 @@ namespace xloil
     public:
       // TODO: we could support resize on this class, with a small amount
       // of string fiddling 
-      ArrayBuilderAlloc(size_t nObjects, size_t stringLen)
+      ArrayBuilderAlloc(size_t nObjects, size_t stringLen, bool intern = false)
         : _buffer((ExcelObj*)
           new char[sizeof(ExcelObj) * nObjects + sizeof(wchar_t) * stringLen])
         , _nObjects(nObjects)
-        , _stringAllocator((wchar_t*)(_buffer + nObjects), stringLen)
+        , _nextString((wchar_t*)(_buffer + nObjects))
+        , _stringAllocator(&_nextString, stringLen)
       {
         assert(nObjects > 0);
+        if (intern)
+          _interned.reset(new std::unordered_map<std::wstring_view, wchar_t*>());
       }
 
+      // The char allocator points into this object, so it cannot be moved
+      ArrayBuilderAlloc(const ArrayBuilderAlloc&) = delete;
+      ArrayBuilderAlloc& operator=(const ArrayBuilderAlloc&) = delete;
+
       ~ArrayBuilderAlloc()
       {
         if (_buffer)
@@ -63,6 +88,48 @@ namespace xloil
         return ptr;
       }
 
+      /// <summary>
+      /// Returns a pascal string in the string store with the given contents.
+      /// If interning, this is the existing copy of the string if there is one.
+      /// </summary>
+      wchar_t* copyString(const wchar_t* str, size_t len)
+      {
+        if (_interned)
+        {
+          auto found = _interned->find(std::wstring_view(str, len));
+          if (found != _interned->end())
+            return found->second;
+        }
+        auto pstr = newString(len);
+        wmemcpy_s(pstr + 1, len, str, len);
+        if (_interned)
+          _interned->emplace(std::wstring_view(pstr + 1, len), pstr);
+        return pstr;
+      }
+
+      /// <summary>
+      /// If interning, replaces a string just allocated from the string store
+      /// with an existing copy, returning its space to the store.
+      /// </summary>
+      void intern(ExcelObj& x)
+      {
+        if (!_interned || x.xltype != msxll::xltypeStr)
+          return;
+        auto pstr = x.val.str;
+        // Strings allocated elsewhere are left alone
+        if (pstr < (wchar_t*)(_buffer + _nObjects) || pstr >= _nextString)
+          return;
+        const auto len = (size_t)pstr[0];
+        auto [found, inserted] = _interned->try_emplace(std::wstring_view(pstr + 1, len), pstr);
+        if (!inserted)
+        {
+          _stringAllocator.reclaim(pstr, len + 1);
+          x.val.str = found->second;
+        }
+      }
+
+      bool interning() const { return (bool)_interned; }
+
       ExcelObj& object(size_t i) { return _buffer[i]; }
 
       void fillNA()
@@ -85,7 +152,11 @@ namespace xloil
     private:
       ExcelObj* _buffer;
       size_t _nObjects;
+      wchar_t* _nextString;
       ArrayBuilderCharAllocator _stringAllocator;
+      // Maps string contents to pascal strings in the string store. The keys
+      // point into the store, so interning needs no extra string copies.
+      std::unique_ptr<std::unordered_map<std::wstring_view, wchar_t*>> _interned;
     };
 
     class ArrayBuilderIterator;
@@ -135,10 +206,12 @@ namespace xloil
 
       /// <summary>
       /// Move emplacement for an ExcelObj. Only safe if it is not a string or
-      /// is a string allocated using the ArrayBuilder's charAllocator.
+      /// is a string allocated using the ArrayBuilder's charAllocator. If the
+      /// builder interns strings, the string should be the last allocated.
       /// </summary>
       void emplace(ExcelObj&& x)
       {
+        _alloc->intern(x);
         new (_target) ExcelObj(std::forward<ExcelObj>(x));
       }
 
@@ -172,11 +245,9 @@ namespace xloil
         }
         else
         {
-          auto pstr = _alloc->newString(len);
-          wmemcpy_s(pstr + 1, len, str, len);
           // This object's dtor will never be called, as it is an array element
           // so the allocated pstr will be freed when the entire array block is
-          xlObj->val.str = pstr;
+          xlObj->val.str = _alloc->copyString(str, len);
         }
       }
 
@@ -231,6 +302,81 @@ namespace xloil
     };
   }
 
+  /// <summary>
+  /// Computes the size of string store an ExcelArrayBuilder needs. By default,
+  /// it counts each distinct string once so the builder can intern strings,
+  /// which saves memory and copying for data with many repeated strings, 
+  /// such as categories. If more than half of the first strings are distinct,
+  /// interning costs more than it saves, so is abandoned.
+  /// 
+  /// Strings passed as views must outlive the counter.
+  /// </summary>
+  class ArrayStringCounter
+  {
+  public:
+    ArrayStringCounter(bool intern = true)
+      : _intern(intern)
+    {}
+
+    void add(const std::wstring_view& str)
+    {
+      // Empty strings point to a static buffer, so need no space
+      if (str.empty())
+        return;
+      add(str.length(), _intern && !_seen.emplace(str).second);
+    }
+
+    void add(const ExcelObj& x)
+    {
+      if (x.isType(ExcelType::Str))
+        add(x.cast<PStringRef>().view());
+    }
+
+    /// <summary>
+    /// Counts a string of the given length for callers which determine 
+    /// whether strings are repeated themselves.
+    /// </summary>
+    void add(size_t length, bool seenBefore)
+    {
+      ++_nStrings;
+      _totalLength += length + 1;
+      if (!seenBefore)
+      {
+        ++_nDistinct;
+        _distinctLength += length + 1;
+      }
+      else if (length > _maxRepeatLength)
+        _maxRepeatLength = length;
+      if (_nStrings == SAMPLE_SIZE && _nDistinct * 2 > SAMPLE_SIZE)
+      {
+        _intern = false;
+        _seen = decltype(_seen)();
+      }
+    }
+
+    bool interning() const { return _intern; }
+
+    /// <summary>
+    /// Number of characters required, including the length counts. When
+    /// interning, this includes space to write a repeated string into the
+    /// store before it is interned by <see cref="ArrayBuilderElement::emplace"/>.
+    /// </summary>
+    size_t length() const 
+    { 
+      return _intern ? _distinctLength + _maxRepeatLength + 1 : _totalLength;
+    }
+
+  private:
+    static constexpr size_t SAMPLE_SIZE = 1024;
+    bool _intern;
+    size_t _nStrings = 0;
+    size_t _nDistinct = 0;
+    size_t _totalLength = 0;
+    size_t _distinctLength = 0;
+    size_t _maxRepeatLength = 0;
+    std::unordered_set<std::wstring_view> _seen;
+  };
+
   /// <summary>
   /// Constructs and allocates ExcelObj arrays. This class does 
   /// not dynamically resize the array, you must know the size you
@@ -251,11 +397,12 @@ namespace xloil
 
   private:
     static auto initialiseAllocator(
-      row_t& nRows, col_t& nCols, size_t strLength, bool padTo2DimArray)
+      row_t& nRows, col_t& nCols, size_t strLength, bool padTo2DimArray, 
+      bool exactLength = false, bool intern = false)
     {
       // Add the terminators and string counts to total length. Maybe 
       // not every cell will be a string so this is an over-estimate
-      if (strLength > 0)
+      if (strLength > 0 && !exactLength)
         strLength += nCols * nRows * 2;
 
       if (padTo2DimArray)
@@ -266,7 +413,18 @@ namespace xloil
 
       auto arrSize = nRows * nCols;
 
-      return detail::ArrayBuilderAlloc(arrSize, strLength);
+      return detail::ArrayBuilderAlloc(arrSize, strLength, intern);
+    }
+
+    void addPadding(row_t nRows, col_t nCols)
+    {
+      if (nCols < _nColumns)
+        for (row_t i = 0; i < nRows; ++i)
+          (*this)(i, nCols) = CellError::NA;
+
+      if (nRows < _nRows)
+        for (col_t j = 0; j < _nColumns; ++j)
+          (*this)(nRows, j) = CellError::NA;
     }
 
   public:
@@ -287,20 +445,33 @@ namespace xloil
       , _allocator(initialiseAllocator(_nRows, _nColumns, totalStrLength, padTo2DimArray))
     {
       if (padTo2DimArray)
-      {
-        // Add padding
-        if (nCols < _nColumns)
-          for (row_t i = 0; i < nRows; ++i)
-            (*this)(i, nCols) = CellError::NA;
-
-        if (nRows < _nRows)
-          for (col_t j = 0; j < _nColumns; ++j)
-            (*this)(nRows, j) = CellError::NA;
-      }
+        addPadding(nRows, nCols);
+    }
+
+    /// <summary>
+    /// Creates an ArrayBuilder with a string store sized by an ArrayStringCounter.
+    /// If the counter is interning, identical strings written to the array share
+    /// one buffer in the store. The result is a single block, like any other
+    /// array, but its strings must not be modified in place.
+    /// </summary>
+    ExcelArrayBuilder(row_t nRows, col_t nCols,
+      const ArrayStringCounter& strings, bool padTo2DimArray = false)
+      : _nRows(nRows)
+      , _nColumns(nCols)
+      , _allocator(initialiseAllocator(_nRows, _nColumns, 
+          strings.length(), padTo2DimArray, true, strings.interning()))
+    {
+      if (padTo2DimArray)
+        addPadding(nRows, nCols);
     }
 
     const auto& charAllocator() const { return _allocator.charAllocator(); }
 
+    /// <summary>
+    /// True if identical strings written to the array share one buffer
+    /// </summary>
+    bool interning() const { return _allocator.interning(); }
+
     /// <summary>
     /// Allocate a PString in the array's string store. This can be used for
     /// optimisations where a temporary string would otherwise be created in
@@ -14,6 +14,21 @@ namespace xloil
     asyncReturn(
       const ExcelObj& asyncHandle, const ExcelObj& value);
 
+  /// <summary>
+  /// Returns the results of several native async functions with a single 
+  /// call to xlAsyncReturn, which Excel allows by passing arrays of handles 
+  /// and values. This is much faster than one call per result.
+  /// 
+  /// Excel cannot take arrays in a batch, so array results are returned
+  /// with one call each. If a handle appears more than once, only its 
+  /// last value is returned.
+  /// </summary>
+  /// <param name="asyncHandles">Array of <paramref name="n"/> handles</param>
+  /// <param name="values">Array of <paramref name="n"/> results</param>
+  XLOIL_EXPORT void 
+    asyncReturn(
+      const ExcelObj* asyncHandles, const ExcelObj* values, size_t n);
+
   struct AsyncHandle : public ExcelObj
   {
     template<class... Args>
@@ -53,5 +68,6 @@ namespace xloil
     {
       asyncReturn(_asyncHandle, value);
     }
+    const ExcelObj& asyncHandle() const { return _asyncHandle; }
   };
 }
\ No newline at end of file
@@ -0,0 +1,167 @@
+#pragma once
+#include <xloil/ExcelObj.h>
+#include <xloil/ExportMacro.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace xloil
+{
+  /// <summary>
+  /// Optional persistence of object cache contents between Excel sessions.
+  /// When a snapshot directory is set, closing a workbook writes the objects
+  /// created by its cells which can be serialised to the file
+  /// <c>Directory\WorkbookName.xlcache</c>. When the workbook is next opened,
+  /// the file is memory-mapped when first needed and entries are decoded
+  /// only when used:
+  ///
+  ///   * A function call wrapped in a <see cref="CacheSnapshot::CellCall"/>
+  ///     returns its previous result without running if its arguments are
+  ///     the same as when the snapshot was written. The cache objects that
+  ///     the result refers to are restored.
+  ///   * A cache reference which is not found is restored from the snapshot
+  ///     so cells which depend on it can calculate before the cell which
+  ///     created it.
+  ///
+  /// Each entry is used at most once: after it is restored, the cache keeps
+  /// or replaces the object as usual.
+  /// </summary>
+  namespace CacheSnapshot
+  {
+    /// <summary>
+    /// Collects the objects to be written on workbook close
+    /// </summary>
+    class Writer
+    {
+    public:
+      /// <summary>
+      /// Adds the objects for a cache key, i.e. a reference string without the
+      /// ",X" count. The i-th blob is the serialised object with count i.
+      /// </summary>
+      virtual void add(
+        const std::wstring_view& cacheKey,
+        std::vector<std::vector<char>>&& blobs) = 0;
+    };
+
+    enum class KeyState
+    {
+      Missing,
+      /// <summary>
+      /// The objects were restored from a snapshot and not since replaced
+      /// </summary>
+      Restored,
+      Current
+    };
+
+    /// <summary>
+    /// Implemented by an object cache to save and restore its contents.
+    /// </summary>
+    class Handler
+    {
+    public:
+      virtual ~Handler() {}
+
+      /// <summary>
+      /// The character which starts all of the cache's reference strings
+      /// </summary>
+      virtual wchar_t uniquifier() const = 0;
+
+      /// <summary>
+      /// Passes to the writer all objects created by the given workbook
+      /// which can be serialised. Called on the main thread.
+      /// </summary>
+      virtual void save(const std::wstring_view& workbook, Writer& writer) = 0;
+
+      /// <summary>
+      /// Recreates the objects for a cache key from the blobs passed to the
+      /// <see cref="Writer"/>, returning false if they could not be read. The
+      /// data is only valid for the duration of the call. May be called on
+      /// any thread.
+      /// </summary>
+      virtual bool restore(
+        const std::wstring_view& cacheKey,
+        const std::vector<std::string_view>& blobs) = 0;
+
+      virtual KeyState state(const std::wstring_view& cacheKey) const = 0;
+    };
+
+    /// <summary>
+    /// Returns true if the cache key, which looks like <c>U[Book]Sheet!R1C1</c>
+    /// where U is the uniquifier, was created by a cell in the workbook.
+    /// </summary>
+    inline bool inWorkbook(const std::wstring_view& cacheKey, const std::wstring_view& workbook)
+    {
+      return cacheKey.size() > workbook.size() + 3
+        && cacheKey[1] == L'['
+        && cacheKey.compare(2, workbook.size(), workbook) == 0
+        && cacheKey[workbook.size() + 2] == L']';
+    }
+
+    /// <summary>
+    /// Registers a cache handler. The caller owns the handler and must call
+    /// <see cref="removeHandler"/> before destroying it.
+    /// </summary>
+    XLOIL_EXPORT void addHandler(Handler* handler);
+
+    XLOIL_EXPORT void removeHandler(Handler* handler);
+
+    /// <summary>
+    /// Sets the directory for snapshot files. An empty string, the default,
+    /// disables snapshots.
+    /// </summary>
+    XLOIL_EXPORT void setDirectory(const std::wstring_view& directory);
+
+    XLOIL_EXPORT bool isEnabled() noexcept;
+
+    /// <summary>
+    /// Restores a missing cache key from the snapshot of its workbook, if
+    /// there is one. Returns true on success. Caches should call this when
+    /// a lookup fails, see ObjectCache::setMissHandler.
+    /// </summary>
+    XLOIL_EXPORT bool restoreMissing(const std::wstring_view& cacheKey);
+
+    /// <summary>
+    /// Allows a worksheet function which returns cache references to skip
+    /// recalculation when the workbook is reopened. Construct it with the
+    /// function arguments before doing any work, then:
+    /// <code>
+    ///    CacheSnapshot::CellCall snapshot(L"myFunc", args, nArgs);
+    ///    if (auto* previous = snapshot.restore())
+    ///      return returnValue(*previous);
+    ///    auto result = ...;
+    ///    snapshot.record(result);
+    /// </code>
+    /// Arguments are hashed by value. Calls with range reference arguments
+    /// or with a cache reference which is not itself restored from the
+    /// snapshot always run. Does nothing if snapshots are disabled.
+    /// </summary>
+    class XLOIL_EXPORT CellCall
+    {
+    public:
+      CellCall(
+        const std::wstring_view& funcName,
+        const ExcelObj** args,
+        size_t nArgs);
+
+      /// <summary>
+      /// If the snapshot has a result for the calling cell and arguments,
+      /// restores the objects it refers to and returns it, else returns
+      /// nullptr.
+      /// </summary>
+      const ExcelObj* restore();
+
+      /// <summary>
+      /// Records the function result, so it is written to the next snapshot
+      /// along with any cache objects it refers to.
+      /// </summary>
+      void record(const ExcelObj& result);
+
+    private:
+      std::wstring _cell;
+      uint64_t _hash;
+      const ExcelObj** _args;
+      size_t _nArgs;
+      ExcelObj _restored;
+    };
+  }
+}
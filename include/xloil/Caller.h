@@ -42,7 +42,8 @@ namespace xloil
   public:
     /// <summary>
     /// Constructor which makes calls to xlfCaller and xlfSheetName to
-    /// determine the caller.
+    /// determine the caller. When the caller includes a sheet ID, the sheet
+    /// name is only requested from Excel once per sheet per calculation.
     /// </summary>
     CallerInfo();
 
@@ -122,10 +123,19 @@ namespace xloil
     /// </summary>
     const msxll::XLREF12* sheetRef() const
     {
-      return _address.isType(ExcelType::SRef)
-        ? &_address.val.sref.ref
-        : nullptr;
+      if (_address.isType(ExcelType::SRef))
+        return &_address.val.sref.ref;
+      if (_address.isType(ExcelType::Ref) && _address.val.mref.lpmref)
+        return _address.val.mref.lpmref->reftbl;
+      return nullptr;
     }
+
+    /// <summary>
+    /// Returns the ID of the calling sheet if the caller was a worksheet, 
+    /// else returns null. The lookup is cached per calculation, so is
+    /// cheap to call for many cells on the same sheet.
+    /// </summary>
+    msxll::IDSHEET sheetId() const;
   };
 
   /// <summary>
@@ -217,18 +227,30 @@ namespace xloil
 
   /// <summary>
   /// Returns true if the user is currently in the function wizard.
-  /// It's quite an expensive check involving looping through visible 
-  /// Windows as Excel does not provide a built-in way to check this.
+  /// Excel does not provide a built-in way to check this, so xlOil
+  /// hooks window events to notice when the wizard's dialog opens and
+  /// closes, making this check a single atomic load. If the hook could
+  /// not be installed, it falls back to looping through Excel's windows,
+  /// which is quite expensive.
   /// </summary>
   XLOIL_EXPORT bool inFunctionWizard();
 
+  /// <summary>
+  /// The number of times Excel's windows have been enumerated to look for
+  /// the function wizard. This should only increase when dialogs open and
+  /// close, not with each call to <see cref="inFunctionWizard"/>.
+  /// </summary>
+  XLOIL_EXPORT uint64_t functionWizardScans() noexcept;
+
+  /// <summary>
+  /// Internal use: called during Core DLL startup on the main thread.
+  /// </summary>
+  void initFunctionWizardHook();
+
   /// <summary>
   /// Throws "#WIZARD!" true if the user is currently in the function 
   /// wizard.  The idea being that this string will be returned to Excel
   /// by the surrounding try...catch.
-  /// 
-  /// Quite an expensive check as Excel does not provide a built-in 
-  /// way to check this.
   /// </summary>
   inline void throwInFunctionWizard()
   {
@@ -0,0 +1,92 @@
+#pragma once
+#include <xloil/ExportMacro.h>
+#include <xloil/ExcelArray.h>
+#include <cstdint>
+#include <vector>
+
+namespace xloil
+{
+  /// <summary>
+  /// A column of an <see cref="ExcelArray"/> prepared for comparing and hashing
+  /// many values at once, as done by sorts, lookups and joins. The constructor
+  /// makes one pass over the column, partitioning its rows by type: numbers are
+  /// stored as doubles and ASCII strings as a case-folded key. The comparison
+  /// functions then work on runs of rows of the same type, using branch-free
+  /// double comparisons and SIMD string comparisons. Other types, and non-ASCII
+  /// strings, fall back to <see cref="ExcelObj::compare"/>.
+  ///
+  /// Comparisons return -1, 0 or 1 with the same sign as ExcelObj::compare and
+  /// hashes match <see cref="ExcelObj::hash"/>.  The array data must outlive
+  /// this object.
+  /// </summary>
+  class XLOIL_EXPORT ColumnKeys
+  {
+  public:
+    using row_t = ExcelArray::row_t;
+    using col_t = ExcelArray::col_t;
+
+    ColumnKeys(const ExcelArray& array, col_t column, bool caseSensitive = false);
+
+    row_t size() const { return (row_t)_kinds.size(); }
+
+    const ExcelObj& operator()(row_t i) const { return _array.at(i, _column); }
+
+    /// <summary>
+    /// The number of rows compared using ASCII string keys. This is zero if
+    /// the process collation locale is not "C".
+    /// </summary>
+    row_t asciiKeyCount() const { return (row_t)_stringRows.size(); }
+
+    /// <summary>
+    /// Compares the values in two rows of the column
+    /// </summary>
+    int compare(row_t i, row_t j) const;
+
+    /// <summary>
+    /// Compares every row of the column to a value, writing
+    /// <see cref="size"/> results.
+    /// </summary>
+    void compare(const ExcelObj& value, int* result) const;
+
+    /// <summary>
+    /// Compares each row of the column to the same row of another column
+    /// of the same size, writing <see cref="size"/> results.
+    /// </summary>
+    void compare(const ColumnKeys& other, int* result) const;
+
+    /// <summary>
+    /// Writes the hash of every row of the column
+    /// </summary>
+    void hash(size_t* result) const;
+
+  private:
+    enum Kind : uint8_t
+    {
+      Number,
+      AsciiString,
+      Other
+    };
+
+    /// <summary>
+    /// Compares two case-folded ASCII keys
+    /// </summary>
+    static int compareKeys(const char* left, size_t leftLen, const char* right, size_t rightLen);
+
+    const char* key(row_t i) const { return _keyChars.data() + _keyStart[i]; }
+    size_t keyLength(row_t i) const { return (*this)(i).val.str[0]; }
+
+    ExcelArray _array;
+    col_t _column;
+    bool _caseSensitive;
+    std::vector<uint8_t> _kinds;
+    // Value of each number, or zero
+    std::vector<double> _numbers;
+    // Start of the key of each ASCII string in _keyChars
+    std::vector<size_t> _keyStart;
+    std::vector<char> _keyChars;
+    // Rows of each kind
+    std::vector<row_t> _numberRows;
+    std::vector<row_t> _stringRows;
+    std::vector<row_t> _otherRows;
+  };
+}
@@ -2,12 +2,17 @@
 #include "ExportMacro.h"
 #include <xloil/ExcelObj.h>
 #include <string_view>
+#include <memory>
 #include <time.h>
 
 namespace std { struct tm; }
 namespace xloil
 {
+  class ExcelArray;
+  namespace detail { class DateFormat; }
+
   constexpr int XL_MAX_SERIAL_DATE = 2958465; // 31 December 9999
+  constexpr int XL_SERIAL_UNIX_EPOCH = 25569;  // 1 January 1970
 
   /// <summary>
   /// Converts as Excel date expressed as an integer to day, month, year
@@ -17,6 +22,38 @@ namespace xloil
   XLOIL_EXPORT bool 
     excelSerialDateToYMD(int nSerialDate, int &nYear, int &nMonth, int &nDay) noexcept;
 
+  /// <summary>
+  /// Converts an array of Excel dates expressed as integers to day, month, 
+  /// year, giving the same results as <see cref="excelSerialDateToYMD"/>.
+  /// The loop is branch-free so the compiler can vectorise it, which makes
+  /// this much faster for columns of dates. Dates which are out of range
+  /// give a zero year, month and day. Returns the number of valid dates.
+  /// </summary>
+  XLOIL_EXPORT size_t
+    excelSerialDatesToYMD(
+      const int* serials, size_t n, int* years, int* months, int* days) noexcept;
+
+  /// <summary>
+  /// Converts an Excel date expressed as an integer to the number of days
+  /// since 1 January 1970, as used by numpy's datetime64[D].  Excel thinks
+  /// 1900 was a leap year, so its non-existent 29 February 1900 is mapped 
+  /// to 1 March.
+  /// </summary>
+  constexpr int excelSerialDateToUnixDays(int serial) noexcept
+  {
+    return serial - XL_SERIAL_UNIX_EPOCH + (serial < 61 ? 1 : 0);
+  }
+
+  /// <summary>
+  /// Converts a number of days since 1 January 1970 to an Excel date
+  /// expressed as an integer. The inverse of <see cref="excelSerialDateToUnixDays"/>.
+  /// </summary>
+  constexpr int excelSerialDateFromUnixDays(int days) noexcept
+  {
+    const auto serial = days + XL_SERIAL_UNIX_EPOCH;
+    return serial < 61 ? serial - 1 : serial;
+  }
+
   /// <summary>
   /// Converts as Excel date expressed as floating point to day, month, year,
   /// hours, minutes, seconds and milliseconds.
@@ -56,14 +93,15 @@ namespace xloil
   /// bases: years are since 1900 and months start at zero.
   /// 
   /// If `format` is omitted, tries to parse the date using
-  /// all registered formats <see cref="dateTimeAddFormat"/>.
+  /// all registered formats <see cref="dateTimeAddFormat"/>,
+  /// starting with the one which last succeeded on this thread.
   /// 
-  /// Because it uses `std::get_time`, month matching is 
-  /// case sensitive based on the convention in the current
-  /// locale. This is such a painful restriction that replacing
-  /// the parsing with a better designed library is an open 
-  /// issue (unfortunately there is nothing particularly 
-  /// lightweight available).
+  /// Formats are compiled into a simple locale-independent parser
+  /// which handles the common `std::get_time` specifiers (%Y %y %m 
+  /// %d %e %H %I %M %S %p %b %B %a %A %F %T %D %R) and matches month
+  /// and day names case-insensitively in English. Unlike `std::get_time`
+  /// the whole string must be consumed. Formats with other specifiers
+  /// fall back to `std::get_time` with its locale-dependent behaviour.
   /// </summary>
   XLOIL_EXPORT bool stringToDateTime(
     const std::wstring_view& str,
@@ -86,6 +124,38 @@ namespace xloil
   /// </summary>
   XLOIL_EXPORT void dateTimeAddFormat(const wchar_t* f);
 
+  /// <summary>
+  /// Parses strings to dates using either a single format or the
+  /// registered formats <see cref="dateTimeAddFormat"/>. The parser
+  /// remembers the format which last matched and tries it first, so 
+  /// reusing one parser over a column of strings typically costs a 
+  /// single format attempt per string.  Not thread-safe: each thread
+  /// should use its own parser.
+  /// </summary>
+  class XLOIL_EXPORT DateTimeParser
+  {
+  public:
+    DateTimeParser(const wchar_t* format = nullptr);
+
+    /// <summary>
+    /// As per <see cref="stringToDateTime"/>
+    /// </summary>
+    bool operator()(const std::wstring_view& str, std::tm& result);
+
+    /// <summary>
+    /// Converts every element of an array to a std::tm, writing the results
+    /// in iteration order. Strings are parsed, numbers are interpreted as
+    /// Excel serial dates. If <paramref name="valid"/> is not null, it 
+    /// receives a flag per element indicating success. Returns the number 
+    /// of elements successfully converted.
+    /// </summary>
+    size_t parse(const ExcelArray& values, std::tm* results, bool* valid = nullptr);
+
+  private:
+    std::shared_ptr<const detail::DateFormat> _format;
+    size_t _lastMatch;
+  };
+
 
 
   struct DateVisitor : public ExcelValVisitor<bool>
@@ -135,12 +135,14 @@ namespace xloil
       const DynamicExcelFunc<TRet>& function)
       : WorksheetFuncSpec(info)
       , function(function)
+      , profileId(Profile::functionId(info->name))
     {}
 
     XLOIL_EXPORT std::shared_ptr<RegisteredWorksheetFunc> registerFunc() const override;
 
     ExcelObj* call(const ExcelObj** args) const;
     DynamicExcelFunc<TRet> function;
+    unsigned profileId;
   };
 
   inline ExcelObj* LambdaSpec<ExcelObj*>::call(const ExcelObj** args) const
@@ -495,6 +495,39 @@ namespace xloil
       bool caseSensitive = false,
       bool recursive = false) noexcept;
 
+    /// <summary>
+    /// Returns a hash consistent with <see cref="compare"/>: if compare 
+    /// returns zero for two objects, they have the same hash. So numeric 
+    /// types are hashed by value, whether they are int, double or bool, and
+    /// strings are case-folded unless <paramref name="caseSensitive"/> is 
+    /// true. Like the non-recursive compare, arrays are hashed by size.
+    /// Use this rather than std::hash to key hash tables on cell values.
+    /// 
+    /// String hashes are only consistent with compare when the LC_COLLATE
+    /// locale is "C", the default: other collations may find different
+    /// strings equal. Hash tables should check <see cref="stringHashMatchesCompare"/>
+    /// and use <see cref="collatedHash"/> if it is false.
+    /// </summary>
+    XLOIL_EXPORT static size_t hash(
+      const ExcelObj& value,
+      bool caseSensitive = false) noexcept;
+
+    /// <summary>
+    /// As <see cref="hash"/>, but strings are hashed by their sort key in the
+    /// LC_COLLATE locale, so the hash is consistent with compare in any 
+    /// locale. This is several times slower than <see cref="hash"/> for
+    /// strings.
+    /// </summary>
+    XLOIL_EXPORT static size_t collatedHash(
+      const ExcelObj& value,
+      bool caseSensitive = false) noexcept;
+
+    /// <summary>
+    /// Returns true if the current LC_COLLATE locale means string hashes
+    /// are consistent with <see cref="compare"/>
+    /// </summary>
+    XLOIL_EXPORT static bool stringHashMatchesCompare() noexcept;
+
     /// <summary>
     /// Returns true if this ExcelObj has ExcelType::Missing type.
     /// </summary>
@@ -558,12 +591,20 @@ namespace xloil
     /// 
     /// The function recurses row-wise over Arrays and ranges and 
     /// concatenates the result. An optional separator may be given to
-    /// insert between array/range entries.
+    /// insert between array/range entries. Numbers are written in the 
+    /// shortest form which reads back as the same double.
     /// </summary>
     /// <param name="separator">optional separator to use for arrays</param>
     /// <returns></returns>
     std::wstring toStringRecursive(const wchar_t* separator = nullptr) const;
 
+    /// <summary>
+    /// Appends the result of <see cref="toStringRecursive"/> to a string. 
+    /// The space required is reserved first so that arrays are written 
+    /// in a single pass without temporary strings.
+    /// </summary>
+    void appendStringRecursive(std::wstring& out, const wchar_t* separator = nullptr) const;
+
     /// <summary>
     /// Similar to toStringRecursive but more suitable for output of object 
     /// descriptions, for example in error messages. For this reason
@@ -0,0 +1,290 @@
+#pragma once
+#include <xlOil/ExcelObj.h>
+#include <xlOil/ExportMacro.h>
+#include <string_view>
+#include <vector>
+#include <cstring>
+
+namespace xloil
+{
+  /// <summary>
+  /// A compact, versioned binary format for ExcelObj values and arrays which
+  /// can be persisted, memory-mapped or shared between processes. The data is
+  /// laid out as follows, with each section 8-byte aligned:
+  ///
+  ///   * A <see cref="Binary::Header"/>
+  ///   * A type tag column: one <see cref="Binary::Tag"/> byte per cell
+  ///   * A value column: eight bytes per cell. Numbers are stored as doubles,
+  ///     Int, Bool and Err types as an int32 and strings as their offset in
+  ///     the string heap
+  ///   * A string heap of length-prefixed UTF-16 strings, which is the layout
+  ///     Excel uses for pascal strings
+  ///
+  /// Cells are stored in row-major order and can be read at random without
+  /// parsing the data. Values are in the machine's (little-endian) byte order.
+  /// A single value is stored as a 1x1 array without the IS_ARRAY flag.
+  /// </summary>
+  namespace Binary
+  {
+    /// <summary>
+    /// The characters "XLOB" read as a little-endian uint32
+    /// </summary>
+    constexpr uint32_t MAGIC = 0x424f4c58;
+    /// <summary>
+    /// Readers reject data written with a later version
+    /// </summary>
+    constexpr uint16_t VERSION = 1;
+
+    enum class Tag : uint8_t
+    {
+      Nil, Num, Int, Bool, Err, Str, Missing
+    };
+
+    enum HeaderFlags : uint16_t
+    {
+      IS_ARRAY = 1
+    };
+
+    struct Header
+    {
+      uint32_t magic;
+      uint16_t version;
+      uint16_t flags;
+      uint32_t nRows;
+      uint32_t nCols;
+      /// <summary>
+      /// Length of the string heap in chars, including length prefixes
+      /// </summary>
+      uint64_t heapLength;
+      /// <summary>
+      /// Total size of the data in bytes
+      /// </summary>
+      uint64_t size;
+    };
+    static_assert(sizeof(Header) == 32, "Binary::Header must be packed");
+
+    constexpr size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+    /// <summary>
+    /// Byte offsets of each section for the given dimensions
+    /// </summary>
+    struct Layout
+    {
+      constexpr Layout(size_t nCells, size_t heapLength)
+        : tags(sizeof(Header))
+        , values(tags + align8(nCells))
+        , heap(values + nCells * sizeof(double))
+        , size(heap + align8(heapLength * sizeof(wchar_t)))
+      {}
+      size_t tags, values, heap, size;
+    };
+
+    /// <summary>
+    /// Returns the number of bytes required to write the object. Throws if
+    /// it cannot be written, e.g. it is a range reference.
+    /// </summary>
+    XLOIL_EXPORT size_t encodedSize(const ExcelObj& obj);
+
+    /// <summary>
+    /// Writes the object to the buffer, which must be at least
+    /// <see cref="encodedSize"/> bytes, returning the number of bytes written.
+    /// </summary>
+    XLOIL_EXPORT size_t encode(const ExcelObj& obj, char* buffer, size_t bufferSize);
+
+    /// <summary>
+    /// Writes the object to a new buffer
+    /// </summary>
+    XLOIL_EXPORT std::vector<char> encode(const ExcelObj& obj);
+
+    /// <summary>
+    /// Reads a value written by <see cref="encode"/> or <see cref="BinaryWriter"/>
+    /// and returns an independent copy. Throws if the data is invalid.
+    /// </summary>
+    XLOIL_EXPORT ExcelObj decode(const void* data, size_t size);
+  }
+
+  /// <summary>
+  /// Reads data in the <see cref="Binary"/> format in-place. The data is
+  /// validated on construction and must outlive the view.
+  /// </summary>
+  class XLOIL_EXPORT BinaryView
+  {
+  public:
+    using row_t = ExcelObj::row_t;
+    using col_t = ExcelObj::col_t;
+
+    /// <summary>
+    /// Throws if the data is not in the binary format, was written by a
+    /// later version or is truncated.
+    /// </summary>
+    BinaryView(const void* data, size_t size);
+
+    row_t nRows() const { return _header->nRows; }
+    col_t nCols() const { return _header->nCols; }
+    size_t size() const { return (size_t)nRows() * nCols(); }
+    bool isArray() const { return (_header->flags & Binary::IS_ARRAY) != 0; }
+
+    /// <summary>
+    /// Total length of the encoded data in bytes
+    /// </summary>
+    size_t byteSize() const { return (size_t)_header->size; }
+
+    Binary::Tag tag(size_t i) const { return (Binary::Tag)_tags[i]; }
+    Binary::Tag tag(row_t i, col_t j) const { return tag(i * nCols() + j); }
+
+    double number(size_t i) const
+    {
+      double result;
+      memcpy(&result, _values + i * sizeof(double), sizeof(double));
+      return result;
+    }
+
+    int32_t integer(size_t i) const
+    {
+      int32_t result;
+      memcpy(&result, _values + i * sizeof(double), sizeof(int32_t));
+      return result;
+    }
+
+    /// <summary>
+    /// Returns the pascal string for a cell of Str type. It points into
+    /// the encoded data.
+    /// </summary>
+    const wchar_t* pstr(size_t i) const
+    {
+      uint64_t offset;
+      memcpy(&offset, _values + i * sizeof(double), sizeof(uint64_t));
+      return _heap + offset;
+    }
+
+    std::wstring_view string(size_t i) const
+    {
+      auto p = pstr(i);
+      return std::wstring_view(p + 1, p[0]);
+    }
+
+    /// <summary>
+    /// Returns a copy of element i as an ExcelObj
+    /// </summary>
+    ExcelObj operator[](size_t i) const;
+
+    ExcelObj operator()(row_t i, col_t j) const { return (*this)[i * nCols() + j]; }
+
+    /// <summary>
+    /// Returns an independent copy of the data as an ExcelObj, using a single
+    /// allocation for arrays.
+    /// </summary>
+    ExcelObj toExcelObj() const;
+
+    /// <summary>
+    /// Returns an array whose strings point directly into the encoded data
+    /// rather than being copied, so only the cells are allocated.  This can
+    /// be viewed with an ExcelArray but must not outlive the encoded data
+    /// and its strings must not be modified. Copying the returned object
+    /// gives an independent array.
+    /// </summary>
+    ExcelObj toExcelObjView() const;
+
+  private:
+    const Binary::Header* _header;
+    const uint8_t* _tags;
+    const char* _values;
+    const wchar_t* _heap;
+  };
+
+  /// <summary>
+  /// Writes an array in the <see cref="Binary"/> format cell by cell, without
+  /// creating an intermediate ExcelObj. It has the same interface as
+  /// <see cref="ExcelArrayBuilder"/> so code which generates arrays can target
+  /// either, but the total string length does not need to be known upfront.
+  /// Cells which are not written are Nil.
+  /// <code>
+  ///    BinaryWriter writer(3, 1);
+  ///    for (auto i = 0; i < 3; ++i)
+  ///      writer(i, 0) = i;
+  ///    auto bytes = writer.toBytes();
+  /// </code>
+  /// </summary>
+  class XLOIL_EXPORT BinaryWriter
+  {
+  public:
+    using row_t = ExcelObj::row_t;
+    using col_t = ExcelObj::col_t;
+
+    class Element
+    {
+    public:
+      Element(size_t index, BinaryWriter& writer)
+        : _index(index), _writer(writer)
+      {}
+
+      /// <summary>
+      /// Writes an Int or, for a bool, a Bool. A non-template bool overload
+      /// would be preferred over wstring_view for string literals.
+      /// </summary>
+      template <class T,
+        std::enable_if_t<std::is_integral<T>::value, int> = 0>
+      void operator=(T x) 
+      { 
+        if constexpr (std::is_same_v<T, bool>)
+          _writer.set(_index, Binary::Tag::Bool, (int32_t)(x ? 1 : 0));
+        else
+          _writer.set(_index, Binary::Tag::Int, (int32_t)x); 
+      }
+
+      void operator=(double x) { _writer.set(_index, Binary::Tag::Num, x); }
+      void operator=(CellError x) { _writer.set(_index, Binary::Tag::Err, (int32_t)x); }
+      void operator=(const std::wstring_view& str) { _writer.setString(_index, str); }
+      void operator=(const ExcelObj& x) { _writer.setValue(_index, x); }
+
+    private:
+      size_t _index;
+      BinaryWriter& _writer;
+    };
+
+    /// <summary>
+    /// Creates a writer for an array of the given size
+    /// </summary>
+    /// <param name="nRows"></param>
+    /// <param name="nCols"></param>
+    /// <param name="heapReserve">Optional hint for the total length of strings</param>
+    BinaryWriter(row_t nRows, col_t nCols, size_t heapReserve = 0);
+
+    Element operator()(size_t i, size_t j) { return Element(i * _nCols + j, *this); }
+    Element operator()(size_t i) { return Element(i, *this); }
+
+    row_t nRows() const { return _nRows; }
+    col_t nCols() const { return _nCols; }
+
+    /// <summary>
+    /// Size in bytes of the encoded data
+    /// </summary>
+    size_t byteSize() const;
+
+    /// <summary>
+    /// Copies the encoded data to the buffer which must be at least
+    /// <see cref="byteSize"/> bytes, e.g. a memory-mapped file
+    /// </summary>
+    void writeTo(char* buffer, size_t bufferSize) const;
+
+    std::vector<char> toBytes() const;
+
+  private:
+    row_t _nRows;
+    col_t _nCols;
+    std::vector<uint8_t> _tags;
+    std::vector<uint64_t> _values;
+    std::vector<wchar_t> _heap;
+
+    template<class T>
+    void set(size_t i, Binary::Tag tag, T value)
+    {
+      _tags[i] = (uint8_t)tag;
+      uint64_t bits = 0;
+      memcpy(&bits, &value, sizeof(T));
+      _values[i] = bits;
+    }
+    void setString(size_t i, const std::wstring_view& str);
+    void setValue(size_t i, const ExcelObj& x);
+  };
+}
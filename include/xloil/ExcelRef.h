@@ -18,7 +18,7 @@ namespace xloil
 
       ExcelObj operator()(int i, int j) const
       {
-        return up().range(i, j, i + 1, j + 1).value();
+        return up().range(i, j, i, j).value();
       }
 
       TSuper& operator=(const ExcelObj& value)
@@ -359,7 +359,12 @@ namespace xloil
 
     ExcelObj value(row_t i, col_t j) const final override
     {
-      return _ref.range(i, j, i + 1, j + 1).value();
+      return _ref.range(i, j, i, j).value();
+    }
+
+    ExcelObj value(int fromRow, int fromCol, int toRow, int toCol) const final override
+    {
+      return _ref.range(fromRow, fromCol, toRow, toCol).value();
     }
 
     void set(const ExcelObj& value) final override
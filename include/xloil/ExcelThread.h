@@ -1,8 +1,11 @@
 #pragma once
 #include "ExportMacro.h"
+#include "QueueTask.h"
 #include <functional>
 #include <future>
 #include <memory>
+#include <type_traits>
+#include <cstdint>
 
 namespace xloil
 {
@@ -29,8 +32,45 @@ namespace xloil
       COM_API = 1 << 4,
       /// Functions requiring COM are continually retried until COM is available.
       /// This disables that functionality.
-      NO_RETRY = 1 << 5
+      NO_RETRY = 1 << 5,
+      /// Run item before any normal priority items which are due, e.g. for
+      /// RTD update notifications
+      HIGH_PRIORITY = 1 << 6,
+      /// Run item after any normal priority items which are due, e.g. for
+      /// housekeeping
+      LOW_PRIORITY = 1 << 7
     };
+
+    /// <summary>
+    /// Counters for the main thread queue, see <see cref="stats"/>. Items run
+    /// immediately because the caller was already on the main thread are 
+    /// not counted.
+    /// </summary>
+    struct Stats
+    {
+      struct Lane
+      {
+        /// Number of items run
+        uint64_t run;
+        /// Mean and maximum time in milliseconds between an item becoming
+        /// due and being run, including any time spent waiting to retry
+        double meanWaitMs;
+        uint64_t maxWaitMs;
+      };
+      /// Number of items queued since startup
+      uint64_t queued;
+      /// Number of times an item could not run because COM or the XLL API
+      /// was unavailable and was requeued
+      uint64_t retried;
+      /// Number of items queued but not yet run or dropped, including items
+      /// waiting for their delay or a retry
+      uint64_t depth;
+      uint64_t maxDepth;
+      /// Indexed by priority: high, normal, low
+      Lane lanes[3];
+    };
+
+    XLOIL_EXPORT Stats stats();
   }
 
   /// <summary>
@@ -53,7 +93,7 @@ namespace xloil
 
   XLOIL_EXPORT void
     runExcelThreadImpl(
-      std::function<void()>&& func,
+      QueueTask&& func,
       int flags,
       unsigned waitBeforeCall,
       unsigned waitBetweenRetries);
@@ -91,10 +131,31 @@ namespace xloil
     unsigned waitBeforeCall = 0,
     unsigned waitBetweenRetries = 200) -> std::future<decltype(func())>
   {
-    auto task = std::make_shared<std::packaged_task<decltype(func())()>>(std::forward<F>(func));
-    auto voidFunc = std::function<void()>( [task]() { (*task)(); });
-    runExcelThreadImpl(std::move(voidFunc), flags, waitBeforeCall, waitBetweenRetries);
-    return task->get_future();
+    using Result = decltype(func());
+    // The promise's shared state, which backs the future, is the only 
+    // allocation: the callable is held in the task, which is stored inline 
+    // in the queue's pooled nodes if it is small enough.
+    std::promise<Result> promise;
+    auto future = promise.get_future();
+    runExcelThreadImpl(QueueTask(
+      [promise = std::move(promise), f = std::forward<F>(func)]() mutable
+      {
+        try
+        {
+          if constexpr (std::is_void_v<Result>)
+          {
+            f();
+            promise.set_value();
+          }
+          else
+            promise.set_value(f());
+        }
+        catch (...)
+        {
+          promise.set_exception(std::current_exception());
+        }
+      }), flags, waitBeforeCall, waitBetweenRetries);
+    return future;
   }
 
   void runComSetupOnXllOpen(const std::function<void()>& func);
@@ -6,6 +6,8 @@
 #include <xloil/Throw.h>
 #include <unordered_map>
 #include <string_view>
+#include <functional>
+#include <optional>
 #include <mutex>
 
 namespace xloil
@@ -94,6 +96,14 @@ namespace xloil
         , _obj(std::move(obj))
       {}
 
+      CellCache(TObj&& obj, std::vector<TObj>&& more, size_t calcId)
+        : _calcId(calcId)
+        , _objects(std::move(more))
+        , _obj(std::move(obj))
+      {}
+
+      size_t calcId() const { return _calcId; }
+
       void getStaleObjects(size_t calcId, std::vector<TObj>& stale)
       {
         if (_calcId != calcId)
@@ -168,10 +178,20 @@ namespace xloil
     std::shared_ptr<const void> _calcEndHandler;
     std::shared_ptr<const void> _workbookCloseHandler;
 
+    std::function<bool(const std::wstring_view&)> _missHandler;
+
+    /// <summary>
+    /// The calcId of restored entries. Any add to the same key will have a
+    /// different calcId so replaces them.
+    /// </summary>
+    static constexpr size_t RESTORED = 0;
+
     void onAfterCalculate()
     {
-      // Called by Excel event so will always be synchonised
-      ++_calcId; // Wraps at MAX_UINT - but this doesn't matter
+      // Called by Excel event so will always be synchonised. Wraps at 
+      // MAX_UINT - but this doesn't matter as long as we skip RESTORED
+      if (++_calcId == RESTORED)
+        ++_calcId;
     }
 
     /// <summary>
@@ -206,9 +226,20 @@ namespace xloil
       const auto iResult = readCount(key[key.size() - 1]);
       const auto cacheKey = key.substr(0, key.size() - PADDING);
 
+      {
+        std::scoped_lock lock(_cacheLock);
+        const auto found = _cache.search(cacheKey);
+        if (found != _cache.end())
+          return found->second.fetch(iResult);
+      }
+
+      // The miss handler may restore the key, so we look again. It is called
+      // without the lock held as it will call restore.
+      if (!_missHandler || !_missHandler(cacheKey))
+        return nullptr;
+
       std::scoped_lock lock(_cacheLock);
       const auto found = _cache.search(cacheKey);
-
       return found == _cache.end()
         ? nullptr
         : found->second.fetch(iResult);
@@ -270,6 +301,49 @@ namespace xloil
       return true;
     }
 
+    /// <summary>
+    /// Inserts objects under the given cache key, i.e. a reference string 
+    /// without the ",X" count, replacing any existing entry. The objects
+    /// are marked as restored: the next <see cref="add"/> from the same
+    /// cell replaces them, whichever calculation cycle it occurs in. Used 
+    /// to reload objects saved in a previous session.
+    /// </summary>
+    void restore(const std::wstring_view& cacheKey, std::vector<TObj>&& objects)
+    {
+      if (objects.empty())
+        return;
+      auto first = std::move(objects.front());
+      objects.erase(objects.begin());
+
+      std::scoped_lock lock(_cacheLock);
+      _cache.insert_or_assign(
+        std::wstring(cacheKey),
+        CellCache(std::move(first), std::move(objects), RESTORED));
+    }
+
+    /// <summary>
+    /// Returns nothing if the cache key is not found, otherwise whether its
+    /// objects were inserted by <see cref="restore"/> and have not since
+    /// been replaced.
+    /// </summary>
+    std::optional<bool> isRestored(const std::wstring_view& cacheKey) const
+    {
+      std::scoped_lock lock(_cacheLock);
+      const auto found = _cache.search(cacheKey);
+      if (found == _cache.end())
+        return std::nullopt;
+      return found->second.calcId() == RESTORED;
+    }
+
+    /// <summary>
+    /// Sets a function called by <see cref="fetch"/> with the cache key when
+    /// a reference is not found. If it returns true, the lookup is retried.
+    /// </summary>
+    void setMissHandler(std::function<bool(const std::wstring_view&)>&& handler)
+    {
+      _missHandler = std::move(handler);
+    }
+
     void onWorkbookClose(const wchar_t* wbName)
     {
       // Called by Excel Event so will always be synchonised
@@ -314,6 +388,11 @@ namespace xloil
         && cacheString[cacheString.length() - PADDING] == L',';
     }
 
+    wchar_t uniquifier() const
+    {
+      return _uniquifier.value;
+    }
+
   private:
 
     size_t readCount(wchar_t count) const
@@ -0,0 +1,168 @@
+#pragma once
+#include <xloil/ExportMacro.h>
+#include <array>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace xloil
+{
+  /// <summary>
+  /// Per-function call counters and latency histograms for registered
+  /// worksheet functions. Recording is off by default and can be toggled
+  /// at runtime. Each thread accumulates into its own counters, which are
+  /// merged into the snapshot returned by <see cref="Profile::stats"/>
+  /// after each calculation cycle (on the AfterCalculate event) or when
+  /// <see cref="Profile::merge"/> is called.
+  /// </summary>
+  namespace Profile
+  {
+    /// <summary>
+    /// The stages of a function call which are timed separately. Functions
+    /// which do not distinguish stages record their entire time as Body.
+    /// </summary>
+    enum class Phase
+    {
+      Args,
+      Body,
+      Return
+    };
+    constexpr size_t NUM_PHASES = 3;
+
+    /// <summary>
+    /// The latency histogram has log2-spaced buckets: bucket zero counts
+    /// calls under 1us, bucket i counts calls in [2^(i-1), 2^i) us and the
+    /// last bucket catches everything slower.
+    /// </summary>
+    constexpr size_t NUM_BUCKETS = 24;
+
+    struct FunctionStats
+    {
+      /// <summary>
+      /// The function name with any namespace qualifier removed
+      /// </summary>
+      std::wstring name;
+      /// <summary>
+      /// The name passed to <see cref="functionId"/>
+      /// </summary>
+      std::wstring qualifiedName;
+      uint64_t calls;
+      uint64_t errors;
+      /// <summary>
+      /// Total time in seconds spent in each <see cref="Phase"/>
+      /// </summary>
+      std::array<double, NUM_PHASES> phaseTime;
+      double maxTime;
+      std::array<uint64_t, NUM_BUCKETS> histogram;
+
+      double totalTime() const { return phaseTime[0] + phaseTime[1] + phaseTime[2]; }
+
+      /// <summary>
+      /// Returns an upper bound for the given quantile (between 0 and 1)
+      /// of call latency in seconds, based on the histogram buckets.
+      /// </summary>
+      XLOIL_EXPORT double quantile(double q) const;
+    };
+
+    XLOIL_EXPORT bool isEnabled() noexcept;
+
+    XLOIL_EXPORT void setEnabled(bool enabled);
+
+    /// <summary>
+    /// Returns a stable identifier for the named function, used to record
+    /// calls. The same name always returns the same ID, so re-registered
+    /// functions keep their history. Functions of the same name in different
+    /// namespaces get different IDs; the qualifier is only removed from
+    /// <see cref="FunctionStats::name"/>.
+    /// </summary>
+    XLOIL_EXPORT unsigned functionId(const std::wstring_view& name);
+    XLOIL_EXPORT unsigned functionId(const char* name);
+
+    /// <summary>
+    /// Records a completed call in the calling thread's counters.
+    /// </summary>
+    XLOIL_EXPORT void record(
+      unsigned id,
+      const int64_t (&phaseNanos)[NUM_PHASES],
+      bool failed) noexcept;
+
+    /// <summary>
+    /// Merges the per-thread counters into the snapshot returned by
+    /// <see cref="stats"/>. Also writes the summary to the log if the
+    /// log interval has elapsed.
+    /// </summary>
+    XLOIL_EXPORT void merge();
+
+    /// <summary>
+    /// Returns the most recently merged statistics for every function which
+    /// has been called since the last reset, sorted by descending total time.
+    /// </summary>
+    XLOIL_EXPORT std::vector<FunctionStats> stats();
+
+    /// <summary>
+    /// Zeros all statistics
+    /// </summary>
+    XLOIL_EXPORT void reset();
+
+    /// <summary>
+    /// If non-zero, the top functions by total time are written to the log
+    /// at info level on the first merge after each interval has elapsed.
+    /// </summary>
+    XLOIL_EXPORT void setLogInterval(std::chrono::seconds interval);
+
+    /// <summary>
+    /// Times a function call when profiling is enabled and records it on
+    /// destruction. Call <see cref="phaseEnd"/> to divide the time between
+    /// phases; any time not allocated to a phase is counted as Body.
+    /// </summary>
+    class CallTimer
+    {
+    public:
+      using clock = std::chrono::steady_clock;
+
+      CallTimer(unsigned id) noexcept
+        : _id(id)
+        , _active(isEnabled())
+        , _failed(false)
+        , _phaseNanos{ 0, 0, 0 }
+      {
+        if (_active)
+          _last = clock::now();
+      }
+
+      ~CallTimer()
+      {
+        if (!_active)
+          return;
+        phaseEnd(Phase::Body);
+        record(_id, _phaseNanos, _failed);
+      }
+
+      void phaseEnd(Phase phase) noexcept
+      {
+        if (!_active)
+          return;
+        const auto now = clock::now();
+        _phaseNanos[(size_t)phase] +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(now - _last).count();
+        _last = now;
+      }
+
+      void failed() noexcept { _failed = true; }
+
+      /// <summary>
+      /// Records nothing for this call, e.g. if it was handed on to another
+      /// function which has its own timer.
+      /// </summary>
+      void discard() noexcept { _active = false; }
+
+    private:
+      unsigned _id;
+      bool _active;
+      bool _failed;
+      int64_t _phaseNanos[NUM_PHASES];
+      clock::time_point _last;
+    };
+  }
+}
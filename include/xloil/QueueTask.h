@@ -0,0 +1,133 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace xloil
+{
+  /// <summary>
+  /// A move-only void() function object which stores functors of up to
+  /// INLINE_SIZE bytes, which includes a std::function, without allocating.
+  /// Larger functors are moved to the heap. Used to pass work to the main
+  /// thread queue, see <see cref="runExcelThread"/>.
+  /// </summary>
+  class QueueTask
+  {
+  public:
+    static constexpr size_t INLINE_SIZE = 64;
+
+    QueueTask() noexcept : _ops(nullptr) {}
+
+    template<class F,
+      std::enable_if_t<!std::is_same_v<std::decay_t<F>, QueueTask>, int> = 0>
+    QueueTask(F&& func)
+    {
+      using T = std::decay_t<F>;
+      if constexpr (fitsInline<T>())
+      {
+        new (_storage) T(std::forward<F>(func));
+        _ops = &InlineOps<T>::ops;
+      }
+      else
+      {
+        *(T**)_storage = new T(std::forward<F>(func));
+        _ops = &HeapOps<T>::ops;
+      }
+    }
+
+    QueueTask(QueueTask&& that) noexcept
+      : _ops(that._ops)
+    {
+      if (_ops)
+      {
+        _ops->move(that._storage, _storage);
+        that._ops = nullptr;
+      }
+    }
+
+    QueueTask& operator=(QueueTask&& that) noexcept
+    {
+      if (this != &that)
+      {
+        reset();
+        _ops = that._ops;
+        if (_ops)
+        {
+          _ops->move(that._storage, _storage);
+          that._ops = nullptr;
+        }
+      }
+      return *this;
+    }
+
+    QueueTask(const QueueTask&) = delete;
+    QueueTask& operator=(const QueueTask&) = delete;
+
+    ~QueueTask() { reset(); }
+
+    void operator()() { _ops->invoke(_storage); }
+
+    explicit operator bool() const noexcept { return _ops != nullptr; }
+
+    /// <summary>
+    /// True if the functor is held without a heap allocation
+    /// </summary>
+    bool isInline() const noexcept { return _ops && _ops->isInline; }
+
+    void reset() noexcept
+    {
+      if (_ops)
+      {
+        _ops->destroy(_storage);
+        _ops = nullptr;
+      }
+    }
+
+  private:
+    struct Ops
+    {
+      void (*invoke)(void*);
+      void (*move)(void* from, void* to) noexcept;
+      void (*destroy)(void*) noexcept;
+      bool isInline;
+    };
+
+    template<class T>
+    static constexpr bool fitsInline()
+    {
+      return sizeof(T) <= INLINE_SIZE
+        && alignof(T) <= alignof(std::max_align_t)
+        && std::is_nothrow_move_constructible_v<T>;
+    }
+
+    template<class T>
+    struct InlineOps
+    {
+      static void invoke(void* p) { (*(T*)p)(); }
+      static void move(void* from, void* to) noexcept
+      {
+        new (to) T(std::move(*(T*)from));
+        ((T*)from)->~T();
+      }
+      static void destroy(void* p) noexcept { ((T*)p)->~T(); }
+      static constexpr Ops ops = { &invoke, &move, &destroy, true };
+    };
+
+    template<class T>
+    struct HeapOps
+    {
+      static void invoke(void* p) { (**(T**)p)(); }
+      static void move(void* from, void* to) noexcept { *(T**)to = *(T**)from; }
+      static void destroy(void* p) noexcept { delete *(T**)p; }
+      static constexpr Ops ops = { &invoke, &move, &destroy, false };
+    };
+
+    alignas(std::max_align_t) unsigned char _storage[INLINE_SIZE];
+    const Ops* _ops;
+  };
+
+  static_assert(sizeof(std::function<void()>) <= QueueTask::INLINE_SIZE,
+    "QueueTask should hold a std::function inline");
+}
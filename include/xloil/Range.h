@@ -110,6 +110,14 @@ namespace xloil
     /// </summary>
     virtual ExcelObj value(row_t i, col_t j) const = 0;
 
+    /// <summary>
+    /// Returns the values in the sub-range from (fromRow, fromCol) to (toRow, toCol)
+    /// inclusive, with indices interpreted as in <see cref="range"/>. The block is 
+    /// fetched in a single call to Excel, which is much faster than reading cells 
+    /// individually. A single cell block returns a single value, otherwise an array.
+    /// </summary>
+    virtual ExcelObj value(int fromRow, int fromCol, int toRow, int toCol) const = 0;
+
     /// <summary>
     /// Convience wrapper for value(i, j). Note writing to the returned value 
     /// does not set values in the range. 
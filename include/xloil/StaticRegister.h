@@ -2,6 +2,7 @@
 #include <xlOil/Register.h>
 #include <xlOil/ExcelObj.h>
 #include <xlOil/FuncSpec.h>
+#include <xlOil/Profile.h>
 #include <array>
 
 namespace xloil {
@@ -20,11 +21,14 @@ namespace xloil {
 /// <summary>
 /// Marks the start of an function registered in Excel. This declares an extern 'C'
 /// DLL-exported function, so the function name must be unique as namespaces are ignored.
+/// Calls are timed by <see cref="xloil::Profile"/> when profiling is enabled.
 /// </summary>
 #define XLO_FUNC_START(func) \
   XLO_ENTRY_POINT(XLOIL_XLOPER*) func; \
   XLOIL_XLOPER* __stdcall func \
   { \
+    static const auto _xloil_profileId = ::xloil::Profile::functionId(__FUNCTION__); \
+    ::xloil::Profile::CallTimer _xloil_timer(_xloil_profileId); \
     try 
 
 #ifdef XLO_RETURN_COM_ERROR
@@ -32,10 +36,12 @@ namespace xloil {
     XLO_RETURN_COM_ERROR \
     catch (const ::std::exception& err) \
     { \
+      _xloil_timer.failed(); \
       return ::xloil::returnValue(err); \
     } \
     catch (...) \
     { \
+      _xloil_timer.failed(); \
       return ::xloil::returnValue(::xloil::CellError::Value); \
     } \
   } \
@@ -44,10 +50,12 @@ namespace xloil {
 #define XLO_FUNC_END(func) \
     catch (const ::std::exception& err) \
     { \
+      _xloil_timer.failed(); \
       return ::xloil::returnValue(err); \
     } \
     catch (...) \
     { \
+      _xloil_timer.failed(); \
       return ::xloil::returnValue(::xloil::CellError::Value); \
     } \
   } \
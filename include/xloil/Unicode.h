@@ -0,0 +1,513 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#  define XLOIL_HAS_SSE2
+#  include <emmintrin.h>
+#endif
+
+/// <summary>
+/// Transcoding between UTF-8, UTF-16 and UTF-32 without intermediate
+/// allocation. Each converter writes into a caller supplied buffer and
+/// returns the number of characters the complete conversion requires,
+/// which may exceed the buffer size, in which case the output is
+/// truncated at a character boundary.  Runs of ASCII characters are
+/// converted a block at a time where SSE2 is available.
+///
+/// Invalid input (unpaired surrogates, malformed UTF-8) is replaced with
+/// U+FFFD rather than throwing.
+/// </summary>
+namespace xloil
+{
+  namespace detail
+  {
+    // http://unicode.org/faq/utf_bom.html
+    constexpr char32_t LEAD_OFFSET = (char32_t)(0xD800 - (0x10000 >> 10));
+    constexpr char32_t SURROGATE_OFFSET = (char32_t)(0x10000 - (0xD800 << 10) - 0xDC00);
+    constexpr char32_t HI_SURROGATE_START = 0xD800;
+    constexpr char32_t LO_SURROGATE_START = 0xDC00;
+    constexpr char32_t SURROGATE_END = 0xE000;
+    constexpr char32_t REPLACEMENT_CHAR = 0xFFFD;
+
+    inline bool isHighSurrogate(char32_t c) noexcept
+    {
+      return c >= HI_SURROGATE_START && c < LO_SURROGATE_START;
+    }
+    inline bool isLowSurrogate(char32_t c) noexcept
+    {
+      return c >= LO_SURROGATE_START && c < SURROGATE_END;
+    }
+
+    inline unsigned popcount16(unsigned x) noexcept
+    {
+      x = x - ((x >> 1) & 0x5555);
+      x = (x & 0x3333) + ((x >> 2) & 0x3333);
+      x = (x + (x >> 4)) & 0x0F0F;
+      return (x + (x >> 8)) & 0x1F;
+    }
+
+#ifdef XLOIL_HAS_SSE2
+    /// <summary>
+    /// True if all 8 char16 at the given address are ASCII
+    /// </summary>
+    inline bool isAsciiBlock(__m128i v) noexcept
+    {
+      const auto high = _mm_and_si128(v, _mm_set1_epi16((short)0xFF80));
+      return _mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) == 0xFFFF;
+    }
+#endif
+
+    /// <summary>
+    /// Encodes a code point as UTF-8, writing only if the whole sequence
+    /// fits in the <paramref name="room"/> available.  Returns the length of
+    /// the sequence.
+    /// </summary>
+    inline size_t encodeUtf8(char32_t c, char* target, size_t room) noexcept
+    {
+      if (c < 0x800)
+      {
+        if (room >= 2)
+        {
+          target[0] = (char)(0xC0 | (c >> 6));
+          target[1] = (char)(0x80 | (c & 0x3F));
+        }
+        return 2;
+      }
+      if (c < 0x10000)
+      {
+        if (room >= 3)
+        {
+          target[0] = (char)(0xE0 | (c >> 12));
+          target[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+          target[2] = (char)(0x80 | (c & 0x3F));
+        }
+        return 3;
+      }
+      if (room >= 4)
+      {
+        target[0] = (char)(0xF0 | (c >> 18));
+        target[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+        target[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+        target[3] = (char)(0x80 | (c & 0x3F));
+      }
+      return 4;
+    }
+  }
+
+  /// <summary>
+  /// Returns the number of chars required to encode the UTF-16 string
+  /// as UTF-8
+  /// </summary>
+  inline size_t utf8Length(const char16_t* begin, const char16_t* end) noexcept
+  {
+    size_t n = 0;
+#ifdef XLOIL_HAS_SSE2
+    for (; end - begin >= 8; begin += 8, n += 8)
+    {
+      if (!detail::isAsciiBlock(_mm_loadu_si128((const __m128i*)begin)))
+        break;
+    }
+#endif
+    while (begin < end)
+    {
+      const char32_t c = *begin++;
+      if (c < 0x80)
+        n += 1;
+      else if (c < 0x800)
+        n += 2;
+      else if (detail::isHighSurrogate(c) && begin < end && detail::isLowSurrogate(*begin))
+      {
+        ++begin;
+        n += 4;
+      }
+      else
+        n += 3;
+    }
+    return n;
+  }
+
+  /// <summary>
+  /// Returns the number of char16 required to encode the UTF-8 string
+  /// as UTF-16. This is exact for valid UTF-8 and an upper bound otherwise.
+  /// </summary>
+  inline size_t utf16Length(const char* begin, const char* end) noexcept
+  {
+    size_t n = 0;
+    const auto start = begin;
+#ifdef XLOIL_HAS_SSE2
+    // Every byte which is not a continuation byte (0x80-0xBF) starts a
+    // character, and 4-byte leads (0xF0-0xF7) require a surrogate pair.
+    // A continuation byte is consumed by a lead up to 3 bytes before it
+    // which takes enough continuations, otherwise it is stray and becomes
+    // U+FFFD. The masks hold a bit per byte, shifted up by 3 to hold the 
+    // last 3 bytes of the previous block.
+    const auto contMax = _mm_set1_epi8((char)0xBF);
+    const auto threeMin = _mm_set1_epi8((char)0xDF);
+    const auto fourMin = _mm_set1_epi8((char)0xEF);
+    const auto leadMax = _mm_set1_epi8((char)0xF8);
+    uint32_t prevCont = 0, prevLead2 = 0, prevLead3 = 0, prevLead4 = 0;
+    for (; end - begin >= 16; begin += 16)
+    {
+      const auto v = _mm_loadu_si128((const __m128i*)begin);
+      const auto belowMax = _mm_cmplt_epi8(v, leadMax);
+      const uint32_t starts = _mm_movemask_epi8(_mm_cmpgt_epi8(v, contMax));
+      const uint32_t lead2 = starts & _mm_movemask_epi8(belowMax);
+      const uint32_t lead3 = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(v, threeMin), belowMax));
+      const uint32_t lead4 = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(v, fourMin), belowMax));
+      const uint32_t cont = ~starts & 0xFFFF;
+
+      const auto c = (cont << 3) | prevCont;
+      const auto consumed = c & (
+          (((lead2 << 3) | prevLead2) << 1)
+        | ((((lead3 << 3) | prevLead3) << 2) & (c << 1))
+        | ((((lead4 << 3) | prevLead4) << 3) & (c << 2) & (c << 1)));
+      const auto stray = cont & ~(consumed >> 3);
+
+      n += detail::popcount16(starts) + detail::popcount16(lead4) + detail::popcount16(stray);
+      prevCont = cont >> 13;
+      prevLead2 = lead2 >> 13;
+      prevLead3 = lead3 >> 13;
+      prevLead4 = lead4 >> 13;
+    }
+#endif
+    // Replay up to 3 bytes already counted to find how many continuations
+    // the last lead can still take
+    int remaining = 0;
+    for (auto p = begin - std::min<std::ptrdiff_t>(3, begin - start); p < end; ++p)
+    {
+      const auto b = (unsigned char)*p;
+      const auto counted = p >= begin;
+      if ((b & 0xC0) == 0x80)
+      {
+        if (remaining > 0)
+          --remaining;
+        else
+          n += counted;
+      }
+      else
+      {
+        remaining = b >= 0xF8 ? 0 : b >= 0xF0 ? 3 : b >= 0xE0 ? 2 : b >= 0xC0 ? 1 : 0;
+        if (counted)
+          n += 1 + (b >= 0xF0 && b < 0xF8);
+      }
+    }
+    return n;
+  }
+
+  /// <summary>
+  /// Returns the number of char16 required to encode the UTF-32 string
+  /// as UTF-16
+  /// </summary>
+  inline size_t utf16Length(const char32_t* begin, const char32_t* end) noexcept
+  {
+    size_t n = end - begin;
+    for (; begin < end; ++begin)
+      n += *begin >= 0x10000;
+    return n;
+  }
+
+  /// <summary>
+  /// Copies single-byte chars to UTF-16, i.e. interprets the input as Latin-1.
+  /// </summary>
+  inline void widenLatin1(char16_t* target, const uint8_t* begin, size_t n) noexcept
+  {
+    const auto* end = begin + n;
+#ifdef XLOIL_HAS_SSE2
+    const auto zero = _mm_setzero_si128();
+    for (; end - begin >= 16; begin += 16, target += 16)
+    {
+      const auto v = _mm_loadu_si128((const __m128i*)begin);
+      _mm_storeu_si128((__m128i*)target, _mm_unpacklo_epi8(v, zero));
+      _mm_storeu_si128((__m128i*)(target + 8), _mm_unpackhi_epi8(v, zero));
+    }
+#endif
+    for (; begin < end; ++begin, ++target)
+      *target = *begin;
+  }
+
+  /// <summary>
+  /// Converts a UTF-16 string to UTF-8.
+  /// </summary>
+  struct ConvertUTF16ToUTF8
+  {
+    using to_char = char;
+    using from_char = char16_t;
+
+    size_t operator()(
+      to_char* target,
+      const size_t targetSize,
+      const from_char* begin,
+      const from_char* end) const noexcept
+    {
+      size_t n = 0;
+      while (begin < end)
+      {
+#ifdef XLOIL_HAS_SSE2
+        if (end - begin >= 8 && n + 8 <= targetSize)
+        {
+          const auto v = _mm_loadu_si128((const __m128i*)begin);
+          if (detail::isAsciiBlock(v))
+          {
+            _mm_storel_epi64((__m128i*)(target + n), _mm_packus_epi16(v, v));
+            begin += 8;
+            n += 8;
+            continue;
+          }
+        }
+#endif
+        char32_t c = *begin++;
+        if (c < 0x80)
+        {
+          if (n < targetSize)
+            target[n] = (char)c;
+          ++n;
+          continue;
+        }
+        if (detail::isHighSurrogate(c) && begin < end && detail::isLowSurrogate(*begin))
+          c = (c << 10) + *begin++ + detail::SURROGATE_OFFSET;
+        else if (c >= detail::HI_SURROGATE_START && c < detail::SURROGATE_END)
+          c = detail::REPLACEMENT_CHAR;
+        n += detail::encodeUtf8(c, target + (n < targetSize ? n : 0), n < targetSize ? targetSize - n : 0);
+      }
+      return n;
+    }
+    size_t operator()(
+      to_char* target,
+      const size_t size,
+      const wchar_t* begin,
+      const wchar_t* end) const noexcept
+    {
+      return (*this)(target, size, (const from_char*)begin, (const from_char*)end);
+    }
+  };
+
+  /// <summary>
+  /// Converts a UTF-8 string to UTF-16.
+  /// </summary>
+  struct ConvertUTF8ToUTF16
+  {
+    using to_char = char16_t;
+    using from_char = char;
+
+    size_t operator()(
+      to_char* target,
+      const size_t targetSize,
+      const from_char* begin,
+      const from_char* end) const noexcept
+    {
+      size_t n = 0;
+      while (begin < end)
+      {
+#ifdef XLOIL_HAS_SSE2
+        if (end - begin >= 16 && n + 16 <= targetSize)
+        {
+          const auto v = _mm_loadu_si128((const __m128i*)begin);
+          if (_mm_movemask_epi8(v) == 0)
+          {
+            const auto zero = _mm_setzero_si128();
+            _mm_storeu_si128((__m128i*)(target + n), _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128((__m128i*)(target + n + 8), _mm_unpackhi_epi8(v, zero));
+            begin += 16;
+            n += 16;
+            continue;
+          }
+        }
+#endif
+        const auto b = (unsigned char)*begin++;
+        if (b < 0x80)
+        {
+          if (n < targetSize)
+            target[n] = b;
+          ++n;
+          continue;
+        }
+        int extra;
+        char32_t c, minValue;
+        // Stray continuation bytes and invalid leads
+        if ((b & 0xC0) == 0x80 || b >= 0xF8)
+          extra = 0, c = detail::REPLACEMENT_CHAR, minValue = 0;
+        else if (b >= 0xF0)
+          extra = 3, c = b & 0x07, minValue = 0x10000;
+        else if (b >= 0xE0)
+          extra = 2, c = b & 0x0F, minValue = 0x800;
+        else
+          extra = 1, c = b & 0x1F, minValue = 0x80;
+
+        int i = 0;
+        for (; i < extra && begin < end && (*begin & 0xC0) == 0x80; ++i)
+          c = (c << 6) | (*begin++ & 0x3F);
+
+        // Reject truncated sequences, overlong encodings, encoded
+        // surrogates and values beyond the unicode range
+        if (i < extra || c < minValue || c > 0x10FFFF
+          || (c >= detail::HI_SURROGATE_START && c < detail::SURROGATE_END))
+          c = detail::REPLACEMENT_CHAR;
+
+        if (c < 0x10000)
+        {
+          if (n < targetSize)
+            target[n] = (char16_t)c;
+          ++n;
+        }
+        else
+        {
+          if (n + 1 < targetSize)
+          {
+            target[n] = (char16_t)(detail::LEAD_OFFSET + (c >> 10));
+            target[n + 1] = (char16_t)(0xDC00 + (c & 0x3FF));
+          }
+          n += 2;
+        }
+      }
+      return n;
+    }
+    size_t operator()(
+      wchar_t* target,
+      const size_t size,
+      const from_char* begin,
+      const from_char* end) const noexcept
+    {
+      return (*this)((to_char*)target, size, begin, end);
+    }
+  };
+
+  /// <summary>
+  /// Concerts a UTF-16 wchar_t string to a UTF-32 char32_t one.
+  /// This string conversion appears to be missing from the standard codecvt
+  /// library as of C++17.
+  /// </summary>
+  struct ConvertUTF16ToUTF32
+  {
+    using to_char = char32_t;
+    using from_char = char16_t;
+
+    size_t operator()(
+      to_char* target,
+      const size_t targetSize,
+      const from_char* begin,
+      const from_char* end) const noexcept
+    {
+      size_t n = 0;
+      while (begin < end)
+      {
+#ifdef XLOIL_HAS_SSE2
+        if (end - begin >= 8 && n + 8 <= targetSize)
+        {
+          // No surrogates means a straight widening
+          const auto v = _mm_loadu_si128((const __m128i*)begin);
+          const auto surrogates = _mm_cmpeq_epi16(
+            _mm_and_si128(v, _mm_set1_epi16((short)0xF800)),
+            _mm_set1_epi16((short)0xD800));
+          if (_mm_movemask_epi8(surrogates) == 0)
+          {
+            const auto zero = _mm_setzero_si128();
+            _mm_storeu_si128((__m128i*)(target + n), _mm_unpacklo_epi16(v, zero));
+            _mm_storeu_si128((__m128i*)(target + n + 4), _mm_unpackhi_epi16(v, zero));
+            begin += 8;
+            n += 8;
+            continue;
+          }
+        }
+#endif
+        char32_t c = *begin++;
+        if (detail::isHighSurrogate(c) && begin < end && detail::isLowSurrogate(*begin))
+          c = (c << 10) + *begin++ + detail::SURROGATE_OFFSET;
+        else if (c >= detail::HI_SURROGATE_START && c < detail::SURROGATE_END)
+          c = detail::REPLACEMENT_CHAR;
+        // If we are past the end of the buffer, carry on so we can
+        // determine the required buffer length, but do not write
+        // any characters
+        if (n < targetSize)
+          target[n] = c;
+        ++n;
+      }
+      return n;
+    }
+    size_t operator()(
+      to_char* target,
+      const size_t size,
+      const wchar_t* begin,
+      const wchar_t* end) const noexcept
+    {
+      return (*this)(target, size, (const from_char*)begin, (const from_char*)end);
+    }
+  };
+
+  struct ConvertUTF32ToUTF16
+  {
+    using from_char = char32_t;
+    using to_char = char16_t;
+
+    static void convertChar(char32_t codepoint, char16_t &h, char16_t &l) noexcept
+    {
+      if (codepoint < 0x10000)
+      {
+        h = (char16_t)codepoint;
+        l = 0;
+        return;
+      }
+      h = (char16_t)(detail::LEAD_OFFSET + (codepoint >> 10));
+      l = (char16_t)(0xDC00 + (codepoint & 0x3FF));
+    }
+
+    size_t operator()(
+      to_char* target,
+      const size_t targetSize,
+      const from_char* begin,
+      const from_char* end) const noexcept
+    {
+      size_t n = 0;
+      to_char lead, trail;
+      while (begin != end)
+      {
+#ifdef XLOIL_HAS_SSE2
+        if (end - begin >= 8 && n + 8 <= targetSize)
+        {
+          // Values below 0x8000 survive the signed saturating pack unchanged
+          const auto v1 = _mm_loadu_si128((const __m128i*)begin);
+          const auto v2 = _mm_loadu_si128((const __m128i*)(begin + 4));
+          const auto high = _mm_and_si128(_mm_or_si128(v1, v2), _mm_set1_epi32((int)0xFFFF8000));
+          if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) == 0xFFFF)
+          {
+            _mm_storeu_si128((__m128i*)(target + n), _mm_packs_epi32(v1, v2));
+            begin += 8;
+            n += 8;
+            continue;
+          }
+        }
+#endif
+        convertChar(*begin++, lead, trail);
+        // If we are past the end of the buffer, carry on so we can
+        // determine the required buffer length, but do not write
+        // any characters
+        if (trail == 0)
+        {
+          if (n < targetSize)
+            target[n] = lead;
+          ++n;
+        }
+        else
+        {
+          if (n + 1 < targetSize)
+          {
+            target[n] = lead;
+            target[n + 1] = trail;
+          }
+          n += 2;
+        }
+      }
+      return n;
+    }
+    size_t operator()(
+      wchar_t* target,
+      const size_t size,
+      const from_char* begin,
+      const from_char* end) const noexcept
+    {
+      return (*this)((to_char*)target, size, begin, end);
+    }
+  };
+}
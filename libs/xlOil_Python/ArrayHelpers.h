@@ -9,7 +9,7 @@ namespace xloil
     inline void accumulateObjectStringLength(PyObject* p, size_t& strLength)
     {
       if (PyUnicode_Check(p))
-        strLength += PyUnicode_GetLength(p);
+        strLength += pyUnicodeToUtf16(p, nullptr, 0);
       else if (!PyFloat_Check(p) && !PyLong_Check(p) && !PyBool_Check(p))
         strLength += CACHE_KEY_MAX_LEN;
     }
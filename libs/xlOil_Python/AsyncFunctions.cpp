@@ -12,6 +12,7 @@
 #include <xloil/StaticRegister.h>
 #include <xloil/Caller.h>
 #include <CTPL/ctpl_stl.h>
+#include <mutex>
 #include <vector>
 
 using std::shared_ptr;
@@ -32,6 +33,51 @@ namespace xloil
       return *theCoreAddin()->thread;
     }
 
+    namespace
+    {
+      /// <summary>
+      /// Collects results of native async functions so they are returned
+      /// to Excel in batches with a single xlAsyncReturn. The first result
+      /// added to an empty queue schedules a flush on the event loop, so 
+      /// results which complete in the same loop iteration share a batch.
+      /// </summary>
+      class AsyncReturnQueue
+      {
+      public:
+        void push(const ExcelObj& asyncHandle, ExcelObj&& value)
+        {
+          bool first;
+          {
+            std::scoped_lock lock(_lock);
+            first = _handles.empty();
+            _handles.push_back(asyncHandle);
+            _values.emplace_back(std::move(value));
+          }
+          if (first)
+            asyncEventLoop().callback(py::cpp_function([this]() { flush(); }));
+        }
+
+        void flush()
+        {
+          vector<ExcelObj> handles, values;
+          {
+            std::scoped_lock lock(_lock);
+            handles.swap(_handles);
+            values.swap(_values);
+          }
+          py::gil_scoped_release releaseGil;
+          asyncReturn(handles.data(), values.data(), handles.size());
+        }
+
+      private:
+        std::mutex _lock;
+        vector<ExcelObj> _handles;
+        vector<ExcelObj> _values;
+      };
+
+      AsyncReturnQueue theAsyncReturns;
+    }
+
     struct AsyncReturn : public AsyncHelper
     {
       AsyncReturn(
@@ -60,10 +106,9 @@ namespace xloil
 
       void set_result(const py::object& value)
       {
-        static ExcelObj obj = _returnConverter
+        theAsyncReturns.push(asyncHandle(), _returnConverter
           ? (*_returnConverter)(*value.ptr())
-          : FromPyObj()(value.ptr());
-        result(obj);
+          : FromPyObj()(value.ptr()));
       }
       void set_done()
       {}
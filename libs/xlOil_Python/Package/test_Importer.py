@@ -0,0 +1,178 @@
+import unittest
+import importlib.util
+import logging
+import os
+import sys
+import tempfile
+import types
+from pathlib import Path
+
+from TestConfig import *
+
+
+class _Record:
+    """
+        Stands in for the core's function and argument spec classes
+    """
+    def __init__(self, **kwargs):
+        self.__dict__.update(kwargs)
+
+
+def _load_importer(registered):
+    """
+        importer.py needs the core addin, so load it with stand-ins for the
+        core and its sibling modules. Registered specs are appended to
+        `registered`.
+    """
+    core = types.ModuleType("xloil_core")
+    core._FuncSpec = _Record
+    core._FuncArg = _Record
+    core._Read_object = object
+    core._register_functions = lambda specs, module, addin, append: registered.append((specs, module))
+
+    package = types.ModuleType("_xloil_test")
+    package.__path__ = []
+
+    register = types.ModuleType("_xloil_test.register")
+    register.scan_module = lambda module, addin=None: None
+    register._clear_pending_registrations = lambda: None
+    register._REGISTERED_TAG = "_xloil_funcs"
+
+    status_bar = types.ModuleType("_xloil_test._core")
+    status_bar.StatusBar = None
+
+    log = logging.getLogger("test_Importer")
+    log_module = types.ModuleType("_xloil_test.logging")
+    log_module.log = log
+    log_module.log_except = log.exception
+
+    modules = {
+        "xloil_core": core,
+        "_xloil_test": package,
+        "_xloil_test.register": register,
+        "_xloil_test._core": status_bar,
+        "_xloil_test.logging": log_module,
+    }
+    # The importer installs import hooks when loaded, which we undo. Only
+    # the stand-ins are removed afterwards: modules which the importer loads
+    # must stay in sys.modules.
+    path_hooks, meta_path = list(sys.path_hooks), list(sys.meta_path)
+    sys.modules.update(modules)
+    try:
+        spec = importlib.util.spec_from_file_location(
+            "_xloil_test.importer", PACKAGE_PATH / "xloil" / "importer.py")
+        importer = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(importer)
+    finally:
+        for name in modules:
+            del sys.modules[name]
+        sys.path_hooks[:] = path_hooks
+        sys.meta_path[:] = meta_path
+        sys.path_importer_cache.clear()
+    return importer
+
+
+def _spec(name, features=""):
+    args = [
+        _Record(name="x", help="An x", special_type="", has_default=False),
+        _Record(name="y", help="", special_type="range", has_default=True)
+    ]
+    return _Record(
+        name=name, help=f"Help for {name}", category="Test", features=features,
+        volatile=False, local=True, has_kwargs=False, args=args)
+
+
+class Test_Importer(unittest.TestCase):
+
+    def setUp(self):
+        self.registered = []
+        self.importer = _load_importer(self.registered)
+        self.directory = tempfile.TemporaryDirectory()
+        self.source = os.path.join(self.directory.name, "funcs.py")
+        Path(self.source).write_text("def f(x, y=None): return x\n")
+        self.module = types.ModuleType("funcs")
+        self.module.__file__ = self.source
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def test_ManifestRoundTrip(self):
+        specs = [_spec("f"), _spec("g", "macro")]
+        self.importer._write_manifest(self.module, specs)
+        self.assertTrue(os.path.exists(self.importer._manifest_path(self.source)))
+
+        funcs = self.importer._read_manifest(self.source)
+        self.assertEqual(len(funcs), 2)
+
+        func = lambda name: None
+        for spec, info in zip(specs, funcs):
+            result = self.importer._spec_from_dict(info, func)
+            self.assertTrue(result.lazy)
+            self.assertIs(result.func, func)
+            for attr in ["name", "help", "category", "features", "volatile", "local", "has_kwargs"]:
+                self.assertEqual(getattr(result, attr), getattr(spec, attr))
+            self.assertEqual([a.name for a in result.args], ["x", "y"])
+            self.assertEqual([a.special_type for a in result.args], ["", "range"])
+            self.assertEqual([hasattr(a, "default") for a in result.args], [False, True])
+
+    def test_StaleManifest(self):
+        self.importer._write_manifest(self.module, [_spec("f")])
+
+        # A changed mtime alone does not invalidate the manifest, e.g. after a copy
+        stat = os.stat(self.source)
+        os.utime(self.source, ns=(stat.st_atime_ns, stat.st_mtime_ns + 10**9))
+        self.assertIsNotNone(self.importer._read_manifest(self.source))
+
+        # Changed source does
+        Path(self.source).write_text("def f(x, y=None, z=None): return x\n")
+        os.utime(self.source, ns=(stat.st_atime_ns, stat.st_mtime_ns + 2 * 10**9))
+        self.assertIsNone(self.importer._read_manifest(self.source))
+
+        # As does a manifest from a different version of xlOil
+        self.importer._write_manifest(self.module, [_spec("f")])
+        self.importer._MANIFEST_VERSION += 1
+        self.assertIsNone(self.importer._read_manifest(self.source))
+
+        # Or a corrupt manifest
+        Path(self.importer._manifest_path(self.source)).write_text("{")
+        self.assertIsNone(self.importer._read_manifest(self.source))
+
+    def test_NoManifestForAsync(self):
+        self.importer._write_manifest(self.module, [_spec("f")])
+        self.importer._write_manifest(self.module, [_spec("f"), _spec("g", "async")])
+        self.assertFalse(os.path.exists(self.importer._manifest_path(self.source)))
+        self.assertIsNone(self.importer._read_manifest(self.source))
+
+    def test_LazyRegistration(self):
+        self.importer._write_manifest(self.module, [_spec("f")])
+
+        real_spec = _spec("f")
+        imports = []
+        def import_module():
+            imports.append(1)
+            self.module._xloil_funcs = { "f": real_spec }
+            return self.module
+
+        self.assertTrue(self.importer._register_lazy(
+            self.source, "funcs", None, import_module, background=False))
+        self.assertEqual(imports, [])
+
+        [(specs, placeholder)] = self.registered
+        self.assertEqual(placeholder.__file__, self.source)
+
+        # The first call imports the module and returns the real spec
+        self.assertIs(specs[0].func("f"), real_spec)
+        self.assertIs(specs[0].func("f"), real_spec)
+        self.assertEqual(imports, [1])
+
+        with self.assertRaises(Exception):
+            specs[0].func("removed")
+
+        # Without an up-to-date manifest, the module must be imported
+        Path(self.source).write_text("")
+        self.assertFalse(self.importer._register_lazy(
+            self.source, "funcs", None, import_module, background=False))
+
+
+if __name__ == '__main__':
+    unittest.main()
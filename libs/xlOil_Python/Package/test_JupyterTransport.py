@@ -0,0 +1,147 @@
+import unittest
+import ast
+import json
+
+from TestConfig import *
+
+import numpy as np
+
+
+def _load_kernel_impl():
+    """
+        jupyter_kernel.py is sent as source to the kernel, so load it the same
+        way rather than importing xloil, which needs the core addin
+    """
+    source = (PACKAGE_PATH / "xloil" / "jupyter_kernel.py").read_text()
+    namespace = {}
+    exec(source, namespace)
+    return source, namespace["_xlOilJupyterImpl"]
+
+
+class Test_JupyterTransport(unittest.TestCase):
+
+    def setUp(self):
+        self.source, self.impl = _load_kernel_impl()
+
+    def _round_trip(self, value):
+        packed = json.loads(json.dumps(self.impl._pack(value)))
+        try:
+            return packed, self.impl._unpack(packed)
+        finally:
+            if "shm" in packed:
+                self.impl._release(packed["shm"])
+
+    def test_SmallValuesArePickled(self):
+        for value in [1, "abc", [1, 2.5, None], np.arange(10)]:
+            packed, result = self._round_trip(value)
+            self.assertIn("pickle", packed)
+            np.testing.assert_equal(result, value)
+
+    def test_ArrayInSharedMemory(self):
+        for value in [np.arange(100000, dtype=np.float64).reshape(1000, 100),
+                      np.arange(20000, dtype=np.int32),
+                      np.arange(10000).astype("M8[D]")]:
+            packed, result = self._round_trip(value)
+            self.assertIn("shm", packed)
+            self.assertEqual(result.dtype, value.dtype)
+            np.testing.assert_array_equal(result, value)
+
+        # Non-contiguous arrays are copied
+        value = np.arange(200000, dtype=np.float64).reshape(1000, 200)[:, ::2]
+        packed, result = self._round_trip(value)
+        np.testing.assert_array_equal(result, value)
+
+    def test_DataFrameInSharedMemory(self):
+        try:
+            import pandas as pd
+        except ImportError:
+            self.skipTest("pandas not installed")
+
+        n = 20000
+        strings = np.array([None if i % 7 == 0 else f"s{i % 13}é" for i in range(n)], dtype=object)
+        df = pd.DataFrame({ "x": np.arange(n, dtype=np.float64), "s": strings, 3: np.arange(n) % 2 == 0 })
+        packed, result = self._round_trip(df)
+        self.assertIn("shm", packed)
+        # Strings come back as object columns whatever pandas' string dtype
+        pd.testing.assert_frame_equal(result, df, check_dtype=False)
+
+        df.index = pd.Index([f"row{i}" for i in range(n)], dtype=object)
+        packed, result = self._round_trip(df)
+        pd.testing.assert_frame_equal(result, df, check_dtype=False, check_index_type=False)
+
+    def test_OwnerReleasesPreviousSegment(self):
+        value = np.zeros(100000)
+        first = self.impl._pack(value, owner="x")
+        second = self.impl._pack(value, owner="x")
+        self.assertNotIn(first["shm"], self.impl._segments)
+        self.assertIn(second["shm"], self.impl._segments)
+        self.impl._release(second["shm"])
+        self.assertEqual(len(self.impl._segment_owners), 0)
+
+    def test_WatchedVariableVersions(self):
+        published = []
+
+        class Events:
+            def register(self, name, func): pass
+            def unregister(self, name, func): pass
+
+        class Shell:
+            events = Events()
+            user_ns = { "a": 1 }
+
+        watcher = self.impl._MonitoredVariables(Shell())
+        # Record non-empty updates as the real _publish would send them
+        watcher._publish = lambda updates: updates and published.append(dict(updates))
+
+        watcher.watch("a")
+        self.assertEqual(published, [{ "a": 1 }])
+
+        # Resubscribing with the current version does not re-send the value
+        watcher.watch("a", known_version=1)
+        watcher.post_execute()
+        self.assertEqual(len(published), 1)
+
+        Shell.user_ns["a"] = 2
+        watcher.post_execute()
+        self.assertEqual(published[-1], { "a": 2 })
+        self.assertEqual(watcher._versions["a"], 2)
+
+    def test_LocalKernel(self):
+        """
+            Packs a large array in a local kernel and reads it in this process
+            via shared memory, as the Excel side does
+        """
+        try:
+            from jupyter_client.manager import start_new_kernel
+        except ImportError:
+            self.skipTest("jupyter_client not installed")
+
+        manager, client = start_new_kernel()
+        try:
+            def execute(code, expressions={}):
+                reply = client.execute_interactive(
+                    code, user_expressions=expressions, timeout=60, output_hook=lambda msg: None)
+                self.assertEqual(reply["content"]["status"], "ok")
+                return reply["content"].get("user_expressions", {})
+
+            execute(self.source)
+            result = execute(
+                "import numpy as np, json\n"
+                "_packed = _xlOilJupyterImpl._pack(np.arange(50000, dtype=np.float64))",
+                { "packed": "json.dumps(_packed)" })
+            packed = json.loads(ast.literal_eval(result["packed"]["data"]["text/plain"]))
+            self.assertIn("shm", packed)
+
+            value = self.impl._unpack(packed)
+            np.testing.assert_array_equal(value, np.arange(50000, dtype=np.float64))
+
+            execute(f"_xlOilJupyterImpl._release('{packed['shm']}')")
+            result = execute("", { "n": "len(_xlOilJupyterImpl._segments)" })
+            self.assertEqual(result["n"]["data"]["text/plain"], "0")
+        finally:
+            client.stop_channels()
+            manager.shutdown_kernel(now=True)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -22,6 +22,187 @@ class _xlOilJupyterImpl:
             return { k: v for k, v in x.__dict__.items() if v is not cls.Arg._EMPTY }
         return json.dumps(obj, default=f)
 
+    # Arrays and DataFrames whose data exceed this many bytes are passed through
+    # shared memory, anything smaller is pickled into the message itself
+    _SHM_THRESHOLD = 1 << 16
+
+    # Shared memory segments created by this process, by name. They are kept
+    # open until the reader releases them: on Windows a segment is destroyed
+    # as soon as its last handle is closed.
+    _segments = dict()
+    _segment_owners = dict()
+
+    @staticmethod
+    def _column(np, values):
+        """
+        Returns a description and list of buffers for a 1-d numpy array, or None 
+        if there is no columnar form. Strings are stored as UTF-8 data with int64
+        offsets and a null mask.
+        """
+        if values.dtype.kind in "biufmM":
+            return { "type": "numeric", "dtype": values.dtype.str }, [values]
+        if values.dtype.kind not in "OU":
+            return None
+        encoded = []
+        for x in values:
+            if isinstance(x, str):
+                encoded.append(x.encode('utf-8'))
+            # pandas string columns give NaN rather than None for missing values
+            elif x is None or (isinstance(x, float) and x != x):
+                encoded.append(None)
+            else:
+                return None
+        offsets = np.zeros(len(encoded) + 1, dtype=np.int64)
+        offsets[1:] = np.cumsum([0 if x is None else len(x) for x in encoded])
+        nulls = np.array([x is None for x in encoded], dtype=np.bool_)
+        data = b"".join(x for x in encoded if x is not None)
+        return { "type": "string" }, [offsets, np.frombuffer(data, dtype=np.uint8), nulls]
+
+    @classmethod
+    def _columns(cls, obj):
+        """
+        Splits a numpy array or pandas DataFrame into a layout description and a 
+        list of buffers, or returns None if the object has no columnar form. 
+        Neither numpy nor pandas is imported if the caller has not already done so.
+        """
+        import sys
+        np = sys.modules.get("numpy", None)
+        pd = sys.modules.get("pandas", None)
+
+        if np is not None and isinstance(obj, np.ndarray):
+            if obj.ndim not in (1, 2) or obj.dtype.kind not in "biufmM":
+                return None
+            return { "kind": "ndarray", "shape": list(obj.shape), "dtype": obj.dtype.str }, [obj]
+
+        if pd is not None and isinstance(obj, pd.DataFrame):
+            if obj.columns.has_duplicates or not all(isinstance(x, (str, int)) for x in obj.columns):
+                return None
+            layout = { "kind": "dataframe", "nrows": len(obj), "columns": [], "index": None }
+            buffers = []
+            for name in obj.columns:
+                column = cls._column(np, obj[name].to_numpy())
+                if column is None:
+                    return None
+                column[0]["name"] = name
+                layout["columns"].append(column[0])
+                buffers += column[1]
+            index = obj.index
+            if isinstance(index, pd.RangeIndex):
+                layout["range_index"] = [index.start, index.stop, index.step]
+            else:
+                column = cls._column(np, index.to_numpy())
+                if column is None:
+                    return None
+                layout["index"] = column[0]
+                buffers += column[1]
+            return layout, buffers
+
+        return None
+
+    @classmethod
+    def _pack(cls, obj, owner=None):
+        """
+        Returns a json-serialisable description of obj. Large numpy arrays and 
+        DataFrames are written column-by-column to a shared memory segment and
+        only its name and layout are returned, anything else is pickled. The 
+        segment is released by the reader or, if an owner is given, when 
+        another segment is packed for the same owner.
+        """
+        try:
+            columnar = cls._columns(obj)
+        except Exception:
+            columnar = None
+
+        if columnar is not None:
+            layout, buffers = columnar
+            buffers = [x.reshape(-1).view("u1") if x.flags.c_contiguous 
+                       else x.copy(order='C').reshape(-1).view("u1") 
+                       for x in buffers]
+            sizes = [len(x) for x in buffers]
+            if sum(sizes) >= cls._SHM_THRESHOLD:
+                from multiprocessing import shared_memory
+                # Keep each buffer 8-byte aligned
+                offsets = []
+                total = 0
+                for size in sizes:
+                    offsets.append(total)
+                    total += (size + 7) & ~7
+                shm = shared_memory.SharedMemory(create=True, size=max(total, 8))
+                for buffer, offset, size in zip(buffers, offsets, sizes):
+                    shm.buf[offset:offset + size] = buffer
+                cls._segments[shm.name] = shm
+                if owner is not None:
+                    previous = cls._segment_owners.pop(owner, None)
+                    if previous is not None:
+                        cls._release(previous)
+                    cls._segment_owners[owner] = shm.name
+                return { "shm": shm.name, "layout": layout, "offsets": offsets, "sizes": sizes }
+
+        return { "pickle": cls._pickle(obj) }
+
+    @staticmethod
+    def _unpack_column(np, desc, buffers, n):
+        if desc["type"] == "numeric":
+            return next(buffers).view(np.dtype(desc["dtype"]))
+        offsets = next(buffers).view(np.int64)
+        data = next(buffers).tobytes()
+        nulls = next(buffers).view(np.bool_)
+        values = np.empty(n, dtype=object)
+        for i in range(n):
+            if not nulls[i]:
+                values[i] = data[offsets[i]:offsets[i + 1]].decode('utf-8')
+        return values
+
+    @classmethod
+    def _unpack(cls, packed):
+        """
+        Reverses _pack. Data in shared memory is copied out, so the segment may
+        be released as soon as this returns.
+        """
+        if "pickle" in packed:
+            return cls._unpickle(packed["pickle"])
+
+        from multiprocessing import shared_memory
+        import numpy as np
+
+        shm = shared_memory.SharedMemory(name=packed["shm"])
+        try:
+            buffers = [np.frombuffer(shm.buf, dtype=np.uint8, count=size, offset=offset).copy() 
+                       for offset, size in zip(packed["offsets"], packed["sizes"])]
+        finally:
+            shm.close()
+
+        layout = packed["layout"]
+        if layout["kind"] == "ndarray":
+            return buffers[0].view(np.dtype(layout["dtype"])).reshape(layout["shape"])
+
+        import pandas as pd
+        n = layout["nrows"]
+        buffers = iter(buffers)
+        data = { desc["name"]: cls._unpack_column(np, desc, buffers, n) 
+                 for desc in layout["columns"] }
+        if layout["index"] is not None:
+            index = pd.Index(cls._unpack_column(np, layout["index"], buffers, n))
+        else:
+            index = pd.RangeIndex(*layout["range_index"])
+        return pd.DataFrame(data, index=index, columns=[x["name"] for x in layout["columns"]])
+
+    @classmethod
+    def _release(cls, name):
+        """
+        Closes a shared memory segment created by _pack
+        """
+        shm = cls._segments.pop(name, None)
+        if shm is None:
+            return
+        for owner in [k for k, v in cls._segment_owners.items() if v == name]:
+            del cls._segment_owners[owner]
+        shm.close()
+        try:
+            shm.unlink() # No-op on Windows
+        except FileNotFoundError:
+            pass
+
     class _MonitoredVariables:
         """
         Created within the jupyter kernel to hook the 'post_execute' event and watch
@@ -30,6 +211,10 @@ class _xlOilJupyterImpl:
         def __init__(self, ipy_shell):
 
             self._values = dict()
+            # Incremented each time a variable changes, so the receiver can
+            # tell if it already has the latest value. Retained after stop_watch
+            # so versions never go backwards.
+            self._versions = dict()
             self._shell = ipy_shell
 
             # Hook post_execute
@@ -45,19 +230,37 @@ class _xlOilJupyterImpl:
                 if not that_val is val:
                     updates[name] = that_val
                     self._values[name] = that_val
+                    self._versions[name] = self._versions.get(name, 0) + 1
 
-            if len(updates) > 0:
-                from IPython.display import publish_display_data
-                publish_display_data(
-                    { "xloil/data": _xlOilJupyterImpl._pickle(updates) },
-                    { 'type': "VariableChange" }
-                )
+            self._publish(updates)
 
-        def watch(self, name):
+        def _publish(self, updates):
+            if len(updates) == 0:
+                return
+
+            import json
+            from IPython.display import publish_display_data
+            # Large values go via shared memory, owned by the variable name so
+            # the previous value's segment is released when it changes
+            message = { 
+                name: { 
+                    "version": self._versions[name], 
+                    "value": _xlOilJupyterImpl._pack(value, owner=name) 
+                } for name, value in updates.items() 
+            }
+            publish_display_data(
+                { "xloil/data": json.dumps(message) },
+                { 'type': "VariableChange" }
+            )
+
+        def watch(self, name, known_version=0):
             # Starts monitoring the given variable name
-            self._values[name] = globals().get(name, None)
-            # Run the hook now to publish the variable
-            self.post_execute()
+            if not name in self._values:
+                self._values[name] = self._shell.user_ns.get(name, None)
+                self._versions[name] = self._versions.get(name, 0) + 1
+            # Publish the variable now unless the caller already has this version
+            if self._versions[name] != known_version:
+                self._publish({ name: self._values[name] })
 
         def stop_watch(self, name):
             # Stops monitoring the given variable name
@@ -79,13 +282,14 @@ class _xlOilJupyterImpl:
 
     @classmethod
     def _function_invoke(cls, func, args_data, kwargs_data):
+        import json
         from IPython.display import publish_display_data
 
-        args   = cls._unpickle(args_data)
-        kwargs = cls._unpickle(kwargs_data)
+        args   = [cls._unpack(x) for x in json.loads(args_data)]
+        kwargs = { k: cls._unpack(v) for k, v in json.loads(kwargs_data).items() }
         result = func(*args, **kwargs)
         publish_display_data(
-            { "xloil/data": cls._pickle(result) },
+            { "xloil/data": json.dumps(cls._pack(result)) },
             { 'type': "FuncResult" }
         )
         #return result # Not used, just in case tho
@@ -43,6 +43,8 @@ __all__ = [
     "cache",
     "call",
     "call_async",
+    "call_batch",
+    "call_batch_async",
     "deregister_functions",
     "event",
     "excel_callback",
@@ -51,8 +53,13 @@ __all__ = [
     "get_async_loop",
     "in_wizard",
     "insert_cell_image",
+    "profile_enable",
+    "profile_reset",
+    "profile_stats",
     "run",
-    "run_async"
+    "run_async",
+    "run_batch",
+    "run_batch_async"
 ]
 
 
@@ -675,6 +682,11 @@ class Range():
 
         x[:-1, :-1] # A sub-range omitting the last row and column
 
+    Cell values are read from Excel in blocks of whole rows which are cached, so
+    iterating over a range or indexing its cells does not make one call to Excel
+    per cell. The cache is discarded when any Range is set or cleared, when a sheet
+    changes and after each calculation.
+
     See `Excel.Range <https://docs.microsoft.com/en-us/office/vba/api/excel.Range(object)>`_ 
     """
     def __getattr__(self, arg0: str) -> object: ...
@@ -1424,6 +1436,34 @@ class _CustomReturnConverter():
     def value(self, arg0: IPyToExcel) -> None:
         pass
     pass
+class _BatchFuture():
+    """
+    A Future represents an eventual result of an asynchronous operation.
+    Future is an awaitable object. Coroutines can await on Future objects 
+    until they either have a result or an exception set. This Future cannot
+    be cancelled.
+
+    This class actually wraps a C++ future so does executes in a separate 
+    thread unrelated to an `asyncio` event loop. 
+    """
+    def __await__(self) -> _BatchFutureIter: ...
+    def done(self) -> bool: 
+        """
+        Return True if the Future is done.  A Future is done if it has a result or an exception.
+        """
+    def result(self) -> object: 
+        """
+        Return the result of the Future, blocking if the Future is not yet done.
+
+        If the Future has a result, its value is returned.
+
+        If the Future has an exception, raises the exception.
+        """
+    pass
+class _BatchFutureIter():
+    def __iter__(self) -> object: ...
+    def __next__(self) -> None: ...
+    pass
 class _ExcelObjFuture():
     """
     A Future represents an eventual result of an asynchronous operation.
@@ -1494,6 +1534,11 @@ class _FuncArg():
     @special_type.setter
     def special_type(self, arg0: str) -> None:
         pass
+    @property
+    def has_default(self) -> bool:
+        """
+        :type: bool
+        """
     pass
 class _FuncSpec():
     def __init__(self, func: function, args: typing.List[_FuncArg], name: str = '', features: str = None, help: str = '', category: str = '', local: bool = True, volatile: bool = False, has_kwargs: bool = False) -> None: ...
@@ -1504,11 +1549,39 @@ class _FuncSpec():
         :type: typing.List[_FuncArg]
         """
     @property
+    def category(self) -> str:
+        """
+        :type: str
+        """
+    @property
+    def features(self) -> str:
+        """
+        :type: str
+        """
+    @property
+    def has_kwargs(self) -> bool:
+        """
+        :type: bool
+        """
+    @property
     def help(self) -> str:
         """
         :type: str
         """
     @property
+    def lazy(self) -> bool:
+        """
+        :type: bool
+        """
+    @lazy.setter
+    def lazy(self, arg1: bool) -> None:
+        pass
+    @property
+    def local(self) -> bool:
+        """
+        :type: bool
+        """
+    @property
     def name(self) -> str:
         """
         :type: str
@@ -1521,6 +1594,11 @@ class _FuncSpec():
     @return_converter.setter
     def return_converter(self, arg1: IPyToExcel) -> None:
         pass
+    @property
+    def volatile(self) -> bool:
+        """
+        :type: bool
+        """
     pass
 class _Future():
     def __await__(self) -> _FutureIter: ...
@@ -1817,6 +1895,30 @@ def call_async(func: object, *args) -> _ExcelObjFuture:
 
     Returns an **awaitable**, i.e. a future which holds the result.
     """
+def call_batch(calls: object) -> object:
+    """
+    Calls a sequence of built-in worksheet functions, commands or user-defined
+    functions. Each item is a tuple `(func, args)` where `func` is as for 
+    ``xloil.call`` and `args` is a list or tuple of arguments or a single 
+    argument. The args may be omitted, i.e. `(func,)`.
+
+    All the calls are made in one trip to Excel's main thread, which is much 
+    faster than calling ``xloil.call`` for each item. Function names are looked
+    up once per batch.
+
+    Returns a 1-d numpy array of the results, or a list if any result is an array
+    or range. A call which fails gives a string describing the error.
+
+    This function must be called from a *non-local worksheet function on the main thread*.
+    """
+def call_batch_async(calls: object) -> _BatchFuture:
+    """
+    Calls a sequence of built-in worksheet functions, commands or user-defined
+    functions in a single trip to the main thread. See ``xloil.call_batch``.
+
+    Can be called from any thread. Returns an **awaitable**, i.e. a future which 
+    holds the results.
+    """
 def deregister_functions(arg0: object, arg1: object) -> None:
     """
     Deregisters worksheet functions linked to specified module. Generally, there
@@ -1894,6 +1996,31 @@ def insert_cell_image(writer: object, size: object = None, pos: object = None, o
     compress:
         if True, compresses the resulting image before storing in the sheet
     """
+def profile_enable(enable: bool = True) -> None:
+    """
+    Switches on or off timing of worksheet function calls. Profiling is off
+    by default and has a small overhead when enabled.
+    """
+def profile_reset() -> None:
+    """
+    Zeros the worksheet function call statistics returned by `profile_stats`.
+    """
+def profile_stats(merge: bool = True) -> list:
+    """
+    Returns a list of dicts, one for each worksheet function called since the 
+    last `profile_reset`, ordered by descending total time. Times are in seconds.
+    The keys are:
+
+      * *name*, *calls*, *errors*
+      * *args*, *body*, *return*: time spent converting arguments, in the 
+        function itself and converting the return value
+      * *total*, *max*
+      * *histogram*: call counts in log2-spaced microsecond buckets, the 
+        first bucket counts calls under 1us.
+
+    Statistics are collected from each thread after every calculation cycle;
+    if `merge` is True they are collected immediately.
+    """
 def run(func: object, *args) -> object:
     """
     Calls VBA's `Application.Run` taking the function name and up to 30 arguments.
@@ -1915,5 +2042,24 @@ def run_async(func: object, *args) -> _ExcelObjFuture:
 
     Returns an **awaitable**, i.e. a future which holds the result.
     """
+def run_batch(calls: object) -> object:
+    """
+    Calls VBA's `Application.Run` for a sequence of items `(func, args)`, where
+    `args` is a list or tuple of up to 30 arguments or a single argument. All the
+    calls are made in one trip to Excel's main thread.
+
+    Returns a 1-d numpy array of the results, or a list if any result is an array
+    or range.
+
+    Must be called on Excel's main thread.
+    """
+def run_batch_async(calls: object) -> _BatchFuture:
+    """
+    Calls VBA's `Application.Run` for a sequence of items in a single trip to
+    the main thread. See ``xloil.run_batch``.
+
+    Can be called from any thread. Returns an **awaitable**, i.e. a future which 
+    holds the results.
+    """
 _return_converter_hook: xloil_core._CustomReturnConverter = None
 cache: xloil_core.ObjectCache = None
@@ -46,16 +46,17 @@ namespace xloil
         fileExtn ? wstring(workbookPath, fileExtn).c_str() : workbookPath);
     }
 
-    void PyAddin::importModule(const pybind11::object& module)
+    void PyAddin::importModule(const pybind11::object& module, bool startup)
     {
       return thread->callback("xloil.importer", "_import_and_scan",
-        module, pathName());
+        module, pathName(), startup && lazyImport, backgroundImport);
     }
 
-    void PyAddin::importFile(const wchar_t* filePath, const wchar_t* linkedWorkbook)
+    void PyAddin::importFile(
+      const wchar_t* filePath, const wchar_t* linkedWorkbook, bool startup)
     {
       return thread->callback("xloil.importer", "_import_file_and_scan",
-        filePath, pathName(), linkedWorkbook);
+        filePath, pathName(), linkedWorkbook, startup && lazyImport, backgroundImport);
     }
   }
 }
\ No newline at end of file
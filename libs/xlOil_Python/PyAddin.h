@@ -26,6 +26,14 @@ namespace xloil
       AddinContext& context;
       std::shared_ptr<EventLoop> thread;
       std::string                comBinder;
+      /// <summary>
+      /// If set, modules imported at startup with a valid function manifest
+      /// have their functions registered from the manifest and are imported
+      /// on first call. If backgroundImport is also set, they are imported
+      /// on the addin's thread straight after registration.
+      /// </summary>
+      bool lazyImport = false;
+      bool backgroundImport = false;
 
       /// <summary>
       /// Gets the addin pathname
@@ -42,16 +50,19 @@ namespace xloil
       /// Imports / reloads the specified modules and scans them for functions
       /// to register. The argument is passed to `xloil.importer._import_and_scan`
       /// so a module, string or enumerable of the these can be given. 
+      /// If <paramref name="startup"/> is true, lazy import settings apply.
       /// </summary>
-      void importModule(const pybind11::object& module);
+      void importModule(const pybind11::object& module, bool startup = false);
 
       /// <summary>
       /// Imports the specified py file without registering it as module in 
       /// `sys.modules`, then scans for functions to register.  Optionally
       /// specifies a linked workbook which is passed back when functions are
-      /// registered
+      /// registered. If <paramref name="startup"/> is true, lazy import 
+      /// settings apply.
       /// </summary>
-      void importFile(const wchar_t* filePath, const wchar_t* linkedWorkbook);
+      void importFile(
+        const wchar_t* filePath, const wchar_t* linkedWorkbook, bool startup = false);
 
     private:
       std::wstring _workbookPattern;
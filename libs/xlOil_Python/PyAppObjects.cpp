@@ -3,6 +3,8 @@
 #include "TypeConversion/BasicTypes.h"
 #include "PyCOM.h"
 #include <xlOil/AppObjects.h>
+#include <xlOil/Events.h>
+#include <atomic>
 
 using std::shared_ptr;
 using std::wstring_view;
@@ -55,20 +57,137 @@ namespace xloil
         return r.range(fromR, fromC, toRow, toCol);
       }
 
-      inline auto convertExcelObj(ExcelObj&& val)
+      inline auto convertExcelObj(const ExcelObj& val)
       {
         return PySteal(PyFromAnyNoTrim()(val));
       }
 
-      auto range_GetValue(const Range& r)
+      /// <summary>
+      /// Incremented whenever sheet values may have changed, which invalidates
+      /// every cached RangeBlock
+      /// </summary>
+      std::atomic<size_t> theSheetGeneration = 1;
+
+      void invalidateRangeBlocks() noexcept
       {
-        // TODO: converting Variant->ExcelObj->Python is not very efficient!
-        ExcelObj val;
+        ++theSheetGeneration;
+      }
+
+      /// <summary>
+      /// The most cells fetched from Excel in one call.  Larger ranges are
+      /// read in chunks of whole rows so memory use stays bounded.
+      /// </summary>
+      constexpr size_t MAX_BLOCK_CELLS = 1 << 14;
+
+      /// <summary>
+      /// Caches a chunk of whole rows of a range's values so that element 
+      /// access and iteration make one call to Excel per chunk rather than one
+      /// per cell. The cache is discarded when any range is set or cleared 
+      /// via xlOil, on a sheet change event and after each calculation.
+      /// 
+      /// Must be used with the GIL held: it is released to fetch values.
+      /// </summary>
+      class RangeBlock
+      {
+      public:
+        RangeBlock(size_t nRows, size_t nCols)
+          : _nRows(nRows)
+          , _nCols(nCols)
+        {}
+
+        size_t nRows() const { return _nRows; }
+        size_t nCols() const { return _nCols; }
+
+        /// <summary>
+        /// Returns the value of cell (i, j), fetching the chunk of rows which 
+        /// contains it if required.
+        /// </summary>
+        const ExcelObj& get(const Range& range, size_t i, size_t j)
+        {
+          if (!holds(i, i + 1))
+          {
+            const auto chunk = std::max<size_t>(1, MAX_BLOCK_CELLS / _nCols);
+            const auto from = i - i % chunk;
+            fetch(range, from, std::min(from + chunk, _nRows));
+          }
+          return ExcelArray(_values, false)(i - _fromRow, j);
+        }
+
+        /// <summary>
+        /// Returns the value of the entire range. It is cached if the range 
+        /// fits into a single chunk.
+        /// </summary>
+        ExcelObj all(const Range& range)
+        {
+          if (!holds(0, _nRows))
+          {
+            if (_nRows * _nCols > MAX_BLOCK_CELLS)
+            {
+              py::gil_scoped_release noGil;
+              return range.value();
+            }
+            fetch(range, 0, _nRows);
+          }
+          return _values;
+        }
+
+      private:
+        bool holds(size_t fromRow, size_t toRow) const
+        {
+          return _generation == theSheetGeneration
+            && fromRow >= _fromRow && toRow <= _toRow;
+        }
+
+        void fetch(const Range& range, size_t fromRow, size_t toRow)
         {
+          // Read the generation first so a concurrent change makes the 
+          // fetched values stale rather than being missed
+          const size_t generation = theSheetGeneration;
+          ExcelObj values;
+          {
+            py::gil_scoped_release noGil;
+            values = range.value((int)fromRow, 0, (int)toRow - 1, (int)_nCols - 1);
+          }
+          _values = std::move(values);
+          _fromRow = fromRow;
+          _toRow = toRow;
+          _generation = generation;
+        }
+
+        size_t _nRows, _nCols;
+        size_t _fromRow = 0, _toRow = 0;
+        size_t _generation = 0;
+        ExcelObj _values;
+      };
+
+      /// <summary>
+      /// Returns the RangeBlock for a python Range object, creating it if 
+      /// required. The block is stored in the object's dict so its lifetime
+      /// matches the python object.
+      /// </summary>
+      RangeBlock& rangeBlock(const py::object& self)
+      {
+        constexpr auto attrName = "_xloil_block";
+        auto dict = py::reinterpret_borrow<py::dict>(self.attr("__dict__"));
+        auto found = PyDict_GetItemString(dict.ptr(), attrName);
+        if (found)
+          return *(RangeBlock*)PyCapsule_GetPointer(found, nullptr);
+
+        size_t nRows, nCols;
+        {
+          auto& range = self.cast<const Range&>();
           py::gil_scoped_release noGil;
-          val = r.value();
+          std::tie(nRows, nCols) = range.shape();
         }
-        return convertExcelObj(std::move(val));
+        auto block = new RangeBlock(nRows, nCols);
+        dict[attrName] = py::capsule(block, [](void* p) { delete (RangeBlock*)p; });
+        return *block;
+      }
+
+      auto range_GetValue(const py::object& self)
+      {
+        // TODO: converting Variant->ExcelObj->Python is not very efficient!
+        return convertExcelObj(rangeBlock(self).all(self.cast<const Range&>()));
       }
 
       void range_SetValue(Range& r, const py::object& pyval)
@@ -79,12 +198,14 @@ namespace xloil
         // which call back into other python functions.
         py::gil_scoped_release noGil;
         r = val;
+        invalidateRangeBlocks();
       };
 
       void range_Clear(Range& r)
       {
         py::gil_scoped_release noGil;
         r.clear();
+        invalidateRangeBlocks();
       }
       
       auto range_GetFormula(Range& r)
@@ -99,6 +220,7 @@ namespace xloil
       { 
         py::gil_scoped_release noGil;
         ExcelRange(r).setFormula(val);
+        invalidateRangeBlocks();
       }
 
       template<class T> 
@@ -113,6 +235,18 @@ namespace xloil
           : py::cast(range.range((int)fromRow, (int)fromCol, (int)toRow - 1, (int)toCol - 1));
       }
 
+      py::object range_GetItem(const py::object& self, py::object loc)
+      {
+        auto& range = self.cast<const Range&>();
+        auto& block = rangeBlock(self);
+        size_t fromRow, fromCol, toRow, toCol;
+        bool singleValue = getItemIndexReader2d(loc, block.nRows(), block.nCols(),
+          fromRow, fromCol, toRow, toCol);
+        return singleValue
+          ? convertExcelObj(block.get(range, fromRow, fromCol))
+          : py::cast(range.range((int)fromRow, (int)fromCol, (int)toRow - 1, (int)toCol - 1));
+      }
+
       inline Range* worksheet_subRange(const ExcelWorksheet& ws,
         int fromR, int fromC,
         const py::object& toR, const py::object& toC,
@@ -216,21 +350,35 @@ namespace xloil
         app.quit(true);
       }
 
+      /// <summary>
+      /// Iterates over the cells in a range row-by-row, reading values in
+      /// chunks via the range's RangeBlock
+      /// </summary>
       struct RangeIter
       {
-        Range& _range;
-        Range::row_t _i;
-        Range::col_t _j;
-
-        RangeIter(Range& r) : _range(r), _i(0), _j(0) 
+        py::object _self;
+        const Range& _range;
+        RangeBlock& _block;
+        size_t _i, _j;
+
+        RangeIter(const py::object& self) 
+          : _self(self)
+          , _range(self.cast<const Range&>())
+          , _block(rangeBlock(self))
+          , _i(0)
+          , _j(0)
         {}
 
         auto next()
         {
-          if (++_j == _range.nCols())
-            if (++_i == _range.nRows())
-              throw py::stop_iteration();
-          return PyFromAny()(_range.value(_i, _j));
+          if (_j == _block.nCols())
+          {
+            _j = 0;
+            ++_i;
+          }
+          if (_i >= _block.nRows())
+            throw py::stop_iteration();
+          return convertExcelObj(_block.get(_range, _i, _j++));
         }
       };
     }
@@ -459,7 +607,7 @@ namespace xloil
 
           )" XLO_CITE_API_SUFFIX(Application, (object)));
 
-      auto declare_Range = py::class_<Range>(mod, "Range", R"(
+      auto declare_Range = py::class_<Range>(mod, "Range", py::dynamic_attr(), R"(
           Represents a cell, a row, a column or a selection of cells containing a contiguous 
           blocks of cells. (Non contiguous ranges are not currently supported).
           This class allows direct access to an area on a worksheet. It uses similar 
@@ -476,6 +624,11 @@ namespace xloil
 
               x[:-1, :-1] # A sub-range omitting the last row and column
 
+          Cell values are read from Excel in blocks of whole rows which are cached, so
+          iterating over a range or indexing its cells does not make one call to Excel
+          per cell. The cache is discarded when any Range is set or cleared, when a sheet
+          changes and after each calculation.
+
           )" XLO_CITE_API_SUFFIX(Range, (object)));
 
       auto declare_Worksheet = py::class_<ExcelWorksheet>(mod, "Worksheet",
@@ -532,6 +685,12 @@ namespace xloil
           py::arg("after") = py::none());
 
 
+      // Cached range values may be stale after any calc or sheet change
+      static auto calcHandler = Event::AfterCalculate().bind(
+        []() { invalidateRangeBlocks(); });
+      static auto changeHandler = Event::SheetChange().bind(
+        [](const wchar_t*, const Range&) { invalidateRangeBlocks(); });
+
       py::class_<RangeIter>(mod, "RangeIter")
         .def("__iter__", [](const py::object& self) { return self; })
         .def("__next__", &RangeIter::next);
@@ -597,10 +756,9 @@ namespace xloil
             at least a single cell, even if it's empty.  
           )")
         .def("__iter__", 
-          [](Range& self) { return new RangeIter(self); },
-          call_release_gil())
+          [](const py::object& self) { return new RangeIter(self); })
         .def("__getitem__", 
-          Range_getItem<Range>,
+          range_GetItem,
           R"(
             Given a 2-tuple, slices the range to return a sub Range or a single element.Uses
             normal python slicing conventions i.e[left included, right excluded), negative
@@ -1,5 +1,6 @@
 #include <xlOil/ExcelObjCache.h>
 #include <xlOil/ObjectCache.h>
+#include <xlOil/CacheSnapshot.h>
 #include "PyCore.h"
 #include "TypeConversion/BasicTypes.h"
 #include "PyCache.h"
@@ -7,6 +8,8 @@
 namespace py = pybind11;
 using std::wstring;
 using std::shared_ptr;
+using std::vector;
+using std::string_view;
 
 namespace xloil
 {
@@ -21,6 +24,98 @@ namespace xloil
 
     namespace
     {
+      /// <summary>
+      /// Python objects are written to cache snapshots if they support the
+      /// buffer protocol with a simple, contiguous layout. The blob is this
+      /// header, the shape as int64s and then the data.
+      /// </summary>
+      struct SnapshotHeader
+      {
+        enum Kind : uint8_t { Bytes, NumpyArray };
+        uint8_t kind;
+        uint8_t ndim;
+        /// <summary>
+        /// The struct module format character for array elements
+        /// </summary>
+        char format;
+        uint8_t padding[5];
+      };
+      static_assert(sizeof(SnapshotHeader) == 8, "SnapshotHeader must be packed");
+
+      /// <summary>
+      /// Native format characters understood by memoryview.cast
+      /// </summary>
+      constexpr char SNAPSHOT_FORMATS[] = "?bBhHiIlLqQfd";
+
+      bool writeSnapshotBlob(const py::object& obj, vector<char>& blob)
+      {
+        SnapshotHeader header = {};
+        if (PyBytes_Check(obj.ptr()))
+          header.kind = SnapshotHeader::Bytes;
+        else if (strcmp(Py_TYPE(obj.ptr())->tp_name, "numpy.ndarray") == 0)
+          header.kind = SnapshotHeader::NumpyArray;
+        else
+          return false;
+
+        Py_buffer view;
+        if (PyObject_GetBuffer(obj.ptr(), &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+        {
+          PyErr_Clear();
+          return false;
+        }
+        std::unique_ptr<Py_buffer, decltype(&PyBuffer_Release)> release(&view, PyBuffer_Release);
+
+        // Accept native or little-endian formats, which are the same on Windows
+        auto format = view.format ? view.format : "B";
+        if (*format == '@' || *format == '=' || *format == '<')
+          ++format;
+        if (format[0] == 0 || format[1] != 0 || !strchr(SNAPSHOT_FORMATS, format[0])
+          || view.ndim < 1 || view.ndim > 255)
+          return false;
+
+        header.ndim = (uint8_t)view.ndim;
+        header.format = format[0];
+
+        const auto shapeBytes = view.ndim * sizeof(int64_t);
+        blob.resize(sizeof(header) + shapeBytes + view.len);
+        memcpy(blob.data(), &header, sizeof(header));
+        for (auto i = 0; i < view.ndim; ++i)
+        {
+          const int64_t dim = view.shape[i];
+          memcpy(blob.data() + sizeof(header) + i * sizeof(int64_t), &dim, sizeof(dim));
+        }
+        memcpy(blob.data() + sizeof(header) + shapeBytes, view.buf, view.len);
+        return true;
+      }
+
+      py::object readSnapshotBlob(const string_view& blob)
+      {
+        SnapshotHeader header;
+        if (blob.size() < sizeof(header))
+          XLO_THROW("Cache snapshot object is truncated");
+        memcpy(&header, blob.data(), sizeof(header));
+
+        const auto dataStart = sizeof(header) + header.ndim * sizeof(int64_t);
+        if (blob.size() < dataStart || !strchr(SNAPSHOT_FORMATS, header.format))
+          XLO_THROW("Cache snapshot object is corrupt");
+
+        auto data = py::bytes(blob.data() + dataStart, blob.size() - dataStart);
+        if (header.kind == SnapshotHeader::Bytes)
+          return data;
+
+        py::list shape;
+        for (auto i = 0; i < header.ndim; ++i)
+        {
+          int64_t dim;
+          memcpy(&dim, blob.data() + sizeof(header) + i * sizeof(int64_t), sizeof(dim));
+          shape.append(dim);
+        }
+        auto view = PySteal(PyMemoryView_FromObject(data.ptr()))
+          .attr("cast")(std::string(1, header.format), shape);
+        // Copies the data into a new array with the dtype given by the format
+        return py::module::import("numpy").attr("array")(view);
+      }
+
       /// <summary>
       /// This odd singleton is constructed and owned by the core module which ensures
       /// deleted when the core module is garbage collected and the interpreter is 
@@ -32,6 +127,7 @@ namespace xloil
 
         PyCache()
           : _cache(cache_type::create(false))
+          , _snapshotHandler(*this)
         {
           _workbookCloseHandler = std::static_pointer_cast<const void>(
             xloil::Event::WorkbookAfterClose().bind(
@@ -40,8 +136,62 @@ namespace xloil
             py::gil_scoped_acquire getGil;
             _cache->onWorkbookClose(wbName);
           }));
+          _cache->setMissHandler(&CacheSnapshot::restoreMissing);
+          CacheSnapshot::addHandler(&_snapshotHandler);
         }
 
+        class SnapshotHandler : public CacheSnapshot::Handler
+        {
+        public:
+          SnapshotHandler(PyCache& owner) : _owner(owner) {}
+
+          wchar_t uniquifier() const override
+          {
+            return _owner._cache->uniquifier();
+          }
+
+          void save(const std::wstring_view& workbook, CacheSnapshot::Writer& writer) override
+          {
+            py::gil_scoped_acquire getGil;
+            for (auto& [key, cellCache] : *_owner._cache)
+            {
+              if (!CacheSnapshot::inWorkbook(key, workbook))
+                continue;
+              vector<vector<char>> blobs(cellCache.count());
+              bool ok = true;
+              for (auto i = 0u; ok && i < cellCache.count(); ++i)
+                ok = writeSnapshotBlob(*cellCache.fetch(i), blobs[i]);
+              if (ok)
+                writer.add(key, std::move(blobs));
+            }
+          }
+
+          bool restore(
+            const std::wstring_view& cacheKey,
+            const vector<string_view>& blobs) override
+          {
+            py::gil_scoped_acquire getGil;
+            vector<py::object> objects;
+            for (auto& blob : blobs)
+              objects.push_back(readSnapshotBlob(blob));
+            _owner._cache->restore(cacheKey, std::move(objects));
+            return true;
+          }
+
+          CacheSnapshot::KeyState state(const std::wstring_view& cacheKey) const override
+          {
+            const auto restored = _owner._cache->isRestored(cacheKey);
+            if (!restored)
+              return CacheSnapshot::KeyState::Missing;
+            return *restored
+              ? CacheSnapshot::KeyState::Restored
+              : CacheSnapshot::KeyState::Current;
+          }
+
+        private:
+          PyCache& _owner;
+        };
+
         // Just to prevent any potential errors!
         PyCache(const PyCache& that) = delete;
 
@@ -51,6 +201,7 @@ namespace xloil
 
         ~PyCache()
         {
+          CacheSnapshot::removeHandler(&_snapshotHandler);
           _theInstance = nullptr;
           XLO_TRACE("Python object cache destroyed");
         }
@@ -113,13 +264,24 @@ namespace xloil
 
         shared_ptr<cache_type> _cache;
         shared_ptr<const void> _workbookCloseHandler;
+        SnapshotHandler _snapshotHandler;
       };
 
       PyCache* PyCache::_theInstance = nullptr;
+
+      bool theCacheDisabled = false;
+    }
+
+    void pyCacheDisable()
+    {
+      theCacheDisabled = true;
     }
 
     ExcelObj pyCacheAdd(const py::object& obj, const wchar_t* caller)
     {
+      if (theCacheDisabled)
+        throw CacheUnavailable();
+
       // Decorate the cache ref with the python object name to 
       // help users keep track
       auto name = utf8ToUtf16(obj.ptr()->ob_type->tp_name);
@@ -1,6 +1,7 @@
 #pragma once
 #include <xlOil/ExcelObj.h>
 #include <xlOil/Caller.h>
+#include <stdexcept>
 
 namespace pybind11 { class object; }
 namespace xloil 
@@ -13,6 +14,21 @@ namespace xloil
     /// </summary>
     ExcelObj pyCacheAdd(const pybind11::object& obj, const wchar_t* caller = nullptr);
 
+    /// <summary>
+    /// Thrown by pyCacheAdd when the cache has been disabled
+    /// </summary>
+    class CacheUnavailable : public std::runtime_error
+    {
+    public:
+      CacheUnavailable() : std::runtime_error("Python object cache not available in this process") {}
+    };
+
+    /// <summary>
+    /// Makes pyCacheAdd throw CacheUnavailable. Used in worker processes, 
+    /// whose cache references would not be valid in Excel's process.
+    /// </summary>
+    void pyCacheDisable();
+
     /// <summary>
     /// Tries to fetch an object give a cache reference string, returning
     /// true if sucessful. Must hold the GIL to call.
@@ -1,10 +1,15 @@
 #include "PyHelpers.h"
 #include "TypeConversion/BasicTypes.h"
+#include "TypeConversion/Numpy.h"
 #include "PyFuture.h"
 #include <xloil/ExcelCall.h>
+#include <xloil/ArrayBuilder.h>
+#include <xloil/ExcelArray.h>
 #include <xlOil/ExcelThread.h>
 #include <xlOil/AppObjects.h>
+#include <algorithm>
 #include <future>
+#include <unordered_map>
 
 using std::shared_ptr;
 using std::vector;
@@ -43,51 +48,197 @@ namespace xloil
 
     using ExcelObjFuture = PyFuture<ExcelObj, PyFromAny>;
 
-    auto callXllAsync(const py::object& func, const py::args& args)
+    /// <summary>
+    /// A built-in function number with its converted arguments
+    /// </summary>
+    struct XllCall
     {
-      // Space to convert all args to Excel objects
-      auto nArgs = args.size();
-      vector<ExcelObj> xlArgs;
-      xlArgs.reserve(nArgs);
-
-      // func can be a string or Excel function number
       int funcNum;
+      vector<ExcelObj> args;
+    };
+
+    /// <summary>
+    /// Converts args with None->Missing Arg and Range->ExcelRef
+    /// </summary>
+    template<class TArgs>
+    void convertArgs(const TArgs& args, vector<ExcelObj>& xlArgs)
+    {
+      for (auto arg : args)
+        xlArgs.emplace_back(ArgFromPyObj()(py::reinterpret_borrow<py::object>(arg)));
+    }
+
+    /// <summary>
+    /// Looks up the function number. func can be a string or Excel function 
+    /// number. If we don't recognise the function name as as built-in, we 
+    /// call it as a UDF, which takes the name as its first argument. 
+    /// </summary>
+    int xllFuncNumber(
+      const py::handle& func, 
+      vector<ExcelObj>& xlArgs, 
+      std::unordered_map<string, int>* lookupCache = nullptr)
+    {
       if (PyLong_Check(func.ptr()))
       {
-        funcNum = PyLong_AsLong(func.ptr());
+        const auto funcNum = PyLong_AsLong(func.ptr());
         if (funcNum < 0)
           throw py::value_error("Not an Excel function: " + std::to_string(funcNum));
+        return funcNum;
       }
-      else
+
+      const auto funcName = (string)py::str(func);
+      int funcNum;
+      if (lookupCache)
       {
-        const auto funcName = (string)py::str(func);
+        auto found = lookupCache->try_emplace(funcName, 0);
+        if (found.second)
+          found.first->second = excelFuncNumber(funcName.c_str());
+        funcNum = found.first->second;
+      }
+      else
         funcNum = excelFuncNumber(funcName.c_str());
-        // If we don't recognise the function name as as built-in, we try
-        // to run a UDF.
-        if (funcNum < 0)
+
+      if (funcNum < 0)
+      {
+        xlArgs.insert(xlArgs.begin(), ExcelObj(funcName));
+        return msxll::xlUDF;
+      }
+      return funcNum;
+    }
+
+    /// <summary>
+    /// Calls Excel on the main thread. Memory allocated by Excel for the result
+    /// is copied and freed here, rather than by whichever thread drops the result.
+    /// </summary>
+    ExcelObj invokeXll(const XllCall& call)
+    {
+      ExcelObj result;
+      auto ret = xloil::callExcelRaw(call.funcNum, &result, call.args.size(), call.args.begin());
+      if (ret != 0)
+        return ExcelObj(wstring(L"#") + xlRetCodeToString(ret));
+
+      switch (result.type())
+      {
+      case ExcelType::Str:
+      case ExcelType::Multi:
+      case ExcelType::Ref:
+        return ExcelObj(static_cast<const ExcelObj&>(result));
+      default:
+        // Nothing for xlFree to do, so save it being called
+        result.xltype &= ~msxll::xlbitXLFree;
+        return std::move(result);
+      }
+    }
+
+    auto callXllAsync(const py::object& func, const py::args& args)
+    {
+      // Space to convert all args to Excel objects
+      vector<ExcelObj> xlArgs;
+      xlArgs.reserve(args.size() + 1);
+
+      const auto funcNum = xllFuncNumber(func, xlArgs);
+      convertArgs(args, xlArgs);
+
+      py::gil_scoped_release releaseGil;
+
+      // Run the function on the main thread
+      return ExcelObjFuture(runExcelThread([call = XllCall{ funcNum, std::move(xlArgs) }]()
+      {
+        return invokeXll(call);
+      }, ExcelRunQueue::XLL_API));
+    }
+
+    /// <summary>
+    /// Converts the results of a batch to a 1-d numpy array, or to a list if
+    /// any result is an array or range since these cannot be array elements.
+    /// </summary>
+    struct PyFromBatchResults
+    {
+      PyObject* operator()(const vector<ExcelObj>& results) const
+      {
+        const auto isScalar = [](const ExcelObj& x) { return x.isType(ExcelType::ArrayValue); };
+        if (!results.empty() && std::all_of(results.begin(), results.end(), isScalar))
+        {
+          size_t strLength = 0;
+          for (auto& x : results)
+            if (x.isType(ExcelType::Str))
+              strLength += x.cast<PStringRef>().length();
+
+          ExcelArrayBuilder builder((ExcelObj::row_t)results.size(), 1, strLength);
+          for (size_t i = 0; i < results.size(); ++i)
+            builder(i, 0) = results[i];
+          const auto array = builder.toExcelObj();
+          return excelArrayToNumpyArray(ExcelArray(array, false), 1);
+        }
+
+        py::list list(results.size());
+        for (size_t i = 0; i < results.size(); ++i)
+          list[i] = PySteal(PyFromAny()(results[i]));
+        return list.release().ptr();
+      }
+    };
+
+    using BatchFuture = PyFuture<vector<ExcelObj>, PyFromBatchResults>;
+
+    /// <summary>
+    /// Splits an item of a batch, which should be a tuple (func, args) or 
+    /// (func,). Args can be a list or tuple or a single argument.
+    /// </summary>
+    template<class F>
+    void parseBatchItem(const py::handle& item, F&& onItem)
+    {
+      if (!PyTuple_Check(item.ptr()) && !PyList_Check(item.ptr()))
+        throw py::value_error("Batch items should be tuples of (func, args)");
+      auto parts = py::reinterpret_borrow<py::sequence>(item);
+      if (parts.size() != 1 && parts.size() != 2)
+        throw py::value_error("Batch items should be tuples of (func, args)");
+
+      vector<ExcelObj> xlArgs;
+      if (parts.size() == 2)
+      {
+        py::object args = parts[1];
+        if (PyTuple_Check(args.ptr()) || PyList_Check(args.ptr()))
         {
-          funcNum = msxll::xlUDF;
-          xlArgs.insert(xlArgs.begin(), ExcelObj(funcName));
+          auto argSeq = py::reinterpret_borrow<py::sequence>(args);
+          xlArgs.reserve(argSeq.size() + 1);
+          convertArgs(argSeq, xlArgs);
         }
+        else
+          xlArgs.emplace_back(ArgFromPyObj()(args));
       }
+      py::object func = parts[0];
+      onItem(func, std::move(xlArgs));
+    }
 
-      // Convert args with None->Missing Arg and Range->ExcelRef
-      for (auto i = 0u; i < nArgs; ++i)
-        xlArgs.emplace_back(ArgFromPyObj()(args[i]));
+    auto callXllBatchAsync(const py::iterable& calls)
+    {
+      vector<XllCall> xlCalls;
+      // Calls in a batch often repeat a function, so only look up each name once
+      std::unordered_map<string, int> funcNumbers;
+      for (auto item : calls)
+        parseBatchItem(item, [&](const py::handle& func, vector<ExcelObj>&& xlArgs)
+        {
+          const auto funcNum = xllFuncNumber(func, xlArgs, &funcNumbers);
+          xlCalls.push_back(XllCall{ funcNum, std::move(xlArgs) });
+        });
 
       py::gil_scoped_release releaseGil;
 
-      // Run the function on the main thread
-      return ExcelObjFuture(runExcelThread([funcNum, args = std::move(xlArgs)]()
+      // One trip to the main thread and into XLL context for the whole batch
+      return BatchFuture(runExcelThread([calls = std::move(xlCalls)]()
       {
-        ExcelObj result;
-        auto ret = xloil::callExcelRaw(funcNum, &result, args.size(), args.begin());
-        if (ret != 0)
-          result = wstring(L"#") + xlRetCodeToString(ret);
-        return std::move(result);
+        vector<ExcelObj> results;
+        results.reserve(calls.size());
+        for (auto& call : calls)
+          results.emplace_back(invokeXll(call));
+        return results;
       }, ExcelRunQueue::XLL_API));
     }
 
+    auto callXllBatch(const py::iterable& calls)
+    {
+      return callXllBatchAsync(calls).result();
+    }
+
     auto callXll(const py::object& func, const py::args& args)
     {
       return callXllAsync(func, args).result();
@@ -126,11 +277,46 @@ namespace xloil
       return appRunAsync(func, args).result();
     }
 
+    auto appRunBatchAsync(const py::iterable& calls)
+    {
+      vector<std::pair<wstring, vector<ExcelObj>>> runs;
+      for (auto item : calls)
+        parseBatchItem(item, [&](const py::handle& func, vector<ExcelObj>&& xlArgs)
+        {
+          if (xlArgs.size() > 30)
+            throw py::value_error("Application.Run takes at most 30 arguments");
+          runs.emplace_back(pyToWStr(func.ptr()), std::move(xlArgs));
+        });
+
+      py::gil_scoped_release releaseGil;
+
+      return BatchFuture(runExcelThread([runs = std::move(runs)]()
+      {
+        vector<ExcelObj> results;
+        results.reserve(runs.size());
+        auto& app = excelApp();
+        const ExcelObj* argsP[30];
+        for (auto& [func, args] : runs)
+        {
+          for (size_t i = 0; i < args.size(); ++i)
+            argsP[i] = &args[i];
+          results.emplace_back(app.run(func, args.size(), argsP));
+        }
+        return results;
+      }));
+    }
+
+    auto appRunBatch(const py::iterable& calls)
+    {
+      return appRunBatchAsync(calls).result();
+    }
+
     namespace
     {
       static int theBinder = addBinder([](py::module& mod)
       {
         ExcelObjFuture::bind(mod, "_ExcelObjFuture");
+        BatchFuture::bind(mod, "_BatchFuture");
 
         mod.def("run", 
           appRun, 
@@ -189,6 +375,61 @@ namespace xloil
             Returns an **awaitable**, i.e. a future which holds the result.
           )",
           py::arg("func"));
+
+        mod.def("call_batch",
+          callXllBatch,
+          R"(
+            Calls a sequence of built-in worksheet functions, commands or user-defined
+            functions. Each item is a tuple `(func, args)` where `func` is as for 
+            ``xloil.call`` and `args` is a list or tuple of arguments or a single 
+            argument. The args may be omitted, i.e. `(func,)`.
+
+            All the calls are made in one trip to Excel's main thread, which is much 
+            faster than calling ``xloil.call`` for each item. Function names are looked
+            up once per batch.
+
+            Returns a 1-d numpy array of the results, or a list if any result is an array
+            or range. A call which fails gives a string describing the error.
+
+            This function must be called from a *non-local worksheet function on the main thread*.
+          )",
+          py::arg("calls"));
+
+        mod.def("call_batch_async",
+          callXllBatchAsync,
+          R"(
+            Calls a sequence of built-in worksheet functions, commands or user-defined
+            functions in a single trip to the main thread. See ``xloil.call_batch``.
+
+            Can be called from any thread. Returns an **awaitable**, i.e. a future which 
+            holds the results.
+          )",
+          py::arg("calls"));
+
+        mod.def("run_batch",
+          appRunBatch,
+          R"(
+            Calls VBA's `Application.Run` for a sequence of items `(func, args)`, where
+            `args` is a list or tuple of up to 30 arguments or a single argument. All the
+            calls are made in one trip to Excel's main thread.
+
+            Returns a 1-d numpy array of the results, or a list if any result is an array
+            or range.
+
+            Must be called on Excel's main thread.
+          )",
+          py::arg("calls"));
+
+        mod.def("run_batch_async",
+          appRunBatchAsync,
+          R"(
+            Calls VBA's `Application.Run` for a sequence of items in a single trip to
+            the main thread. See ``xloil.run_batch``.
+
+            Can be called from any thread. Returns an **awaitable**, i.e. a future which 
+            holds the results.
+          )",
+          py::arg("calls"));
       });
     }
   }
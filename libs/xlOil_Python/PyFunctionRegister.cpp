@@ -6,17 +6,21 @@
 #include "PySource.h"
 #include "AsyncFunctions.h"
 #include "PyEvents.h"
+#include "PyWorkerPool.h"
 #include <xloil/StaticRegister.h>
 #include <xloil/DynamicRegister.h>
 #include <xloil/ExcelCall.h>
 #include <xloil/Caller.h>
 #include <xloil/FPArray.h>
 #include <xloil/RtdServer.h>
+#include <xloil/Profile.h>
+#include <xloil/CacheSnapshot.h>
 #include <xlOil/ExcelThread.h>
 #include <xlOil/Interface.h>
 #include <pybind11/stl.h>
 
 #include <map>
+#include <optional>
 #include <filesystem>
 
 namespace fs = std::filesystem;
@@ -90,11 +94,15 @@ namespace xloil
       , isLocalFunc(isLocal)
       , isRtdAsync(false)
       , isAsync(false)
+      , isLazy(false)
+      , workerFallback(false)
     {
       _info->name = name.empty() 
         ? py::wstr(func.attr("__name__"))
         : name;
 
+      profileId = Profile::functionId(_info->name);
+
       _info->help = help;
       _info->category = category;
       
@@ -234,28 +242,123 @@ namespace xloil
       const ExcelObj** xlArgs) noexcept
     {
       TReturn returner(info->getReturnConverter().get());
+      Profile::CallTimer timer(info->profileId);
+
+      // Only functions returning an ExcelObj can return cache references
+      constexpr bool canSnapshot = std::is_same_v<typename TReturn::return_type, ExcelObj*>;
 
       try
       {
+        // If the workbook was closed with a cache snapshot, we may be able to
+        // return the previous result without running the function
+        std::optional<CacheSnapshot::CellCall> snapshot;
+        if constexpr (canSnapshot)
+        {
+          if (CacheSnapshot::isEnabled() && !info->isVolatile())
+          {
+            snapshot.emplace(info->name(), xlArgs, info->info()->numArgs());
+            if (auto* previous = snapshot->restore())
+              return returner(*previous);
+          }
+        }
+
         py::gil_scoped_acquire gilAcquired;
         PyErr_Clear(); // TODO: required?
-        return returner(info->invoke([&](auto i) -> auto& { return *xlArgs[i]; }).ptr());
+
+        // Equivalent to info->invoke, but split so the profiler can 
+        // distinguish argument conversion from the python call
+        PyCallArgs<> pyArgs;
+        py::object kwargs;
+        info->convertArgs([&](auto i) -> auto& { return *xlArgs[i]; }, pyArgs, kwargs);
+        timer.phaseEnd(Profile::Phase::Args);
+
+        auto retVal = PySteal<>(pyArgs.call(info->func().ptr(), kwargs.ptr()));
+        timer.phaseEnd(Profile::Phase::Body);
+
+        auto result = returner(retVal.ptr());
+        timer.phaseEnd(Profile::Phase::Return);
+
+        if constexpr (canSnapshot)
+        {
+          if (snapshot)
+            snapshot->record(*result);
+        }
+        return result;
       }
       catch (const py::error_already_set& e)
       {
+        timer.failed();
         raiseUserException(e);
         return returner(e.what(), info);
       }
       catch (const std::exception& e)
       {
+        timer.failed();
         return returner(e.what(), info);
       }
       catch (...)
       {
+        timer.failed();
         return returner(CellError::Value, info);
       }
     }
 
+    /// <summary>
+    /// Invoked for lazy functions: the module is imported and the call is
+    /// forwarded to the real function. Importing the module re-registers 
+    /// its functions so subsequent calls go directly to pythonCallback.
+    /// </summary>
+    template<class TReturn = ExcelObjReturn>
+    typename TReturn::return_type pythonLazyCallback(
+      const PyFuncInfo* info,
+      const ExcelObj** xlArgs) noexcept
+    {
+      shared_ptr<PyFuncInfo> target;
+      try
+      {
+        py::gil_scoped_acquire gilAcquired;
+        target = info->func()(info->name()).cast<shared_ptr<PyFuncInfo>>();
+      }
+      catch (const py::error_already_set& e)
+      {
+        raiseUserException(e);
+        return TReturn(nullptr)(e.what(), info);
+      }
+      catch (const std::exception& e)
+      {
+        return TReturn(nullptr)(e.what(), info);
+      }
+      return pythonCallback<TReturn>(target.get(), xlArgs);
+    }
+
+    /// <summary>
+    /// Invoked for threaded functions when the worker pool is running. The 
+    /// call runs in a worker process, so does not need the GIL. Calls which
+    /// cannot be sent to a worker, for example if an argument is too large
+    /// for the channel, run in-process.
+    /// </summary>
+    ExcelObj* pythonWorkerCallback(
+      const PyFuncInfo* info,
+      const ExcelObj** xlArgs) noexcept
+    {
+      {
+        Profile::CallTimer timer(info->profileId);
+        try
+        {
+          ExcelObj result;
+          if (WorkerPool::call(*info, xlArgs, result, timer))
+            return returnValue(std::move(result));
+          timer.discard();
+        }
+        catch (const std::exception& e)
+        {
+          timer.failed();
+          return returnValue(e.what());
+        }
+      }
+      return pythonCallback<ExcelObjThreadSafeReturn>(info, xlArgs);
+    }
+
     shared_ptr<const DynamicSpec> 
       PyFuncInfo::createSpec(
         const std::shared_ptr<PyFuncInfo>& func)
@@ -265,10 +368,25 @@ namespace xloil
       // std::bad_weak_ptr during construction which seems rather un-C++ like and irksome
       func->describeFuncArgs();
       auto cfunc = std::const_pointer_cast<const PyFuncInfo>(func);
-      if (func->isAsync)
+      if (func->isLazy)
+      {
+        if (func->isAsync || func->isRtdAsync)
+          XLO_THROW(L"Async function '{0}' cannot be registered lazily", func->name());
+        else if (func->isThreadSafe())
+          return make_shared<DynamicSpec>(func->info(), &pythonLazyCallback<ExcelObjThreadSafeReturn>, cfunc);
+        else if (func->isCommand())
+          return make_shared<DynamicSpec>(func->info(), &pythonLazyCallback<CommandReturn>, cfunc);
+        else if (func->isFPArray())
+          return make_shared<DynamicSpec>(func->info(), &pythonLazyCallback<FPArrayReturn>, cfunc);
+        else
+          return make_shared<DynamicSpec>(func->info(), &pythonLazyCallback<>, cfunc);
+      }
+      else if (func->isAsync)
         return make_shared<DynamicSpec>(func->info(), &pythonAsyncCallback, cfunc);
       else if (func->isRtdAsync)
         return make_shared<DynamicSpec>(func->info(), &pythonRtdCallback, cfunc);
+      else if (func->isThreadSafe() && !func->workerModule.empty())
+        return make_shared<DynamicSpec>(func->info(), &pythonWorkerCallback, cfunc);
       else if (func->isThreadSafe())
         return make_shared<DynamicSpec>(func->info(), &pythonCallback<ExcelObjThreadSafeReturn>, cfunc);
       else if (func->isCommand())
@@ -392,11 +510,20 @@ namespace xloil
         vector<shared_ptr<const WorksheetFuncSpec>> nonLocal, localFuncs;
 
         bool usesRtdAsync = false;
+        bool usesWorkers = false;
 
         for (auto& f : functions)
         {
           if (!_linkedWorkbook)
             f->isLocalFunc = false;
+
+          if (WorkerPool::isRunning() && name() != XLOPY_ANON_SOURCE 
+            && WorkerPool::canDispatch(*f))
+          {
+            f->workerModule = name();
+            usesWorkers = true;
+          }
+
           auto spec = PyFuncInfo::createSpec(f);
 
           if (f->isLocalFunc)
@@ -413,6 +540,10 @@ namespace xloil
         if (usesRtdAsync)
           runExcelThread([]() { rtdAsync(shared_ptr<IRtdAsyncTask>()); });
 
+        // Workers import or reload the module before their next call
+        if (usesWorkers)
+          WorkerPool::addModule(name());
+
         registerFuncs(nonLocal, append);
         if (!localFuncs.empty())
           registerLocal(localFuncs, append);
@@ -554,6 +685,50 @@ namespace xloil
         return result;
       }
       
+      /// <summary>
+      /// Recovers the features string passed to the _FuncSpec constructor
+      /// </summary>
+      string pyFuncFeatures(const PyFuncInfo& info)
+      {
+        const auto options = info.info()->options;
+        vector<const char*> features;
+        if (options & FuncInfo::MACRO_TYPE)  features.push_back("macro");
+        if (options & FuncInfo::ARRAY)       features.push_back("fastarray");
+        if (options & FuncInfo::COMMAND)     features.push_back("command");
+        if (options & FuncInfo::THREAD_SAFE) features.push_back("threaded");
+        if (info.isRtdAsync)                 features.push_back("rtd");
+        if (info.isAsync)                    features.push_back("async");
+
+        string result;
+        for (auto f : features)
+          result.append(result.empty() ? "" : ",").append(f);
+        return result;
+      }
+
+      py::list profileStats(bool merge)
+      {
+        if (merge)
+          Profile::merge();
+        const auto stats = Profile::stats();
+
+        py::list result;
+        for (auto& s : stats)
+        {
+          py::dict d;
+          d["name"] = s.name;
+          d["calls"] = s.calls;
+          d["errors"] = s.errors;
+          d["total"] = s.totalTime();
+          d["args"] = s.phaseTime[(size_t)Profile::Phase::Args];
+          d["body"] = s.phaseTime[(size_t)Profile::Phase::Body];
+          d["return"] = s.phaseTime[(size_t)Profile::Phase::Return];
+          d["max"] = s.maxTime;
+          d["histogram"] = py::cast(vector<uint64_t>(s.histogram.begin(), s.histogram.end()));
+          result.append(std::move(d));
+        }
+        return result;
+      }
+
       static int theBinder = addBinder([](py::module& mod)
       {
         py::class_<PyFuncArg>(mod, "_FuncArg")
@@ -562,7 +737,9 @@ namespace xloil
           .def_readwrite("help", &PyFuncArg::help)
           .def_readwrite("converter", &PyFuncArg::converter)
           .def_readwrite("default", &PyFuncArg::default)
-          .def_readwrite("special_type", &PyFuncArg::type);
+          .def_readwrite("special_type", &PyFuncArg::type)
+          .def_property_readonly("has_default", 
+            [](const PyFuncArg& self) { return (bool)self.default; });
 
         py::class_<PyFuncInfo, shared_ptr<PyFuncInfo>>(mod, "_FuncSpec")
           .def(py::init<py::function, vector<PyFuncArg>, wstring, string, wstring, wstring, bool, bool, bool>(),
@@ -584,6 +761,18 @@ namespace xloil
             [](const PyFuncInfo& self) { return self.info()->name; })
           .def_property_readonly("help", 
             [](const PyFuncInfo& self) { return self.info()->help; })
+          .def_property_readonly("category", 
+            [](const PyFuncInfo& self) { return self.info()->category; })
+          .def_property_readonly("features", 
+            pyFuncFeatures)
+          .def_property_readonly("volatile", 
+            [](const PyFuncInfo& self) { return (self.info()->options & FuncInfo::VOLATILE) != 0; })
+          .def_readonly("local", 
+            &PyFuncInfo::isLocalFunc)
+          .def_property_readonly("has_kwargs", 
+            &PyFuncInfo::hasKeywordArgs)
+          .def_readwrite("lazy", 
+            &PyFuncInfo::isLazy)
           .def("__str__", pyFuncInfoToString);
 
         mod.def("_register_functions", &registerFunctions, 
@@ -598,6 +787,39 @@ namespace xloil
             Deregisters worksheet functions linked to specified module. Generally, there
             is no need to call this directly.
           )");
+
+        mod.def("profile_enable",
+          &Profile::setEnabled,
+          R"(
+            Switches on or off timing of worksheet function calls. Profiling is off
+            by default and has a small overhead when enabled.
+          )",
+          py::arg("enable") = true);
+
+        mod.def("profile_reset",
+          &Profile::reset,
+          R"(
+            Zeros the worksheet function call statistics returned by `profile_stats`.
+          )");
+
+        mod.def("profile_stats",
+          &profileStats,
+          R"(
+            Returns a list of dicts, one for each worksheet function called since the 
+            last `profile_reset`, ordered by descending total time. Times are in seconds.
+            The keys are:
+
+              * *name*, *calls*, *errors*
+              * *args*, *body*, *return*: time spent converting arguments, in the 
+                function itself and converting the return value
+              * *total*, *max*
+              * *histogram*: call counts in log2-spaced microsecond buckets, the 
+                first bucket counts calls under 1us.
+
+            Statistics are collected from each thread after every calculation cycle;
+            if `merge` is True they are collected immediately.
+          )",
+          py::arg("merge") = true);
       });
     }
   }
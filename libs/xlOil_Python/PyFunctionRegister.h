@@ -3,6 +3,7 @@
 #include "TypeConversion/PyDictType.h"
 #include <xlOil/Register.h>
 #include <xlOil/Throw.h>
+#include <atomic>
 #include <map>
 #include <string>
 #include <pybind11/pybind11.h>
@@ -71,8 +72,27 @@ namespace xloil
 
       bool isLocalFunc;
       bool isAsync;
+      unsigned profileId;
       bool isRtdAsync;
+      /// <summary>
+      /// A lazy function is registered before its module is imported. Its 
+      /// python function takes the registered name, imports the module and
+      /// returns the real PyFuncInfo which is then invoked.
+      /// </summary>
+      bool isLazy;
+      /// <summary>
+      /// If not empty, the function runs in the worker process pool which
+      /// imports it from this module path.
+      /// </summary>
+      std::wstring workerModule;
+      /// <summary>
+      /// Set if a worker could not return the function's result, for example
+      /// as it needed the object cache. Later calls run in Excel's process.
+      /// </summary>
+      std::atomic<bool> workerFallback;
+      bool hasKeywordArgs() const { return _hasKeywordArgs; }
       bool isThreadSafe() const { return (_info->options & FuncInfo::THREAD_SAFE) != 0; }
+      bool isVolatile()   const { return (_info->options & FuncInfo::VOLATILE) != 0; }
       bool isCommand()    const { return (_info->options & FuncInfo::COMMAND) != 0; }
       bool isFPArray()    const { return (_info->options & FuncInfo::ARRAY) != 0; }
 
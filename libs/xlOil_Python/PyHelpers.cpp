@@ -85,26 +85,16 @@ namespace xloil {
 
     std::wstring pyToWStr(const PyObject* p)
     {
-      Py_ssize_t len;
-      wchar_t* wstr;
       if (!p)
         return wstring();
-      else if (PyUnicode_Check(p))
-        wstr = PyUnicode_AsWideCharString((PyObject*)p, &len);
-      else
-      {
-        auto str = PyObject_Str((PyObject*)p);
-        if (!str)
-          throw py::error_already_set();
-        wstr = PyUnicode_AsWideCharString(str, &len);
-        Py_XDECREF(str);
-      }
 
-      if (!wstr) 
-        throw py::error_already_set();
+      auto str = PyUnicode_Check(p)
+        ? py::reinterpret_borrow<py::object>((PyObject*)p)
+        : PySteal(PyObject_Str((PyObject*)p));
 
-      auto freer = std::unique_ptr<wchar_t, void(*)(void*)>(wstr, PyMem_Free);
-      return wstring(wstr, len);
+      wstring result(pyUnicodeToUtf16(str.ptr(), nullptr, 0), L'\0');
+      pyUnicodeToUtf16(str.ptr(), result.data(), result.size());
+      return result;
     }
 
     PyObject* fastCall(
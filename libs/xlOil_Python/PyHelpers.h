@@ -135,6 +135,35 @@ namespace xloil
       return (std::string)pybind11::str(pybind11::handle((PyObject*)p));
     }
 
+    /// <summary>
+    /// Writes a python str to a UTF-16 buffer directly from its internal
+    /// representation. Follows the convention of the converters in 
+    /// xloil/Unicode.h: returns the full required length, but writes at 
+    /// most <paramref name="bufSize"/> chars, so calling with a zero-size
+    /// buffer gives the exact length required.
+    /// </summary>
+    inline size_t pyUnicodeToUtf16(PyObject* p, wchar_t* buf, size_t bufSize)
+    {
+      if (PyUnicode_READY(p) != 0)
+        throw pybind11::error_already_set();
+      const auto len = (size_t)PyUnicode_GET_LENGTH(p);
+      const auto* data = PyUnicode_DATA(p);
+      switch (PyUnicode_KIND(p))
+      {
+      case PyUnicode_1BYTE_KIND:
+        widenLatin1((char16_t*)buf, (const uint8_t*)data, std::min(len, bufSize));
+        return len;
+      case PyUnicode_2BYTE_KIND:
+        // Python's UCS-2 kind contains no surrogates
+        if (bufSize > 0)
+          memcpy(buf, data, std::min(len, bufSize) * sizeof(wchar_t));
+        return len;
+      default:
+        return ConvertUTF32ToUTF16()(
+          buf, bufSize, (const char32_t*)data, (const char32_t*)data + len);
+      }
+    }
+
     /// <summary>
     /// Converts a PyObject to a str, then to a C++ wstring
     /// </summary>
@@ -78,7 +78,7 @@ namespace xloil
           auto wbPathName = (fs::path(wbPath) / wbName).wstring();
 
           py::gil_scoped_acquire getGil;
-          _loadContext.importFile(modulePath.c_str(), wbPathName.c_str());
+          _loadContext.importFile(modulePath.c_str(), wbPathName.c_str(), true);
         }
       };
 
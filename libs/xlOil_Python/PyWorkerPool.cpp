@@ -0,0 +1,520 @@
+#include "PyWorkerPool.h"
+#include "PyWorkerProtocol.h"
+#include "PyFunctionRegister.h"
+#include "PyCache.h"
+#include "PyCore.h"
+#include "TypeConversion/BasicTypes.h"
+#include <xloil/ExcelObjBinary.h>
+#include <xloil/Profile.h>
+#include <xloil/Log.h>
+#include <xloil/Throw.h>
+#include <xloil/StringUtils.h>
+#include <xloil/WindowsSlim.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace py = pybind11;
+using std::wstring;
+using std::wstring_view;
+using std::vector;
+using std::shared_ptr;
+using std::unique_ptr;
+using std::make_unique;
+
+namespace xloil
+{
+  namespace Python
+  {
+    namespace
+    {
+      using namespace WorkerPool::Protocol;
+
+      struct Worker
+      {
+        unique_ptr<Channel> channel;
+        HANDLE process = nullptr;
+        size_t modulesLoaded = 0;
+      };
+
+      class Pool
+      {
+      public:
+        Pool(size_t nWorkers, size_t bufferSize)
+          : _nAlive(0)
+          , _bufferSize(bufferSize)
+        {
+          for (size_t i = 0; i < nWorkers; ++i)
+          {
+            auto worker = make_unique<Worker>();
+            worker->channel = make_unique<Channel>(
+              formatStr(L"Local\\xlOil_Worker_%d_%d", (int)GetCurrentProcessId(), (int)i),
+              bufferSize);
+            _workers.emplace_back(std::move(worker));
+          }
+        }
+
+        ~Pool()
+        {
+          for (auto& worker : _workers)
+          {
+            if (!worker->process)
+              continue;
+            // The worker also exits if our process does, so don't wait for it
+            worker->channel->header().message = Message::Exit;
+            worker->channel->signalRequest();
+            CloseHandle(worker->process);
+          }
+        }
+
+        vector<wstring> channelNames() const
+        {
+          vector<wstring> result;
+          for (auto& worker : _workers)
+            result.push_back(worker->channel->name());
+          return result;
+        }
+
+        void attach(const vector<unsigned long>& processIds)
+        {
+          for (size_t i = 0; i < _workers.size() && i < processIds.size(); ++i)
+          {
+            _workers[i]->process = OpenProcess(SYNCHRONIZE, FALSE, processIds[i]);
+            if (!_workers[i]->process)
+            {
+              XLO_ERROR(L"Failed to open python worker process {0}: {1}",
+                processIds[i], writeWindowsError());
+              continue;
+            }
+            _idle.push_back(_workers[i].get());
+            ++_nAlive;
+          }
+        }
+
+        size_t nAlive() const { return _nAlive; }
+        size_t bufferSize() const { return _bufferSize; }
+
+        /// <summary>
+        /// Blocks until a worker is free. Returns null if there are no
+        /// running workers.
+        /// </summary>
+        Worker* acquire()
+        {
+          std::unique_lock<std::mutex> lock(_lock);
+          _available.wait(lock, [&]() { return !_idle.empty() || _nAlive == 0; });
+          if (_idle.empty())
+            return nullptr;
+          auto* worker = _idle.back();
+          _idle.pop_back();
+          return worker;
+        }
+
+        void release(Worker* worker, bool alive)
+        {
+          {
+            std::scoped_lock lock(_lock);
+            if (alive)
+              _idle.push_back(worker);
+            else
+            {
+              XLO_ERROR(L"Python worker process for '{0}' exited unexpectedly",
+                worker->channel->name());
+              --_nAlive;
+            }
+          }
+          // Wake all waiters if the last worker has gone, so they run in-process
+          if (_nAlive == 0)
+            _available.notify_all();
+          else
+            _available.notify_one();
+        }
+
+        void addModule(const wstring& path)
+        {
+          std::scoped_lock lock(_lock);
+          _moduleLog.push_back(path);
+        }
+
+        /// <summary>
+        /// Returns the modules which the worker has not yet loaded since they
+        /// were last registered
+        /// </summary>
+        vector<wstring> pendingModules(const Worker& worker)
+        {
+          std::scoped_lock lock(_lock);
+          return vector<wstring>(_moduleLog.begin() + worker.modulesLoaded, _moduleLog.end());
+        }
+
+      private:
+        vector<unique_ptr<Worker>> _workers;
+        vector<Worker*> _idle;
+        std::atomic<size_t> _nAlive;
+        size_t _bufferSize;
+        vector<wstring> _moduleLog;
+        std::mutex _lock;
+        std::condition_variable _available;
+      };
+
+      unique_ptr<Pool> thePool;
+
+      /// <summary>
+      /// Holds a worker for the duration of a call and returns it to the pool
+      /// </summary>
+      struct WorkerLease
+      {
+        Worker* worker;
+        bool alive = true;
+
+        WorkerLease(Worker* w) : worker(w) {}
+        ~WorkerLease() { thePool->release(worker, alive); }
+
+        /// <summary>
+        /// Sends the request and waits for the response. Returns Exit if
+        /// the worker process exited before responding.
+        /// </summary>
+        Message exchange()
+        {
+          auto& channel = *worker->channel;
+          channel.signalRequest();
+          if (!channel.waitResponse(worker->process))
+          {
+            alive = false;
+            return Message::Exit;
+          }
+          return channel.header().message;
+        }
+      };
+
+      /// <summary>
+      /// Returns false if the worker exited
+      /// </summary>
+      bool loadModules(WorkerLease& lease)
+      {
+        auto& worker = *lease.worker;
+        auto paths = thePool->pendingModules(worker);
+        if (paths.empty())
+          return true;
+
+        auto& channel = *worker.channel;
+        size_t totalLength = 0;
+        for (auto& path : paths)
+          totalLength += path.size() + 1;
+        BinaryWriter pathArray((ExcelObj::row_t)paths.size(), 1, totalLength);
+        for (size_t i = 0; i < paths.size(); ++i)
+          pathArray(i) = wstring_view(paths[i]);
+        if (pathArray.byteSize() > channel.capacity())
+          XLO_THROW("Module paths exceed worker buffer size");
+
+        auto writer = channel.writer();
+        writer.write(pathArray);
+        channel.send(Message::Load, writer);
+
+        const auto reply = lease.exchange();
+        if (reply == Message::Exit)
+          return false;
+        if (reply == Message::Error)
+          XLO_WARN(L"Python worker failed to import modules: {0}",
+            wstring(channel.reader().readString()));
+
+        worker.modulesLoaded += paths.size();
+        return true;
+      }
+
+      void respond(Channel& channel, Message message, const ExcelObj& value)
+      {
+        auto writer = channel.writer();
+        writer.write(value);
+        channel.send(message, writer);
+        channel.signalResponse();
+      }
+
+      void respondError(Channel& channel, const wstring_view& message)
+      {
+        // Leave room for the header, tag and value columns and length prefix
+        const auto overhead = Binary::encodedSize(ExcelObj(L""));
+        const auto maxLen = std::min<size_t>(
+          (channel.capacity() - overhead) / sizeof(wchar_t), XL_STRING_MAX_LEN);
+        respond(channel, Message::Error, ExcelObj(message.substr(0, maxLen)));
+      }
+
+      /// <summary>
+      /// Runs in the worker process: serves requests on the channel until
+      /// told to exit or the parent process exits.
+      /// </summary>
+      void serveWorker(
+        const wstring& channelName,
+        unsigned long parentPid,
+        const py::object& load,
+        const py::object& resolve)
+      {
+        // Cache references made here would not be valid in Excel's process
+        pyCacheDisable();
+
+        Channel channel(channelName);
+        auto parent = OpenProcess(SYNCHRONIZE, FALSE, parentPid);
+        if (!parent)
+          XLO_THROW(L"Failed to open parent process {0}: {1}", parentPid, writeWindowsError());
+
+        // Keyed on module path and function name
+        std::unordered_map<wstring, shared_ptr<PyFuncInfo>> funcs;
+
+        while (true)
+        {
+          bool received;
+          {
+            py::gil_scoped_release releaseGil;
+            received = channel.waitRequest(parent);
+          }
+          if (!received || channel.header().message == Message::Exit)
+            break;
+
+          try
+          {
+            auto reader = channel.reader();
+            switch (channel.header().message)
+            {
+            case Message::Load:
+            {
+              const auto paths = reader.next();
+              for (size_t i = 0; i < paths.size(); ++i)
+              {
+                if (paths.tag(i) != Binary::Tag::Str)
+                  XLO_THROW("Corrupt worker message: expected module path");
+                const auto path = wstring(paths.string(i));
+                // Forget functions from any previous import of the module
+                const auto prefix = path + L'|';
+                for (auto f = funcs.begin(); f != funcs.end();)
+                  f = f->first.compare(0, prefix.size(), prefix) == 0 ? funcs.erase(f) : std::next(f);
+                load(path);
+              }
+              respond(channel, Message::Ok, ExcelObj());
+              break;
+            }
+            case Message::Call:
+            {
+              const auto callHeader = reader.next();
+              if (callHeader.size() != 3
+                  || callHeader.tag(0) != Binary::Tag::Str
+                  || callHeader.tag(1) != Binary::Tag::Str
+                  || callHeader.tag(2) != Binary::Tag::Int)
+                XLO_THROW("Corrupt worker message: bad call header");
+              const auto name = callHeader.string(0);
+              const auto path = callHeader.string(1);
+              auto key = wstring(path).append(1, L'|').append(name);
+
+              auto found = funcs.find(key);
+              if (found == funcs.end())
+              {
+                auto info = resolve(wstring(path), wstring(name)).cast<shared_ptr<PyFuncInfo>>();
+                // Completes the argument set up which registration would do,
+                // the returned spec is not required
+                PyFuncInfo::createSpec(info);
+                found = funcs.emplace(std::move(key), info).first;
+              }
+              auto& info = *found->second;
+
+              // The arguments' strings point into the channel, which is not
+              // written until the function has returned
+              vector<ExcelObj> args;
+              const auto nArgs = (size_t)callHeader.integer(2);
+              if (nArgs != info.constArgs().size())
+                XLO_THROW(L"Worker function '{0}' expected {1} args, received {2}",
+                  info.name(), info.constArgs().size(), nArgs);
+              args.reserve(nArgs);
+              for (size_t i = 0; i < nArgs; ++i)
+                args.emplace_back(reader.next().toExcelObjView());
+
+              auto retVal = info.invoke([&](auto i) -> const ExcelObj& { return args[i]; });
+
+              // Objects which can only be returned as a cache reference are
+              // returned by running the function in Excel's process instead
+              ExcelObj result;
+              try
+              {
+                const auto& returnConverter = info.getReturnConverter();
+                result = returnConverter
+                  ? (*returnConverter)(*retVal.ptr())
+                  : FromPyObj<>()(retVal.ptr());
+              }
+              catch (const CacheUnavailable&)
+              {
+                respond(channel, Message::Fallback, ExcelObj(true));
+                break;
+              }
+
+              // Nested arrays cannot be encoded, so the function is run in
+              // Excel's process from now on. A result which is too large for
+              // the buffer is only run there this time.
+              size_t size;
+              try
+              {
+                size = Binary::encodedSize(result);
+              }
+              catch (const std::exception&)
+              {
+                respond(channel, Message::Fallback, ExcelObj(true));
+                break;
+              }
+              if (size > channel.capacity())
+              {
+                respond(channel, Message::Fallback, ExcelObj(false));
+                break;
+              }
+
+              auto writer = channel.writer();
+              writer.write(result, size);
+              channel.send(Message::Ok, writer);
+              channel.signalResponse();
+              break;
+            }
+            default:
+              XLO_THROW("Unexpected worker message {}", (int)channel.header().message);
+            }
+          }
+          catch (const py::error_already_set& e)
+          {
+            respondError(channel, utf8ToUtf16(e.what()));
+          }
+          catch (const std::exception& e)
+          {
+            respondError(channel, utf8ToUtf16(e.what()));
+          }
+        }
+        CloseHandle(parent);
+      }
+
+      static int theBinder = addBinder([](py::module& mod)
+      {
+        mod.def("_worker_serve",
+          serveWorker,
+          R"(
+            Runs in a worker process started by xlOil to serve calls to threaded
+            functions sent from Excel. Returns when the parent process exits.
+          )",
+          py::arg("channel"),
+          py::arg("parent_pid"),
+          py::arg("load"),
+          py::arg("resolve"));
+      });
+    }
+
+    namespace WorkerPool
+    {
+      void start(size_t nWorkers, size_t bufferSize)
+      {
+        if (thePool)
+          XLO_THROW("Python worker pool already started");
+
+        auto pool = make_unique<Pool>(nWorkers, bufferSize);
+        auto processIds = py::module::import("xloil.worker").attr("_spawn_workers")(
+          pool->channelNames(), GetCurrentProcessId());
+        pool->attach(processIds.cast<vector<unsigned long>>());
+
+        XLO_INFO("Started {0} python worker processes with {1} byte buffers",
+          pool->nAlive(), bufferSize);
+        thePool = std::move(pool);
+      }
+
+      void stop()
+      {
+        thePool.reset();
+      }
+
+      bool isRunning()
+      {
+        return thePool && thePool->nAlive() > 0;
+      }
+
+      bool canDispatch(const PyFuncInfo& info)
+      {
+        if (!info.isThreadSafe() || info.isAsync || info.isRtdAsync || info.isLazy)
+          return false;
+        for (auto& arg : info.constArgs())
+          if (!dispatchableArgType(arg.type.c_str()))
+            return false;
+        return true;
+      }
+
+      void addModule(const std::wstring& modulePath)
+      {
+        if (thePool)
+          thePool->addModule(modulePath);
+      }
+
+      bool call(
+        const PyFuncInfo& info,
+        const ExcelObj** xlArgs,
+        ExcelObj& result,
+        Profile::CallTimer& timer)
+      {
+        if (!thePool || info.workerFallback.load(std::memory_order_relaxed))
+          return false;
+
+        const auto nArgs = info.constArgs().size();
+        BinaryWriter callHeader(1, 3, info.name().size() + info.workerModule.size() + 2);
+        callHeader(0) = wstring_view(info.name());
+        callHeader(1) = wstring_view(info.workerModule);
+        callHeader(2) = (int)nArgs;
+
+        // Arguments which cannot be encoded, such as references, are run
+        // in-process
+        vector<size_t> argSizes(nArgs);
+        size_t size = callHeader.byteSize();
+        try
+        {
+          for (size_t i = 0; i < nArgs; ++i)
+            size += argSizes[i] = Binary::encodedSize(*xlArgs[i]);
+        }
+        catch (const std::exception&)
+        {
+          return false;
+        }
+        if (size > thePool->bufferSize())
+          return false;
+
+        auto* worker = thePool->acquire();
+        if (!worker)
+          return false;
+        WorkerLease lease(worker);
+        auto& channel = *worker->channel;
+
+        if (!loadModules(lease))
+          return false;
+
+        auto writer = channel.writer();
+        writer.write(callHeader);
+        for (size_t i = 0; i < nArgs; ++i)
+          writer.write(*xlArgs[i], argSizes[i]);
+        channel.send(Message::Call, writer);
+        timer.phaseEnd(Profile::Phase::Args);
+
+        const auto reply = lease.exchange();
+        timer.phaseEnd(Profile::Phase::Body);
+
+        switch (reply)
+        {
+        case Message::Exit:
+          return false;
+        case Message::Fallback:
+          if (channel.reader().next().integer(0) != 0 && !info.workerFallback.exchange(true))
+            XLO_INFO(L"Python function '{0}' returns values which cannot be sent "
+              "from a worker, so will run in Excel's process", info.name());
+          return false;
+        default:
+          break;
+        }
+
+        auto reader = channel.reader();
+        if (reply == Message::Error)
+          XLO_THROW(L"{0}", wstring(reader.readString()));
+        result = reader.read();
+        timer.phaseEnd(Profile::Phase::Return);
+        return true;
+      }
+    }
+  }
+}
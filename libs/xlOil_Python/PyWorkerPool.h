@@ -0,0 +1,69 @@
+#pragma once
+#include <xlOil/ExcelObj.h>
+#include <string>
+
+namespace xloil
+{
+  namespace Profile { class CallTimer; }
+  namespace Python
+  {
+    class PyFuncInfo;
+
+    /// <summary>
+    /// A pool of python worker processes which run threaded worksheet functions
+    /// so that Excel's calculation threads are not serialised by the GIL.
+    /// Each worker imports the same modules as the Excel process and is sent
+    /// calls through a shared memory block: the function name, source module
+    /// and argument values are written in a compact binary layout and the
+    /// result returned the same way, so no pickling is involved.
+    /// </summary>
+    namespace WorkerPool
+    {
+      /// <summary>
+      /// Creates the channels and starts the worker processes. Must hold
+      /// the GIL to call.
+      /// </summary>
+      /// <param name="nWorkers"></param>
+      /// <param name="bufferSize">Size in bytes of the shared memory block
+      /// used by each worker, which limits the size of arguments and results
+      /// </param>
+      void start(size_t nWorkers, size_t bufferSize);
+
+      /// <summary>
+      /// Asks the workers to exit and closes the channels
+      /// </summary>
+      void stop();
+
+      bool isRunning();
+
+      /// <summary>
+      /// Returns true if the function can run in a worker: it must be
+      /// threaded, not async and not take ranges or FastArray arguments.
+      /// </summary>
+      bool canDispatch(const PyFuncInfo& info);
+
+      /// <summary>
+      /// Records that functions from the given module will be dispatched to
+      /// the workers. Each worker imports the module before its next call,
+      /// or reloads it if the module has been registered before.
+      /// </summary>
+      void addModule(const std::wstring& modulePath);
+
+      /// <summary>
+      /// Runs the function in a worker, blocking until a worker is free and
+      /// the call completes. Returns false if the call cannot be sent, for
+      /// example if the arguments exceed the buffer size, or the worker
+      /// cannot return the result, in which case the caller should invoke the
+      /// function in-process. A result cannot be returned if it needs the
+      /// object cache, is a nested array, exceeds the buffer size or the 
+      /// worker exits during the call: the function is then run twice. Throws if the function raises an exception in the
+      /// worker.
+      /// </summary>
+      bool call(
+        const PyFuncInfo& info,
+        const ExcelObj** xlArgs,
+        ExcelObj& result,
+        Profile::CallTimer& timer);
+    }
+  }
+}
@@ -0,0 +1,263 @@
+#pragma once
+#include <xloil/ExcelObj.h>
+#include <xloil/ExcelObjBinary.h>
+#include <xloil/Throw.h>
+#include <xloil/StringUtils.h>
+#include <xloil/WindowsSlim.h>
+#include <algorithm>
+#include <string>
+#include <string_view>
+
+namespace xloil
+{
+  namespace Python
+  {
+    namespace WorkerPool
+    {
+      /// <summary>
+      /// The shared memory channel and message layout used to send calls to
+      /// worker processes and return their results. Values are sent in the
+      /// <see cref="Binary"/> ExcelObj format. Nothing here uses python, so
+      /// the protocol can be tested without an interpreter.
+      /// </summary>
+      namespace Protocol
+      {
+        using std::wstring;
+        using std::wstring_view;
+
+        /// <summary>
+        /// Returns false for argument types which hold a reference into Excel's
+        /// process, such as ranges and FastArrays, so cannot be sent to a worker
+        /// </summary>
+        inline bool dispatchableArgType(const char* type)
+        {
+          return _stricmp(type, "array") != 0 && _stricmp(type, "range") != 0;
+        }
+
+        /// <summary>
+        /// Writes a message payload: a sequence of values in the <see cref="Binary"/>
+        /// format. Each encoded value is a multiple of 8 bytes, so the next one 
+        /// starts aligned.
+        /// </summary>
+        class MessageWriter
+        {
+        public:
+          MessageWriter(char* buffer, size_t capacity)
+            : _begin(buffer)
+            , _pos(buffer)
+            , _end(buffer + capacity)
+          {}
+
+          /// <summary>
+          /// Writes a value whose <see cref="Binary::encodedSize"/> is known
+          /// </summary>
+          void write(const ExcelObj& value, size_t encodedSize)
+          {
+            if (encodedSize > remaining())
+              XLO_THROW("Worker message exceeds buffer size");
+            _pos += Binary::encode(value, _pos, encodedSize);
+          }
+
+          void write(const ExcelObj& value)
+          {
+            write(value, Binary::encodedSize(value));
+          }
+
+          void write(const BinaryWriter& value)
+          {
+            const auto size = value.byteSize();
+            if (size > remaining())
+              XLO_THROW("Worker message exceeds buffer size");
+            value.writeTo(_pos, size);
+            _pos += size;
+          }
+
+          size_t size() const { return _pos - _begin; }
+          size_t remaining() const { return _end - _pos; }
+
+        private:
+          char* _begin;
+          char* _pos;
+          char* _end;
+        };
+
+        /// <summary>
+        /// Reads the values in a message payload in turn. Each is validated
+        /// by <see cref="BinaryView"/>, which throws if it is corrupt.
+        /// </summary>
+        class MessageReader
+        {
+        public:
+          MessageReader(const char* data, size_t size)
+            : _pos(data)
+            , _end(data + size)
+          {}
+
+          /// <summary>
+          /// Returns a view of the next value, which points into the payload
+          /// </summary>
+          BinaryView next()
+          {
+            if (_pos >= _end)
+              XLO_THROW("Corrupt worker message: unexpected end");
+            BinaryView view(_pos, _end - _pos);
+            _pos += view.byteSize();
+            return view;
+          }
+
+          /// <summary>
+          /// Returns an independent copy of the next value
+          /// </summary>
+          ExcelObj read() { return next().toExcelObj(); }
+
+          /// <summary>
+          /// Reads a string value. It points into the payload.
+          /// </summary>
+          wstring_view readString()
+          {
+            const auto view = next();
+            if (view.isArray() || view.tag(0) != Binary::Tag::Str)
+              XLO_THROW("Corrupt worker message: expected string");
+            return view.string(0);
+          }
+
+        private:
+          const char* _pos;
+          const char* _end;
+        };
+
+        enum class Message : uint32_t
+        {
+          /// Payload: a 1x3 array of function name, module path and argument 
+          /// count, then the arguments
+          Call,
+          /// Payload: a column array of module paths
+          Load,
+          Exit,
+          /// Payload: the result value
+          Ok,
+          /// Payload: the error message
+          Error,
+          /// The result cannot be returned from a worker, for example as it 
+          /// needs the object cache or is a nested array, so the call should
+          /// run in Excel's process. Payload: a bool which is true if later 
+          /// calls to the function should also run in Excel's process.
+          Fallback
+        };
+
+        struct ChannelHeader
+        {
+          uint64_t capacity;
+          uint64_t size;
+          Message message;
+          uint32_t padding;
+        };
+
+        /// <summary>
+        /// A block of shared memory with a pair of events to signal that a
+        /// request or response has been written to it. Only one call is in
+        /// flight on a channel at a time.
+        /// </summary>
+        class Channel
+        {
+        public:
+          /// <summary>
+          /// Creates the shared memory and events
+          /// </summary>
+          Channel(const wstring& name, size_t capacity)
+            : _name(name)
+          {
+            const auto totalSize = (uint64_t)(sizeof(ChannelHeader) + capacity);
+            _mapping = CreateFileMapping(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+              (DWORD)(totalSize >> 32), (DWORD)totalSize, name.c_str());
+            if (!_mapping)
+              XLO_THROW(L"Failed to create worker channel '{0}': {1}", name, writeWindowsError());
+            map();
+            header().capacity = capacity;
+            _request = CreateEvent(nullptr, FALSE, FALSE, (name + L"_Request").c_str());
+            _response = CreateEvent(nullptr, FALSE, FALSE, (name + L"_Response").c_str());
+            if (!_request || !_response)
+              XLO_THROW(L"Failed to create worker channel events '{0}': {1}", name, writeWindowsError());
+          }
+
+          /// <summary>
+          /// Opens a channel created by another process
+          /// </summary>
+          Channel(const wstring& name)
+            : _name(name)
+          {
+            _mapping = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+            if (!_mapping)
+              XLO_THROW(L"Failed to open worker channel '{0}': {1}", name, writeWindowsError());
+            map();
+            _request = OpenEvent(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, (name + L"_Request").c_str());
+            _response = OpenEvent(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, (name + L"_Response").c_str());
+            if (!_request || !_response)
+              XLO_THROW(L"Failed to open worker channel events '{0}': {1}", name, writeWindowsError());
+          }
+
+          ~Channel()
+          {
+            if (_view) UnmapViewOfFile(_view);
+            if (_mapping) CloseHandle(_mapping);
+            if (_request) CloseHandle(_request);
+            if (_response) CloseHandle(_response);
+          }
+
+          Channel(const Channel&) = delete;
+          Channel& operator=(const Channel&) = delete;
+
+          const wstring& name() const { return _name; }
+          ChannelHeader& header() { return *(ChannelHeader*)_view; }
+          char* payload() { return _view + sizeof(ChannelHeader); }
+          size_t capacity() { return header().capacity; }
+
+          MessageWriter writer()
+          {
+            return MessageWriter(payload(), capacity());
+          }
+
+          void send(Message message, const MessageWriter& writer)
+          {
+            header().message = message;
+            header().size = writer.size();
+          }
+
+          MessageReader reader()
+          {
+            return MessageReader(payload(), std::min<size_t>(header().size, capacity()));
+          }
+
+          void signalRequest() { SetEvent(_request); }
+          void signalResponse() { SetEvent(_response); }
+
+          /// <summary>
+          /// Waits for a request, returning false if the other process exits first
+          /// </summary>
+          bool waitRequest(HANDLE otherProcess) { return wait(_request, otherProcess); }
+          bool waitResponse(HANDLE otherProcess) { return wait(_response, otherProcess); }
+
+        private:
+          wstring _name;
+          HANDLE _mapping = nullptr;
+          HANDLE _request = nullptr;
+          HANDLE _response = nullptr;
+          char* _view = nullptr;
+
+          void map()
+          {
+            _view = (char*)MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+            if (!_view)
+              XLO_THROW(L"Failed to map worker channel '{0}': {1}", _name, writeWindowsError());
+          }
+
+          static bool wait(HANDLE event, HANDLE otherProcess)
+          {
+            HANDLE handles[] = { event, otherProcess };
+            return WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0;
+          }
+        };
+      }
+    }
+  }
+}
@@ -275,9 +275,9 @@ namespace xloil
           XLO_THROW("Expected python str, got '{0}'", pyToStr(obj));
 
         const auto len = (char16_t)std::min<size_t>(
-          USHRT_MAX, PyUnicode_GET_LENGTH((PyObject*)obj));
+          USHRT_MAX, pyUnicodeToUtf16((PyObject*)obj, nullptr, 0));
         BasicPString<wchar_t, TAlloc> pstr(len, allocator);
-        PyUnicode_AsWideChar((PyObject*)obj, pstr.pstr(), pstr.length());
+        pyUnicodeToUtf16((PyObject*)obj, pstr.pstr(), pstr.length());
         return ExcelObj(std::move(pstr));
       }
     };
@@ -14,9 +14,19 @@
 #include <numpy/arrayscalars.h>
 #include <numpy/npy_math.h>
 #include <numpy/ndarrayobject.h>
+// numpy 2 hides the descriptor fields behind accessors. Its compatibility
+// header provides them for both versions, but older numpy lacks it.
+#if __has_include(<numpy/npy_2_compat.h>)
+#  include <numpy/npy_2_compat.h>
+#else
+#  define PyDataType_C_METADATA(descr) ((descr)->c_metadata)
+#endif
 #include <pybind11/pybind11.h>
+#include <algorithm>
+#include <cmath>
 #include <locale>
 #include <tuple>
+#include <unordered_set>
 
 namespace py = pybind11;
 using std::shared_ptr;
@@ -82,37 +92,72 @@ namespace xloil
       }
     };
 
-    class NumpyDateFromDate : public ExcelValVisitor<npy_datetime>
+    constexpr npy_datetime MICROSECS_PER_DAY = 86400000000ll;
+
+    /// <summary>
+    /// Converts an Excel serial date, with fractional time, to microseconds
+    /// since the Unix epoch, rounded to the nearest microsecond. Gives NaT if 
+    /// the number is not a valid Excel date.
+    /// </summary>
+    npy_datetime serialToMicrosecs(double serial)
     {
-    public:
-      using ExcelValVisitor::operator();
+      if (!(serial >= 0 && serial < XL_MAX_SERIAL_DATE + 1))
+        return NPY_DATETIME_NAT;
+      const auto day = std::floor(serial);
+      return excelSerialDateToUnixDays((int)day) * MICROSECS_PER_DAY
+        + std::llround((serial - day) * MICROSECS_PER_DAY);
+    }
 
-      npy_datetime operator()(int x) const
-      {
-        int day, month, year;
-        excelSerialDateToYMD(x, year, month, day);
-        npy_datetimestruct dt = { year, month, day };
-        return PyArray_DatetimeStructToDatetime(NPY_FR_us, &dt);
-      }
-      npy_datetime operator()(double x) const
-      {
-        int day, month, year, hours, mins, secs, usecs;
-        excelSerialDatetoYMDHMS(x, year, month, day, hours, mins, secs, usecs);
-        npy_datetimestruct dt = { year, month, day, hours, mins, secs, usecs };
-        return PyArray_DatetimeStructToDatetime(NPY_FR_us, &dt);
-      }
-      npy_datetime operator()(const PStringRef& str) const
+    /// <summary>
+    /// Converts Excel values to microseconds since the Unix epoch. Numbers are
+    /// serial dates and strings are parsed. Empty cells and errors give NaT.
+    /// </summary>
+    class NumpyDateFromExcel
+    {
+    public:
+      npy_datetime operator()(const ExcelObj& x)
       {
-        std::tm tm;
-        if (stringToDateTime(str.view(), tm))
+        switch (x.type())
         {
-          npy_datetimestruct dt = { tm.tm_year + 1900, tm.tm_mon + 1,
-            tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, 0 };
-          return PyArray_DatetimeStructToDatetime(NPY_FR_us, &dt);
+        case ExcelType::Num:
+          return serialToMicrosecs(x.val.num);
+        case ExcelType::Int:
+          return serialToMicrosecs(x.val.w);
+        case ExcelType::Str:
+        {
+          std::tm tm;
+          const auto str = x.cast<PStringRef>().view();
+          if (!_parser(str, tm))
+            XLO_THROW(L"Cannot read '{0}' as a date", str);
+          return excelSerialDateToUnixDays(excelSerialDateFromYMD(
+              tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday)) * MICROSECS_PER_DAY
+            + ((tm.tm_hour * 60 + tm.tm_min) * 60 + tm.tm_sec) * 1000000ll;
+        }
+        case ExcelType::Nil:
+        case ExcelType::Missing:
+        case ExcelType::Err:
+          return NPY_DATETIME_NAT;
+        default:
+          XLO_THROW(L"Cannot read '{0}' as a date", x.toString());
         }
-        XLO_THROW("Cannot read '{0}' as a date");
       }
+
+    private:
+      // Remembers the last matching format, which is likely to be shared
+      // by all strings in the array
+      DateTimeParser _parser;
     };
+
+    /// <summary>
+    /// Gives the datetime64 descriptor for a unit string such as "D" or "us"
+    /// </summary>
+    PyArray_Descr* datetimeDescr(const char* unit)
+    {
+      PyArray_Descr* descr = nullptr;
+      if (!PyArray_DescrConverter(py::str(string("M8[") + unit + "]").ptr(), &descr))
+        throw py::error_already_set();
+      return descr;
+    }
    
 
     struct TruncateUTF16ToChar
@@ -174,6 +219,19 @@ namespace xloil
       }
     };
 
+    /// <summary>
+    /// Unlike NPToT, keeps a single converter for the whole array so the
+    /// date format affinity of NumpyDateFromExcel carries between elements
+    /// </summary>
+    struct NPToDate
+    {
+      mutable NumpyDateFromExcel _conv;
+      void operator()(npy_datetime* d, size_t, const ExcelObj& x) const
+      {
+        *d = _conv(x);
+      }
+    };
+
     template <class T> struct TypeTraitsBase { };
 
     template <int> struct TypeTraits {};
@@ -189,7 +247,7 @@ namespace xloil
     template<> struct TypeTraits<NPY_DATETIME> 
     { 
       using storage = npy_datetime;
-      using from_excel = NPToT<NumpyDateFromDate, storage>;
+      using from_excel = NPToDate;
     };
     template<> struct TypeTraits<NPY_STRING> 
     { 
@@ -275,6 +333,47 @@ namespace xloil
         nullptr); // array finaliser
     }
 
+    /// <summary>
+    /// As newNumpyArray, for types like datetime64 which need a descriptor
+    /// with a unit. Steals the reference to the descriptor.
+    /// </summary>
+    template<int N>
+    PyObject* newNumpyArray(PyArray_Descr* descr, Py_intptr_t(&dims)[N], void* data)
+    {
+      return PyArray_NewFromDescr(
+        &PyArray_Type,
+        descr,
+        N,
+        dims,
+        nullptr, // strides
+        data,
+        NPY_ARRAY_OWNDATA,
+        nullptr);
+    }
+
+    /// <summary>
+    /// Writes datetime64 values to a new numpy array. The converter fills the
+    /// data with microseconds. If every value is a whole day, we divide down 
+    /// to give datetime64[D], the natural type for a column of dates, 
+    /// otherwise the array is datetime64[us].  We do not use datetime64[ns]
+    /// as it cannot hold dates after 2262.
+    /// </summary>
+    template<int N>
+    PyObject* newDatetimeArray(Py_intptr_t(&dims)[N], npy_datetime* data, size_t size)
+    {
+      const auto wholeDays = std::all_of(data, data + size, [](npy_datetime x)
+      {
+        return x == NPY_DATETIME_NAT || x % MICROSECS_PER_DAY == 0;
+      });
+      if (wholeDays)
+      {
+        for (auto p = data; p != data + size; ++p)
+          if (*p != NPY_DATETIME_NAT)
+            *p /= MICROSECS_PER_DAY;
+      }
+      return newNumpyArray(datetimeDescr(wholeDays ? "D" : "us"), dims, data);
+    }
+
     template <int TNpType>
     class PyFromArray1d : public detail::PyFromExcelImpl
     {
@@ -313,7 +412,10 @@ namespace xloil
         for (auto p = arr.begin(); p != arr.end(); ++p, d += itemsize)
           _conv((data_type*)d, itemsize, *p);
         
-        return newNumpyArray(TNpType, dims, data, itemsize);
+        if constexpr (TNpType == NPY_DATETIME)
+          return newDatetimeArray(dims, (npy_datetime*)data, arr.size());
+        else
+          return newNumpyArray(TNpType, dims, data, itemsize);
       }
 
       constexpr wchar_t* failMessage() const { return L"Expected array"; }
@@ -364,7 +466,10 @@ namespace xloil
             _conv((TDataType*)d, itemsize, *pObj);
         }
 
-        return newNumpyArray(TNpType, dims, data, itemsize);
+        if constexpr (TNpType == NPY_DATETIME)
+          return newDatetimeArray(dims, (npy_datetime*)data, arr.size());
+        else
+          return newNumpyArray(TNpType, dims, data, itemsize);
       }
 
       constexpr wchar_t* failMessage() const { return L"Expected array"; }
@@ -404,6 +509,31 @@ namespace xloil
       return new FPArrayConverter();
     }
 
+    namespace
+    {
+      /// <summary>
+      /// Makes an ExcelObj which points to a string in an array builder's 
+      /// string store. It must be emplaced in the array, which owns the buffer.
+      /// </summary>
+      ExcelObj inStringStore(BasicPString<wchar_t, detail::ArrayBuilderCharAllocator>&& pstr)
+      {
+        return ExcelObj(PString::steal(pstr.release()));
+      }
+
+      struct PyStrHash
+      {
+        size_t operator()(PyObject* p) const { return (size_t)PyObject_Hash(p); }
+      };
+
+      struct PyStrEqual
+      {
+        bool operator()(PyObject* l, PyObject* r) const
+        {
+          return l == r || PyUnicode_Compare(l, r) == 0;
+        }
+      };
+    }
+
     template<
       int TNpType, 
       bool IsString = (TNpType == NPY_UNICODE) || (TNpType == NPY_STRING)>
@@ -415,7 +545,8 @@ namespace xloil
       { 
         PyArray_ITEMSIZE(pArr) == sizeof(TDataType) && PyArray_TYPE(pArr) == TNpType;
       }
-      static constexpr size_t stringLength = 0;
+      // Size of the string store needed by the array builder
+      static constexpr size_t strings = 0;
       auto toExcelObj(
         ExcelArrayBuilder&, 
         void* arrayPtr)
@@ -434,13 +565,16 @@ namespace xloil
       static constexpr uint16_t charMultiple =
         std::max<uint16_t>(1, sizeof(data_type) / sizeof(char16_t));
       
-      // Contains the number of characters per numpy array element multiplied 
-      // by the number of char16 we will need
-      const uint16_t stringLength;
+      // The number of characters per numpy array element
+      const size_t itemChars;
+
+      // Contains the total number of characters in the array multiplied 
+      // by the number of char16 we will need for each
+      const size_t strings;
 
       FromArrayImpl(PyArrayObject* pArr)
-        : stringLength(std::min<uint16_t>(USHRT_MAX,
-            (uint16_t)PyArray_ITEMSIZE(pArr) / sizeof(data_type) * charMultiple))
+        : itemChars(std::min<size_t>(USHRT_MAX, PyArray_ITEMSIZE(pArr) / sizeof(data_type)))
+        , strings(itemChars * charMultiple * PyArray_SIZE(pArr))
       {
         const auto type = PyArray_TYPE(pArr);
         if (type != NPY_UNICODE && type != NPY_STRING)
@@ -451,23 +585,37 @@ namespace xloil
         ExcelArrayBuilder& builder, 
         void* arrayPtr)
       {
-        const auto x = (const char32_t*)arrayPtr;
-        const auto len = strlen32(x, stringLength / charMultiple);
-        auto pstr = builder.string((uint16_t)len);
-        auto nChars = ConvertUTF32ToUTF16()(
-          (char16_t*)pstr.pstr(), pstr.length(), x, x + len );
-
-        // Because not every UTF-32 char takes two UTF-16 chars and not
-        // every string takes up the full fixed with, we resize here
-        pstr.resize((char16_t)nChars);
-        return ExcelObj(std::move(pstr));
+        const auto maxChars = itemChars;
+        if constexpr (TNpType == NPY_STRING)
+        {
+          // Fixed width byte strings: read as Latin-1
+          const auto x = (const char*)arrayPtr;
+          const auto len = strnlen(x, maxChars);
+          auto pstr = builder.string((uint16_t)len);
+          widenLatin1((char16_t*)pstr.pstr(), (const uint8_t*)x, len);
+          return inStringStore(std::move(pstr));
+        }
+        else
+        {
+          const auto x = (const char32_t*)arrayPtr;
+          const auto len = strlen32(x, maxChars);
+          // Size the string exactly: only chars outside the BMP need two
+          // UTF-16 chars and the builder has reserved space for that case
+          const auto nChars = std::min<size_t>(USHRT_MAX, utf16Length(x, x + len));
+          auto pstr = builder.string((uint16_t)nChars);
+          ConvertUTF32ToUTF16()(
+            (char16_t*)pstr.pstr(), pstr.length(), x, x + len);
+          return inStringStore(std::move(pstr));
+        }
       }
     };
 
     template<>
     struct FromArrayImpl<NPY_OBJECT, false>
     {
-      size_t stringLength;
+      // Object arrays, such as pandas string columns, often repeat strings
+      // so we count the distinct ones and the array builder interns them
+      ArrayStringCounter strings;
 
       FromArrayImpl(PyArrayObject* pArr)
       {
@@ -475,20 +623,31 @@ namespace xloil
         if (PyArray_ITEMSIZE(pArr) != sizeof(PyObject*) || type != NPY_OBJECT)
           XLO_THROW("Incorrect array type: expected object");
 
-        stringLength = 0;
         auto dims = PyArray_DIMS(pArr);
         auto nDims = PyArray_NDIM(pArr);
 
+        // Python strings cache their hash, so finding repeats is cheap
+        std::unordered_set<PyObject*, PyStrHash, PyStrEqual> seen;
+        auto count = [&](PyObject* p)
+        {
+          // Only strings are written to the array's string store
+          if (!PyUnicode_Check(p))
+            return;
+          const auto len = std::min<size_t>(USHRT_MAX, pyUnicodeToUtf16(p, nullptr, 0));
+          if (len > 0)
+            strings.add(len, strings.interning() && !seen.insert(p).second);
+        };
+
         switch (nDims)
         {
         case 1:
           for (auto i = 0; i < dims[0]; ++i)
-            accumulateObjectStringLength(*(PyObject**)PyArray_GETPTR1(pArr, i), stringLength);
+            count(*(PyObject**)PyArray_GETPTR1(pArr, i));
           break;
         case 2:
           for (auto i = 0; i < dims[0]; ++i)
             for (auto j = 0; j < dims[1]; ++j)
-              accumulateObjectStringLength(*(PyObject**)PyArray_GETPTR2(pArr, i, j), stringLength);
+              count(*(PyObject**)PyArray_GETPTR2(pArr, i, j));
           break;
         default:
           XLO_THROW("FromArray: dimension must be 1 or 2");
@@ -499,11 +658,81 @@ namespace xloil
         ExcelArrayBuilder& builder, 
         void* arrayPtr)
       {
-        const auto* pyObj = *(PyObject**)arrayPtr;
+        auto* pyObj = *(PyObject**)arrayPtr;
+        if (PyUnicode_Check(pyObj))
+        {
+          // Write directly into the string store, where the builder can 
+          // intern the string when it is emplaced
+          const auto len = std::min<size_t>(USHRT_MAX, pyUnicodeToUtf16(pyObj, nullptr, 0));
+          auto pstr = builder.string((uint16_t)len);
+          pyUnicodeToUtf16(pyObj, pstr.pstr(), pstr.length());
+          return inStringStore(std::move(pstr));
+        }
         return FromPyObj()(pyObj, builder.charAllocator());
       }
     };
 
+    template<>
+    struct FromArrayImpl<NPY_DATETIME, false>
+    {
+      static constexpr size_t strings = 0;
+
+      // The datetime64 value is a count of ticks, each of which is 
+      // _multiplier units. There are _unitsPerDay units in a day.
+      npy_int64 _multiplier;
+      npy_int64 _unitsPerDay;
+
+      FromArrayImpl(PyArrayObject* pArr)
+      {
+        if (PyArray_TYPE(pArr) != NPY_DATETIME)
+          XLO_THROW("Incorrect array type: expected datetime64");
+
+        const auto& meta = ((PyArray_DatetimeDTypeMetaData*)
+          PyDataType_C_METADATA(PyArray_DESCR(pArr)))->meta;
+        _multiplier = meta.num;
+        switch (meta.base)
+        {
+        case NPY_FR_W:  _unitsPerDay = 1; _multiplier *= 7; break;
+        case NPY_FR_D:  _unitsPerDay = 1; break;
+        case NPY_FR_h:  _unitsPerDay = 24; break;
+        case NPY_FR_m:  _unitsPerDay = 24 * 60; break;
+        case NPY_FR_s:  _unitsPerDay = 24 * 60 * 60; break;
+        case NPY_FR_ms: _unitsPerDay = 24 * 60 * 60 * 1000ll; break;
+        case NPY_FR_us: _unitsPerDay = MICROSECS_PER_DAY; break;
+        case NPY_FR_ns: _unitsPerDay = MICROSECS_PER_DAY * 1000; break;
+        default:
+          XLO_THROW("Unsupported datetime64 unit: expected weeks to nanoseconds");
+        }
+      }
+
+      ExcelObj toExcelObj(
+        ExcelArrayBuilder&,
+        void* arrayPtr) const
+      {
+        const auto ticks = *(npy_datetime*)arrayPtr;
+        if (ticks == NPY_DATETIME_NAT)
+          return ExcelObj(CellError::NA);
+
+        // Floor division, as dates before the epoch are negative
+        const auto units = ticks * _multiplier;
+        auto days = units / _unitsPerDay;
+        auto remainder = units % _unitsPerDay;
+        if (remainder < 0)
+        {
+          --days;
+          remainder += _unitsPerDay;
+        }
+        if (days < excelSerialDateToUnixDays(0) 
+          || days > excelSerialDateToUnixDays(XL_MAX_SERIAL_DATE))
+          return ExcelObj(CellError::Num);
+
+        const auto serial = excelSerialDateFromUnixDays((int)days);
+        return remainder == 0
+          ? ExcelObj(serial)
+          : ExcelObj(serial + (double)remainder / _unitsPerDay);
+      }
+    };
+
     namespace
     {
       std::tuple<PyArrayObject*, npy_intp*, int, bool> 
@@ -547,7 +776,7 @@ namespace xloil
         
         TImpl converter(pyArr);
 
-        ExcelArrayBuilder builder((uint32_t)dims[0], 1, converter.stringLength);
+        ExcelArrayBuilder builder((uint32_t)dims[0], 1, converter.strings);
         for (auto j = 0; j < dims[0]; ++j)
           builder(j, 0).emplace(converter.toExcelObj(builder, PyArray_GETPTR1(pyArr, j)));
         
@@ -579,7 +808,7 @@ namespace xloil
         TImpl converter(pyArr);
 
         ExcelArrayBuilder builder((uint32_t)dims[0], (uint32_t)dims[1],
-          converter.stringLength);
+          converter.strings);
         for (auto i = 0; i < dims[0]; ++i)
           for (auto j = 0; j < dims[1]; ++j)
             builder(i, j).emplace(converter.toExcelObj(builder, PyArray_GETPTR2(pyArr, i, j)));
@@ -72,7 +72,7 @@ namespace xloil
       {
         std::tm tm;
         if (stringToDateTime(pstr.view(), tm))
-          return PyDate_FromDate(tm.tm_year, tm.tm_mon, tm.tm_yday);
+          return PyDate_FromDate(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
         return nullptr;
       }
       constexpr wchar_t* failMessage() const { return L"Expected date"; }
@@ -5,11 +5,23 @@ import builtins
 import sys
 import os
 import inspect
+import hashlib
+import json
+import threading
+import time
+import types
 
-from .register import scan_module, _clear_pending_registrations
+from .register import scan_module, _clear_pending_registrations, _REGISTERED_TAG
 from ._core import StatusBar
 from .logging import log, log_except
 
+from xloil_core import (
+    _Read_object,
+    _FuncSpec,
+    _FuncArg,
+    _register_functions
+)
+
 _module_addin_map = dict() # Stores which addin loads a particular source file
 _linked_workbooks = dict() # Stores the workbooks associated with an source file 
 
@@ -79,19 +91,260 @@ def get_event_loop():
     return xloil_core._get_event_loop(addin)
 
 
-def _import_and_scan(what, addin):
+_MANIFEST_VERSION = 1
+
+def _manifest_path(source_path):
+    """
+    The manifest for a source file is kept in its __pycache__ directory, next
+    to python's bytecode cache
+    """
+    directory, filename = os.path.split(source_path)
+    return os.path.join(directory, "__pycache__", 
+                        os.path.splitext(filename)[0] + ".xloil-manifest.json")
+
+
+def _source_hash(path):
+    with open(path, "rb") as file:
+        return hashlib.sha256(file.read()).hexdigest()
+
+
+def _spec_to_dict(spec):
+    return {
+        "name": spec.name,
+        "help": spec.help,
+        "category": spec.category,
+        "features": spec.features,
+        "volatile": spec.volatile,
+        "local": spec.local,
+        "has_kwargs": spec.has_kwargs,
+        "args": [{ 
+            "name": arg.name, 
+            "help": arg.help, 
+            "special_type": arg.special_type, 
+            "has_default": arg.has_default 
+        } for arg in spec.args]
+    }
+
+
+def _spec_from_dict(info, func):
+    args = []
+    for arg_info in info["args"]:
+        arg = _FuncArg()
+        arg.name = arg_info["name"]
+        arg.help = arg_info["help"]
+        arg.special_type = arg_info["special_type"]
+        # Calls are forwarded with the Excel values to the real function, so 
+        # this converter is never used, but registration requires one
+        arg.converter = _Read_object()
+        if arg_info["has_default"]:
+            arg.default = None
+        args.append(arg)
+
+    spec = _FuncSpec(
+        func = func,
+        args = args,
+        name = info["name"],
+        features = info["features"],
+        help = info["help"],
+        category = info["category"],
+        local = info["local"],
+        volatile = info["volatile"],
+        has_kwargs = info["has_kwargs"])
+    spec.lazy = True
+    return spec
+
+
+def _write_manifest(module, specs):
+    """
+    Records the function specs registered for a module so that a later session
+    can register them without importing the module.  Async functions cannot be
+    registered lazily, so modules which contain them do not get a manifest.
+
+    Internal use only.
+    """
+    path = getattr(module, "__file__", None)
+    if path is None or not path.endswith(".py") or not os.path.exists(path):
+        return
+
+    manifest_path = _manifest_path(path)
+    try:
+        if any("async" in spec.features or "rtd" in spec.features for spec in specs):
+            if os.path.exists(manifest_path):
+                os.remove(manifest_path)
+            return
+
+        manifest = {
+            "version": _MANIFEST_VERSION,
+            "mtime": os.stat(path).st_mtime_ns,
+            "hash": _source_hash(path),
+            "funcs": [_spec_to_dict(spec) for spec in specs]
+        }
+        os.makedirs(os.path.dirname(manifest_path), exist_ok=True)
+        temp_path = manifest_path + ".tmp"
+        with open(temp_path, "w", encoding="utf-8") as file:
+            json.dump(manifest, file)
+        os.replace(temp_path, manifest_path)
+
+    except Exception as e:
+        log.debug(f"Could not write function manifest for {path}: {e}")
+
+
+def _read_manifest(path):
+    """
+    Returns the list of function descriptions in the manifest for a source file, 
+    or None if there is no manifest or the source has changed since it was written.
+    """
+    try:
+        with open(_manifest_path(path), "r", encoding="utf-8") as file:
+            manifest = json.load(file)
+        if manifest.get("version") != _MANIFEST_VERSION:
+            return None
+        # Only hash the source if the mtime differs, e.g. after a file copy
+        if manifest["mtime"] != os.stat(path).st_mtime_ns \
+                and manifest["hash"] != _source_hash(path):
+            return None
+        return manifest["funcs"]
+    except (OSError, ValueError, KeyError):
+        return None
+
+
+class _LazyModule:
+    """
+    A module whose functions have been registered from its manifest. The module
+    is imported by the first call to any of its functions, or in the background.
+    """
+    def __init__(self, path, importer):
+        self.path = path
+        self._importer = importer
+        self._lock = threading.Lock()
+        self._funcs = None
+
+    def load(self):
+        """
+        Imports the module if required, returning a dict of its registered specs
+        """
+        with self._lock:
+            if self._funcs is None:
+                module = self._importer()
+                self._funcs = getattr(module, _REGISTERED_TAG, dict())
+        return self._funcs
+
+    def resolve(self, name):
+        """
+        Called by xlOil on the first call to a lazy function: returns the real
+        function spec, importing the module if required.
+
+        Unless the background import has already run, the import happens on the
+        thread calculating the function, which for threadsafe functions may be 
+        one of Excel's calculation threads, and that calculation waits for it.
+        Module-level code in lazily imported modules should therefore not call
+        Excel, for example via COM, as it may not run on the main thread.
+        """
+        spec = self.load().get(name, None)
+        if spec is None:
+            raise Exception(f"Function '{name}' is no longer declared in {self.path}")
+        return spec
+
+
+def _register_lazy(path, module_name, addin, importer, background):
+    """
+    Registers the functions in the manifest for the given source file, if it
+    exists and is up-to-date, without importing the module. Returns True on 
+    success.
+    """
+    start_time = time.perf_counter()
+
+    funcs = _read_manifest(path)
+    if funcs is None:
+        return False
+
+    lazy_module = _LazyModule(path, importer)
+
+    # Registration associates functions with the module's file, so we pass 
+    # a placeholder until the real module is imported
+    placeholder = types.ModuleType(module_name)
+    placeholder.__file__ = path
+    placeholder._xloil_lazy = lazy_module
+
+    try:
+        specs = [_spec_from_dict(info, lazy_module.resolve) for info in funcs]
+        _register_functions(specs, placeholder, addin, append=False)
+    except Exception:
+        log_except(f"Failed registering functions from manifest for {path}")
+        return False
+
+    log.info(f"Registered {len(specs)} funcs for {path} from manifest "
+             f"in {time.perf_counter() - start_time:.3f}s")
+
+    if background:
+        def load():
+            try:
+                lazy_module.load()
+            except Exception:
+                log_except(f"Error importing {path}")
+        # Queue after the current batch of registrations on the addin's loop
+        try:
+            import asyncio
+            asyncio.get_running_loop().call_soon(load)
+        except RuntimeError:
+            load()
+
+    return True
+
+
+def _module_source(name):
+    """
+    Returns the path of the source file for a module name without importing the
+    module, or None if it is not a plain py file.
+    """
+    try:
+        spec = importlib.util.find_spec(name)
+    except (ImportError, ValueError):
+        return None
+    origin = getattr(spec, "origin", None)
+    return origin if origin is not None and origin.endswith(".py") else None
+
+
+def _import_module(name, addin):
+    start_time = time.perf_counter()
+
+    module = importlib.import_module(name)
+    # Remember which addin loaded this module
+    _module_addin_map[module.__file__] = addin ## TODO: hasattr
+    scan_module(module, addin)
+
+    log.info(f"Imported {name} with {len(getattr(module, _REGISTERED_TAG, ()))} funcs "
+             f"in {time.perf_counter() - start_time:.2f}s")
+    return module
+
+
+def _import_and_scan(what, addin, lazy=False, background=False):
     """
     Loads or reloads the specifed module, which can be a string name
     or module object, then calls scan_module.
 
+    If `lazy` is True and a module has an up-to-date function manifest, its
+    functions are registered from the manifest and the import is deferred to
+    the first function call, or runs in the background if `background` is True.
+
     Internal use only.
     """
     
     if isinstance(what, str):
-        module = importlib.import_module(what)
-        # Remember which addin loaded this module
-        _module_addin_map[module.__file__] = addin ## TODO: hasattr
+        if lazy and what not in sys.modules:
+            path = _module_source(what)
+            if path is not None and _register_lazy(
+                    path, what, addin, lambda: _import_module(what, addin), background):
+                return None
+        return _import_module(what, addin)
+
     elif inspect.ismodule(what):
+        # A placeholder registered from a manifest is reloaded by importing the 
+        # real module for the first time
+        lazy_module = getattr(what, "_xloil_lazy", None)
+        if lazy_module is not None:
+            lazy_module.load()
+            return None
         module = importlib.reload(what)
     else:
         # We don't care about the return value currently
@@ -99,52 +352,84 @@ def _import_and_scan(what, addin):
         with StatusBar(2000) as status:
             for m in what:
                 status.msg(f"Loading {m}")
-                result.append(_import_and_scan(m, addin))
+                result.append(_import_and_scan(m, addin, lazy, background))
             status.msg("xlOil load complete")
         return result
     
     scan_module(module, addin)
     return module
 
-def _import_file_and_scan(path, addin, workbook_name=None):
+
+def _import_file(path, addin, workbook_name):
+    """
+    Imports the specifed py file as a module without adding its path to sys.modules
+    then registers its functions.
+    """
+    start_time = time.perf_counter()
+
+    module_name = _file_module_name(path, workbook_name)
+
+    # Force a reload if an attempt is made to load a module again.
+    # This can happen if a workbook is closed and reopened - it is
+    # difficult to get python to delete the module. Without a reload
+    # the 'pending funcs' won't be populated for the registration 
+    # machinery.
+    try:
+        module = importlib.reload(sys.modules[module_name])
+    except KeyError:
+        module = importlib.import_module(module_name)
+
+    # Calling import_module will bypass our import hook, so scan_module explicitly
+    scan_module(module, addin)
+
+    log.info(f"Imported {path} with {len(getattr(module, _REGISTERED_TAG, ()))} funcs "
+             f"in {time.perf_counter() - start_time:.2f}s")
+    return module
+
+
+def _file_module_name(path, workbook_name):
+    """
+    Returns the module name used to import a py file and records the information
+    required to import it.
+    """
+    directory, filename = os.path.split(path)
+    filename = os.path.splitext(filename)[0]
+            
+    # avoid name collisions when loading workbook modules
+    module_name = filename
+    if workbook_name is not None:
+        module_name = "xloil_wb_" + filename
+        _linked_workbooks[path] = workbook_name
+
+    if len(directory) > 0 or workbook_name is not None:
+        _module_finder.add_path(module_name, path)
+
+    _module_addin_map[path] = addin
+    return module_name
+
+
+def _import_file_and_scan(path, addin, workbook_name=None, lazy=False, background=False):
 
     """
     Imports the specifed py file as a module without adding its path to sys.modules.
 
-    Optionally also adds xlOil linked workbook information.
+    Optionally also adds xlOil linked workbook information. The `lazy` and 
+    `background` arguments are as for `_import_and_scan`.
     """
 
+    module_name = _file_module_name(path, workbook_name)
+
+    if lazy and module_name not in sys.modules and _register_lazy(
+            path, module_name, addin, lambda: _import_file(path, addin, workbook_name), background):
+        return None
+
     with StatusBar(3000) as status:
         try:
             status.msg(f"Loading {path}...")
-            directory, filename = os.path.split(path)
-            filename = os.path.splitext(filename)[0]
-            
-            # avoid name collisions when loading workbook modules
-            module_name = filename
-            if workbook_name is not None:
-                module_name = "xloil_wb_" + filename
-                _linked_workbooks[path] = workbook_name
-
-            if len(directory) > 0 or workbook_name is not None:
-                _module_finder.add_path(module_name, path)
-
-            _module_addin_map[path] = addin
-
-            # Force a reload if an attempt is made to load a module again.
-            # This can happen if a workbook is closed and reopened - it is
-            # difficult to get python to delete the module. Without a reload
-            # the 'pending funcs' won't be populated for the registration 
-            # machinery.
-            try:
-                module = importlib.reload(sys.modules[module_name])
-            except KeyError:
-                module = importlib.import_module(module_name)
 
-            # Calling import_module will bypass our import hook, so scan_module explicitly
-            n_funcs = scan_module(module, addin)
+            module = _import_file(path, addin, workbook_name)
 
-            status.msg(f"Registered {n_funcs} funcs for {path}")
+            status.msg(f"Registered {len(getattr(module, _REGISTERED_TAG, ()))} funcs for {path}")
 
             return module
 
@@ -13,6 +13,9 @@ from . import func_inspect
 from .jupyter_kernel import _xlOilJupyterImpl
 _unpickle = _xlOilJupyterImpl._unpickle
 _pickle = _xlOilJupyterImpl._pickle
+_pack = _xlOilJupyterImpl._pack
+_unpack = _xlOilJupyterImpl._unpack
+_release = _xlOilJupyterImpl._release
 _FuncDescription = _xlOilJupyterImpl._FuncDescription
 
 def _remove_ansi_escapes(s):
@@ -82,7 +85,10 @@ class _VariableWatcher(xlo.RtdPublisher):
         # a module level global. But NO: the deletion order during teardown means
         # it's not available when the RTD server wants to tidy up
         #
-        self._connection.execute(f"_xloil_jpy_impl._vars.watch('{self._name}')", silent=True)
+        # Pass the version we hold so the kernel does not resend an unchanged value
+        known_version = self._connection.variable_version(self._name)
+        self._connection.execute(
+            f"_xloil_jpy_impl._vars.watch('{self._name}', {known_version})", silent=True)
 
     def disconnect(self, num_subscribers):
         if num_subscribers == 0:
@@ -137,6 +143,7 @@ class _JupyterConnection:
         self._loop = xlo.get_async_loop()
         self._client = AsyncKernelClient()
         self._connection_file = connection_file
+        self._variable_versions = dict() # Dict[str -> int] latest version received
 
         cf = jupyter_client.find_connection_file(self._connection_file)
         xlo.log(f"Jupyter: found connection for file {self._connection_file}", level='debug')
@@ -205,6 +212,7 @@ class _JupyterConnection:
 
         self._sessionId = msg['header']['session']
         self._watched_variables.clear()
+        self._variable_versions.clear()
         self._ready = True
 
 
@@ -287,13 +295,31 @@ class _JupyterConnection:
 
         # TODO: won't work with cellerror, need to convert that to None or string or?
 
-        args_data = repr(_pickle(args))
-        kwargs_data = repr(_pickle(kwargs))
+        # Large array arguments are written to shared memory which we hold
+        # open until the kernel has replied
+        args_packed = [_pack(x) for x in args]
+        kwargs_packed = { k: _pack(v) for k, v in kwargs.items() }
 
-        return await self.aexecute(
-            f"_xloil_jpy_impl._function_invoke("
-            f"{func_name}, {args_data}, {kwargs_data})"
-            )
+        try:
+            return await self.aexecute(
+                f"_xloil_jpy_impl._function_invoke("
+                f"{func_name}, {repr(json.dumps(args_packed))}, {repr(json.dumps(kwargs_packed))})"
+                )
+        finally:
+            for packed in args_packed + list(kwargs_packed.values()):
+                if "shm" in packed:
+                    _release(packed["shm"])
+
+    def _read_packed(self, packed):
+        """
+        Unpacks a value sent by the kernel, telling the kernel to release any 
+        shared memory segment once we have copied the data out
+        """
+        try:
+            return _unpack(packed)
+        finally:
+            if "shm" in packed:
+                self.execute(f"_xloil_jpy_impl._release('{packed['shm']}')", silent=True)
 
     def _watch_prefix(self, name):
         # Just come up with some unique ID for the RTD topic...
@@ -324,8 +350,21 @@ class _JupyterConnection:
         except KeyError:
             pass
 
+    def variable_version(self, name):
+        return self._variable_versions.get(name, 0)
+
     def publish_variables(self, updates:dict):
-        for name, value in updates.items():
+        for name, update in updates.items():
+            # Skip stale or repeated updates, e.g. if a watch was re-sent
+            version = update["version"]
+            if version <= self._variable_versions.get(name, 0):
+                continue
+            try:
+                value = self._read_packed(update["value"])
+            except FileNotFoundError:
+                # The kernel has replaced the segment, so a newer version is on its way
+                continue
+            self._variable_versions[name] = version
             _rtd_server().publish(self._watch_prefix(name), value)
 
     async def process_messages(self):
@@ -395,7 +434,7 @@ class _JupyterConnection:
         payload = None
 
         if meta_type == "VariableChange":
-            payload = _unpickle(xloil_data)
+            payload = json.loads(xloil_data)
             self.publish_variables(payload)
 
         elif meta_type == "FuncRegister":
@@ -411,7 +450,7 @@ class _JupyterConnection:
 
         elif meta_type == "FuncResult":
             if pending:
-                return _unpickle(xloil_data)
+                return self._read_packed(json.loads(xloil_data))
             else:
                 xlo.log(f"Unexpected function result: {msg}")
         else:
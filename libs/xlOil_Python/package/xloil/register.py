@@ -24,6 +24,12 @@ _LANDMARK_TAG = "_xloil_pending_funcs_"
     of functions
 """
 
+_REGISTERED_TAG = "_xloil_registered_funcs_"
+"""
+    Tag added to a module's __dict__ by scan_module which contains a dict of 
+    the registered function specs by name
+"""
+
 def _add_pending_funcs(module, objects):
     pending = getattr(module, _LANDMARK_TAG, set())
     pending.update(objects)
@@ -196,6 +202,66 @@ class Caller:
         return override or xloil_core.Caller(*args, **kwargs)
     
 
+class _PendingTask:
+    """
+    Stands in for the asyncio task of an async function call until the call's 
+    batch is started on the event loop. Cancellation is always invoked on the 
+    loop's thread, so needs no locking.
+    """
+    __slots__ = ("coro", "task", "cancelled")
+
+    def __init__(self, coro):
+        self.coro = coro
+        self.task = None
+        self.cancelled = False
+
+    def cancel(self):
+        if self.task is not None:
+            self.task.cancel()
+        else:
+            self.cancelled = True
+
+
+class _AsyncBatch:
+    """
+    Collects async function calls made during a calculation and starts them on
+    the event loop in a single hop, rather than one run_coroutine_threadsafe 
+    (and concurrent.futures.Future) per call.
+    """
+    def __init__(self, loop):
+        self._loop = loop
+        self._pending = []
+        self._lock = threading.Lock()
+
+    def submit(self, coro):
+        pending = _PendingTask(coro)
+        with self._lock:
+            self._pending.append(pending)
+            first = len(self._pending) == 1
+        # Only the first call in a batch needs to wake the loop
+        if first:
+            self._loop.call_soon_threadsafe(self._start)
+        return pending
+
+    def _start(self):
+        with self._lock:
+            pending, self._pending = self._pending, []
+        for call in pending:
+            if call.cancelled:
+                call.coro.close()
+            else:
+                call.task = self._loop.create_task(call.coro)
+
+
+_async_batches = dict()
+
+def _async_batch(loop):
+    batch = _async_batches.get(loop, None)
+    if batch is None:
+        batch = _async_batches.setdefault(loop, _AsyncBatch(loop))
+    return batch
+
+
 def async_wrapper(fn):
     """
     Wraps an async function or generator with a function which runs that generator on the thread's
@@ -210,30 +276,30 @@ def async_wrapper(fn):
     import asyncio
     import traceback
 
-    @functools.wraps(fn)
-    def synchronised(xloil_thread_context, *args, **kwargs):
+    # Determined once here rather than on every call
+    is_generator = inspect.isasyncgenfunction(fn)
 
-        ctx = xloil_thread_context
-
-        async def run_async():
-            _async_caller.set(ctx.caller)
-            try:
-                # TODO: is inspect.isasyncgenfunction expensive?
-                if inspect.isasyncgenfunction(fn):
-                    async for result in fn(*args, **kwargs):
-                        ctx.set_result(result)
-                else:
-                    result = await fn(*args, **kwargs)
+    async def run_async(ctx, args, kwargs):
+        _async_caller.set(ctx.caller)
+        try:
+            if is_generator:
+                async for result in fn(*args, **kwargs):
                     ctx.set_result(result)
-            except (asyncio.CancelledError, StopAsyncIteration):
-                ctx.set_done()
-                raise
-            except Exception as e:
-                ctx.set_result(str(e) + ": " + traceback.format_exc())
-                
+            else:
+                result = await fn(*args, **kwargs)
+                ctx.set_result(result)
+        except (asyncio.CancelledError, StopAsyncIteration):
             ctx.set_done()
+            raise
+        except Exception as e:
+            ctx.set_result(str(e) + ": " + traceback.format_exc())
             
-        ctx.set_task(asyncio.run_coroutine_threadsafe(run_async(), ctx.loop))
+        ctx.set_done()
+
+    @functools.wraps(fn)
+    def synchronised(xloil_thread_context, *args, **kwargs):
+        ctx = xloil_thread_context
+        ctx.set_task(_async_batch(ctx.loop).submit(run_async(ctx, args, kwargs)))
 
     return synchronised
 
@@ -441,6 +507,10 @@ def _clear_pending_registrations(module):
 import threading
 _scan_module_mutex = threading.Lock()
 
+# Set by the worker process bootstrap in xloil.worker. Workers serve calls
+# from Excel's process rather than registering functions themselves.
+_in_worker_process = False
+
 def scan_module(module, addin=None):
     """
         Parses a specified module to look for functions with with the xloil.func 
@@ -451,6 +521,11 @@ def scan_module(module, addin=None):
     # Enabling this generates a large amount of unhelpful output
     # log.trace(f"Scanning module {module}")
 
+    # In a worker process, declarations are left pending so the worker can 
+    # find the function specs
+    if _in_worker_process:
+        return 0
+
     # We quickly discard modules which do not contain xloil declarations 
     pending_funcs = getattr(module, _LANDMARK_TAG, None) 
     if pending_funcs is None or not any(pending_funcs):
@@ -472,6 +547,12 @@ def scan_module(module, addin=None):
 
         _register_functions(func_list, module, addin, append=False)
 
+        # Used to resolve lazily registered functions
+        setattr(module, _REGISTERED_TAG, {spec.name: spec for spec in func_list})
+
+        from .importer import _write_manifest
+        _write_manifest(module, func_list)
+
         return len(func_list)
 
 
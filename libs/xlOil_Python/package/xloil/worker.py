@@ -0,0 +1,119 @@
+"""
+Worker processes which run threaded worksheet functions outside Excel so that
+calls are not serialised by the GIL. xlOil starts the workers if `WorkerProcesses`
+is set in the ini file. Each worker imports the modules which declare threaded
+functions and serves calls sent through shared memory by the Excel process.
+"""
+
+import importlib
+import importlib.util
+import os
+import sys
+
+_processes = []
+
+def _python_executable():
+    # Prefer pythonw to avoid each worker creating a console window
+    candidates = [
+        os.path.join(os.path.dirname(sys.executable), "pythonw.exe"),
+        os.path.join(sys.exec_prefix, "pythonw.exe"),
+        os.path.join(sys.exec_prefix, "Scripts", "pythonw.exe"),
+        os.path.join(sys.exec_prefix, "python.exe"),
+    ]
+    for path in candidates:
+        if os.path.exists(path):
+            return path
+    return sys.executable
+
+
+def _spawn_workers(channels, parent_pid):
+    """
+    Starts a worker process for each shared memory channel, returning their
+    process ids. Called by xlOil in the Excel process.
+    """
+    import subprocess
+
+    # Workers should find modules the same way as Excel's interpreter
+    env = dict(os.environ)
+    env["PYTHONPATH"] = os.pathsep.join(path for path in sys.path if path)
+
+    executable = _python_executable()
+    for channel in channels:
+        _processes.append(subprocess.Popen(
+            [executable, "-m", "xloil.worker", channel, str(parent_pid)],
+            env=env,
+            creationflags=getattr(subprocess, "CREATE_NO_WINDOW", 0)))
+
+    return [process.pid for process in _processes]
+
+
+_modules = dict()   # Source path -> module
+_specs = dict()     # Source path -> dict of function name -> _FuncSpec
+
+def _module_name(path):
+    """
+    Returns the dotted module name for a source path if it can be imported
+    from sys.path, otherwise None
+    """
+    path = os.path.normcase(os.path.abspath(path))
+    for root in sys.path:
+        root = os.path.normcase(os.path.abspath(root or os.getcwd()))
+        if not path.startswith(root + os.sep):
+            continue
+        parts = os.path.splitext(path[len(root) + 1:])[0].split(os.sep)
+        if parts[-1] == "__init__":
+            parts = parts[:-1]
+        if any(parts) and all(part.isidentifier() for part in parts):
+            return ".".join(parts)
+    return None
+
+
+def _load(path):
+    """
+    Imports or reloads the module at the given path. Called by the worker loop.
+    """
+    from .register import _LANDMARK_TAG, _clear_pending_registrations
+
+    module = _modules.get(path, None)
+    if module is not None:
+        _clear_pending_registrations(module)
+        module = importlib.reload(module)
+    else:
+        name = _module_name(path)
+        if name is not None:
+            module = importlib.import_module(name)
+        else:
+            # Workbook modules and others not on sys.path
+            name = "xloil_worker_" + os.path.splitext(os.path.basename(path))[0]
+            spec = importlib.util.spec_from_file_location(name, path)
+            module = importlib.util.module_from_spec(spec)
+            sys.modules[name] = module
+            spec.loader.exec_module(module)
+
+    # In a worker, scan_module does not register functions so the specs
+    # created by the xloil.func decorator remain in the pending list
+    _modules[path] = module
+    _specs[path] = { spec.name: spec for spec in getattr(module, _LANDMARK_TAG, ()) }
+
+
+def _resolve(path, name):
+    """
+    Returns the _FuncSpec for a function. Called by the worker loop.
+    """
+    if path not in _specs:
+        _load(path)
+    spec = _specs[path].get(name, None)
+    if spec is None:
+        raise KeyError(f"Function '{name}' not found in '{path}' by worker process")
+    return spec
+
+
+def _main(channel, parent_pid):
+    from xloil_core import _worker_serve
+    from . import register
+    register._in_worker_process = True
+    _worker_serve(channel, parent_pid, _load, _resolve)
+
+
+if __name__ == "__main__":
+    _main(sys.argv[1], int(sys.argv[2]))
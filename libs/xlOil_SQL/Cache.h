@@ -14,6 +14,15 @@ namespace xloil
       {
         return std::shared_ptr<sqlite3>();
       }
+
+      /// <summary>
+      /// Returns a connection for read-only queries from the calling thread.
+      /// By default this is the same connection as <see cref="getDB"/>.
+      /// </summary>
+      virtual std::shared_ptr<sqlite3> getReader() const
+      {
+        return getDB();
+      }
     };
 
     ExcelObj 
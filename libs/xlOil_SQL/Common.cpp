@@ -2,6 +2,10 @@
 #include <xloil/Interface.h>
 #include "XlArrayTable.h"
 #include <xlOil/ExcelArray.h>
+#include <xlOil/ExcelRef.h>
+#include <xlOil/StringUtils.h>
+#include <xloil/ArrayBuilder.h>
+#include <unordered_set>
 
 using std::shared_ptr;
 using std::string;
@@ -23,7 +27,9 @@ namespace xloil
     {
       sqlite3 *db;
       if (sqlite3_open(":memory:", &db) == SQLITE_OK
-        && sqlite3_create_module(db, "xlarray", &XlArrayModule, 0) == SQLITE_OK)
+        && sqlite3_create_module(db, "xlarray", &XlArrayModule, 0) == SQLITE_OK
+        && sqlite3_create_module(db, "xlrange", &XlRangeModule, 0) == SQLITE_OK
+        && sqlite3_create_module(db, "xlboundarray", &XlBoundArrayModule, 0) == SQLITE_OK)
         return shared_ptr<sqlite3>(db, sqlite3_close);
 
       string msg(sqlite3_errmsg(db));
@@ -31,11 +37,47 @@ namespace xloil
       XLO_THROW(msg);
     }
 
+    shared_ptr<sqlite3> openDatabase(const wstring& path, bool readOnly)
+    {
+      // Readers are only used by one thread at a time so do not need
+      // sqlite's connection mutex. The writer keeps it for ScopedLock.
+      const auto flags = readOnly
+        ? SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX
+        : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX;
+
+      sqlite3 *db = nullptr;
+      auto rc = sqlite3_open_v2(utf16ToUtf8(path).c_str(), &db, flags, nullptr);
+      if (rc == SQLITE_OK)
+      {
+        // Wait rather than fail if another connection holds the write lock
+        // or is checkpointing
+        sqlite3_busy_timeout(db, 5000);
+        if (!readOnly)
+        {
+          rc = sqlite3_exec(db, 
+            "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;", nullptr, nullptr, nullptr);
+          if (rc == SQLITE_OK)
+            rc = sqlite3_create_module(db, "xlarray", &XlArrayModule, 0);
+          if (rc == SQLITE_OK)
+            rc = sqlite3_create_module(db, "xlrange", &XlRangeModule, 0);
+        }
+      }
+      if (rc == SQLITE_OK)
+        return shared_ptr<sqlite3>(db, sqlite3_close);
+
+      string msg(db ? sqlite3_errmsg(db) : sqlite3_errstr(rc));
+      sqlite3_close(db);
+      XLO_THROW(msg);
+    }
+
     wstring tableSchema(
       const ExcelArray& arr,
       const vector<wstring>* headings)
     {
       auto nCols = arr.nCols();
+      const auto firstRow = headings ? 0 : 1;
+      if ((int)arr.nRows() < firstRow)
+        XLO_THROW("Data must contain a row of headings");
       wstring sql;
       sql.reserve(20 + nCols * 14);
       sql += L"CREATE TABLE x(";
@@ -47,7 +89,7 @@ namespace xloil
         sql += headings
           ? headings->at(j)
           : arr(0, j).toString();
-        auto col = arr.slice(headings ? 0 : 1, j, -1, j + 1);
+        auto col = arr.slice(firstRow, j, arr.nRows(), j + 1);
         auto colType = col.dataType();
         switch (colType)
         {
@@ -73,6 +115,30 @@ namespace xloil
       return sql;
     }
 
+    namespace
+    {
+      void createVTable(
+        sqlite3* db,
+        const wchar_t* module,
+        const void* input,
+        const wstring& schema,
+        const wchar_t* name)
+      {
+        auto sql = fmt::format(
+          L"CREATE VIRTUAL TABLE {0} USING {1}({2},{3},0)", name, module, (long long)input, schema);
+
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare16_v2(db, sql.c_str(),
+          (int)sql.length() * sizeof(wchar_t), &stmt, 0) == SQLITE_OK)
+        {
+          sqlite3_step(stmt);
+          sqlite3_finalize(stmt);
+        }
+        else
+          XLO_THROW(L"Failed to create virtual table {0}", name);
+      }
+    }
+
     void createVTable(
       sqlite3* db,
       const ExcelArray& arr,
@@ -81,18 +147,44 @@ namespace xloil
     {
       auto schema = tableSchema(arr, headings);
       auto arrayData = arr.slice(headings ? 0 : 1, 0);
-      auto sql = fmt::format(
-        L"CREATE VIRTUAL TABLE {0} USING xlarray({1},{2},0)", name, (long long)&arrayData, schema);
+      createVTable(db, L"xlarray", &arrayData, schema, name);
+    }
 
-      sqlite3_stmt *stmt;
-      if (sqlite3_prepare16_v2(db, sql.c_str(),
-        (int)sql.length() * sizeof(wchar_t), &stmt, 0) == SQLITE_OK)
+    void createVTable(
+      sqlite3* db,
+      const XlArrayBinding& binding,
+      const wstring& schema,
+      const wchar_t* name)
+    {
+      createVTable(db, L"xlboundarray", &binding, schema, name);
+    }
+
+    void createVTable(
+      sqlite3* db,
+      const ExcelRef& range,
+      const wchar_t* name,
+      const vector<wstring>* headings)
+    {
+      // Column types are taken from the first block of rows, which the 
+      // table will also read first, rather than coercing the whole range
+      const auto nHeadRows = std::min<int>(range.nRows(), rangeBlockRows(range.nCols()));
+      const auto head = range.range(0, 0, nHeadRows - 1).value();
+      const ExcelArray headArray(head, false);
+      auto schema = tableSchema(headArray, headings);
+      
+      // A range containing only headings gives an empty table. A range
+      // cannot have zero rows, so use an empty array table, which reads
+      // nothing from the head array.
+      const auto firstRow = headings ? 0 : 1;
+      if (range.nRows() <= firstRow)
       {
-        sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
+        auto arrayData = headArray.slice(firstRow, 0);
+        createVTable(db, L"xlarray", &arrayData, schema, name);
+        return;
       }
-      else
-        XLO_THROW(L"Failed to create virtual table {0}", name);
+
+      auto rangeData = range.range(firstRow, 0);
+      createVTable(db, L"xlrange", &rangeData, schema, name);
     }
 
     shared_ptr<sqlite3_stmt> sqlPrepare(sqlite3* db, const wstring& sql)
@@ -133,6 +225,35 @@ namespace xloil
       return rc;
     }
 
+    namespace
+    {
+      /// <summary>
+      /// Views the pascal string at an offset in a string store
+      /// </summary>
+      std::wstring_view storedString(const vector<wchar_t>& store, size_t offset)
+      {
+        return std::wstring_view(store.data() + offset + 1, store[offset]);
+      }
+
+      struct StoredStringHash
+      {
+        const vector<wchar_t>& store;
+        size_t operator()(size_t offset) const
+        {
+          return std::hash<std::wstring_view>()(storedString(store, offset));
+        }
+      };
+
+      struct StoredStringEqual
+      {
+        const vector<wchar_t>& store;
+        bool operator()(size_t l, size_t r) const
+        {
+          return storedString(store, l) == storedString(store, r);
+        }
+      };
+    }
+
     ExcelObj sqlQueryToArray(const std::shared_ptr<sqlite3_stmt>& prepared)
     {
       // Since we don't know the number of results in advance, our strategy is
@@ -144,6 +265,14 @@ namespace xloil
       vector<ExcelObj> results;
       vector<wchar_t> strings;
 
+      // Query results often repeat strings, for example in categorical columns,
+      // so we store each distinct string once and record the offset in the store
+      // of each string result. The set holds offsets of the distinct strings.
+      vector<size_t> stringOffsets;
+      std::unordered_set<size_t, StoredStringHash, StoredStringEqual> distinct(
+        64, StoredStringHash{ strings }, StoredStringEqual{ strings });
+      ArrayStringCounter counter;
+
       auto rc = sqlite3_step(prepared.get());
       auto nCols = sqlite3_column_count(prepared.get());
       int nRows = 0;
@@ -161,10 +290,30 @@ namespace xloil
             break;
           case SQLITE_TEXT:
           {
-            auto text = (const wchar_t*)sqlite3_column_text16(prepared.get(), j);
-            auto len = std::min<wchar_t>(USHRT_MAX, (unsigned short)wcslen(text));
-            strings.push_back(len);
-            strings.insert(strings.end(), text, text + len);
+            // Transcode sqlite's UTF-8 directly into the string store rather
+            // than have sqlite allocate a UTF-16 copy
+            auto text = (const char*)sqlite3_column_text(prepared.get(), j);
+            auto nBytes = sqlite3_column_bytes(prepared.get(), j);
+            auto len = std::min<size_t>(USHRT_MAX, utf16Length(text, text + nBytes));
+            const auto start = strings.size();
+            strings.resize(start + 1 + len);
+            len = std::min(len, 
+              ConvertUTF8ToUTF16()(strings.data() + start + 1, len, text, text + nBytes));
+            strings[start] = (wchar_t)len;
+            strings.resize(start + 1 + len);
+            if (counter.interning())
+            {
+              auto [found, inserted] = distinct.insert(start);
+              if (!inserted)
+                strings.resize(start);
+              stringOffsets.push_back(*found);
+              // The counter decides when too few strings repeat to be worthwhile
+              counter.add(len, !inserted);
+              if (!counter.interning())
+                distinct.clear();
+            }
+            else
+              stringOffsets.push_back(start);
             // Empty string into results - we will fix it later
             results.emplace_back(ExcelType::Str);
             break;
@@ -196,14 +345,13 @@ namespace xloil
       auto pObj = (ExcelObj*)arrayData;
       auto pEnd = pObj + results.size();
       auto pStr = (wchar_t*)stringData;
+      auto offset = stringOffsets.begin();
       for (; pObj != pEnd; ++pObj)
       {
         if (pObj->xltype == msxll::xltypeStr)
         {
-          assert((char*)pStr < stringData + stringsNBytes);
-          pObj->val.str = pStr;
-          // Skip to the next string by adding the string length
-          pStr += pStr[0] + 1;
+          assert(*offset < strings.size());
+          pObj->val.str = pStr + *offset++;
         }
       }
 
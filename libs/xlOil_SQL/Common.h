@@ -1,7 +1,6 @@
 #pragma once
 #define SQLITE_OMIT_PROGRESS_CALLBACK
 #define SQLITE_OMIT_AUTHORIZATION
-#define SQLITE_OMIT_WAL
 
 #include <xlOil/ExcelObj.h>
 #include <sqlite/sqlite3.h>
@@ -10,18 +9,28 @@
 #include <string>
 #include <vector>
 
-namespace xloil { class ExcelArray; }
+namespace xloil { class ExcelArray; class ExcelRef; }
 
 namespace xloil
 {
   namespace SQL
   {
+    struct XlArrayBinding;
+
     void 
       sqlThrow(sqlite3* db, int errCode);
 
     std::shared_ptr<sqlite3> 
       newDatabase();
 
+    /// <summary>
+    /// Opens or creates a database file. A writeable connection puts the 
+    /// database in WAL mode, so read-only connections to the same file can 
+    /// run queries in parallel with each other and with the writer.
+    /// </summary>
+    std::shared_ptr<sqlite3> 
+      openDatabase(const std::wstring& path, bool readOnly);
+
     void 
       createVTable(
         sqlite3* db, 
@@ -29,6 +38,38 @@ namespace xloil
         const wchar_t* name, 
         const std::vector<std::wstring>* headings = nullptr);
 
+    /// <summary>
+    /// Returns a CREATE TABLE statement for the array. Unless headings are
+    /// given, they are taken from the first row.
+    /// </summary>
+    std::wstring 
+      tableSchema(
+        const ExcelArray& arr, 
+        const std::vector<std::wstring>* headings = nullptr);
+
+    /// <summary>
+    /// Creates a virtual table which reads whichever array the binding 
+    /// points to. The schema should come from <see cref="tableSchema"/>.
+    /// </summary>
+    void 
+      createVTable(
+        sqlite3* db, 
+        const XlArrayBinding& binding, 
+        const std::wstring& schema,
+        const wchar_t* name);
+
+    /// <summary>
+    /// Creates a virtual table which reads directly from a range on a sheet.
+    /// Rows are fetched from Excel in blocks when the table is queried, 
+    /// so the range must not be used after the calling function returns.
+    /// </summary>
+    void 
+      createVTable(
+        sqlite3* db, 
+        const ExcelRef& range, 
+        const wchar_t* name, 
+        const std::vector<std::wstring>* headings = nullptr);
+
     std::shared_ptr<sqlite3_stmt> 
       sqlPrepare(sqlite3* db, const std::wstring& sql);
 
@@ -0,0 +1,167 @@
+#include "QueryPool.h"
+#include "Common.h"
+#include "XlArrayTable.h"
+#include <xloil/Throw.h>
+#include <xlOil/ExcelArray.h>
+#include <algorithm>
+#include <cwctype>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+using std::wstring;
+using std::vector;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace xloil
+{
+  namespace SQL
+  {
+    struct PooledConnection
+    {
+      struct Table
+      {
+        wstring schema;
+        std::optional<ExcelArray> data;
+        XlArrayBinding binding;
+      };
+
+      // Keyed on lowercase name, as SQL table names are case-insensitive.
+      // Declared before the database so the bindings outlive its tables.
+      std::unordered_map<wstring, Table> tables;
+      shared_ptr<sqlite3> db;
+      // Declared after the database so statements are finalised first
+      std::unordered_map<wstring, shared_ptr<sqlite3_stmt>> statements;
+      bool inUse = false;
+
+      PooledConnection() : db(newDatabase()) {}
+
+      void reset()
+      {
+        statements.clear();
+        db = newDatabase();
+        tables.clear();
+      }
+    };
+
+    namespace
+    {
+      // Limits on what each thread's database keeps. If exceeded, the 
+      // database or statement cache starts again from empty.
+      constexpr size_t MAX_TABLES = 64;
+      constexpr size_t MAX_STATEMENTS = 32;
+
+      std::mutex thePoolLock;
+      std::unordered_map<std::thread::id, unique_ptr<PooledConnection>> thePool;
+    }
+
+    PooledQuery::PooledQuery()
+      : _conn(nullptr)
+      , _pooled(false)
+    {
+      {
+        std::scoped_lock lock(thePoolLock);
+        auto& conn = thePool[std::this_thread::get_id()];
+        if (!conn)
+          conn.reset(new PooledConnection());
+        if (!conn->inUse)
+        {
+          conn->inUse = true;
+          _conn = conn.get();
+          _pooled = true;
+        }
+      }
+      if (!_pooled)
+        _conn = new PooledConnection();
+      else if (_conn->tables.size() > MAX_TABLES)
+        _conn->reset();
+    }
+
+    PooledQuery::~PooledQuery()
+    {
+      // Unbind the arrays as they may not outlive this object
+      for (auto& [name, table] : _conn->tables)
+      {
+        table.binding.data = nullptr;
+        table.data.reset();
+      }
+      if (_pooled)
+      {
+        std::scoped_lock lock(thePoolLock);
+        _conn->inUse = false;
+      }
+      else
+        delete _conn;
+    }
+
+    void PooledQuery::addTable(
+      const ExcelArray& arr,
+      const wchar_t* name,
+      const vector<wstring>* headings)
+    {
+      auto schema = tableSchema(arr, headings);
+
+      wstring key(name);
+      std::transform(key.begin(), key.end(), key.begin(),
+        [](wchar_t c) { return (wchar_t)std::towlower(c); });
+      auto& table = _conn->tables[key];
+
+      if (table.schema != schema)
+      {
+        auto* db = _conn->db.get();
+        // Attempt to drop the old table, but ignore return code as
+        // it may not exist
+        sqlExec(db, fmt::format(L"DROP TABLE {0}", name));
+        table.schema.clear();
+        createVTable(db, table.binding, schema, name);
+        table.schema = std::move(schema);
+      }
+
+      table.data.emplace(arr.slice(headings ? 0 : 1, 0));
+      table.binding.data = &*table.data;
+    }
+
+    ExcelObj PooledQuery::run(const wstring& sql)
+    {
+      // Drop tables kept from earlier calls which were not added by this
+      // one, so a query which names them fails rather than seeing an
+      // empty table
+      auto& tables = _conn->tables;
+      for (auto i = tables.begin(); i != tables.end();)
+      {
+        if (i->second.binding.data)
+          ++i;
+        else
+        {
+          sqlExec(_conn->db.get(), fmt::format(L"DROP TABLE {0}", i->first));
+          i = tables.erase(i);
+        }
+      }
+
+      auto& statements = _conn->statements;
+      shared_ptr<sqlite3_stmt> stmt;
+      auto found = statements.find(sql);
+      if (found != statements.end())
+        stmt = found->second;
+      else
+      {
+        stmt = sqlPrepare(_conn->db.get(), sql);
+        if (statements.size() >= MAX_STATEMENTS)
+          statements.clear();
+        statements.emplace(sql, stmt);
+      }
+
+      // The statement is reset for reuse even if reading results throws
+      struct Reset
+      {
+        sqlite3_stmt* stmt;
+        ~Reset() { sqlite3_reset(stmt); }
+      } reset{ stmt.get() };
+
+      return sqlQueryToArray(stmt);
+    }
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <xlOil/ExcelObj.h>
+#include <string>
+#include <vector>
+
+namespace xloil { class ExcelArray; }
+
+namespace xloil
+{
+  namespace SQL
+  {
+    struct PooledConnection;
+
+    /// <summary>
+    /// Runs a one-off query on array tables using an in-memory database
+    /// kept between calls, rather than creating a new database each time.
+    /// Each thread has its own database. Tables are virtual tables which are
+    /// pointed at the new arrays on each call: a table is only recreated if
+    /// its schema, i.e. headings and column types, has changed, and tables
+    /// not added for the current query are dropped. Prepared statements are
+    /// also kept, so repeating a query skips parsing it.
+    /// </summary>
+    class PooledQuery
+    {
+    public:
+      /// <summary>
+      /// Takes the calling thread's database, or a new one if it is in use
+      /// </summary>
+      PooledQuery();
+
+      /// <summary>
+      /// Unbinds the arrays and returns the database to the pool
+      /// </summary>
+      ~PooledQuery();
+
+      PooledQuery(const PooledQuery&) = delete;
+      PooledQuery& operator=(const PooledQuery&) = delete;
+
+      /// <summary>
+      /// Makes the array available as a table with the given name until 
+      /// this object is destroyed. The array must remain valid until then.
+      /// </summary>
+      void addTable(
+        const ExcelArray& arr,
+        const wchar_t* name,
+        const std::vector<std::wstring>* headings = nullptr);
+
+      ExcelObj run(const std::wstring& sql);
+
+    private:
+      PooledConnection* _conn;
+      bool _pooled;
+    };
+  }
+}
@@ -3,6 +3,7 @@
 #include <sqlite/sqlite3ext.h>
 #include <xlOil/ExcelArray.h>
 #include <xlOil/ExcelRef.h>
+#include <algorithm>
 
 using std::shared_ptr;
 using std::pair;
@@ -11,11 +12,43 @@ namespace xloil
 {
   namespace SQL
   {
+    int rangeBlockRows(int nCols)
+    {
+      // Limit the block size for very wide ranges
+      constexpr int MAX_BLOCK_CELLS = 1 << 20;
+      return std::max(1, std::min(RANGE_BLOCK_ROWS, MAX_BLOCK_CELLS / std::max(1, nCols)));
+    }
+
     /* An instance of the XlArray virtual table */
    
+    struct XlTableCursor 
+    {
+      sqlite3_vtab_cursor base;  /* Base class.  Must be first */
+      int iRowid;                /* The current rowid.  Negative for EOF */
+    };
+
+    /*
+    ** A cursor over a range on a sheet. Rows are fetched from Excel in 
+    ** blocks with a single xlCoerce, and xColumn reads from the current 
+    ** block. The block is kept when xFilter rewinds the cursor, so repeated
+    ** scans of a small range do not call Excel again.
+    */
+    struct XlRangeCursor
+    {
+      XlTableCursor row;              /* Must be first */
+      ExcelObj block;                 /* Values of the rows in the block */
+      const ExcelObj* cells = nullptr;/* Row-major cells of the block */
+      int blockStart = 0;             /* Row number of the first row in block */
+      int blockRows = 0;              /* Zero if no block is loaded */
+    };
+
     struct XlArrayTable
     {
       using InputType = XlArrayInput;
+      using Cursor = XlTableCursor;
+      /* Values are valid for the lifetime of the table */
+      static constexpr bool stableValues = true;
+
       XlArrayTable(const InputType& input) : data(input) {};
       sqlite3_vtab base;              /* Base class.  Must be first */
       ExcelArray data;
@@ -24,9 +57,33 @@ namespace xloil
     struct XlRangeTable
     {
       using InputType = XlRangeInput;
-      XlRangeTable(const InputType& input) : data(input) {};
+      using Cursor = XlRangeCursor;
+      /* Values are only valid until the cursor fetches the next block */
+      static constexpr bool stableValues = false;
+
+      XlRangeTable(const InputType& input) 
+        : data(input)
+        , nRows(input.nRows())
+        , nCols(input.nCols())
+        , blockRows(rangeBlockRows(input.nCols()))
+      {}
       sqlite3_vtab base;              /* Base class.  Must be first */
       ExcelRef data;
+      int nRows;
+      int nCols;
+      int blockRows;
+    };
+
+    struct XlBoundArrayTable
+    {
+      using InputType = XlArrayBinding;
+      using Cursor = XlTableCursor;
+      /* The binding is not changed while a query runs */
+      static constexpr bool stableValues = true;
+
+      XlBoundArrayTable(const InputType& input) : binding(&input) {};
+      sqlite3_vtab base;              /* Base class.  Must be first */
+      const XlArrayBinding* binding;
     };
 
     // Not sure what this could be used for...
@@ -44,13 +101,6 @@ namespace xloil
     //  shared_ptr<const ExcelObj> storage;
     //};
 
-
-    struct XlTableCursor 
-    {
-      sqlite3_vtab_cursor base;  /* Base class.  Must be first */
-      int iRowid;                /* The current rowid.  Negative for EOF */
-    };
-
     template<class T>
     static int xConnect(
       sqlite3 *db,
@@ -106,33 +156,101 @@ namespace xloil
       return SQLITE_OK;
     }
 
+    template<class T>
     static int xOpen(sqlite3_vtab*, sqlite3_vtab_cursor **ppCursor) {
-      auto *pCur = new XlTableCursor();
-      *ppCursor = &pCur->base;
+      auto *pCur = new typename T::Cursor();
+      *ppCursor = (sqlite3_vtab_cursor*)pCur;
       return SQLITE_OK;
     }
 
     /*
     ** Destructor for a Cursor.
     */
+    template<class T>
     static int xClose(sqlite3_vtab_cursor *cur) {
-      auto *pCur = (XlTableCursor*)cur;
+      auto *pCur = (typename T::Cursor*)cur;
       delete pCur;
       return SQLITE_OK;
     }
 
+    /*
+    ** Moves the cursor to the given row, or sets the EOF marker if it is
+    ** past the end of the table. Returns false on failure.
+    */
+    static bool moveTo(XlTableCursor& cur, const XlArrayTable& tab, int row)
+    {
+      cur.iRowid = row < (int)tab.data.nRows() ? row : -1;
+      return true;
+    }
+
+    static bool moveTo(XlTableCursor& cur, const XlBoundArrayTable& tab, int row)
+    {
+      const auto* data = tab.binding->data;
+      cur.iRowid = data && row < (int)data->nRows() ? row : -1;
+      return true;
+    }
+
+    static bool loadBlock(XlRangeCursor& cur, const XlRangeTable& tab, int start)
+    {
+      cur.block.reset();
+      cur.cells = nullptr;
+      cur.blockRows = 0;
+
+      const auto nRows = std::min(tab.blockRows, tab.nRows - start);
+      const auto ref = tab.data.range(start, 0, start + nRows - 1);
+      if (callExcelRaw(msxll::xlCoerce, &cur.block, &(const ExcelObj&)ref) != msxll::xlretSuccess)
+        return false;
+
+      // Excel returns a single cell as a scalar rather than an array
+      if (cur.block.isType(ExcelType::Multi))
+      {
+        if (cur.block.val.array.rows != nRows || cur.block.val.array.columns != tab.nCols)
+          return false;
+        cur.cells = (const ExcelObj*)cur.block.val.array.lparray;
+      }
+      else if (nRows == 1 && tab.nCols == 1)
+        cur.cells = &cur.block;
+      else
+        return false;
+
+      cur.blockStart = start;
+      cur.blockRows = nRows;
+      return true;
+    }
+
+    static bool moveTo(XlRangeCursor& cur, const XlRangeTable& tab, int row)
+    {
+      if (row >= tab.nRows)
+      {
+        cur.row.iRowid = -1;
+        return true;
+      }
+      cur.row.iRowid = row;
+      if (cur.blockRows > 0 && row >= cur.blockStart && row < cur.blockStart + cur.blockRows)
+        return true;
+      return loadBlock(cur, tab, row);
+    }
+
+    static int moveFailed(sqlite3_vtab_cursor *cur)
+    {
+      sqlite3_free(cur->pVtab->zErrMsg);
+      cur->pVtab->zErrMsg = sqlite3_mprintf("Could not read values from Excel range");
+      return SQLITE_ERROR;
+    }
+
     /*
     ** Only a full table scan is supported.  So xFilter simply rewinds to
     ** the beginning.
     */
+    template<class T>
     static int xFilter(
       sqlite3_vtab_cursor *pVtabCursor,
       int /*idxNum*/, const char* /*idxStr*/,
       int /*argc*/, sqlite3_value** /*argv*/)
     {
-      auto *pCur = (XlTableCursor*)pVtabCursor;
-      pCur->iRowid = 0;
-      return SQLITE_OK;
+      auto *pCur = (typename T::Cursor*)pVtabCursor;
+      auto *pTab = (const T*)pVtabCursor->pVtab;
+      return moveTo(*pCur, *pTab, 0) ? SQLITE_OK : moveFailed(pVtabCursor);
     }
 
     /*
@@ -142,11 +260,10 @@ namespace xloil
     template<class T>
     static int xNext(sqlite3_vtab_cursor *cur)
     {
-      auto *pCur = (XlTableCursor*)cur;
+      auto *pCur = (typename T::Cursor*)cur;
       auto *pTab = (const T*)cur->pVtab;
-      if (++pCur->iRowid >= (int)pTab->data.nRows())
-        pCur->iRowid = -1;
-      return SQLITE_OK;
+      const auto next = ((XlTableCursor*)cur)->iRowid + 1;
+      return moveTo(*pCur, *pTab, next) ? SQLITE_OK : moveFailed(cur);
     }
 
     /*
@@ -159,14 +276,28 @@ namespace xloil
     }
 
     
-    template<class T> struct TableReturn {};
-    template<> struct TableReturn<XlRangeTable> { using type = ExcelObj; };
-    template<> struct TableReturn<XlArrayTable> { using type = const ExcelObj&; };
+    static const ExcelObj& cellValue(
+      const XlTableCursor& cur, const XlArrayTable& tab, int i)
+    {
+      return tab.data(cur.iRowid, i);
+    }
+
+    static const ExcelObj& cellValue(
+      const XlTableCursor& cur, const XlBoundArrayTable& tab, int i)
+    {
+      return (*tab.binding->data)(cur.iRowid, i);
+    }
 
+    static const ExcelObj& cellValue(
+      const XlRangeCursor& cur, const XlRangeTable& tab, int i)
+    {
+      return cur.cells[(size_t)(cur.row.iRowid - cur.blockStart) * tab.nCols + i];
+    }
 
     struct ExcelValToSqlType
     {
       sqlite3_context* ctx;
+      bool copyStrings;
 
       void operator()(int x) const     { sqlite3_result_int64(ctx, x); }
       void operator()(bool x) const    { sqlite3_result_int64(ctx, x); }
@@ -176,7 +307,7 @@ namespace xloil
       void operator()(const PStringRef& pstr) const 
       {
         sqlite3_result_text16(ctx, pstr.pstr(),
-          pstr.length() * sizeof(wchar_t), SQLITE_STATIC);
+          pstr.length() * sizeof(wchar_t), copyStrings ? SQLITE_TRANSIENT : SQLITE_STATIC);
       }
 
       template <class T> void operator()(T) const
@@ -195,10 +326,9 @@ namespace xloil
       sqlite3_context *ctx,       /* First argument to sqlite3_result_...() */
       int i)                      /* Which column to return */
     {
-      auto *pCur = (XlTableCursor*)cur;
+      auto *pCur = (const typename T::Cursor*)cur;
       auto *pTab = (const T*)cur->pVtab;
-      TableReturn<T>::type val = pTab->data(pCur->iRowid, i);
-      val.visit(ExcelValToSqlType{ ctx });
+      cellValue(*pCur, *pTab, i).visit(ExcelValToSqlType{ ctx, !T::stableValues });
       return SQLITE_OK;
     }
 
@@ -220,9 +350,9 @@ namespace xloil
       xBestIndex,         /* xBestIndex */
       xDisconnect<T>,     /* xDisconnect */
       xDisconnect<T>,     /* xDestroy */
-      xOpen,              /* xOpen - open a cursor */
-      xClose,             /* xClose - close a cursor */
-      xFilter,            /* xFilter - configure scan constraints */
+      xOpen<T>,           /* xOpen - open a cursor */
+      xClose<T>,          /* xClose - close a cursor */
+      xFilter<T>,         /* xFilter - configure scan constraints */
       xNext<T>,           /* xNext - advance a cursor */
       xEof,               /* xEof - check for end of scan */
       xColumn<T>,         /* xColumn - read data */
@@ -239,5 +369,6 @@ namespace xloil
 
     extern sqlite3_module XlArrayModule = XlModule<XlArrayTable>;
     extern sqlite3_module XlRangeModule = XlModule<XlRangeTable>; 
+    extern sqlite3_module XlBoundArrayModule = XlModule<XlBoundArrayTable>;
   }
 }
\ No newline at end of file
@@ -10,7 +10,29 @@ namespace xloil
     using XlArrayInput = ExcelArray;
     using XlRangeInput = ExcelRef;
 
+    /// <summary>
+    /// The number of rows a range table fetches from Excel at once
+    /// </summary>
+    constexpr int RANGE_BLOCK_ROWS = 4096;
+
+    /// <summary>
+    /// The number of rows a range table with the given number of columns
+    /// fetches at once: fewer than RANGE_BLOCK_ROWS for very wide ranges.
+    /// </summary>
+    int rangeBlockRows(int nCols);
+
+    /// <summary>
+    /// Input to a virtual table whose data can be changed after it is
+    /// created by pointing <c>data</c> at another array. The table has no
+    /// rows while <c>data</c> is null. The binding must outlive the table.
+    /// </summary>
+    struct XlArrayBinding
+    {
+      const ExcelArray* data = nullptr;
+    };
+
     extern sqlite3_module XlArrayModule;
     extern sqlite3_module XlRangeModule;
+    extern sqlite3_module XlBoundArrayModule;
   }
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <xlOil/ExcelObj.h>
 #include <xloil/ExcelObjCache.h>
 #include "Common.h"
+#include "QueryPool.h"
 
 #include <xlOil/Preprocessor.h>
 
@@ -18,7 +19,7 @@ namespace xloil
   {
     void processMeta(
       const ExcelArray& metaData, 
-      sqlite3* db,
+      PooledQuery& db,
       ExcelObj::row_t i, 
       const ExcelObj& arg, 
       const wchar_t* defaultName)
@@ -27,7 +28,7 @@ namespace xloil
         return;
 
       if (i >= metaData.nRows() || metaData.nCols() < 1 || metaData(i, 0).isMissing())
-        createVTable(db, ExcelArray(arg), defaultName);
+        db.addTable(ExcelArray(arg), defaultName);
       else
       { 
         vector<wstring> headings;
@@ -35,8 +36,7 @@ namespace xloil
           metaData.row_begin(i) + 1, metaData.row_end(i),
           std::back_inserter(headings),
           [](const ExcelObj& x) { return x.toString(); });
-        createVTable(
-          db,
+        db.addTable(
           ExcelArray(arg),
           metaData(i, 0).toString().c_str(),
           headings.empty() ? nullptr : &headings);
@@ -56,7 +56,9 @@ namespace xloil
       )
     )
     {
-      auto db = newDatabase();
+      // Reuses this thread's database, and its tables if they have the 
+      // same schema, rather than setting up a new database each call
+      PooledQuery db;
 
       if (meta.isNonEmpty())
       {
@@ -73,25 +75,23 @@ namespace xloil
             builder(i, 0) = names[i];*/
         }
         ExcelArray metaData(cacheCheck(meta));
-        ProcessArgs([db, metaData](auto iArg, auto& argVal, auto& argName)
+        ProcessArgs([&db, &metaData](auto iArg, auto& argVal, auto& argName)
         {
-          processMeta(metaData, db.get(), iArg, argVal, argName);
+          processMeta(metaData, db, iArg, argVal, argName);
         }, XLO_ARGS_LIST(XLOSQL_NARGS, XLOSQL_ARG_NAME));
       }
       else
       {
-        ProcessArgs([db](auto& argVal, auto& argName)
+        ProcessArgs([&db](auto& argVal, auto& argName)
         {
           if (argVal.isNonEmpty())
-            createVTable(db.get(), ExcelArray(cacheCheck(argVal)), argName);
+            db.addTable(ExcelArray(cacheCheck(argVal)), argName);
         }, XLO_ARGS_LIST(XLOSQL_NARGS, XLOSQL_ARG_NAME));
       }
 
       auto sql = query.toStringRecursive();
 
-      auto stmt = sqlPrepare(db.get(), sql);
-
-      return returnValue(sqlQueryToArray(stmt));
+      return returnValue(db.run(sql));
     }
     XLO_FUNC_END(xloSql).threadsafe()
       .help(L"Excecutes the SQL query on the provided tables. "
@@ -5,6 +5,9 @@
 #include <xlOil/ExcelArray.h>
 #include "Common.h"
 #include "Cache.h"
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 using std::shared_ptr;
 using std::vector;
@@ -27,15 +30,60 @@ namespace xloil
       std::shared_ptr<sqlite3> _db;
     };
 
-    XLO_FUNC_START(xloSqlDB())
+    /// <summary>
+    /// A database file opened in WAL mode. Writes, such as creating tables,
+    /// go through a single connection and are serialised. Read-only queries
+    /// use a connection per calling thread, so run in parallel during a 
+    /// multi-threaded recalc.
+    /// </summary>
+    class SharedDataBaseRef : public DataBaseRef
+    {
+    public:
+      SharedDataBaseRef(const std::wstring& path)
+        : DataBaseRef(openDatabase(path, false))
+        , _path(path)
+      {}
+
+      std::shared_ptr<sqlite3> getReader() const override
+      {
+        const auto thread = std::this_thread::get_id();
+        {
+          std::scoped_lock lock(_lock);
+          auto found = _readers.find(thread);
+          if (found != _readers.end())
+            return found->second;
+        }
+        // Open outside the lock, it involves file I/O
+        auto reader = openDatabase(_path, true);
+        std::scoped_lock lock(_lock);
+        return _readers.try_emplace(thread, reader).first->second;
+      }
+
+    private:
+      std::wstring _path;
+      mutable std::mutex _lock;
+      mutable std::unordered_map<std::thread::id, std::shared_ptr<sqlite3>> _readers;
+    };
+
+    XLO_FUNC_START(xloSqlDB(const ExcelObj& path))
     {
       throwInFunctionWizard();
 
+      const auto pathStr = path.toString();
+      if (pathStr.empty() || pathStr == L":memory:")
+        return returnValue(
+          cacheAdd(
+            make_unique<DataBaseRef>(
+              newDatabase())));
+
       return returnValue(
         cacheAdd(
-          make_unique<DataBaseRef>(
-            newDatabase())));
+          make_unique<SharedDataBaseRef>(pathStr)));
     }
-    XLO_FUNC_END(xloSqlDB).threadsafe();
+    XLO_FUNC_END(xloSqlDB).threadsafe()
+      .help(L"Creates an empty database, by default in memory, and returns a reference to it")
+      .arg(L"Path", L"[opt] A file to create or open as the database. Read-only queries on "
+                     "a database file can run in parallel during a multi-threaded recalc, at "
+                     "the cost of writing tables to disk");
   }
 }
\ No newline at end of file
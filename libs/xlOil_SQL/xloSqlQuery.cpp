@@ -26,7 +26,20 @@ namespace xloil
         XLO_THROW("No database provided");
 
       auto sql = query.toStringRecursive();
-      auto stmt = sqlPrepare(dbObj->getDB().get(), sql);
+
+      // Read-only queries run on this thread's reader connection, if the 
+      // database has them, so they do not contend with other threads
+      auto db = dbObj->getReader();
+      auto stmt = sqlPrepare(db.get(), sql);
+      if (!sqlite3_stmt_readonly(stmt.get()))
+      {
+        auto writer = dbObj->getDB();
+        if (writer != db)
+        {
+          stmt = sqlPrepare(writer.get(), sql);
+          db = writer;
+        }
+      }
 
       return returnValue(sqlQueryToArray(stmt));
     }
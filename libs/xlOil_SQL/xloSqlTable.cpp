@@ -1,6 +1,7 @@
 #include <xlOil/StaticRegister.h>
 #include <xloil/Caller.h>
 #include <xlOil/ExcelArray.h>
+#include <xlOil/ExcelRef.h>
 #include <xloil/ExcelObjCache.h>
 #include "Common.h"
 #include "Cache.h"
@@ -16,7 +17,7 @@ namespace xloil
   {
     XLO_FUNC_START( xloSqlTable(
       const ExcelObj& database,
-      const ExcelObj& data,
+      const RangeArg& data,
       const ExcelObj& name,
       const ExcelObj& headings,
       const ExcelObj& query)
@@ -43,30 +44,57 @@ namespace xloil
       auto db = dbObj->getDB();
       ScopedLock lock(db.get());
 
-      // Attempt to drop table if it already exists, e.g. function called 
-      // again, but ignore return code
-      sqlExec(db.get(), fmt::format(L"DROP TABLE {0}", tableName));
+      // Readers on other connections to a shared database must not see the
+      // temporary virtual table or a half-made table, so the whole update 
+      // is one transaction
+      sqlThrow(db.get(), sqlExec(db.get(), L"BEGIN IMMEDIATE"));
+      try
+      {
+        // Attempt to drop table if it already exists, e.g. function called 
+        // again, but ignore return code
+        sqlExec(db.get(), fmt::format(L"DROP TABLE {0}", tableName));
 
-      createVTable(
-        db.get(),
-        ExcelArray(cacheCheck(data)),
-        tableName.c_str(),
-        headingsVec.empty() ? nullptr : &headingsVec);
+        // A range is read in blocks as the table is queried rather than
+        // being converted to an array up front
+        if (data.isType(ExcelType::RangeRef))
+        {
+          if (data.isType(ExcelType::Ref) && data.val.mref.lpmref->count != 1)
+            XLO_THROW("Data must be a single contiguous range");
+          createVTable(
+            db.get(),
+            ExcelRef(data),
+            tableName.c_str(),
+            headingsVec.empty() ? nullptr : &headingsVec);
+        }
+        else
+          createVTable(
+            db.get(),
+            ExcelArray(cacheCheck(data)),
+            tableName.c_str(),
+            headingsVec.empty() ? nullptr : &headingsVec);
 
-      wstring select = query.isNonEmpty()
-        ? query.toString()
-        : fmt::format(L"SELECT * FROM {0}", tableName);
+        wstring select = query.isNonEmpty()
+          ? query.toString()
+          : fmt::format(L"SELECT * FROM {0}", tableName);
 
-      // We do this little rename so the table can have the 
-      // expected name in the query even though it is just
-      // the temporary vtable.
-      auto tempName = wstring(L"xloil_temp");
-      auto sql = fmt::format(
-        L"CREATE TABLE {0} AS {1};"
-        "DROP TABLE {2};"
-        "ALTER TABLE {0} RENAME TO {2};",
-        tempName, select, tableName);
-      sqlThrow(db.get(), sqlExec(db.get(), sql));
+        // We do this little rename so the table can have the 
+        // expected name in the query even though it is just
+        // the temporary vtable.
+        auto tempName = wstring(L"xloil_temp");
+        auto sql = fmt::format(
+          L"CREATE TABLE {0} AS {1};"
+          "DROP TABLE {2};"
+          "ALTER TABLE {0} RENAME TO {2};",
+          tempName, select, tableName);
+        sqlThrow(db.get(), sqlExec(db.get(), sql));
+        sqlThrow(db.get(), sqlExec(db.get(), L"COMMIT"));
+      }
+      catch (...)
+      {
+        if (!sqlite3_get_autocommit(db.get()))
+          sqlExec(db.get(), L"ROLLBACK");
+        throw;
+      }
         
       return const_cast<ExcelObj*>(&database);
     }
@@ -75,7 +103,7 @@ namespace xloil
             "Returns a reference to the database: it is recommended to chain xloSqlTable calls "
             "to force execution order before calling xloSqlQuery")
       .arg(L"Database", L"A reference to a database created by xloSqlDB or another call to xloSqlTable")
-      .arg(L"Data", L"An array of data to read into the table. First row must be headings, unless "
+      .arg(L"Data", L"An array or range of data to read into the table. First row must be headings, unless "
                      "headings parameter is specified")
       .arg(L"Name", L"The table name in the database, this must be unique")
       .arg(L"Headings", L"[opt] headings (field names) for the data")
@@ -0,0 +1,123 @@
+#include "LookupIndex.h"
+#include <xloil/ExcelObjCache.h>
+#include <xloil/Throw.h>
+#include <algorithm>
+#include <numeric>
+
+using std::vector;
+using std::unique_ptr;
+
+namespace xloil
+{
+  template<>
+  struct CacheUniquifier<std::unique_ptr<const Utils::LookupIndex>>
+  {
+    static constexpr wchar_t value = L'\x7D22';
+  };
+
+  namespace Utils
+  {
+    namespace
+    {
+      ExcelArray withoutHeadings(const ExcelArray& all, bool hasHeadings)
+      {
+        if (!hasHeadings)
+          return all;
+        if (all.nRows() == 0)
+          XLO_THROW("Array has no heading row");
+        return all.slice(1, 0);
+      }
+    }
+
+    LookupIndex::LookupIndex(
+      const ExcelObj& data,
+      vector<col_t>&& keyCols,
+      bool hasHeadings,
+      bool sorted)
+      : _store(data)
+      , _all(_store)
+      , _data(withoutHeadings(_all, hasHeadings))
+      , _hasHeadings(hasHeadings)
+      , _hasSorted(sorted)
+      , _table(_data, std::move(keyCols))
+    {
+      const auto nRows = _data.nRows();
+
+      // Duplicate keys resolve to the first row, like VLOOKUP
+      for (row_t i = 0; i < nRows; ++i)
+        _table.insertUnique(i);
+
+      if (sorted)
+      {
+        _sorted.resize(nRows);
+        std::iota(_sorted.begin(), _sorted.end(), 0);
+        std::stable_sort(_sorted.begin(), _sorted.end(),
+          [this](row_t l, row_t r) { return _table.compareRows(l, r) < 0; });
+      }
+    }
+
+    LookupIndex::row_t LookupIndex::find(const ExcelObj* keys) const
+    {
+      return _table.find([keys](col_t k) -> const ExcelObj& { return keys[k]; });
+    }
+
+    LookupIndex::row_t LookupIndex::findNearest(const ExcelObj* keys, int matchType) const
+    {
+      if (!_hasSorted)
+        XLO_THROW("Index must be built with a sorted index for approximate matches");
+
+      const auto key = [keys](col_t k) -> const ExcelObj& { return keys[k]; };
+      if (matchType > 0)
+      {
+        // Last row with keys <= given keys
+        auto found = std::partition_point(_sorted.begin(), _sorted.end(),
+          [&](row_t row) { return _table.compareKeys(row, key) <= 0; });
+        return found == _sorted.begin() ? NOT_FOUND : *(found - 1);
+      }
+      else
+      {
+        // First row with keys >= given keys
+        auto found = std::partition_point(_sorted.begin(), _sorted.end(),
+          [&](row_t row) { return _table.compareKeys(row, key) < 0; });
+        return found == _sorted.end() ? NOT_FOUND : *found;
+      }
+    }
+
+    LookupIndex::col_t LookupIndex::column(const ExcelObj& colOrHeading) const
+    {
+      const auto nCols = _data.nCols();
+      switch (colOrHeading.type())
+      {
+      case ExcelType::Int:
+      case ExcelType::Num:
+      {
+        // 1-based column indexing to match Excel's INDEX function etc.
+        const auto column = colOrHeading.get<int>() - 1;
+        if (column < 0 || (col_t)column >= nCols)
+          XLO_THROW("Column number {0} is outside array columns 1 to {1}", column + 1, nCols);
+        return (col_t)column;
+      }
+      case ExcelType::Str:
+        if (!_hasHeadings)
+          XLO_THROW(L"Cannot find heading {0}: index was built without headings",
+            colOrHeading.toString());
+        for (col_t j = 0; j < nCols; ++j)
+          if (colOrHeading == _all(0, j))
+            return j;
+        XLO_THROW(L"Could not find heading {0} in first row of array", colOrHeading.toString());
+      default:
+        XLO_THROW("Column must be a number or heading");
+      }
+    }
+
+    ExcelObj indexAdd(unique_ptr<const LookupIndex>&& index)
+    {
+      return addCached<LookupIndex>(index.release(), L"Index");
+    }
+
+    const LookupIndex* indexFetch(const std::wstring_view& key)
+    {
+      return getCached<LookupIndex>(key);
+    }
+  }
+}
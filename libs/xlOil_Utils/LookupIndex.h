@@ -0,0 +1,81 @@
+#pragma once
+#include <xloil/ExcelObj.h>
+#include <xloil/ExcelArray.h>
+#include "RowHashTable.h"
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace xloil
+{
+  namespace Utils
+  {
+    /// <summary>
+    /// Holds a copy of an array with a hash index, and optionally a sorted
+    /// index, over one or more key columns. Keys match if
+    /// <see cref="ExcelObj::compare"/> finds them equal, so strings are case
+    /// insensitive and numbers match regardless of int/double type.
+    /// </summary>
+    class LookupIndex
+    {
+    public:
+      using row_t = ExcelObj::row_t;
+      using col_t = ExcelObj::col_t;
+
+      static constexpr row_t NOT_FOUND = RowHashTable::NOT_FOUND;
+
+      /// <summary>
+      /// Indexes the array on the given (0-based) key columns. If
+      /// <paramref name="hasHeadings"/> the first row is not indexed but
+      /// can be used to name columns. If <paramref name="sorted"/> a
+      /// sorted index is also built to support <see cref="findNearest"/>.
+      /// </summary>
+      LookupIndex(
+        const ExcelObj& data,
+        std::vector<col_t>&& keyCols,
+        bool hasHeadings,
+        bool sorted);
+
+      /// <summary>
+      /// Returns the first row whose key columns match the given keys, which
+      /// should point to <see cref="nKeys"/> values, or NOT_FOUND.
+      /// </summary>
+      row_t find(const ExcelObj* keys) const;
+
+      /// <summary>
+      /// Like Excel's MATCH with a non-zero match type, if <paramref name="matchType"/>
+      /// is 1, returns the row with the largest keys less than or equal to the given
+      /// ones, if -1, the row with the smallest keys greater than or equal to the
+      /// given ones, or NOT_FOUND. Throws if there is no sorted index.
+      /// </summary>
+      row_t findNearest(const ExcelObj* keys, int matchType) const;
+
+      /// <summary>
+      /// The indexed data, excluding any headings
+      /// </summary>
+      const ExcelArray& data() const { return _data; }
+
+      col_t nKeys() const { return _table.nKeys(); }
+
+      bool hasSorted() const { return _hasSorted; }
+
+      /// <summary>
+      /// Returns the 0-based column for a 1-based column number or a heading
+      /// </summary>
+      col_t column(const ExcelObj& colOrHeading) const;
+
+    private:
+      ExcelObj _store;
+      ExcelArray _all;
+      ExcelArray _data;
+      bool _hasHeadings;
+      bool _hasSorted;
+      RowHashTable _table;
+      std::vector<row_t> _sorted;
+    };
+
+    ExcelObj indexAdd(std::unique_ptr<const LookupIndex>&& index);
+
+    const LookupIndex* indexFetch(const std::wstring_view& key);
+  }
+}
@@ -0,0 +1,66 @@
+#include "RowHashTable.h"
+
+using std::vector;
+
+namespace xloil
+{
+  namespace Utils
+  {
+    vector<ExcelObj::col_t> parseColumns(
+      const ExcelArray& array, const ExcelObj& colsOrHeadings, bool hasHeadings)
+    {
+      vector<ExcelObj::col_t> result;
+      if (colsOrHeadings.isMissing())
+      {
+        result.push_back(0);
+        return result;
+      }
+
+      ExcelArray specs(colsOrHeadings);
+      for (auto& spec : specs)
+      {
+        switch (spec.type())
+        {
+        case ExcelType::Int:
+        case ExcelType::Num:
+        {
+          const auto column = spec.get<int>() - 1;
+          if (column < 0 || (ExcelObj::col_t)column >= array.nCols())
+            XLO_THROW("Column {0} is outside array columns 1 to {1}", column + 1, array.nCols());
+          result.push_back((ExcelObj::col_t)column);
+          break;
+        }
+        case ExcelType::Str:
+        {
+          if (!hasHeadings)
+            XLO_THROW(L"Cannot find heading {0} as array has no headings", spec.toString());
+          auto column = array.nCols();
+          for (auto j = 0u; j < array.nCols(); ++j)
+            if (spec == array(0, j))
+            {
+              column = j;
+              break;
+            }
+          if (column == array.nCols())
+            XLO_THROW(L"Could not find heading {0} in first row of array", spec.toString());
+          result.push_back(column);
+          break;
+        }
+        default:
+          XLO_THROW("Columns must be column numbers or headings");
+        }
+      }
+      return result;
+    }
+
+    bool anyHeadings(const ExcelObj& colsOrHeadings)
+    {
+      if (colsOrHeadings.isMissing())
+        return false;
+      for (auto& spec : ExcelArray(colsOrHeadings))
+        if (spec.isType(ExcelType::Str))
+          return true;
+      return false;
+    }
+  }
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include <xloil/ExcelObj.h>
+#include <xloil/ExcelArray.h>
+#include <xloil/StringUtils.h>
+#include <xloil/Throw.h>
+#include <vector>
+
+namespace xloil
+{
+  namespace Utils
+  {
+    /// <summary>
+    /// A hash table of the rows of an array keyed on one or more of its
+    /// columns. Keys match if <see cref="ExcelObj::compare"/> finds them
+    /// equal, so strings are case insensitive and numbers match regardless
+    /// of int/double type.
+    ///
+    /// Keys are passed to the lookup functions as a callable taking a key
+    /// number and returning an ExcelObj, so they may come from any array.
+    /// Rows with matching keys are visited in the order they were inserted.
+    ///
+    /// If the collation locale means string hashes do not agree with 
+    /// ExcelObj::compare, strings are hashed by their collation sort key,
+    /// which is slower but keeps lookups consistent with compare.
+    /// </summary>
+    class RowHashTable
+    {
+    public:
+      using row_t = ExcelObj::row_t;
+      using col_t = ExcelObj::col_t;
+
+      static constexpr row_t NOT_FOUND = (row_t)-1;
+
+      /// <summary>
+      /// Creates an empty table with space for all rows of the array, which
+      /// must outlive the table.
+      /// </summary>
+      RowHashTable(const ExcelArray& data, std::vector<col_t>&& keyCols)
+        : _data(data)
+        , _keyCols(std::move(keyCols))
+        , _hashStrings(ExcelObj::stringHashMatchesCompare())
+      {
+        if (_keyCols.empty())
+          XLO_THROW("No key columns specified");
+        for (auto j : _keyCols)
+          if (j >= _data.nCols())
+            XLO_THROW("Key column {0} is beyond number of array columns {1}", j + 1, _data.nCols());
+
+        // Keep the load factor at or below one half
+        size_t capacity = 16;
+        while (capacity < 2 * (size_t)_data.nRows())
+          capacity <<= 1;
+        _mask = capacity - 1;
+        _slots.assign(capacity, Slot{ 0, NOT_FOUND });
+      }
+
+      RowHashTable(const RowHashTable&) = delete;
+      RowHashTable& operator=(const RowHashTable&) = delete;
+
+      /// <summary>
+      /// Adds a row, even if its keys are already in the table
+      /// </summary>
+      void insert(row_t row)
+      {
+        const auto h = hashRow(row);
+        auto k = h & _mask;
+        while (_slots[k].row != NOT_FOUND)
+          k = (k + 1) & _mask;
+        _slots[k] = Slot{ h, row };
+      }
+
+      /// <summary>
+      /// If a row with the same keys is in the table, returns it, otherwise
+      /// adds the row and returns NOT_FOUND.
+      /// </summary>
+      row_t insertUnique(row_t row)
+      {
+        const auto h = hashRow(row);
+        auto k = h & _mask;
+        for (; _slots[k].row != NOT_FOUND; k = (k + 1) & _mask)
+          if (_slots[k].hash == h && compareRows(_slots[k].row, row) == 0)
+            return _slots[k].row;
+        _slots[k] = Slot{ h, row };
+        return NOT_FOUND;
+      }
+
+      /// <summary>
+      /// Returns the first inserted row matching the keys, or NOT_FOUND
+      /// </summary>
+      template<class TKeys>
+      row_t find(const TKeys& keys) const
+      {
+        row_t result = NOT_FOUND;
+        forEachMatch(keys, [&result](row_t row) { result = row; return false; });
+        return result;
+      }
+
+      /// <summary>
+      /// Calls the function with each row matching the keys, stopping if it
+      /// returns false.
+      /// </summary>
+      template<class TKeys, class TFunc>
+      void forEachMatch(const TKeys& keys, TFunc func) const
+      {
+        size_t h = 0;
+        for (col_t k = 0; k < nKeys(); ++k)
+          h = boost_hash_combine(h, hashValue(keys(k)));
+
+        for (auto k = h & _mask; _slots[k].row != NOT_FOUND; k = (k + 1) & _mask)
+        {
+          if (_slots[k].hash == h && compareKeys(_slots[k].row, keys) == 0
+              && !func(_slots[k].row))
+            return;
+        }
+      }
+
+      /// <summary>
+      /// Compares the keys of two rows of the data with ExcelObj::compare
+      /// </summary>
+      int compareRows(row_t left, row_t right) const
+      {
+        const auto* l = _data.row_begin(left);
+        const auto* r = _data.row_begin(right);
+        for (auto j : _keyCols)
+        {
+          const auto cmp = ExcelObj::compare(l[j], r[j]);
+          if (cmp != 0)
+            return cmp;
+        }
+        return 0;
+      }
+
+      /// <summary>
+      /// Compares the keys of a row of the data to the given keys
+      /// </summary>
+      template<class TKeys>
+      int compareKeys(row_t row, const TKeys& keys) const
+      {
+        const auto* values = _data.row_begin(row);
+        for (col_t k = 0; k < nKeys(); ++k)
+        {
+          const auto cmp = ExcelObj::compare(values[_keyCols[k]], keys(k));
+          if (cmp != 0)
+            return cmp;
+        }
+        return 0;
+      }
+
+      col_t nKeys() const { return (col_t)_keyCols.size(); }
+      const std::vector<col_t>& keyColumns() const { return _keyCols; }
+
+    private:
+      struct Slot
+      {
+        size_t hash;
+        row_t row;
+      };
+
+      size_t hashRow(row_t row) const
+      {
+        const auto* values = _data.row_begin(row);
+        size_t h = 0;
+        for (auto j : _keyCols)
+          h = boost_hash_combine(h, hashValue(values[j]));
+        return h;
+      }
+
+      size_t hashValue(const ExcelObj& value) const
+      {
+        return _hashStrings
+          ? ExcelObj::hash(value)
+          : ExcelObj::collatedHash(value);
+      }
+
+      const ExcelArray& _data;
+      std::vector<col_t> _keyCols;
+      bool _hashStrings;
+      // Open addressing with linear probing
+      std::vector<Slot> _slots;
+      size_t _mask;
+    };
+
+    /// <summary>
+    /// Returns a list of 0-based columns given 1-based column numbers or
+    /// headings in the first row of the array. Defaults to the first column
+    /// if <paramref name="colsOrHeadings"/> is missing.
+    /// </summary>
+    std::vector<ExcelObj::col_t> parseColumns(
+      const ExcelArray& array, const ExcelObj& colsOrHeadings, bool hasHeadings);
+
+    /// <summary>
+    /// Returns true if any of the column specifiers is a heading rather
+    /// than a number.
+    /// </summary>
+    bool anyHeadings(const ExcelObj& colsOrHeadings);
+  }
+}
@@ -31,13 +31,17 @@ namespace xloil
     else
     {
       auto sep = separator.get<std::wstring>();
-      ProcessArgs([&result, &sep](auto& argVal)
+      auto first = true;
+      ProcessArgs([&result, &sep, &first](auto& argVal)
       {
         if (argVal.isNonEmpty())
-          result += argVal.toStringRecursive(sep.c_str()) + sep;
+        {
+          if (!first)
+            result += sep;
+          first = false;
+          argVal.appendStringRecursive(result, sep.c_str());
+        }
       }, XLO_ARGS_LIST(XLOCONCAT_NARGS, XLOCONCAT_ARG_NAME));
-      if (!result.empty())
-        result.erase(result.size() - sep.size());
     }
     return returnValue(result);
   }
@@ -0,0 +1,266 @@
+#include <xloil/ExcelObj.h>
+#include <xloil/ArrayBuilder.h>
+#include <xloil/ExcelArray.h>
+#include <xloil/StaticRegister.h>
+#include <xloil/ExcelObjCache.h>
+#include "RowHashTable.h"
+#include <algorithm>
+#include <limits>
+
+using std::vector;
+using std::wstring;
+
+namespace xloil
+{
+  namespace Utils
+  {
+    namespace
+    {
+      using row_t = RowHashTable::row_t;
+      using col_t = RowHashTable::col_t;
+
+      enum class Aggregate
+      {
+        Sum, Count, Min, Max, Mean, First
+      };
+
+      constexpr const wchar_t* AGGREGATE_NAMES[] = {
+        L"sum", L"count", L"min", L"max", L"mean", L"first"
+      };
+
+      Aggregate parseAggregate(const ExcelObj& name)
+      {
+        const auto str = name.get<wstring>();
+        for (auto i = 0u; i < _countof(AGGREGATE_NAMES); ++i)
+          if (_wcsicmp(str.c_str(), AGGREGATE_NAMES[i]) == 0)
+            return Aggregate(i);
+        XLO_THROW(L"Unknown aggregate '{0}': must be one of sum, count, min, max, mean, first", str);
+      }
+
+      struct Accumulator
+      {
+        double sum = 0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        // Number of numeric values, which excludes empty cells and text
+        row_t nNumbers = 0;
+        // Number of non-empty values
+        row_t count = 0;
+        int error = 0;
+
+        void add(const ExcelObj& value)
+        {
+          double x;
+          switch (value.type())
+          {
+          case ExcelType::Num:
+            x = value.val.num;
+            break;
+          case ExcelType::Int:
+            x = value.val.w;
+            break;
+          case ExcelType::Err:
+            // Errors propagate, as in Excel's SUM etc.
+            if (error == 0)
+              error = value.val.err;
+            [[fallthrough]];
+          default:
+            if (value.isNonEmpty())
+              ++count;
+            return;
+          }
+          ++count;
+          ++nNumbers;
+          sum += x;
+          min = std::min(min, x);
+          max = std::max(max, x);
+        }
+      };
+    }
+
+    XLO_FUNC_START(
+      xloGroupBy(
+        const ExcelObj& arrayOrRef,
+        const ExcelObj& keyCols,
+        const ExcelObj& valueCols,
+        const ExcelObj& aggregates,
+        const ExcelObj& headings
+      )
+    )
+    {
+      ExcelArray array(cacheCheck(arrayOrRef));
+
+      const auto hasHeadings = headings.isMissing()
+        ? anyHeadings(keyCols) || anyHeadings(valueCols)
+        : headings.get<bool>();
+
+      auto keys = parseColumns(array, keyCols, hasHeadings);
+      const auto nKeys = (col_t)keys.size();
+
+      // With no value columns, we just count the rows in each group
+      vector<col_t> values;
+      vector<Aggregate> ops;
+      if (!valueCols.isMissing())
+      {
+        values = parseColumns(array, valueCols, hasHeadings);
+        if (aggregates.isMissing())
+          ops.assign(values.size(), Aggregate::Sum);
+        else
+        {
+          ExcelArray names(aggregates);
+          if (names.size() == 1)
+            ops.assign(values.size(), parseAggregate(names(0)));
+          else if (names.size() == values.size())
+            for (auto& name : names)
+              ops.push_back(parseAggregate(name));
+          else
+            XLO_THROW("Specify one aggregate, or one for each value column");
+        }
+      }
+      const auto nAggs = std::max<col_t>((col_t)values.size(), 1);
+
+      const row_t first = hasHeadings ? 1 : 0;
+      if (array.nRows() < first)
+        XLO_THROW("Array has no heading row");
+      const auto data = array.slice(first, 0);
+
+      // Assign each row to a group, numbered in order of first appearance
+      RowHashTable table(data, std::move(keys));
+      vector<row_t> groupOfRow(data.nRows());
+      vector<row_t> firstRows;
+      for (row_t i = 0; i < data.nRows(); ++i)
+      {
+        const auto existing = table.insertUnique(i);
+        if (existing == RowHashTable::NOT_FOUND)
+        {
+          groupOfRow[i] = (row_t)firstRows.size();
+          firstRows.push_back(i);
+        }
+        else
+          groupOfRow[i] = groupOfRow[existing];
+      }
+      const auto nGroups = (row_t)firstRows.size();
+
+      vector<Accumulator> accumulators((size_t)nGroups * nAggs);
+      if (values.empty())
+      {
+        for (row_t i = 0; i < data.nRows(); ++i)
+          ++accumulators[groupOfRow[i]].count;
+      }
+      else
+      {
+        for (row_t i = 0; i < data.nRows(); ++i)
+        {
+          const auto* row = data.row_begin(i);
+          auto* acc = &accumulators[(size_t)groupOfRow[i] * nAggs];
+          for (col_t k = 0; k < nAggs; ++k)
+            acc[k].add(row[values[k]]);
+        }
+      }
+
+      const auto nRows = nGroups + first;
+      const auto nCols = nKeys + nAggs;
+      if (nRows == 0)
+        return returnValue(CellError::NA);
+
+      // Headings of the aggregate columns are like "sum(Heading)"
+      const auto& keyColumns = table.keyColumns();
+      vector<wstring> aggHeadings;
+      size_t strLen = 0;
+      if (hasHeadings)
+      {
+        for (auto j : keyColumns)
+          strLen += array.at(0, j).stringLength();
+        if (values.empty())
+          aggHeadings.emplace_back(AGGREGATE_NAMES[(int)Aggregate::Count]);
+        for (col_t k = 0; k < values.size(); ++k)
+          aggHeadings.push_back(wstring(AGGREGATE_NAMES[(int)ops[k]])
+            + L"(" + array.at(0, values[k]).toString() + L")");
+        for (auto& h : aggHeadings)
+          strLen += h.length();
+      }
+      for (auto i : firstRows)
+      {
+        const auto* row = data.row_begin(i);
+        for (auto j : keyColumns)
+          strLen += row[j].stringLength();
+        for (col_t k = 0; k < values.size(); ++k)
+          if (ops[k] == Aggregate::First)
+            strLen += row[values[k]].stringLength();
+      }
+
+      ExcelArrayBuilder builder(nRows, nCols, strLen);
+      if (hasHeadings)
+      {
+        for (col_t j = 0; j < nKeys; ++j)
+          builder(0, j) = array.at(0, keyColumns[j]);
+        for (col_t k = 0; k < nAggs; ++k)
+          builder(0, nKeys + k) = aggHeadings[k];
+      }
+
+      for (row_t g = 0; g < nGroups; ++g)
+      {
+        const auto i = g + first;
+        const auto* row = data.row_begin(firstRows[g]);
+        for (col_t j = 0; j < nKeys; ++j)
+          builder(i, j) = row[keyColumns[j]];
+
+        const auto* acc = &accumulators[(size_t)g * nAggs];
+        if (values.empty())
+        {
+          builder(i, nKeys) = (int)acc->count;
+          continue;
+        }
+        for (col_t k = 0; k < nAggs; ++k)
+        {
+          auto cell = builder(i, nKeys + k);
+          const auto& a = acc[k];
+          if (a.error != 0 && ops[k] != Aggregate::Count && ops[k] != Aggregate::First)
+          {
+            cell = CellError(a.error);
+            continue;
+          }
+          switch (ops[k])
+          {
+          case Aggregate::Sum:
+            cell = a.sum;
+            break;
+          case Aggregate::Count:
+            cell = (int)a.count;
+            break;
+          case Aggregate::Min:
+            if (a.nNumbers > 0) cell = a.min; else cell = CellError::NA;
+            break;
+          case Aggregate::Max:
+            if (a.nNumbers > 0) cell = a.max; else cell = CellError::NA;
+            break;
+          case Aggregate::Mean:
+            if (a.nNumbers > 0) cell = a.sum / a.nNumbers; else cell = CellError::Div0;
+            break;
+          case Aggregate::First:
+            cell = row[values[k]];
+            break;
+          }
+        }
+      }
+
+      return returnValue(builder.toExcelObj());
+    }
+    XLO_FUNC_END(xloGroupBy).threadsafe()
+      .help(L"Groups the rows of an array by one or more key columns and aggregates "
+            L"value columns in each group. Returns a row for each group, in order of first "
+            L"appearance, containing the keys then the aggregates. Keys match as in Excel: "
+            L"strings are case-insensitive")
+      .arg(L"ArrayOrRef", L"A range/array or an xlOil ref")
+      .optArg(L"KeyCols", L"Column number (1-based) or heading, or an array of these. "
+                          L"Defaults to the first column")
+      .optArg(L"ValueCols", L"Column numbers or headings to aggregate. If omitted, "
+                            L"returns the number of rows in each group")
+      .optArg(L"Aggregates", L"One of sum, count, min, max, mean, first, or an array with "
+                             L"one for each value column. Defaults to sum. Only numbers are "
+                             L"included in sum, min, max and mean; count gives the number of "
+                             L"non-empty values")
+      .optArg(L"Headings", L"If TRUE, the first row contains headings. Defaults to TRUE "
+                           L"if any column is a heading");
+  }
+}
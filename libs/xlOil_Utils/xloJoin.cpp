@@ -0,0 +1,148 @@
+#include <xloil/ExcelObj.h>
+#include <xloil/ArrayBuilder.h>
+#include <xloil/ExcelArray.h>
+#include <xloil/StaticRegister.h>
+#include <xloil/ExcelObjCache.h>
+#include "RowHashTable.h"
+#include <algorithm>
+
+using std::vector;
+
+namespace xloil
+{
+  namespace Utils
+  {
+    XLO_FUNC_START(
+      xloJoin(
+        const ExcelObj& leftArray,
+        const ExcelObj& rightArray,
+        const ExcelObj& leftKeys,
+        const ExcelObj& rightKeys,
+        const ExcelObj& how,
+        const ExcelObj& headings
+      )
+    )
+    {
+      using row_t = RowHashTable::row_t;
+      using col_t = RowHashTable::col_t;
+
+      ExcelArray left(cacheCheck(leftArray));
+      ExcelArray right(cacheCheck(rightArray));
+
+      // The right keys default to the left ones, which is natural when
+      // the key columns have the same headings
+      const auto& rightKeySpec = rightKeys.isMissing() ? leftKeys : rightKeys;
+
+      const auto hasHeadings = headings.isMissing()
+        ? anyHeadings(leftKeys) || anyHeadings(rightKeySpec)
+        : headings.get<bool>();
+
+      auto leftCols = parseColumns(left, leftKeys, hasHeadings);
+      auto rightCols = parseColumns(right, rightKeySpec, hasHeadings);
+      if (leftCols.size() != rightCols.size())
+        XLO_THROW("Left and right must have the same number of key columns");
+
+      const auto howStr = how.isMissing() ? std::wstring(L"inner") : how.get<std::wstring>();
+      const auto leftJoin = _wcsicmp(howStr.c_str(), L"left") == 0;
+      if (!leftJoin && _wcsicmp(howStr.c_str(), L"inner") != 0)
+        XLO_THROW("Join type must be 'inner' or 'left'");
+
+      const row_t first = hasHeadings ? 1 : 0;
+      if (left.nRows() < first || right.nRows() < first)
+        XLO_THROW("Array has no heading row");
+      const auto leftData = left.slice(first, 0);
+      const auto rightData = right.slice(first, 0);
+
+      // The output has all left columns then the right non-key columns
+      vector<col_t> rightOut;
+      for (col_t j = 0; j < right.nCols(); ++j)
+        if (std::find(rightCols.begin(), rightCols.end(), j) == rightCols.end())
+          rightOut.push_back(j);
+
+      RowHashTable table(rightData, std::move(rightCols));
+      for (row_t i = 0; i < rightData.nRows(); ++i)
+        table.insert(i);
+
+      // Find all matching pairs of rows and the space needed for strings
+      // so we can write the result in one pass
+      vector<std::pair<row_t, row_t>> matches;
+      matches.reserve(leftData.nRows());
+      size_t strLen = 0;
+      for (row_t i = 0; i < leftData.nRows(); ++i)
+      {
+        const auto* leftRow = leftData.row_begin(i);
+        const auto nBefore = matches.size();
+        table.forEachMatch(
+          [&](col_t k) -> const ExcelObj& { return leftRow[leftCols[k]]; },
+          [&](row_t j)
+          {
+            matches.emplace_back(i, j);
+            for (auto c : rightOut)
+              strLen += rightData.at(j, c).stringLength();
+            return true;
+          });
+        if (leftJoin && matches.size() == nBefore)
+          matches.emplace_back(i, RowHashTable::NOT_FOUND);
+
+        size_t leftLen = 0;
+        for (auto p = leftRow; p != leftData.row_end(i); ++p)
+          leftLen += p->stringLength();
+        strLen += leftLen * (matches.size() - nBefore);
+      }
+
+      const auto nRows = (row_t)matches.size() + first;
+      const auto nCols = left.nCols() + (col_t)rightOut.size();
+      if (nRows == 0)
+        return returnValue(CellError::NA);
+
+      if (hasHeadings)
+      {
+        for (auto p = left.row_begin(0); p != left.row_end(0); ++p)
+          strLen += p->stringLength();
+        for (auto c : rightOut)
+          strLen += right.at(0, c).stringLength();
+      }
+
+      ExcelArrayBuilder builder(nRows, nCols, strLen);
+      if (hasHeadings)
+      {
+        col_t j = 0;
+        for (auto p = left.row_begin(0); p != left.row_end(0); ++p)
+          builder(0, j++) = *p;
+        for (auto c : rightOut)
+          builder(0, j++) = right.at(0, c);
+      }
+
+      row_t i = first;
+      for (auto [l, r] : matches)
+      {
+        col_t j = 0;
+        for (auto p = leftData.row_begin(l); p != leftData.row_end(l); ++p)
+          builder(i, j++) = *p;
+        if (r == RowHashTable::NOT_FOUND)
+          for (; j < nCols; ++j)
+            builder(i, j) = CellError::NA;
+        else
+          for (auto c : rightOut)
+            builder(i, j++) = rightData.at(r, c);
+        ++i;
+      }
+
+      return returnValue(builder.toExcelObj());
+    }
+    XLO_FUNC_END(xloJoin).threadsafe()
+      .help(L"Joins two arrays on one or more key columns, returning the left columns "
+            L"followed by the non-key right columns. Keys match as in Excel: strings are "
+            L"case-insensitive")
+      .arg(L"Left", L"A range/array or an xlOil ref")
+      .arg(L"Right", L"A range/array or an xlOil ref")
+      .optArg(L"LeftKeys", L"Column number (1-based) or heading, or an array of these, "
+                           L"of the left keys. Defaults to the first column")
+      .optArg(L"RightKeys", L"Column numbers or headings of the right keys. Defaults "
+                            L"to LeftKeys")
+      .optArg(L"How", L"'inner' (default) or 'left'. A left join keeps unmatched left "
+                      L"rows, filling the right columns with #N/A")
+      .optArg(L"Headings", L"If TRUE, the first rows contain headings. Defaults to TRUE "
+                           L"if any key column is a heading");
+  }
+}
@@ -0,0 +1,230 @@
+#include <xloil/ExcelObj.h>
+#include <xloil/ArrayBuilder.h>
+#include <xloil/ExcelArray.h>
+#include <xloil/StaticRegister.h>
+#include <xloil/ExcelObjCache.h>
+#include "LookupIndex.h"
+
+using std::vector;
+
+namespace xloil
+{
+  namespace Utils
+  {
+    namespace
+    {
+      using row_t = LookupIndex::row_t;
+      using col_t = LookupIndex::col_t;
+
+      const LookupIndex& fetchIndex(const ExcelObj& ref)
+      {
+        const LookupIndex* index = nullptr;
+        if (ref.isType(ExcelType::Str))
+          index = indexFetch(ref.cast<PStringRef>().view());
+        if (!index)
+          XLO_THROW("Index must be a reference returned by xloIndexBuild");
+        return *index;
+      }
+
+      /// <summary>
+      /// Finds the data row for each lookup. With a single key column, each
+      /// value is a lookup and the results have the same shape as the values.
+      /// With multiple keys, each row of values is a lookup.
+      /// </summary>
+      vector<row_t> findRows(
+        const LookupIndex& index,
+        const ExcelArray& values,
+        int matchType,
+        row_t& nRows,
+        col_t& nCols)
+      {
+        vector<row_t> rows;
+        const auto nKeys = index.nKeys();
+        if (nKeys == 1)
+        {
+          nRows = values.nRows();
+          nCols = values.nCols();
+          rows.reserve(values.size());
+          for (row_t i = 0; i < nRows; ++i)
+            for (auto p = values.row_begin(i); p != values.row_end(i); ++p)
+              rows.push_back(matchType == 0 ? index.find(p) : index.findNearest(p, matchType));
+        }
+        else
+        {
+          if (values.nCols() != nKeys)
+            XLO_THROW("Lookup values must have one column for each of the {0} keys", nKeys);
+          nRows = values.nRows();
+          nCols = 1;
+          rows.reserve(nRows);
+          for (row_t i = 0; i < nRows; ++i)
+          {
+            auto p = values.row_begin(i);
+            rows.push_back(matchType == 0 ? index.find(p) : index.findNearest(p, matchType));
+          }
+        }
+        return rows;
+      }
+
+      int matchTypeArg(const ExcelObj& arg)
+      {
+        const auto matchType = arg.get<int>(0);
+        return matchType > 0 ? 1 : (matchType < 0 ? -1 : 0);
+      }
+    }
+
+    XLO_FUNC_START(
+      xloIndexBuild(
+        const ExcelObj& arrayOrRef,
+        const ExcelObj& keyCols,
+        const ExcelObj& sorted,
+        const ExcelObj& headings
+      )
+    )
+    {
+      const auto& data = cacheCheck(arrayOrRef);
+      ExcelArray array(data);
+
+      // Like xloSort, naming a key column implies the array has headings
+      const auto hasHeadings = headings.isMissing()
+        ? anyHeadings(keyCols)
+        : headings.get<bool>();
+
+      auto cols = parseColumns(array, keyCols, hasHeadings);
+      return returnValue(indexAdd(std::make_unique<LookupIndex>(
+        data, std::move(cols), hasHeadings, sorted.get<bool>(false))));
+    }
+    XLO_FUNC_END(xloIndexBuild).threadsafe()
+      .help(L"Copies an array and builds a hash index on one or more key columns, returning "
+            L"a reference for use with xloLookup and xloMatch. Keys match as in Excel: "
+            L"strings are case-insensitive")
+      .arg(L"ArrayOrRef", L"A range/array or an xlOil ref")
+      .optArg(L"KeyCols", L"Column number (1-based) or heading, or an array of these for "
+                          L"a multi-column key. Defaults to the first column")
+      .optArg(L"Sorted", L"If TRUE, also builds a sorted index to allow approximate "
+                         L"matches. Defaults to FALSE")
+      .optArg(L"Headings", L"If TRUE, the first row contains headings and is not indexed. "
+                           L"Defaults to TRUE if any key column is a heading");
+
+    XLO_FUNC_START(
+      xloLookup(
+        const ExcelObj& indexRef,
+        const ExcelObj& value,
+        const ExcelObj& returnCol,
+        const ExcelObj& matchType
+      )
+    )
+    {
+      const auto& index = fetchIndex(indexRef);
+      const auto& data = index.data();
+      ExcelArray values(cacheCheck(value), false);
+
+      row_t nRows;
+      col_t nCols;
+      const auto rows = findRows(index, values, matchTypeArg(matchType), nRows, nCols);
+
+      // If no column is given, return the whole row for each lookup
+      const auto wholeRow = returnCol.isMissing();
+      const auto column = wholeRow ? 0 : index.column(returnCol);
+      if (wholeRow)
+      {
+        nRows = (row_t)rows.size();
+        nCols = data.nCols();
+      }
+
+      if (nRows * nCols == 1)
+      {
+        return rows[0] == LookupIndex::NOT_FOUND
+          ? returnValue(CellError::NA)
+          : returnValue(data(rows[0], column));
+      }
+
+      size_t strLen = 0;
+      for (auto row : rows)
+        if (row != LookupIndex::NOT_FOUND)
+        {
+          if (wholeRow)
+            for (auto p = data.row_begin(row); p != data.row_end(row); ++p)
+              strLen += p->stringLength();
+          else
+            strLen += data.at(row, column).stringLength();
+        }
+
+      ExcelArrayBuilder builder(nRows, nCols, strLen);
+      if (wholeRow)
+      {
+        for (row_t i = 0; i < nRows; ++i)
+          for (col_t j = 0; j < nCols; ++j)
+            if (rows[i] == LookupIndex::NOT_FOUND)
+              builder(i, j) = CellError::NA;
+            else
+              builder(i, j) = data.at(rows[i], j);
+      }
+      else
+      {
+        auto row = rows.begin();
+        for (row_t i = 0; i < nRows; ++i)
+          for (col_t j = 0; j < nCols; ++j, ++row)
+            if (*row == LookupIndex::NOT_FOUND)
+              builder(i, j) = CellError::NA;
+            else
+              builder(i, j) = data.at(*row, column);
+      }
+      return returnValue(builder.toExcelObj());
+    }
+    XLO_FUNC_END(xloLookup).threadsafe()
+      .help(L"Looks up values in an index created by xloIndexBuild, returning the value in "
+            L"the specified column, or the entire row, of the first matching row. "
+            L"Returns #N/A if there is no match")
+      .arg(L"Index", L"A reference returned by xloIndexBuild")
+      .arg(L"Value", L"Key value or array of values to find. For a multi-column key, "
+                     L"each row should contain the key values")
+      .optArg(L"ReturnCol", L"Column number (1-based) or heading of the value to return. If "
+                            L"omitted, returns the entire matching row")
+      .optArg(L"MatchType", L"0 (default) for an exact match, 1 for the largest key less than "
+                            L"or equal to the value, -1 for the smallest key greater than or "
+                            L"equal to the value. Non-zero values require a sorted index");
+
+    XLO_FUNC_START(
+      xloMatch(
+        const ExcelObj& indexRef,
+        const ExcelObj& value,
+        const ExcelObj& matchType
+      )
+    )
+    {
+      const auto& index = fetchIndex(indexRef);
+      ExcelArray values(cacheCheck(value), false);
+
+      row_t nRows;
+      col_t nCols;
+      const auto rows = findRows(index, values, matchTypeArg(matchType), nRows, nCols);
+
+      if (nRows * nCols == 1)
+      {
+        return rows[0] == LookupIndex::NOT_FOUND
+          ? returnValue(CellError::NA)
+          : returnValue(int(rows[0] + 1));
+      }
+
+      ExcelArrayBuilder builder(nRows, nCols);
+      auto row = rows.begin();
+      for (row_t i = 0; i < nRows; ++i)
+        for (col_t j = 0; j < nCols; ++j, ++row)
+          if (*row == LookupIndex::NOT_FOUND)
+            builder(i, j) = CellError::NA;
+          else
+            builder(i, j) = int(*row + 1);
+      return returnValue(builder.toExcelObj());
+    }
+    XLO_FUNC_END(xloMatch).threadsafe()
+      .help(L"Returns the 1-based row number, not counting any headings, of the first row "
+            L"matching each value in an index created by xloIndexBuild, or #N/A if there "
+            L"is no match")
+      .arg(L"Index", L"A reference returned by xloIndexBuild")
+      .arg(L"Value", L"Key value or array of values to find. For a multi-column key, "
+                     L"each row should contain the key values")
+      .optArg(L"MatchType", L"0 (default) for an exact match, 1 for the largest key less than "
+                            L"or equal to the value, -1 for the smallest key greater than or "
+                            L"equal to the value. Non-zero values require a sorted index");
+  }
+}
@@ -4,6 +4,7 @@
 #include <xloil/StaticRegister.h>
 #include <xlOil/Preprocessor.h>
 #include <xloil/ExcelObjCache.h>
+#include <xloil/ColumnKeys.h>
 #include <algorithm>
 #include <numeric>
 #include <array>
@@ -26,33 +27,26 @@ namespace xloil
 
     using MyArray = array<ExcelArray::col_t, XLOSORT_NARGS + 1>;
 
-    // TOOD: template<int N>
     struct LessThan
     {
-      LessThan(const ExcelArray& data, const MyArray& directions, const MyArray& columns)
-        : _data(data)
-        , _directions(directions)
-        , _columns(columns)
+      // Sort keys are prepared once for each column so the comparisons
+      // avoid dispatching on type and collating strings
+      LessThan(const MyArray& directions, const vector<ColumnKeys>& keys)
+        : _directions(directions)
+        , _keys(keys)
       {}
       bool operator()(const ExcelObj::row_t left, const ExcelObj::row_t right)
       {
-        ExcelObj::row_t i = 0;
-        while (_directions[i] != StopSearch)
+        for (size_t i = 0; i < _keys.size(); ++i)
         {
-          bool cased = _directions[i] & CaseSensitive;
-          auto cmp = ExcelObj::compare(
-            _data.at(left, _columns[i]), 
-            _data.at(right, _columns[i]), 
-            cased);
+          auto cmp = _keys[i].compare(left, right);
           if (cmp != 0)
             return (_directions[i] & Descending) == 0 ? cmp < 0 : cmp > 0;
-          ++i;
         }
         return false;
       }
       const MyArray& _directions;
-      const MyArray& _columns;
-      const ExcelArray& _data;
+      const vector<ColumnKeys>& _keys;
     };
 
     void swapmem(size_t* a, size_t* b, size_t nBytes)
@@ -95,7 +89,8 @@ namespace xloil
     // could use raw pascal str, but that's an unnecessary optimisation
     auto orderStr = order->get<std::wstring>(); 
 
-    MyArray directions, columns;
+    // Zero initialise so that the default single ascending order is defined
+    MyArray directions{}, columns;
 
     // Default sort order is left to right on columns
     std::iota(columns.begin(), columns.end(), 0);
@@ -170,8 +165,13 @@ namespace xloil
     vector<row_t> indices(nRows);
     std::iota(indices.begin(), indices.end(), 0);
 
+    vector<ColumnKeys> keys;
+    keys.reserve(nOrders);
+    for (size_t i = 0; i < nOrders; ++i)
+      keys.emplace_back(arr, columns[i], (directions[i] & CaseSensitive) != 0);
+
     std::sort(indices.begin() + (hasHeadings ? 1 : 0), indices.end(),
-      LessThan(arr, directions, columns));
+      LessThan(directions, keys));
 
 
     if (inplace)
@@ -146,6 +146,12 @@ namespace xloil
     return COM::variantToExcelObj(com().Cells->Item[i + 1][j + 1]);
   }
 
+  ExcelObj ExcelRange::value(int fromRow, int fromCol, int toRow, int toCol) const
+  {
+    std::unique_ptr<Range> block(range(fromRow, fromCol, toRow, toCol));
+    return block->value();
+  }
+
   void ExcelRange::set(const ExcelObj& value)
   {
     try
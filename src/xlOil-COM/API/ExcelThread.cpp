@@ -3,22 +3,17 @@
 #include <xlOil-COM/XllContextInvoke.h>
 #include <xlOil-COM/Connect.h>
 #include <xlOil-COM/ComVariant.h>
+#include <xlOil-COM/MainThreadQueue.h>
 #include <xloil/Log.h>
 #include <xloil/AppObjects.h>
 #include <xloil/Throw.h>
 #include <xloil/State.h>
 #include <xloil/ExcelUI.h>
 #include <functional>
-#include <queue>
-#include <mutex>
+#include <optional>
 #include <future>
 #include <comdef.h>
 
-using std::scoped_lock;
-using std::shared_ptr;
-using std::make_shared;
-using std::vector;
-
 namespace xloil
 {
   namespace
@@ -60,95 +55,61 @@ namespace xloil
         return *_theInstance;
       }
 
-      struct QueueItem
+      /// <summary>
+      /// Runs a queued function, returning false if it should be retried
+      /// because the COM or XLL interface is unavailable.
+      /// </summary>
+      template<class F>
+      static bool runJob(F& func, int flags, bool comAvailable, bool xllAvailable) noexcept
       {
-        std::function<void()> _func;
-        int _flags;
-        unsigned _waitTime;
-
-        QueueItem(
-          const std::function<void()>& func,
-          int flags,
-          unsigned waitTime)
-          : _func(func)
-          , _flags(flags)
-          , _waitTime(waitTime)
-        {}
-
-        bool useCOM() const noexcept
+        const auto useCOM = (flags & ExcelRunQueue::COM_API) != 0;
+        const auto useXLL = (flags & ExcelRunQueue::XLL_API) != 0;
+        if (useCOM && !comAvailable)
+          return false;
+        if (useXLL && !(xllAvailable || comAvailable))
+          return false;
+        // Tasks from runExcelThread pass errors to their promise, so the only errors
+        // we catch should come from runInXllContext.
+        try
         {
-          return (_flags & ExcelRunQueue::COM_API) != 0;
+          if (useXLL)
+            runInXllContext([&func]() { func(); });
+          else
+            func();
         }
-        bool useXLL() const noexcept
+        catch (const xloil::ComBusyException&)
         {
-          return (_flags & ExcelRunQueue::XLL_API) != 0;
+          // Even though we previously called the COM interface, it can still
+          // become 'busy' later
+          return false;
         }
-        bool operator()(bool comAvailable, bool xllAvailable) noexcept
+        catch (const std::exception& e)
         {
-          if (useCOM() && !comAvailable)
-            return false;
-          if (useXLL() && !(xllAvailable || comAvailable))
-            return false;
-          // The _func should be a packaged task which is noexcept, so the only errors we catch
-          // should come from runInXllContext.
-          try
-          {
-            if (useXLL())
-              runInXllContext(_func);
-            else
-              _func();
-          }
-          catch (const xloil::ComBusyException&)
-          {
-            // Even though we previously called the COM interface, it can still
-            // become 'busy' later
-            return false;
-          }
-          catch (const std::exception& e)
-          {
-            XLO_ERROR("Error running on main thread: {}", e.what());
-          }
-          catch (...)
-          {
-            XLO_ERROR("Error running on main thread: unknown");
-          }
-          return true;
+          XLO_ERROR("Error running on main thread: {}", e.what());
+        }
+        catch (...)
+        {
+          XLO_ERROR("Error running on main thread: unknown");
         }
-      };
+        return true;
+      }
 
       // Entirely arbitrary ID numbers
       static constexpr unsigned IDT_TIMER1 = 101;
       static constexpr unsigned WINDOW_MESSAGE = 666;
       static constexpr unsigned WM_TIMER = 0x0113;
 
-      auto firstJobTime(ULONGLONG now)
-      {
-        // The queue is a sorted map so first element is due first.
-        return _timerQueue.begin()->first > now
-          ? unsigned(_timerQueue.begin()->first - now)
-          : 0;
-      }
-
-      void startTimer(unsigned millisecs)
-      {
-        if (millisecs == 0)
-          PostMessage(_hiddenWindow, WINDOW_MESSAGE, 0, 0);
-        else
-          SetTimer(_hiddenWindow, IDT_TIMER1, millisecs, TimerCallback);
-      }
-
-      void enqueue(const shared_ptr<QueueItem>& item, unsigned millisecs) noexcept
+      void enqueue(
+        QueueTask&& task, 
+        int flags, 
+        unsigned waitBeforeCall, 
+        unsigned waitBetweenRetries) noexcept
       {
         try
         {
-          ULONGLONG now = GetTickCount64();
-          {
-            scoped_lock lock(_lock);
-            _timerQueue.emplace(now + millisecs, item);
-            if (millisecs > 0)
-              millisecs = firstJobTime(now);
-          }
-          startTimer(millisecs);
+          // Delayed items also go via the main thread, which owns the timer
+          if (_queue.push(std::move(task), flags, waitBeforeCall, waitBetweenRetries, GetTickCount64()))
+            PostMessage(_hiddenWindow, WINDOW_MESSAGE, 0, 0);
         }
         catch (const std::exception& e)
         {
@@ -160,58 +121,25 @@ namespace xloil
         }
       }
 
+      ExcelRunQueue::Stats stats() const noexcept
+      {
+        return _queue.stats();
+      }
+
     private:
-      static void CALLBACK TimerCallback(
-        HWND /*hwnd*/, UINT /*uMsg*/, UINT_PTR /*idEvent*/, DWORD /*dwTime*/) noexcept
+      void processQueue() noexcept
       {
         try
         {
-          auto& self = instance();
-          auto now = GetTickCount64();
-          vector<shared_ptr<QueueItem>> items;
-          {
-            scoped_lock lock(self._lock);
-            auto i = self._timerQueue.begin();
-            auto end = self._timerQueue.end();
-            // Find all the queue items with a due time before now and copy them
-            // to our pending vector.
-            while (i != end && i->first <= now) {
-              items.push_back(i->second);
-              ++i;
-            }
-            // Erase all the items copied to the pending vector
-            self._timerQueue.erase(self._timerQueue.begin(), i);
-          }
-
-          // Nothing to do, then exit
-          if (items.empty())
-            return;
-
-          // We have released mutex, now run pending queue items
-          const auto comAvailable = COM::isComApiAvailable();
-          const auto xllAvailable = InXllContext::check();
-
-          items.erase(std::remove_if(items.begin(), items.end(),
-            [=](auto& pJob)
+          // Only check COM and XLL availability if there is something to run
+          std::optional<std::pair<bool, bool>> available;
+          _queue.run(GetTickCount64(), [&](MainThreadQueue::Job& job)
           {
-            return (*pJob)(comAvailable, xllAvailable);
-          }), items.end());
-
-          // Any remaining items failed due to COM/XLL availability
-          // so are requeued.
-          if (!items.empty())
-          {
-            now = GetTickCount64();
-            unsigned startTime;
-            {
-              scoped_lock lock(self._lock);
-              for (auto& item : items)
-                if ((item->_flags & ExcelRunQueue::NO_RETRY) == 0)
-                  self._timerQueue.emplace(now + item->_waitTime, item);
-              startTime = self.firstJobTime(now);
-            }
-            self.startTimer(startTime);
-          }
+            if (!available)
+              available.emplace(COM::isComApiAvailable(), InXllContext::check());
+            return runJob(job.task, job.flags, available->first, available->second);
+          });
+          setTimer();
         }
         catch (const std::exception& e)
         {
@@ -223,6 +151,41 @@ namespace xloil
         }
       }
 
+      /// <summary>
+      /// Points the timer at the next delayed item or retry, or stops it
+      /// if there are none.
+      /// </summary>
+      void setTimer()
+      {
+        const auto due = _queue.nextDue();
+        if (!due)
+        {
+          if (_timerDue != 0)
+            KillTimer(_hiddenWindow, IDT_TIMER1);
+          _timerDue = 0;
+          return;
+        }
+        if (*due == _timerDue)
+          return;
+        const auto now = GetTickCount64();
+        const auto wait = *due > now
+          ? (UINT)std::min<ULONGLONG>(*due - now, USER_TIMER_MAXIMUM)
+          : USER_TIMER_MINIMUM;
+        SetTimer(_hiddenWindow, IDT_TIMER1, wait, TimerCallback);
+        _timerDue = *due;
+      }
+
+      static void CALLBACK TimerCallback(
+        HWND /*hwnd*/, UINT uMsg, UINT_PTR /*idEvent*/, DWORD /*dwTime*/) noexcept
+      {
+        auto& self = instance();
+        // The timer may fire slightly before the due time, so ensure
+        // setTimer rearms it 
+        if (uMsg == WM_TIMER)
+          self._timerDue = TIMER_FIRED;
+        self.processQueue();
+      }
+
       static LRESULT CALLBACK WindowProc(
         HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) noexcept
       {
@@ -239,8 +202,12 @@ namespace xloil
         }
       }
 
-      std::multimap<ULONGLONG, shared_ptr<QueueItem>> _timerQueue;
-      std::mutex _lock;
+      MainThreadQueue _queue;
+      /// <summary>
+      /// Time the timer is set to fire, zero if not set. Main thread only.
+      /// </summary>
+      ULONGLONG _timerDue = 0;
+      static constexpr ULONGLONG TIMER_FIRED = ~0ull;
 
       HWND _hiddenWindow;
       HANDLE _threadHandle;
@@ -260,15 +227,11 @@ namespace xloil
   }
 
   void runExcelThreadImpl(
-    std::function<void()>&& func,
+    QueueTask&& func,
     int flags, 
     unsigned waitBeforeCall,
     unsigned waitBetweenRetries)
   {
-    auto queueItem = make_shared<Messenger::QueueItem>(func,
-      flags,
-      waitBetweenRetries);
-
     // Try to run immediately if possible
     const bool canRunNow = waitBeforeCall == 0 
       && (flags & ExcelRunQueue::ENQUEUE) == 0 
@@ -279,11 +242,21 @@ namespace xloil
       // Generally functions scheduled for the main thread do need the COM or XLL interface
       const auto comAvailable = COM::isComApiAvailable();
       const auto xllAvailable = InXllContext::check();
-      if ((*queueItem)(comAvailable, xllAvailable))
+      if (Messenger::runJob(func, flags, comAvailable, xllAvailable))
         return;
     }
 
-    Messenger::instance().enqueue(queueItem, waitBeforeCall);
+    Messenger::instance().enqueue(std::move(func), flags, waitBeforeCall, waitBetweenRetries);
+  }
+
+  namespace ExcelRunQueue
+  {
+    Stats stats()
+    {
+      return Messenger::_theInstance 
+        ? Messenger::instance().stats() 
+        : Stats{};
+    }
   }
 
   struct RetryAtStartup
@@ -0,0 +1,615 @@
+#pragma once
+#include <xloil/ExcelThread.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
+namespace xloil
+{
+  namespace detail
+  {
+    /// <summary>
+    /// Index of the lowest set bit; x must be non-zero
+    /// </summary>
+    inline unsigned lowestBit(uint64_t x) noexcept
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+      unsigned long index;
+      _BitScanForward64(&index, x);
+      return (unsigned)index;
+#elif defined(_MSC_VER)
+      unsigned long index;
+      if (_BitScanForward(&index, (unsigned long)x))
+        return (unsigned)index;
+      _BitScanForward(&index, (unsigned long)(x >> 32));
+      return (unsigned)index + 32;
+#else
+      return (unsigned)__builtin_ctzll(x);
+#endif
+    }
+
+    template<class TNode>
+    struct IntrusiveList
+    {
+      TNode* head = nullptr;
+      TNode* tail = nullptr;
+
+      bool empty() const noexcept { return !head; }
+
+      void push(TNode* node) noexcept
+      {
+        node->next = nullptr;
+        if (tail)
+          tail->next = node;
+        else
+          head = node;
+        tail = node;
+      }
+
+      TNode* pop() noexcept
+      {
+        auto node = head;
+        if (node)
+        {
+          head = node->next;
+          if (!head)
+            tail = nullptr;
+        }
+        return node;
+      }
+
+      /// <summary>
+      /// Empties the list, returning the first node. The remainder can be
+      /// found by following the next pointers.
+      /// </summary>
+      TNode* take() noexcept
+      {
+        auto node = head;
+        head = tail = nullptr;
+        return node;
+      }
+    };
+  }
+
+  /// <summary>
+  /// A hierarchical timer wheel holding intrusive nodes which have members
+  /// <c>TNode* next</c> and <c>uint64_t due</c>, a time in ticks (we use
+  /// milliseconds). There are four levels of 64 slots: level 0 has one slot
+  /// per tick and each higher level has slots 64 times wider, so the wheel
+  /// spans 2^24 ticks (about 4.6 hours) with anything further out held in
+  /// an overflow list. A node is placed at the level of the highest 6-bit
+  /// group in which its due time differs from the current time and moves
+  /// down a level when time reaches the start of its slot.
+  ///
+  /// Insertion and expiry are O(1). Each level keeps a bitmap of occupied
+  /// slots, so advancing over an empty stretch of time jumps directly to
+  /// the next occupied slot rather than visiting every tick. Not thread-safe.
+  /// </summary>
+  template<class TNode>
+  class TimerWheel
+  {
+  public:
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr unsigned SLOTS = 1u << SLOT_BITS;
+    static constexpr unsigned LEVELS = 4;
+
+    explicit TimerWheel(uint64_t now = 0) noexcept
+      : _now(now)
+    {}
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    uint64_t now() const noexcept { return _now; }
+    size_t size() const noexcept { return _size; }
+    bool empty() const noexcept { return _size == 0; }
+
+    /// <summary>
+    /// Adds a node, which the wheel does not own. A node which is already
+    /// due expires on the next call to <see cref="advance"/>.
+    /// </summary>
+    void insert(TNode* node) noexcept
+    {
+      place(node);
+      ++_size;
+    }
+
+    /// <summary>
+    /// Moves the current time forward, calling <c>expire(TNode*)</c> for each
+    /// node which becomes due in order of due time. Nodes with the same due
+    /// time expire in the order they were inserted.
+    /// </summary>
+    template<class F>
+    void advance(uint64_t now, F&& expire)
+    {
+      releaseExpired(expire);
+      while (_now < now)
+      {
+        const auto next = nextEvent();
+        if (next > now)
+        {
+          _now = now;
+          break;
+        }
+        _now = next;
+
+        if ((_now & (SPAN - 1)) == 0)
+        {
+          auto node = _overflow.take();
+          while (node)
+          {
+            auto following = node->next;
+            place(node);
+            node = following;
+          }
+        }
+        // Move nodes down from each level whose slot starts at this tick,
+        // highest first as nodes may cascade through several levels
+        for (auto level = LEVELS - 1; level > 0; --level)
+        {
+          const auto shift = level * SLOT_BITS;
+          if ((_now & ((uint64_t(1) << shift) - 1)) == 0)
+            cascade(level, (_now >> shift) & (SLOTS - 1));
+        }
+        cascade(0, _now & (SLOTS - 1));
+        releaseExpired(expire);
+      }
+    }
+
+    /// <summary>
+    /// Returns the earliest due time of any node, or nothing if the wheel
+    /// is empty.
+    /// </summary>
+    std::optional<uint64_t> nextDue() const noexcept
+    {
+      if (!_expired.empty())
+        return _now;
+      if (_size == 0)
+        return std::nullopt;
+      // The earliest node is in the first occupied slot of the lowest level 
+      // which has one, but not necessarily at its start
+      for (unsigned level = 0; level < LEVELS; ++level)
+      {
+        const auto ahead = slotsAhead(level);
+        if (ahead)
+        {
+          auto earliest = UINT64_MAX;
+          for (auto node = _slots[level][detail::lowestBit(ahead)].head; node; node = node->next)
+            earliest = std::min(earliest, node->due);
+          return earliest;
+        }
+      }
+      auto earliest = UINT64_MAX;
+      for (auto node = _overflow.head; node; node = node->next)
+        earliest = std::min(earliest, node->due);
+      return earliest;
+    }
+
+    /// <summary>
+    /// Removes all nodes, passing each to the given function
+    /// </summary>
+    template<class F>
+    void clear(F&& release)
+    {
+      auto drain = [&](detail::IntrusiveList<TNode>& list)
+      {
+        auto node = list.take();
+        while (node)
+        {
+          auto following = node->next;
+          release(node);
+          node = following;
+        }
+      };
+      for (auto& level : _slots)
+        for (auto& slot : level)
+          drain(slot);
+      drain(_overflow);
+      drain(_expired);
+      std::fill(std::begin(_occupied), std::end(_occupied), 0);
+      _size = 0;
+    }
+
+  private:
+    static constexpr uint64_t SPAN = uint64_t(1) << (LEVELS * SLOT_BITS);
+
+    void place(TNode* node) noexcept
+    {
+      if (node->due <= _now)
+      {
+        _expired.push(node);
+        return;
+      }
+      const auto diff = node->due ^ _now;
+      unsigned level = 0;
+      while (level < LEVELS && (diff >> ((level + 1) * SLOT_BITS)) != 0)
+        ++level;
+      if (level == LEVELS)
+      {
+        _overflow.push(node);
+        return;
+      }
+      const auto slot = (node->due >> (level * SLOT_BITS)) & (SLOTS - 1);
+      _slots[level][slot].push(node);
+      _occupied[level] |= uint64_t(1) << slot;
+    }
+
+    void cascade(unsigned level, uint64_t slot) noexcept
+    {
+      const auto bit = uint64_t(1) << slot;
+      if ((_occupied[level] & bit) == 0)
+        return;
+      _occupied[level] &= ~bit;
+      auto node = _slots[level][slot].take();
+      while (node)
+      {
+        auto following = node->next;
+        place(node);
+        node = following;
+      }
+    }
+
+    template<class F>
+    void releaseExpired(F& expire)
+    {
+      auto node = _expired.take();
+      while (node)
+      {
+        auto following = node->next;
+        --_size;
+        expire(node);
+        node = following;
+      }
+    }
+
+    /// <summary>
+    /// Bitmap of occupied slots at a level which are ahead of the current
+    /// position in its rotation. A node is always placed ahead of the current 
+    /// position, so this is all of them.
+    /// </summary>
+    uint64_t slotsAhead(unsigned level) const noexcept
+    {
+      const auto pos = (unsigned)((_now >> (level * SLOT_BITS)) & (SLOTS - 1));
+      return pos == SLOTS - 1 ? 0 : _occupied[level] & (~uint64_t(0) << (pos + 1));
+    }
+
+    /// <summary>
+    /// The next tick at which a slot needs processing. A lower level's 
+    /// slots all start before the next higher level slot, so the answer 
+    /// is in the lowest level with an occupied slot.
+    /// </summary>
+    uint64_t nextEvent() const noexcept
+    {
+      for (unsigned level = 0; level < LEVELS; ++level)
+      {
+        const auto ahead = slotsAhead(level);
+        if (ahead)
+        {
+          const auto shift = level * SLOT_BITS;
+          const auto rotation = (_now >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+          return rotation + (uint64_t(detail::lowestBit(ahead)) << shift);
+        }
+      }
+      if (!_overflow.empty())
+        return ((_now / SPAN) + 1) * SPAN;
+      return UINT64_MAX;
+    }
+
+    uint64_t _now;
+    size_t _size = 0;
+    uint64_t _occupied[LEVELS] = {};
+    detail::IntrusiveList<TNode> _slots[LEVELS][SLOTS];
+    detail::IntrusiveList<TNode> _overflow;
+    detail::IntrusiveList<TNode> _expired;
+  };
+
+  /// <summary>
+  /// The scheduling part of the main thread queue, kept separate from the
+  /// hidden window and timer which drive it so it can be tested on its own.
+  ///
+  /// Any thread may <see cref="push"/> a job: it goes on a lock-free stack.
+  /// The consumer, i.e. the main thread, calls <see cref="run"/> which takes
+  /// the whole stack in one exchange, puts delayed jobs in a
+  /// <see cref="TimerWheel"/> and runs due jobs in priority order. Only
+  /// the consumer touches the wheel, so it needs no lock. Jobs which could
+  /// not run are put back in the wheel to retry, without reallocating.
+  /// Finished nodes are kept in a pool for later pushes, so once the queue
+  /// is warm a push does not allocate unless the task is too large to be
+  /// held inline.
+  ///
+  /// Times are in milliseconds from any clock, supplied by the caller.
+  /// </summary>
+  class MainThreadQueue
+  {
+  public:
+    enum Lane { HIGH, NORMAL, LOW };
+    static constexpr size_t NUM_LANES = 3;
+
+    struct Job
+    {
+      QueueTask task;
+      int flags = 0;
+      unsigned retryWait = 0;
+    };
+
+    MainThreadQueue() = default;
+    MainThreadQueue(const MainThreadQueue&) = delete;
+    MainThreadQueue& operator=(const MainThreadQueue&) = delete;
+
+    ~MainThreadQueue()
+    {
+      auto node = _incoming.exchange(nullptr);
+      while (node)
+      {
+        auto following = node->next;
+        delete node;
+        node = following;
+      }
+      for (auto& lane : _ready)
+        while (auto ready = lane.pop())
+          delete ready;
+      _wheel.clear([](Node* n) { delete n; });
+      while (_pool)
+      {
+        auto following = _pool->next;
+        delete _pool;
+        _pool = following;
+      }
+    }
+
+    static Lane laneFor(int flags) noexcept
+    {
+      if (flags & ExcelRunQueue::HIGH_PRIORITY)
+        return HIGH;
+      if (flags & ExcelRunQueue::LOW_PRIORITY)
+        return LOW;
+      return NORMAL;
+    }
+
+    /// <summary>
+    /// Adds a job which is due <paramref name="delay"/> ms after
+    /// <paramref name="now"/>. Thread-safe. Returns true if the consumer
+    /// should be woken to call <see cref="run"/>, which is the case for
+    /// the first push after each run.
+    /// </summary>
+    bool push(QueueTask&& task, int flags, unsigned delay, unsigned retryWait, uint64_t now)
+    {
+      auto node = acquireNode();
+      node->job.task = std::move(task);
+      node->job.flags = flags;
+      node->job.retryWait = retryWait;
+      node->due = node->firstDue = now + delay;
+      node->lane = laneFor(flags);
+      _queued.fetch_add(1, std::memory_order_relaxed);
+
+      auto head = _incoming.load(std::memory_order_relaxed);
+      do
+        node->next = head;
+      while (!_incoming.compare_exchange_weak(head, node));
+
+      return !_wakePending.exchange(true);
+    }
+
+    /// <summary>
+    /// Runs all jobs due at <paramref name="now"/>, high priority first.
+    /// <c>runJob(Job&)</c> should return false if the job could not run,
+    /// in which case it is retried after its retry wait unless it has the
+    /// NO_RETRY flag. Jobs pushed while running are left for the next call.
+    /// Returns the number of jobs run. Consumer only.
+    /// </summary>
+    template<class F>
+    size_t run(uint64_t now, F&& runJob)
+    {
+      // Clear the flag before taking the stack, so any later push wakes us
+      _wakePending.store(false);
+      auto incoming = _incoming.exchange(nullptr);
+
+      // Delayed jobs and retries go first as they were queued earlier
+      _wheel.advance(now, [this](Node* node) { _ready[node->lane].push(node); });
+
+      // The stack has the newest job first, so reverse it
+      Node* ordered = nullptr;
+      while (incoming)
+      {
+        auto following = incoming->next;
+        incoming->next = ordered;
+        ordered = incoming;
+        incoming = following;
+      }
+      while (ordered)
+      {
+        auto following = ordered->next;
+        if (ordered->due <= now)
+          _ready[ordered->lane].push(ordered);
+        else
+          _wheel.insert(ordered);
+        ordered = following;
+      }
+
+      const auto currentDepth = depth();
+      if (currentDepth > _maxDepth.load(std::memory_order_relaxed))
+        _maxDepth.store(currentDepth, std::memory_order_relaxed);
+
+      size_t nRun = 0;
+      for (size_t lane = 0; lane < NUM_LANES; ++lane)
+      {
+        while (auto ready = _ready[lane].pop())
+        {
+          std::unique_ptr<Node, Recycle> node(ready, Recycle{ this });
+          if (runJob(node->job))
+          {
+            recordRun(lane, now > node->firstDue ? now - node->firstDue : 0);
+            ++nRun;
+          }
+          else if (node->job.flags & ExcelRunQueue::NO_RETRY)
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+          else
+          {
+            _retried.fetch_add(1, std::memory_order_relaxed);
+            node->due = now + node->job.retryWait;
+            _wheel.insert(node.release());
+          }
+        }
+      }
+      return nRun;
+    }
+
+    /// <summary>
+    /// Returns when <see cref="run"/> should next be called for delayed
+    /// jobs or retries, or nothing if there are none. Consumer only.
+    /// </summary>
+    std::optional<uint64_t> nextDue() const noexcept
+    {
+      return _wheel.nextDue();
+    }
+
+    /// <summary>
+    /// The number of job nodes allocated since construction, which stops
+    /// growing once the pool covers the peak depth. Thread-safe.
+    /// </summary>
+    uint64_t nodesAllocated() const noexcept
+    {
+      return _allocated.load(std::memory_order_relaxed);
+    }
+
+    /// <summary>
+    /// The number of jobs pushed but not yet run or dropped. Thread-safe.
+    /// </summary>
+    uint64_t depth() const noexcept
+    {
+      // Read the finished count first: every finished job was counted in
+      // _queued before it could finish
+      const auto finished = _dropped.load() + totalRun();
+      const auto queued = _queued.load();
+      return queued > finished ? queued - finished : 0;
+    }
+
+    /// <summary>
+    /// Thread-safe
+    /// </summary>
+    ExcelRunQueue::Stats stats() const noexcept
+    {
+      ExcelRunQueue::Stats result;
+      result.queued = _queued.load(std::memory_order_relaxed);
+      result.retried = _retried.load(std::memory_order_relaxed);
+      result.depth = depth();
+      result.maxDepth = std::max(result.depth, _maxDepth.load(std::memory_order_relaxed));
+      for (size_t i = 0; i < NUM_LANES; ++i)
+      {
+        auto& lane = result.lanes[i];
+        lane.run = _lanes[i].run.load(std::memory_order_relaxed);
+        lane.meanWaitMs = lane.run == 0 ? 0.0
+          : (double)_lanes[i].totalWait.load(std::memory_order_relaxed) / lane.run;
+        lane.maxWaitMs = _lanes[i].maxWait.load(std::memory_order_relaxed);
+      }
+      return result;
+    }
+
+  private:
+    struct Node
+    {
+      Node* next = nullptr;
+      Job job;
+      /// Time at which the job is next due to run
+      uint64_t due = 0;
+      /// Time at which the job was first due, for the wait time statistics
+      uint64_t firstDue = 0;
+      Lane lane = NORMAL;
+    };
+
+    /// The most finished nodes kept for reuse
+    static constexpr size_t MAX_POOL = 1024;
+
+    Node* acquireNode()
+    {
+      {
+        std::scoped_lock lock(_poolLock);
+        if (_pool)
+        {
+          auto node = _pool;
+          _pool = node->next;
+          --_poolSize;
+          return node;
+        }
+      }
+      _allocated.fetch_add(1, std::memory_order_relaxed);
+      return new Node();
+    }
+
+    /// <summary>
+    /// Destroys the node's task and returns it to the pool. Consumer only.
+    /// </summary>
+    void releaseNode(Node* node) noexcept
+    {
+      node->job.task.reset();
+      {
+        std::scoped_lock lock(_poolLock);
+        if (_poolSize < MAX_POOL)
+        {
+          node->next = _pool;
+          _pool = node;
+          ++_poolSize;
+          return;
+        }
+      }
+      delete node;
+    }
+
+    struct Recycle
+    {
+      MainThreadQueue* queue;
+      void operator()(Node* node) const noexcept { queue->releaseNode(node); }
+    };
+
+    /// Counters are only written by the consumer, but may be read by any thread
+    struct LaneCounters
+    {
+      std::atomic<uint64_t> run{ 0 };
+      std::atomic<uint64_t> totalWait{ 0 };
+      std::atomic<uint64_t> maxWait{ 0 };
+    };
+
+    void recordRun(size_t lane, uint64_t wait) noexcept
+    {
+      auto& counters = _lanes[lane];
+      counters.run.fetch_add(1, std::memory_order_relaxed);
+      counters.totalWait.fetch_add(wait, std::memory_order_relaxed);
+      if (wait > counters.maxWait.load(std::memory_order_relaxed))
+        counters.maxWait.store(wait, std::memory_order_relaxed);
+    }
+
+    uint64_t totalRun() const noexcept
+    {
+      uint64_t total = 0;
+      for (auto& lane : _lanes)
+        total += lane.run.load(std::memory_order_relaxed);
+      return total;
+    }
+
+    std::atomic<Node*> _incoming{ nullptr };
+    std::atomic<bool> _wakePending{ false };
+    TimerWheel<Node> _wheel;
+    detail::IntrusiveList<Node> _ready[NUM_LANES];
+
+    std::atomic<uint64_t> _queued{ 0 };
+    std::atomic<uint64_t> _retried{ 0 };
+    std::atomic<uint64_t> _dropped{ 0 };
+    std::atomic<uint64_t> _maxDepth{ 0 };
+    std::atomic<uint64_t> _allocated{ 0 };
+    LaneCounters _lanes[NUM_LANES];
+
+    std::mutex _poolLock;
+    Node* _pool = nullptr;
+    size_t _poolSize = 0;
+  };
+}
@@ -388,8 +388,7 @@ namespace xloil
         // It's OK to cast away half the sheetref ptr: it's likely the detail
         // is in the lower part and it doesn't matter if we have collisions
         // in the map since we check for explicit equality later.
-        const auto sheetId = (unsigned)(intptr_t)callExcel(
-          msxll::xlSheetId, caller.fullSheetName()).val.mref.idSheet;
+        const auto sheetId = (unsigned)(intptr_t)caller.sheetId();
 
         // Acquire the lock then check if the instance has been created
         unique_lock lock(theManagerMutex);
@@ -239,12 +239,14 @@ namespace xloil
       const LambdaSpec<TRet>* data,
       const ExcelObj** args) noexcept
     {
+      Profile::CallTimer timer(data->profileId);
       try
       {
         return data->function(*data->info(), args);
       }
       catch (const std::exception& e)
       {
+        timer.failed();
         if constexpr (std::is_same_v<TRet, ExcelObj*>)
           return returnValue(e);
         else
@@ -12,6 +12,7 @@
 #include <xloil/ExcelThread.h>
 #include <oleacc.h>
 #include <map>
+#include <atomic>
 
 using std::wstring;
 using std::map;
@@ -36,9 +37,15 @@ namespace xloil
   }
 
   LocalWorksheetFunc::LocalWorksheetFunc(
-    const std::shared_ptr<const WorksheetFuncSpec>& spec)
+    const std::shared_ptr<const WorksheetFuncSpec>& spec,
+    intptr_t registerId)
     : _spec(spec)
-  {}
+  {
+    // Use a counter rather than the spec address, which could be reused by
+    // a later spec while a kept id still refers to it
+    static std::atomic<intptr_t> nextId = 1;
+    _registerId = registerId != 0 ? registerId : nextId++;
+  }
 
   LocalWorksheetFunc::~LocalWorksheetFunc()
   {
@@ -54,7 +61,7 @@ namespace xloil
   }
   intptr_t LocalWorksheetFunc::registerId() const
   {
-    return (intptr_t)_spec.get();
+    return _registerId;
   }
 
   void registerLocalFuncs(
@@ -68,54 +75,79 @@ namespace xloil
     if (!append)
       existing.swap(toRemove);
 
-    auto rewriteVBAModule = !append;
-
-    vector<shared_ptr<const LocalWorksheetFunc>> toRegister;
+    vector<shared_ptr<const LocalWorksheetFunc>> toRegister, toWrite;
+    auto rewriteVBAModule = false;
 
     for (auto& func : funcs)
     {
-      toRegister.push_back(make_shared<LocalWorksheetFunc>(func));
-      auto found = existing.find(func->name());
-      if (found != existing.end())
+      if (append)
+      {
+        auto found = existing.find(func->name());
+        if (found != existing.end())
+          toRemove.insert(existing.extract(found));
+      }
+
+      auto previous = toRemove.find(func->name());
+      if (previous != toRemove.end() && *previous->second->info() == *func->info())
+      {
+        // The declaration is unchanged, so keep the id and the VBA stub which
+        // refers to it: we only need to point the id at the new spec
+        toRegister.push_back(make_shared<LocalWorksheetFunc>(func, previous->second->registerId()));
+        toRemove.erase(previous);
+      }
+      else
       {
-        rewriteVBAModule = true;
-        toRemove.insert(existing.extract(found));
+        toRegister.push_back(make_shared<LocalWorksheetFunc>(func));
+        toWrite.push_back(toRegister.back());
+        // A changed declaration cannot be edited in-place, so rewrite the module
+        if (previous != toRemove.end())
+          rewriteVBAModule = true;
       }
     }
 
-    const auto nNewFuncs = toRegister.size();
+    // Any remaining functions have been removed or, if not appending, the 
+    // module may contain stale stubs from a previous session, so we rewrite
+    // it unless nothing has changed.
+    if (!toRemove.empty() || (!append && !toWrite.empty()))
+      rewriteVBAModule = true;
+
+    for (auto& f : toRegister)
+      existing.insert_or_assign(f->info()->name, f);
 
     if (rewriteVBAModule)
     {
+      toWrite.clear();
       for (auto& f : existing)
-        toRegister.push_back(f.second);
+        toWrite.push_back(f.second);
     }
-    
-    const auto iNewFuncsEnd = toRegister.begin() + nNewFuncs;
-    for (auto i = toRegister.begin(); i != iNewFuncsEnd; ++i)
-      existing.emplace(i->get()->info()->name, *i);
+
+    XLO_DEBUG(L"Registering {0} local functions in '{1}', writing {2} VBA stubs", 
+      toRegister.size(), workbookName, toWrite.size());
 
     vector<shared_ptr<const FuncInfo>> funcInfos;
-    for (auto& f : toRegister)
+    for (auto& f : toWrite)
       funcInfos.emplace_back(f->info());
 
     runExcelThread([
-        append, 
+        appendVBA = !rewriteVBAModule,
         workbookName = wstring(workbookName), 
-        newRegisteredFuncs = move(toRegister),
+        toRegister = move(toRegister),
+        toWrite = move(toWrite),
         toRemove = move(toRemove) 
     ]() mutable
     {
       unregisterLocalFuncs(toRemove);
-      COM::writeLocalFunctionsToVBA(workbookName.c_str(), newRegisteredFuncs, append);
-      for (auto& f : newRegisteredFuncs)
-        theRegistry2.emplace(f->registerId(), f->spec());
+      if (!toWrite.empty())
+        COM::writeLocalFunctionsToVBA(workbookName.c_str(), toWrite, appendVBA);
+      for (auto& f : toRegister)
+        theRegistry2.insert_or_assign(f->registerId(), f->spec());
     });
 
-    runExcelThread([funcInfos = std::move(funcInfos)]()
-    {
-      publishIntellisenseInfo(funcInfos);
-    }, ExcelRunQueue::XLL_API | ExcelRunQueue::ENQUEUE);
+    if (!funcInfos.empty())
+      runExcelThread([funcInfos = std::move(funcInfos)]()
+      {
+        publishIntellisenseInfo(funcInfos);
+      }, ExcelRunQueue::XLL_API | ExcelRunQueue::ENQUEUE);
   }
 
   void clearLocalFunctions(
@@ -7,7 +7,14 @@ namespace xloil
   class LocalWorksheetFunc
   {
   public:
-    LocalWorksheetFunc(const std::shared_ptr<const WorksheetFuncSpec>& spec);
+    /// <summary>
+    /// Creates a local function. The registerId is written into the VBA stub 
+    /// which calls the function, so passing the id of a function being 
+    /// replaced allows the stub to be kept. If zero, a new id is assigned.
+    /// </summary>
+    LocalWorksheetFunc(
+      const std::shared_ptr<const WorksheetFuncSpec>& spec, 
+      intptr_t registerId = 0);
 
     ~LocalWorksheetFunc();
 
@@ -18,6 +25,7 @@ namespace xloil
 
   private:
     std::shared_ptr<const WorksheetFuncSpec> _spec;
+    intptr_t _registerId;
   };
 
   void registerLocalFuncs(
@@ -1,12 +1,92 @@
 #include <xloil/ExcelObjCache.h>
 #include <xloil/ObjectCache.h>
 #include <xloil/ExcelObj.h>
+#include <xloil/ExcelObjBinary.h>
+#include <xloil/CacheSnapshot.h>
 #include <xloil/StaticRegister.h>
 
+using std::vector;
+using std::unique_ptr;
+
 namespace xloil
 {
   decltype(ObjectCacheFactory<std::unique_ptr<const ExcelObj>>::cache) 
     ObjectCacheFactory<std::unique_ptr<const ExcelObj>>::cache;
+
+  namespace
+  {
+    /// <summary>
+    /// Saves and restores the ExcelObj cache using the binary ExcelObj format
+    /// </summary>
+    class ExcelObjSnapshotHandler : public CacheSnapshot::Handler
+    {
+    public:
+      ExcelObjSnapshotHandler()
+      {
+        CacheSnapshot::addHandler(this);
+        cache().setMissHandler(&CacheSnapshot::restoreMissing);
+      }
+
+      ~ExcelObjSnapshotHandler()
+      {
+        CacheSnapshot::removeHandler(this);
+      }
+
+      wchar_t uniquifier() const override
+      {
+        return cache().uniquifier();
+      }
+
+      void save(const std::wstring_view& workbook, CacheSnapshot::Writer& writer) override
+      {
+        for (auto& [key, cellCache] : cache())
+        {
+          if (!CacheSnapshot::inWorkbook(key, workbook))
+            continue;
+          vector<vector<char>> blobs;
+          try
+          {
+            for (auto i = 0u; i < cellCache.count(); ++i)
+              blobs.emplace_back(Binary::encode(**cellCache.fetch(i)));
+          }
+          catch (const std::exception&)
+          {
+            continue; // The cell holds a value we cannot write, e.g. a range
+          }
+          writer.add(key, std::move(blobs));
+        }
+      }
+
+      bool restore(
+        const std::wstring_view& cacheKey,
+        const vector<std::string_view>& blobs) override
+      {
+        vector<unique_ptr<const ExcelObj>> objects;
+        for (auto& blob : blobs)
+          objects.emplace_back(new ExcelObj(Binary::decode(blob.data(), blob.size())));
+        cache().restore(cacheKey, std::move(objects));
+        return true;
+      }
+
+      CacheSnapshot::KeyState state(const std::wstring_view& cacheKey) const override
+      {
+        const auto restored = cache().isRestored(cacheKey);
+        if (!restored)
+          return CacheSnapshot::KeyState::Missing;
+        return *restored
+          ? CacheSnapshot::KeyState::Restored
+          : CacheSnapshot::KeyState::Current;
+      }
+
+    private:
+      static auto& cache()
+      {
+        return ObjectCacheFactory<unique_ptr<const ExcelObj>>::cache();
+      }
+    };
+
+    ExcelObjSnapshotHandler theSnapshotHandler;
+  }
 }
 
 using namespace xloil;
@@ -36,7 +116,7 @@ XLO_FUNC_START(
 }
 XLO_FUNC_END(xloVal).threadsafe()
   .help(L"Given a string reference, returns a stored array or value. Cached values "
-         "are not saved so will need to be recreated by a full recalc (Ctrl-Alt-F9) "
-         "on workbook open")
+         "are not saved unless cache snapshots are enabled, so will otherwise need to "
+         "be recreated by a full recalc (Ctrl-Alt-F9) on workbook open")
   .arg(L"CacheRef", L"Cache reference string");
 
@@ -0,0 +1,58 @@
+#include <xloil/StaticRegister.h>
+#include <xloil/ArrayBuilder.h>
+#include <xloil/Profile.h>
+
+namespace xloil
+{
+  XLO_FUNC_START(xloProfile(
+    const ExcelObj& enable,
+    const ExcelObj& reset
+  ))
+  {
+    if (!enable.isMissing())
+      Profile::setEnabled(enable.get<bool>());
+    if (reset.get<bool>(false))
+      Profile::reset();
+
+    Profile::merge();
+    const auto stats = Profile::stats();
+
+    constexpr const wchar_t* headings[] = {
+      L"Function", L"Calls", L"Errors", L"Total", L"Args", L"Body", L"Return",
+      L"Max", L"Median", L"95%" };
+    constexpr auto nCols = _countof(headings);
+
+    size_t stringLen = 0;
+    for (auto h : headings)
+      stringLen += wcslen(h);
+    for (auto& s : stats)
+      stringLen += s.name.size();
+
+    ExcelArrayBuilder builder((ExcelObj::row_t)stats.size() + 1, nCols, stringLen);
+    for (auto j = 0u; j < nCols; ++j)
+      builder(0, j) = headings[j];
+
+    for (auto i = 0u; i < stats.size(); ++i)
+    {
+      auto& s = stats[i];
+      const auto row = i + 1;
+      builder(row, 0) = std::wstring_view(s.name);
+      builder(row, 1) = (double)s.calls;
+      builder(row, 2) = (double)s.errors;
+      builder(row, 3) = s.totalTime();
+      builder(row, 4) = s.phaseTime[(size_t)Profile::Phase::Args];
+      builder(row, 5) = s.phaseTime[(size_t)Profile::Phase::Body];
+      builder(row, 6) = s.phaseTime[(size_t)Profile::Phase::Return];
+      builder(row, 7) = s.maxTime;
+      builder(row, 8) = s.quantile(0.5);
+      builder(row, 9) = s.quantile(0.95);
+    }
+
+    return returnValue(builder.toExcelObj());
+  }
+  XLO_FUNC_END(xloProfile).threadsafe()
+    .help(L"Returns call counts and timings in seconds for each registered function "
+      "since profiling was last reset. Quantiles are upper bounds from a log2 histogram.")
+    .arg(L"Enable", L"If given, switches profiling on or off")
+    .arg(L"Reset", L"If True, zeros the statistics before returning them");
+}
@@ -1,9 +1,36 @@
 #include <xloil/Async.h>
 #include <xloil/ExcelCall.h>
 #include <xlOil/WindowsSlim.h>
+#include <unordered_map>
+#include <vector>
 
 namespace xloil
 {
+  namespace
+  {
+    // Excel's async handles are BigData, which ExcelObj's comparison
+    // treats as all equal, so compare the handle data directly
+    struct HandleHash
+    {
+      size_t operator()(const ExcelObj* h) const
+      {
+        return h->type() == ExcelType::BigData
+          ? std::hash<const void*>()(h->val.bigdata.h.lpbData)
+          : std::hash<ExcelObj>()(*h);
+      }
+    };
+    struct HandleEqual
+    {
+      bool operator()(const ExcelObj* a, const ExcelObj* b) const
+      {
+        if (a->type() == ExcelType::BigData && b->type() == ExcelType::BigData)
+          return a->val.bigdata.h.lpbData == b->val.bigdata.h.lpbData
+            && a->val.bigdata.cbData == b->val.bigdata.cbData;
+        return *a == *b;
+      }
+    };
+  }
+
   XLOIL_EXPORT void asyncReturn(
     const ExcelObj& asyncHandle, const ExcelObj& value)
   {
@@ -16,6 +43,60 @@ namespace xloil
     callExcelRaw(msxll::xlAsyncReturn, &result, 2, callBackArgs);
   }
 
+  XLOIL_EXPORT void asyncReturn(
+    const ExcelObj* asyncHandles, const ExcelObj* values, size_t n)
+  {
+    if (n == 0)
+      return;
+    if (n == 1)
+      return asyncReturn(*asyncHandles, *values);
+
+    // Keep only the latest value for each handle
+    std::unordered_map<const ExcelObj*, size_t, HandleHash, HandleEqual> latest;
+    latest.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+      latest[asyncHandles + i] = i;
+
+    // An array of values cannot hold an array, so array results are returned 
+    // individually. The scalars are shallow copied into column arrays: these
+    // are plain XLOPERs rather than ExcelObj as they must not free the data.
+    std::vector<msxll::XLOPER12> handles, scalars;
+    handles.reserve(latest.size());
+    scalars.reserve(latest.size());
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (latest[asyncHandles + i] != i)
+        continue;
+      if (values[i].isType(ExcelType::Multi))
+        asyncReturn(asyncHandles[i], values[i]);
+      else
+      {
+        handles.push_back(asyncHandles[i]);
+        scalars.push_back(values[i]);
+      }
+    }
+
+    if (scalars.size() <= 1)
+    {
+      if (!scalars.empty())
+        asyncReturn(*(const ExcelObj*)&handles[0], *(const ExcelObj*)&scalars[0]);
+      return;
+    }
+
+    msxll::XLOPER12 handleArray, valueArray;
+    handleArray.xltype = valueArray.xltype = msxll::xltypeMulti;
+    handleArray.val.array.lparray = handles.data();
+    valueArray.val.array.lparray = scalars.data();
+    handleArray.val.array.rows = valueArray.val.array.rows = (int)scalars.size();
+    handleArray.val.array.columns = valueArray.val.array.columns = 1;
+
+    const ExcelObj* callBackArgs[2];
+    callBackArgs[0] = (const ExcelObj*)&handleArray;
+    callBackArgs[1] = (const ExcelObj*)&valueArray;
+    ExcelObj result;
+    callExcelRaw(msxll::xlAsyncReturn, &result, 2, callBackArgs);
+  }
+
   XLOIL_EXPORT bool yieldAndCheckIfEscPressed()
   {
     auto[res, ret] = tryCallExcel(msxll::xlAbort);
@@ -0,0 +1,760 @@
+#include <xloil/CacheSnapshot.h>
+#include <xloil/ExcelObjBinary.h>
+#include <xloil/ExcelArray.h>
+#include <xloil/Caller.h>
+#include <xloil/Events.h>
+#include <xloil/Log.h>
+#include <xloil/Throw.h>
+#include <xloil/StringUtils.h>
+#include <xlOil/WindowsSlim.h>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+using std::vector;
+using std::wstring;
+using std::wstring_view;
+using std::string_view;
+using std::shared_ptr;
+using std::make_shared;
+
+namespace xloil
+{
+  namespace CacheSnapshot
+  {
+    namespace
+    {
+      /// <summary>
+      /// The characters "XLCS" read as a little-endian uint32
+      /// </summary>
+      constexpr uint32_t MAGIC = 0x53434c58;
+      constexpr uint16_t VERSION = 1;
+      constexpr wchar_t FILE_EXT[] = L".xlcache";
+
+      /// <summary>
+      /// A snapshot file is a FileHeader followed by nCells cell records,
+      /// then nObjects object records. Each record is a RecordHeader, the
+      /// UTF-16 key, then for each blob a uint64 size and the data. Every
+      /// part starts on an 8-byte boundary.
+      ///
+      /// Cell records are keyed by cell address and hold the input hash and
+      /// the function result in the Binary ExcelObj format.  Object records
+      /// are keyed by cache key and hold the cache's serialised objects.
+      /// </summary>
+      struct FileHeader
+      {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t flags;
+        uint32_t nCells;
+        uint32_t nObjects;
+        uint64_t size;
+      };
+      static_assert(sizeof(FileHeader) == 24, "FileHeader must be packed");
+
+      struct RecordHeader
+      {
+        uint64_t inputHash;
+        uint32_t keyLength;
+        uint32_t nBlobs;
+      };
+      static_assert(sizeof(RecordHeader) == 16, "RecordHeader must be packed");
+
+      /// <summary>
+      /// A record in a mapped file: the blobs point into the mapped view
+      /// </summary>
+      struct Record
+      {
+        uint64_t inputHash;
+        vector<string_view> blobs;
+      };
+
+      /// <summary>
+      /// A record waiting to be written
+      /// </summary>
+      struct PendingRecord
+      {
+        uint64_t inputHash;
+        vector<vector<char>> blobs;
+      };
+
+      size_t recordSize(const wstring& key, const PendingRecord& record)
+      {
+        auto size = sizeof(RecordHeader) + Binary::align8(key.size() * sizeof(wchar_t));
+        for (auto& blob : record.blobs)
+          size += sizeof(uint64_t) + Binary::align8(blob.size());
+        return size;
+      }
+
+      class MappedFile
+      {
+      public:
+        /// <summary>
+        /// Maps an existing file for reading or, if size is non-zero, creates
+        /// a file of the given size and maps it for writing.
+        /// </summary>
+        MappedFile(const fs::path& path, size_t size = 0)
+        {
+          const auto write = size > 0;
+          _file = CreateFile(path.c_str(),
+            write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+            write ? 0 : FILE_SHARE_READ,
+            nullptr,
+            write ? CREATE_ALWAYS : OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr);
+          if (_file == INVALID_HANDLE_VALUE)
+            XLO_THROW(L"Failed to open cache snapshot '{0}': {1}", path.wstring(), writeWindowsError());
+
+          if (!write)
+          {
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(_file, &fileSize))
+              XLO_THROW(L"Failed to read cache snapshot '{0}': {1}", path.wstring(), writeWindowsError());
+            size = (size_t)fileSize.QuadPart;
+          }
+          _size = size;
+          if (_size == 0)
+            return;
+
+          _mapping = CreateFileMapping(_file, nullptr,
+            write ? PAGE_READWRITE : PAGE_READONLY,
+            (DWORD)((uint64_t)size >> 32), (DWORD)size, nullptr);
+          if (!_mapping)
+            XLO_THROW(L"Failed to map cache snapshot '{0}': {1}", path.wstring(), writeWindowsError());
+          _view = (char*)MapViewOfFile(_mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+          if (!_view)
+            XLO_THROW(L"Failed to map cache snapshot '{0}': {1}", path.wstring(), writeWindowsError());
+        }
+
+        ~MappedFile()
+        {
+          if (_view) UnmapViewOfFile(_view);
+          if (_mapping) CloseHandle(_mapping);
+          if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        char* data() const { return _view; }
+        size_t size() const { return _size; }
+
+      private:
+        HANDLE _file = INVALID_HANDLE_VALUE;
+        HANDLE _mapping = nullptr;
+        char* _view = nullptr;
+        size_t _size = 0;
+      };
+
+      /// <summary>
+      /// The mapped snapshot for a workbook and an index of its records.
+      /// Records are removed from the index when used.
+      /// </summary>
+      struct Snapshot
+      {
+        Snapshot(const fs::path& path)
+          : file(path)
+        {
+          const auto* begin = file.data();
+          const auto* end = begin + file.size();
+          const auto* p = begin;
+
+          auto need = [&](size_t n)
+          {
+            if ((size_t)(end - p) < n)
+              XLO_THROW("Cache snapshot is truncated");
+          };
+
+          need(sizeof(FileHeader));
+          const auto& header = *(const FileHeader*)p;
+          if (header.magic != MAGIC)
+            XLO_THROW("Not a cache snapshot");
+          if (header.version > VERSION)
+            XLO_THROW("Cache snapshot has version {0}, this reader supports up to {1}",
+              header.version, VERSION);
+          if (header.size != file.size())
+            XLO_THROW("Cache snapshot is truncated");
+          p += sizeof(FileHeader);
+
+          // We only index the records here: nothing is decoded until used
+          const auto nRecords = (size_t)header.nCells + header.nObjects;
+          for (size_t i = 0; i < nRecords; ++i)
+          {
+            need(sizeof(RecordHeader));
+            const auto& recordHeader = *(const RecordHeader*)p;
+            p += sizeof(RecordHeader);
+
+            const auto keyBytes = Binary::align8(recordHeader.keyLength * sizeof(wchar_t));
+            need(keyBytes);
+            wstring key((const wchar_t*)p, recordHeader.keyLength);
+            p += keyBytes;
+
+            Record record{ recordHeader.inputHash };
+            for (auto j = 0u; j < recordHeader.nBlobs; ++j)
+            {
+              need(sizeof(uint64_t));
+              const auto blobSize = *(const uint64_t*)p;
+              p += sizeof(uint64_t);
+              // Check before aligning, which wraps for sizes near 2^64
+              if (blobSize > (uint64_t)(end - p))
+                XLO_THROW("Cache snapshot is truncated");
+              need(Binary::align8(blobSize));
+              record.blobs.emplace_back(p, (size_t)blobSize);
+              p += Binary::align8(blobSize);
+            }
+
+            (i < header.nCells ? cells : objects).emplace(std::move(key), std::move(record));
+          }
+        }
+
+        MappedFile file;
+        std::unordered_map<wstring, Record> cells;
+        std::unordered_map<wstring, Record> objects;
+      };
+
+      struct Recorded
+      {
+        uint64_t inputHash;
+        ExcelObj result;
+      };
+
+      struct State
+      {
+        std::mutex lock;
+        fs::path directory;
+        vector<Handler*> handlers;
+        /// <summary>
+        /// Snapshots by workbook name. A null entry means we looked for a
+        /// snapshot and there was none.
+        /// </summary>
+        std::map<wstring, shared_ptr<Snapshot>, std::less<>> snapshots;
+        /// <summary>
+        /// Results of CellCalls by cell address, to be written on close
+        /// </summary>
+        std::unordered_map<wstring, Recorded> recorded;
+        shared_ptr<const void> closeHandler;
+      };
+
+      std::atomic<bool> theEnabled = false;
+
+      State& state()
+      {
+        static State instance;
+        return instance;
+      }
+
+      Handler* findHandler(wchar_t uniquifier)
+      {
+        auto& s = state();
+        std::scoped_lock lock(s.lock);
+        for (auto* handler : s.handlers)
+          if (handler->uniquifier() == uniquifier)
+            return handler;
+        return nullptr;
+      }
+
+      bool isCacheRef(const wstring_view& str)
+      {
+        return str.size() > 4 && str[1] == L'[' && str[str.size() - 2] == L',';
+      }
+
+      /// <summary>
+      /// Returns the workbook name from an address like [Book]Sheet!R1C1
+      /// </summary>
+      wstring_view workbookOf(const wstring_view& address)
+      {
+        if (address.empty() || address[0] != L'[')
+          return wstring_view();
+        const auto bang = address.find(L'!');
+        const auto close = address.rfind(L']', bang);
+        if (bang == wstring_view::npos || close == wstring_view::npos || close < 1)
+          return wstring_view();
+        return address.substr(1, close - 1);
+      }
+
+      shared_ptr<Snapshot> findSnapshot(const wstring_view& workbook)
+      {
+        if (workbook.empty())
+          return shared_ptr<Snapshot>();
+
+        auto& s = state();
+        std::scoped_lock lock(s.lock);
+        auto found = s.snapshots.find(workbook);
+        if (found != s.snapshots.end())
+          return found->second;
+
+        // First use since the workbook was opened: map the file
+        shared_ptr<Snapshot> snapshot;
+        auto path = s.directory / (wstring(workbook) + FILE_EXT);
+        std::error_code fsErr;
+        if (fs::exists(path, fsErr))
+        {
+          try
+          {
+            snapshot = make_shared<Snapshot>(path);
+            XLO_INFO(L"Loaded cache snapshot '{0}' with {1} cells and {2} objects",
+              path.wstring(), snapshot->cells.size(), snapshot->objects.size());
+          }
+          catch (const std::exception& e)
+          {
+            XLO_WARN(L"Ignoring cache snapshot '{0}': {1}", path.wstring(), utf8ToUtf16(e.what()));
+          }
+        }
+        s.snapshots.emplace(workbook, snapshot);
+        return snapshot;
+      }
+
+      /// <summary>
+      /// Removes and returns a record from the snapshot. The returned
+      /// snapshot pointer keeps the record's data alive.
+      /// </summary>
+      shared_ptr<Snapshot> takeRecord(
+        const wstring_view& address, bool isCell, const wstring& key, Record& record)
+      {
+        auto snapshot = findSnapshot(workbookOf(address));
+        if (!snapshot)
+          return snapshot;
+
+        std::scoped_lock lock(state().lock);
+        auto& records = isCell ? snapshot->cells : snapshot->objects;
+        auto found = records.find(key);
+        if (found == records.end())
+          return shared_ptr<Snapshot>();
+        record = std::move(found->second);
+        records.erase(found);
+        return snapshot;
+      }
+
+      template<class TFunc>
+      void visitStrings(const ExcelObj& obj, TFunc func)
+      {
+        if (obj.isType(ExcelType::Str))
+          func(obj.cast<PStringRef>().view());
+        else if (obj.isType(ExcelType::Multi))
+          for (auto& cell : ExcelArray(obj, false))
+            if (cell.isType(ExcelType::Str))
+              func(cell.cast<PStringRef>().view());
+      }
+
+      /// <summary>
+      /// FNV-1a: the hash is written to file so must be the same in every
+      /// session, which std::hash does not guarantee
+      /// </summary>
+      uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+      {
+        auto* bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; ++i)
+          hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        return hash;
+      }
+
+      /// <summary>
+      /// Hashes the value of an argument, returning false if it has no
+      /// fixed value, e.g. it is a range reference
+      /// </summary>
+      bool hashValue(uint64_t& hash, const ExcelObj& obj)
+      {
+        const auto type = (uint8_t)obj.type();
+        hash = hashBytes(hash, &type, 1);
+        switch (obj.type())
+        {
+        case ExcelType::Num:
+          hash = hashBytes(hash, &obj.val.num, sizeof(double));
+          return true;
+        case ExcelType::Int:
+          hash = hashBytes(hash, &obj.val.w, sizeof(obj.val.w));
+          return true;
+        case ExcelType::Bool:
+          hash = hashBytes(hash, &obj.val.xbool, sizeof(obj.val.xbool));
+          return true;
+        case ExcelType::Err:
+          hash = hashBytes(hash, &obj.val.err, sizeof(obj.val.err));
+          return true;
+        case ExcelType::Str:
+        {
+          const auto str = obj.cast<PStringRef>();
+          hash = hashBytes(hash, str.pstr(), (str.length() + 1) * sizeof(wchar_t));
+          return true;
+        }
+        case ExcelType::Nil:
+        case ExcelType::Missing:
+          return true;
+        case ExcelType::Multi:
+        {
+          ExcelArray array(obj, false);
+          const uint32_t dims[] = { array.nRows(), array.nCols() };
+          hash = hashBytes(hash, dims, sizeof(dims));
+          for (auto& cell : array)
+            if (!hashValue(hash, cell))
+              return false;
+          return true;
+        }
+        default:
+          return false;
+        }
+      }
+
+      void writeSnapshot(
+        const fs::path& path,
+        const std::map<wstring, PendingRecord>& cells,
+        const std::map<wstring, PendingRecord>& objects)
+      {
+        std::error_code fsErr;
+        if (cells.empty() && objects.empty())
+        {
+          fs::remove(path, fsErr);
+          return;
+        }
+
+        size_t size = sizeof(FileHeader);
+        for (auto& [key, record] : cells)
+          size += recordSize(key, record);
+        for (auto& [key, record] : objects)
+          size += recordSize(key, record);
+
+        // Write to a temporary file then replace, so an interrupted write
+        // does not leave a corrupt snapshot
+        auto tempPath = path;
+        tempPath += L".tmp";
+        {
+          MappedFile file(tempPath, size);
+          auto* p = file.data();
+          // Zero the padding so the output is deterministic
+          memset(p, 0, size);
+
+          const FileHeader header{
+            MAGIC, VERSION, 0, (uint32_t)cells.size(), (uint32_t)objects.size(), size };
+          memcpy(p, &header, sizeof(header));
+          p += sizeof(header);
+
+          auto writeRecords = [&](const std::map<wstring, PendingRecord>& records)
+          {
+            for (auto& [key, record] : records)
+            {
+              const RecordHeader recordHeader{
+                record.inputHash, (uint32_t)key.size(), (uint32_t)record.blobs.size() };
+              memcpy(p, &recordHeader, sizeof(recordHeader));
+              p += sizeof(recordHeader);
+              wmemcpy((wchar_t*)p, key.data(), key.size());
+              p += Binary::align8(key.size() * sizeof(wchar_t));
+              for (auto& blob : record.blobs)
+              {
+                const uint64_t blobSize = blob.size();
+                memcpy(p, &blobSize, sizeof(blobSize));
+                p += sizeof(blobSize);
+                if (!blob.empty())
+                  memcpy(p, blob.data(), blob.size());
+                p += Binary::align8(blob.size());
+              }
+            }
+          };
+          writeRecords(cells);
+          writeRecords(objects);
+        }
+        if (!MoveFileEx(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+          XLO_THROW(L"Failed to replace cache snapshot '{0}': {1}", path.wstring(), writeWindowsError());
+      }
+
+      class SnapshotWriter : public Writer
+      {
+      public:
+        void add(const wstring_view& cacheKey, vector<vector<char>>&& blobs) override
+        {
+          objects[wstring(cacheKey)] = PendingRecord{ 0, std::move(blobs) };
+        }
+        std::map<wstring, PendingRecord> objects;
+      };
+
+      void onWorkbookClose(const wchar_t* wbName)
+      {
+        if (!theEnabled)
+          return;
+
+        auto& s = state();
+        const wstring_view workbook(wbName);
+
+        vector<Handler*> handlers;
+        fs::path directory;
+        {
+          std::scoped_lock lock(s.lock);
+          handlers = s.handlers;
+          directory = s.directory;
+        }
+
+        SnapshotWriter writer;
+        for (auto* handler : handlers)
+        {
+          try
+          {
+            handler->save(workbook, writer);
+          }
+          catch (const std::exception& e)
+          {
+            XLO_WARN("Error writing cache snapshot: {0}", e.what());
+          }
+        }
+
+        std::map<wstring, PendingRecord> cells;
+        shared_ptr<Snapshot> previous;
+        {
+          std::scoped_lock lock(s.lock);
+          for (auto i = s.recorded.begin(); i != s.recorded.end();)
+          {
+            if (workbookOf(i->first) != workbook)
+            {
+              ++i;
+              continue;
+            }
+            // Only keep a result if all the objects it refers to were saved
+            bool complete = true;
+            visitStrings(i->second.result, [&](const wstring_view& str)
+            {
+              if (isCacheRef(str)
+                && writer.objects.find(wstring(str.substr(0, str.size() - 2))) == writer.objects.end())
+                complete = false;
+            });
+            if (complete)
+            {
+              try
+              {
+                cells[i->first] = PendingRecord{ i->second.inputHash };
+                cells[i->first].blobs.emplace_back(Binary::encode(i->second.result));
+              }
+              catch (const std::exception&)
+              {
+                cells.erase(i->first);
+              }
+            }
+            i = s.recorded.erase(i);
+          }
+
+          auto found = s.snapshots.find(workbook);
+          if (found != s.snapshots.end())
+          {
+            previous = found->second;
+            s.snapshots.erase(found);
+          }
+        }
+
+        // Entries in the previous snapshot which were not used this session,
+        // e.g. if the workbook was not recalculated, are carried forward
+        if (previous)
+        {
+          auto copyBlobs = [](const Record& record)
+          {
+            PendingRecord result{ record.inputHash };
+            for (auto& blob : record.blobs)
+              result.blobs.emplace_back(blob.begin(), blob.end());
+            return result;
+          };
+          for (auto& [key, record] : previous->cells)
+            if (cells.find(key) == cells.end())
+              cells.emplace(key, copyBlobs(record));
+          for (auto& [key, record] : previous->objects)
+            if (writer.objects.find(key) == writer.objects.end())
+              writer.objects.emplace(key, copyBlobs(record));
+          if (previous.use_count() > 1)
+            XLO_WARN(L"Cache snapshot for '{0}' is in use so may not be updated", workbook);
+          // Release the mapping so the file can be replaced
+          previous.reset();
+        }
+
+        try
+        {
+          writeSnapshot(directory / (wstring(workbook) + FILE_EXT), cells, writer.objects);
+          XLO_DEBUG(L"Wrote cache snapshot for '{0}' with {1} cells and {2} objects",
+            workbook, cells.size(), writer.objects.size());
+        }
+        catch (const std::exception& e)
+        {
+          XLO_WARN("Error writing cache snapshot: {0}", e.what());
+        }
+      }
+    }
+
+    void addHandler(Handler* handler)
+    {
+      auto& s = state();
+      std::scoped_lock lock(s.lock);
+      s.handlers.push_back(handler);
+    }
+
+    void removeHandler(Handler* handler)
+    {
+      auto& s = state();
+      std::scoped_lock lock(s.lock);
+      s.handlers.erase(
+        std::remove(s.handlers.begin(), s.handlers.end(), handler), s.handlers.end());
+    }
+
+    void setDirectory(const std::wstring_view& directory)
+    {
+      auto& s = state();
+      {
+        std::scoped_lock lock(s.lock);
+        s.directory = directory;
+        s.snapshots.clear();
+        if (!directory.empty())
+        {
+          std::error_code fsErr;
+          fs::create_directories(s.directory, fsErr);
+          if (!s.closeHandler)
+            s.closeHandler = Event::WorkbookBeforeClose().bind(
+              [](const wchar_t* wbName, bool&) { onWorkbookClose(wbName); });
+        }
+      }
+      theEnabled = !directory.empty();
+      if (theEnabled)
+        XLO_INFO(L"Cache snapshots enabled in '{0}'", directory);
+    }
+
+    bool isEnabled() noexcept
+    {
+      return theEnabled;
+    }
+
+    bool restoreMissing(const std::wstring_view& cacheKey)
+    {
+      if (!theEnabled || cacheKey.size() < 2)
+        return false;
+
+      auto* handler = findHandler(cacheKey[0]);
+      if (!handler)
+        return false;
+
+      Record record;
+      auto snapshot = takeRecord(cacheKey.substr(1), false, wstring(cacheKey), record);
+      if (!snapshot)
+        return false;
+
+      try
+      {
+        return handler->restore(cacheKey, record.blobs);
+      }
+      catch (const std::exception& e)
+      {
+        XLO_WARN(L"Failed to restore '{0}' from cache snapshot: {1}",
+          cacheKey, utf8ToUtf16(e.what()));
+        return false;
+      }
+    }
+
+    CellCall::CellCall(
+      const std::wstring_view& funcName,
+      const ExcelObj** args,
+      size_t nArgs)
+      : _hash(0)
+      , _args(args)
+      , _nArgs(nArgs)
+    {
+      if (!theEnabled)
+        return;
+
+      uint64_t hash = hashBytes(0xcbf29ce484222325ull, funcName.data(), funcName.size() * sizeof(wchar_t));
+      for (size_t i = 0; i < nArgs; ++i)
+        if (!hashValue(hash, *args[i]))
+          return;
+
+      CallerInfo caller;
+      if (!caller.sheetRef())
+        return;
+      _cell = caller.writeAddress(AddressStyle::RC | AddressStyle::NOQUOTE);
+      // Zero means the call is not eligible
+      _hash = hash == 0 ? 1 : hash;
+    }
+
+    const ExcelObj* CellCall::restore()
+    {
+      if (_hash == 0)
+        return nullptr;
+
+      Record entry;
+      auto snapshot = takeRecord(_cell, true, _cell, entry);
+      if (!snapshot || entry.inputHash != _hash || entry.blobs.size() != 1)
+        return nullptr;
+
+      // A cache reference argument has the same string in every session, so
+      // only its object tells us if the input has changed. We accept it if
+      // the object is also from the snapshot.
+      for (size_t i = 0; i < _nArgs; ++i)
+      {
+        const auto& arg = *_args[i];
+        if (!arg.isType(ExcelType::Str))
+          continue;
+        const auto str = arg.cast<PStringRef>().view();
+        if (!isCacheRef(str))
+          continue;
+        auto* handler = findHandler(str[0]);
+        if (!handler)
+          return nullptr;
+        const auto key = str.substr(0, str.size() - 2);
+        switch (handler->state(key))
+        {
+        case KeyState::Current:
+          return nullptr;
+        case KeyState::Missing:
+          if (!restoreMissing(key))
+            return nullptr;
+          break;
+        default:
+          break;
+        }
+      }
+
+      try
+      {
+        _restored = Binary::decode(entry.blobs[0].data(), entry.blobs[0].size());
+      }
+      catch (const std::exception&)
+      {
+        return nullptr;
+      }
+
+      bool complete = true;
+      visitStrings(_restored, [&](const wstring_view& str)
+      {
+        if (!complete || !isCacheRef(str))
+          return;
+        const auto key = str.substr(0, str.size() - 2);
+        auto* handler = findHandler(str[0]);
+        complete = handler
+          && (handler->state(key) != KeyState::Missing || restoreMissing(key));
+      });
+      if (!complete)
+        return nullptr;
+
+      record(_restored);
+      return &_restored;
+    }
+
+    void CellCall::record(const ExcelObj& result)
+    {
+      if (_hash == 0)
+        return;
+
+      bool hasRefs = false;
+      visitStrings(result, [&](const wstring_view& str)
+      {
+        hasRefs = hasRefs || (isCacheRef(str) && findHandler(str[0]));
+      });
+
+      auto& s = state();
+      std::scoped_lock lock(s.lock);
+      if (hasRefs)
+        s.recorded.insert_or_assign(_cell, Recorded{ _hash, result });
+      else
+        s.recorded.erase(_cell);
+
+      // Any snapshot entry for the cell is now out of date
+      auto found = s.snapshots.find(workbookOf(_cell));
+      if (found != s.snapshots.end() && found->second)
+        found->second->cells.erase(_cell);
+    }
+  }
+}
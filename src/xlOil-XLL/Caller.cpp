@@ -5,8 +5,13 @@
 #include <xlOil/WindowsSlim.h>
 #include <xlOil/XlCallSlim.h>
 #include <xloil/AppObjects.h>
+#include <xloil/Events.h>
+#include <xloil/Log.h>
 #include <xlOilHelpers/Environment.h>
 #include <array>
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
 
 using namespace msxll;
 
@@ -32,6 +37,7 @@ namespace
     HWND  hwnd;
     const char *window_title_text; // set to NULL if don't care
     DWORD pid;
+    HWND found;
   };
 
 #pragma warning(disable: 4311 4302)
@@ -85,10 +91,11 @@ namespace
         return TRUE; // Keep iterating
     }
     p_enum->is_dlg = true;
+    p_enum->found = hwnd;
     return FALSE; // Tells Windows to stop iterating.
   }
 
-  bool called_from_paste_fn_dlg()
+  HWND called_from_paste_fn_dlg()
   {
     DWORD pid = 0;
     const char* windowName;
@@ -102,9 +109,9 @@ namespace
     }
 
     // Search for bosa_sdm_xl* dialog box with no title string.
-    xldlg_enum_struct es = { false, (HWND)state.hWnd, windowName, pid };
+    xldlg_enum_struct es = { false, (HWND)state.hWnd, windowName, pid, nullptr };
     EnumWindows((WNDENUMPROC)xldlg_enum_proc, (LPARAM)&es);
-    return es.is_dlg;
+    return es.is_dlg ? es.found : nullptr;
   }
 }
 
@@ -346,12 +353,143 @@ namespace xloil
     }
   }
 
+  namespace
+  {
+    /// <summary>
+    /// Remembers sheet names and IDs so they are fetched from Excel once
+    /// per sheet per calc rather than once per calling cell. It is cleared
+    /// after each calc and when a workbook is renamed or closed. Since
+    /// events can be disabled, entries are also discarded after a short
+    /// time, so a renamed sheet cannot keep its old name for long.
+    /// </summary>
+    class SheetCache
+    {
+    public:
+      static SheetCache& get()
+      {
+        static SheetCache instance;
+        static auto afterCalc = Event::AfterCalculate() += 
+          []() { instance.clear(); };
+        static auto afterClose = Event::WorkbookAfterClose() += 
+          [](const wchar_t*) { instance.clear(); };
+        static auto rename = Event::WorkbookRename() += 
+          [](const wchar_t*, const wchar_t*) { instance.clear(); };
+        return instance;
+      }
+
+      /// <summary>
+      /// Returns the name [Book]Sheet for a sheet ref, which must be of type
+      /// Ref, or Nil if Excel does not recognise the sheet.
+      /// </summary>
+      ExcelObj name(const ExcelObj& ref)
+      {
+        const auto id = ref.val.mref.idSheet;
+        {
+          std::shared_lock lock(_lock);
+          if (fresh())
+          {
+            auto found = _names.find(id);
+            if (found != _names.end())
+              return found->second;
+          }
+        }
+
+        ExcelObj name;
+        if (callExcelRaw(xlSheetNm, &name, &ref) != xlretSuccess 
+            || !name.isType(ExcelType::Str))
+          return ExcelObj();
+
+        std::unique_lock lock(_lock);
+        expire();
+        return _names.try_emplace(id, name).first->second;
+      }
+
+      /// <summary>
+      /// Returns the sheet ID for a name [Book]Sheet or null if there is
+      /// no such sheet
+      /// </summary>
+      IDSHEET id(const PStringRef& name)
+      {
+        std::wstring key(name.view());
+        {
+          std::shared_lock lock(_lock);
+          if (fresh())
+          {
+            auto found = _ids.find(key);
+            if (found != _ids.end())
+              return found->second;
+          }
+        }
+
+        ExcelObj sheetId;
+        const auto nameObj = ExcelObj(std::wstring_view(key));
+        if (callExcelRaw(xlSheetId, &sheetId, &nameObj) != xlretSuccess
+            || !sheetId.isType(ExcelType::Ref))
+          return nullptr;
+
+        std::unique_lock lock(_lock);
+        expire();
+        return _ids.try_emplace(std::move(key), sheetId.val.mref.idSheet).first->second;
+      }
+
+      void clear()
+      {
+        std::unique_lock lock(_lock);
+        _names.clear();
+        _ids.clear();
+      }
+
+    private:
+      static constexpr uint64_t MAX_AGE_MS = 1000;
+
+      SheetCache() {}
+
+      bool fresh() const
+      {
+        return GetTickCount64() - _created < MAX_AGE_MS;
+      }
+
+      /// <summary>
+      /// Called with the exclusive lock held before adding an entry
+      /// </summary>
+      void expire()
+      {
+        if (_names.empty() && _ids.empty())
+          _created = GetTickCount64();
+        else if (!fresh())
+        {
+          _names.clear();
+          _ids.clear();
+          _created = GetTickCount64();
+        }
+      }
+
+      std::shared_mutex _lock;
+      std::unordered_map<IDSHEET, ExcelObj> _names;
+      std::unordered_map<std::wstring, IDSHEET> _ids;
+      uint64_t _created = 0;
+    };
+  }
+
   CallerInfo::CallerInfo()
   {
     callExcelRaw(xlfCaller, &_address);
-    if (_address.isType(ExcelType::RangeRef))
+    // A caller of type Ref includes the sheet ID, which lets us use the 
+    // sheet cache. An SRef refers to the current sheet which we can only
+    // determine by asking Excel.
+    if (_address.isType(ExcelType::Ref))
+      _sheetName = SheetCache::get().name(_address);
+    else if (_address.isType(ExcelType::SRef))
       callExcelRaw(xlSheetNm, &_sheetName, &_address);
   }
+
+  msxll::IDSHEET CallerInfo::sheetId() const
+  {
+    if (_address.isType(ExcelType::Ref))
+      return _address.val.mref.idSheet;
+    const auto name = fullSheetName();
+    return name.empty() ? nullptr : SheetCache::get().id(name);
+  }
   
   CallerInfo::CallerInfo(
     const ExcelObj& address, const wchar_t* fullSheetName)
@@ -430,10 +568,18 @@ namespace xloil
     bool A1Style,
     bool quoteSheet)
   {
-    ExcelObj sheetNm;
-    sheetNm.xltype = msxll::xltypeRef;
-    sheetNm.val.mref.idSheet = sheet;
-    callExcelRaw(msxll::xlSheetNm, &sheetNm, &sheetNm);
+    ExcelObj sheetRef;
+    sheetRef.xltype = msxll::xltypeRef;
+    sheetRef.val.mref.idSheet = sheet;
+    sheetRef.val.mref.lpmref = nullptr;
+    const auto sheetNm = SheetCache::get().name(sheetRef);
+
+    // The sheet name is Nil if Excel does not recognise the sheet, for
+    // example if it has been closed, so write the address without it
+    if (!sheetNm.isType(ExcelType::Str))
+      return A1Style
+        ? writeLocalAddress<WriteA1>(ref, buf, bufSize)
+        : writeLocalAddress<WriteRC>(ref, buf, bufSize);
 
     return writeSheetAddress(buf, bufSize, ref, sheetNm.cast<PStringRef>(), A1Style, quoteSheet);
   }
@@ -551,8 +697,105 @@ namespace xloil
     return r.colFirst >= 0 && r.rwFirst >= 0 && r.rwLast >= 0 && r.colLast >= 0;
   }
 
+  namespace
+  {
+    std::atomic<uint64_t> theWizardScans{ 0 };
+
+    /// <summary>
+    /// Maintained by the window event hook, when it is installed
+    /// </summary>
+    std::atomic<bool> theWizardOpen{ false };
+    std::atomic<bool> theWizardHooked{ false };
+    HWINEVENTHOOK theWizardHooks[2] = { nullptr, nullptr };
+    /// <summary>
+    /// Main thread only. We remember the wizard's window as a destroyed 
+    /// window no longer has a class name to check.
+    /// </summary>
+    HWND theWizardWindow = nullptr;
+
+    HWND scanForFunctionWizard()
+    {
+      ++theWizardScans;
+      return called_from_paste_fn_dlg();
+    }
+
+    bool isExcelDialog(HWND hwnd)
+    {
+      char className[CLASS_NAME_BUFFSIZE + 1];
+      className[CLASS_NAME_BUFFSIZE] = 0;
+      return GetClassNameA(hwnd, className, CLASS_NAME_BUFFSIZE) > 0
+        && _strnicmp(className, "bosa_sdm_xl", 11) == 0;
+    }
+
+    /// <summary>
+    /// Called on the main thread when a window in the Excel process is created,
+    /// shown, hidden, renamed or destroyed. Only Excel dialogs trigger a scan.
+    /// </summary>
+    void CALLBACK onWindowEvent(
+      HWINEVENTHOOK /*hook*/, DWORD event, HWND hwnd,
+      LONG idObject, LONG idChild, DWORD /*thread*/, DWORD /*time*/)
+    {
+      if (!hwnd || idObject != OBJID_WINDOW || idChild != CHILDID_SELF)
+        return;
+      if (event == EVENT_OBJECT_DESTROY ? hwnd != theWizardWindow : !isExcelDialog(hwnd))
+        return;
+      theWizardWindow = scanForFunctionWizard();
+      theWizardOpen = theWizardWindow != nullptr;
+    }
+
+    void removeFunctionWizardHook()
+    {
+      theWizardHooked = false;
+      for (auto& hook : theWizardHooks)
+      {
+        if (hook)
+          UnhookWinEvent(hook);
+        hook = nullptr;
+      }
+    }
+  }
+
+  void initFunctionWizardHook()
+  {
+    if (theWizardHooked)
+      return;
+
+    // Out-of-context hooks are called on this thread when it pumps messages, 
+    // so this must be the main thread. We hook create/destroy/show/hide and
+    // name change separately to avoid the very frequent location change events.
+    const auto pid = GetCurrentProcessId();
+    theWizardHooks[0] = SetWinEventHook(
+      EVENT_OBJECT_CREATE, EVENT_OBJECT_HIDE, nullptr, onWindowEvent,
+      pid, 0, WINEVENT_OUTOFCONTEXT);
+    theWizardHooks[1] = SetWinEventHook(
+      EVENT_OBJECT_NAMECHANGE, EVENT_OBJECT_NAMECHANGE, nullptr, onWindowEvent,
+      pid, 0, WINEVENT_OUTOFCONTEXT);
+
+    if (!theWizardHooks[0] || !theWizardHooks[1])
+    {
+      XLO_WARN("Could not hook window events, function wizard detection will be slower");
+      removeFunctionWizardHook();
+      return;
+    }
+
+    // The wizard could already be open if we are loaded from its dialog
+    theWizardWindow = scanForFunctionWizard();
+    theWizardOpen = theWizardWindow != nullptr;
+    theWizardHooked = true;
+
+    // Remove the hook before the core DLL, which contains the callback, unloads
+    static auto handler = Event::AutoClose() += []() { removeFunctionWizardHook(); };
+  }
+
   bool inFunctionWizard()
   {
-    return called_from_paste_fn_dlg();
+    if (theWizardHooked)
+      return theWizardOpen;
+    return scanForFunctionWizard() != nullptr;
+  }
+
+  uint64_t functionWizardScans() noexcept
+  {
+    return theWizardScans;
   }
 }
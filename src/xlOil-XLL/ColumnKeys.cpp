@@ -0,0 +1,300 @@
+#include <xloil/ColumnKeys.h>
+#include <xloil/Unicode.h>
+#include <xloil/Throw.h>
+#include <algorithm>
+#include <clocale>
+#include <cstring>
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
+using std::vector;
+
+namespace xloil
+{
+  namespace
+  {
+    // SIMD comparisons may read this far past the start of a key block
+    constexpr size_t KEY_PADDING = 16;
+
+    /// <summary>
+    /// ExcelObj::compare uses locale collation for strings. In the "C"
+    /// collation locale this orders strings by their (lower-cased) characters,
+    /// which is what the ASCII keys do. The keys fold case themselves, so
+    /// LC_CTYPE does not matter.
+    /// </summary>
+    bool asciiKeysMatchCollation()
+    {
+      const auto* collate = setlocale(LC_COLLATE, nullptr);
+      return collate && strcmp(collate, "C") == 0;
+    }
+
+    /// <summary>
+    /// Branch-free and, like ExcelObj::compare, returns 1 for unordered values
+    /// </summary>
+    inline int compareNumbers(double l, double r)
+    {
+      return 1 - 2 * (int)(l < r) - (int)(l == r);
+    }
+
+    inline int sign(int x)
+    {
+      return (int)(x > 0) - (int)(x < 0);
+    }
+
+    inline unsigned firstSetBit(unsigned x)
+    {
+#ifdef _MSC_VER
+      unsigned long index;
+      _BitScanForward(&index, x);
+      return index;
+#else
+      return (unsigned)__builtin_ctz(x);
+#endif
+    }
+
+    /// <summary>
+    /// Writes the string to the key as single byte chars, lower-casing it
+    /// if <paramref name="fold"/> is set. Returns false if the string is not
+    /// ASCII.
+    /// </summary>
+    bool asciiKey(const wchar_t* str, size_t len, char* key, bool fold)
+    {
+      size_t i = 0;
+#ifdef XLOIL_HAS_SSE2
+      const auto beforeA = _mm_set1_epi16(L'A' - 1);
+      const auto afterZ = _mm_set1_epi16(L'Z' + 1);
+      const auto caseBit = _mm_set1_epi16(0x20);
+      for (; i + 8 <= len; i += 8)
+      {
+        auto v = _mm_loadu_si128((const __m128i*)(str + i));
+        if (!detail::isAsciiBlock(v))
+          return false;
+        if (fold)
+        {
+          // Signed comparisons are safe as the chars are ASCII
+          const auto upper = _mm_and_si128(
+            _mm_cmpgt_epi16(v, beforeA), _mm_cmplt_epi16(v, afterZ));
+          v = _mm_add_epi16(v, _mm_and_si128(upper, caseBit));
+        }
+        _mm_storel_epi64((__m128i*)(key + i), _mm_packus_epi16(v, v));
+      }
+#endif
+      for (; i < len; ++i)
+      {
+        auto c = str[i];
+        if (c >= 0x80)
+          return false;
+        if (fold && c >= L'A' && c <= L'Z')
+          c += 0x20;
+        key[i] = (char)c;
+      }
+      return true;
+    }
+
+    inline size_t hashKey(const char* key, size_t len)
+    {
+      // FNV-1a, as ExcelObj::hash
+      size_t h = 14695981039346656037ull;
+      for (size_t i = 0; i < len; ++i)
+        h = (h ^ (unsigned char)key[i]) * 1099511628211ull;
+      return h;
+    }
+  }
+
+  ColumnKeys::ColumnKeys(const ExcelArray& array, col_t column, bool caseSensitive)
+    : _array(array)
+    , _column(column)
+    , _caseSensitive(caseSensitive)
+  {
+    if (column >= array.nCols())
+      XLO_THROW("Column {0} is beyond number of array columns {1}", column + 1, array.nCols());
+
+    const auto nRows = array.nRows();
+    _kinds.resize(nRows);
+    _numbers.assign(nRows, 0.0);
+    _keyStart.assign(nRows, 0);
+
+    const auto useKeys = asciiKeysMatchCollation();
+
+    for (row_t i = 0; i < nRows; ++i)
+    {
+      const auto& value = array.at(i, column);
+      auto kind = Other;
+      switch (value.xtype())
+      {
+      case msxll::xltypeNum:
+        _numbers[i] = value.val.num;
+        kind = Number;
+        break;
+      case msxll::xltypeInt:
+        _numbers[i] = value.val.w;
+        kind = Number;
+        break;
+      case msxll::xltypeBool:
+        _numbers[i] = value.val.xbool != 0 ? 1 : 0;
+        kind = Number;
+        break;
+      case msxll::xltypeStr:
+      {
+        if (!useKeys)
+          break;
+        const auto len = (size_t)value.val.str[0];
+        const auto start = _keyChars.size();
+        _keyChars.resize(start + len);
+        if (asciiKey(value.val.str + 1, len, _keyChars.data() + start, !caseSensitive))
+        {
+          _keyStart[i] = start;
+          kind = AsciiString;
+        }
+        else
+          _keyChars.resize(start);
+        break;
+      }
+      default:
+        break;
+      }
+      _kinds[i] = kind;
+      switch (kind)
+      {
+      case Number:      _numberRows.push_back(i); break;
+      case AsciiString: _stringRows.push_back(i); break;
+      default:          _otherRows.push_back(i);
+      }
+    }
+    _keyChars.resize(_keyChars.size() + KEY_PADDING);
+  }
+
+  int ColumnKeys::compareKeys(
+    const char* left, size_t leftLen, const char* right, size_t rightLen)
+  {
+    const auto n = std::min(leftLen, rightLen);
+    size_t i = 0;
+#ifdef XLOIL_HAS_SSE2
+    // Keys are followed by padding, so reading a block past their end is safe
+    for (; i < n; i += 16)
+    {
+      const auto equal = _mm_cmpeq_epi8(
+        _mm_loadu_si128((const __m128i*)(left + i)),
+        _mm_loadu_si128((const __m128i*)(right + i)));
+      const auto diff = ~(unsigned)_mm_movemask_epi8(equal) & 0xFFFF;
+      if (diff != 0)
+      {
+        const auto k = i + firstSetBit(diff);
+        if (k >= n)
+          break;
+        return (unsigned char)left[k] < (unsigned char)right[k] ? -1 : 1;
+      }
+    }
+#else
+    for (; i < n; ++i)
+      if (left[i] != right[i])
+        return (unsigned char)left[i] < (unsigned char)right[i] ? -1 : 1;
+#endif
+    return leftLen < rightLen ? -1 : (leftLen == rightLen ? 0 : 1);
+  }
+
+  int ColumnKeys::compare(row_t i, row_t j) const
+  {
+    if (i == j)
+      return 0;
+    const auto ki = _kinds[i], kj = _kinds[j];
+    if (ki == Number && kj == Number)
+      return compareNumbers(_numbers[i], _numbers[j]);
+    if (ki == AsciiString && kj == AsciiString)
+      return compareKeys(key(i), keyLength(i), key(j), keyLength(j));
+    // Numbers come before strings
+    if (ki == Number && kj == AsciiString)
+      return -1;
+    if (ki == AsciiString && kj == Number)
+      return 1;
+    return sign(ExcelObj::compare((*this)(i), (*this)(j), _caseSensitive));
+  }
+
+  void ColumnKeys::compare(const ExcelObj& value, int* result) const
+  {
+    const auto scalar = [&](row_t i)
+    {
+      result[i] = sign(ExcelObj::compare((*this)(i), value, _caseSensitive));
+    };
+
+    switch (value.xtype())
+    {
+    case msxll::xltypeNum:
+    case msxll::xltypeInt:
+    case msxll::xltypeBool:
+    {
+      const auto x = value.get<double>();
+      for (auto i : _numberRows)
+        result[i] = compareNumbers(_numbers[i], x);
+      for (auto i : _stringRows)
+        result[i] = 1;
+      break;
+    }
+    case msxll::xltypeStr:
+    {
+      const auto len = (size_t)value.val.str[0];
+      vector<char> valueKey(len + KEY_PADDING);
+      if (!_stringRows.empty()
+        && asciiKey(value.val.str + 1, len, valueKey.data(), !_caseSensitive))
+      {
+        for (auto i : _stringRows)
+          result[i] = compareKeys(key(i), keyLength(i), valueKey.data(), len);
+      }
+      else
+        std::for_each(_stringRows.begin(), _stringRows.end(), scalar);
+      for (auto i : _numberRows)
+        result[i] = -1;
+      break;
+    }
+    default:
+      std::for_each(_numberRows.begin(), _numberRows.end(), scalar);
+      std::for_each(_stringRows.begin(), _stringRows.end(), scalar);
+    }
+    std::for_each(_otherRows.begin(), _otherRows.end(), scalar);
+  }
+
+  void ColumnKeys::compare(const ColumnKeys& other, int* result) const
+  {
+    if (other.size() != size())
+      XLO_THROW("Cannot compare columns with {0} and {1} rows", size(), other.size());
+    if (other._caseSensitive != _caseSensitive)
+      XLO_THROW("Cannot compare case sensitive and insensitive columns");
+
+    // Partition the rows by the kind of value in both columns, then compare
+    // each run of the same kinds
+    vector<row_t> numbers, strings;
+    for (row_t i = 0; i < size(); ++i)
+    {
+      const auto k = _kinds[i], ko = other._kinds[i];
+      if (k == Number && ko == Number)
+        numbers.push_back(i);
+      else if (k == AsciiString && ko == AsciiString)
+        strings.push_back(i);
+      else if (k == Number && ko == AsciiString)
+        result[i] = -1;
+      else if (k == AsciiString && ko == Number)
+        result[i] = 1;
+      else
+        result[i] = sign(ExcelObj::compare((*this)(i), other(i), _caseSensitive));
+    }
+    for (auto i : numbers)
+      result[i] = compareNumbers(_numbers[i], other._numbers[i]);
+    for (auto i : strings)
+      result[i] = compareKeys(key(i), keyLength(i), other.key(i), other.keyLength(i));
+  }
+
+  void ColumnKeys::hash(size_t* result) const
+  {
+    for (auto i : _numberRows)
+    {
+      // Maps -0 to +0, as ExcelObj::hash
+      const auto x = _numbers[i];
+      result[i] = std::hash<double>()(x == 0 ? 0.0 : x);
+    }
+    for (auto i : _stringRows)
+      result[i] = hashKey(key(i), keyLength(i));
+    for (auto i : _otherRows)
+      result[i] = ExcelObj::hash((*this)(i), _caseSensitive);
+  }
+}
@@ -1,13 +1,16 @@
 #include <xlOil/Date.h>
+#include <xlOil/ExcelArray.h>
 #include <cmath>
+#include <cstdint>
 #include <chrono>
 #include <streambuf>
 #include <istream>
 #include <iomanip>
-#include <unordered_set>
+#include <vector>
+#include <memory>
+#include <cwctype>
 
 using namespace std::chrono;
-using std::unordered_set;
 using std::string;
 using std::wstring;
 
@@ -16,6 +19,46 @@ namespace xloil
   namespace
   {
     constexpr auto microsecsPerDay = double(duration_cast<microseconds>(hours(24)).count());
+
+    /// <summary>
+    /// The month and day of each day of a year which starts on 1 March, 
+    /// packed as month * 32 + day. Starting in March puts the leap day
+    /// at the end, so one table serves every year.
+    /// </summary>
+    struct MarchYearTable
+    {
+      uint16_t monthDay[366];
+
+      constexpr MarchYearTable() : monthDay()
+      {
+        constexpr int monthLengths[] = { 31, 30, 31, 30, 31, 31, 30, 31, 30, 31, 31, 29 };
+        int dayOfYear = 0;
+        for (int m = 0; m < 12; ++m)
+          for (int d = 1; d <= monthLengths[m]; ++d)
+            monthDay[dayOfYear++] = uint16_t(((m + 2) % 12 + 1) * 32 + d);
+      }
+    };
+    constexpr MarchYearTable theMarchYear;
+
+    /// <summary>
+    /// Splits the fractional part of a serial date into a time of day
+    /// </summary>
+    void timeFromDayFraction(
+      double fraction, int& nHours, int& nMins, int& nSecs, int& uSecs) noexcept
+    {
+      auto us = microseconds(long long(fraction * microsecsPerDay));
+      auto secs = duration_cast<seconds>(us);
+      us -= duration_cast<microseconds>(secs);
+      auto mins = duration_cast<minutes>(secs);
+      secs -= duration_cast<seconds>(mins);
+      auto hour = duration_cast<hours>(mins);
+      mins -= duration_cast<minutes>(hour);
+
+      nHours = hour.count();
+      nMins = mins.count();
+      nSecs = (int)secs.count();
+      uSecs = (int)us.count();
+    }
   }
 
   /// Verbatim from https://www.codeproject.com/Articles/2750/Excel-Serial-Date-to-Day-Month-Year-and-Vice-Versa
@@ -55,6 +98,36 @@ namespace xloil
     return true;
   }
 
+  size_t excelSerialDatesToYMD(
+    const int* serials, size_t n, int* years, int* months, int* days) noexcept
+  {
+    size_t nValid = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      const auto serial = serials[i];
+      const int valid = serial >= 0 && serial <= XL_MAX_SERIAL_DATE;
+
+      // Hinnant's civil_from_days, counting from 1 March 0000. The count is
+      // positive for every Excel date so unsigned division can be used.
+      const auto z = unsigned(excelSerialDateToUnixDays(valid ? serial : 0) + 719468);
+      const auto era = z / 146097;
+      const auto dayOfEra = z - era * 146097;
+      const auto yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+      const auto dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+      const auto monthDay = theMarchYear.monthDay[dayOfYear];
+      const int month = monthDay >> 5;
+      const int year = int(era * 400 + yearOfEra) + (month <= 2);
+
+      // Serial 60 is Excel's 29 February 1900, which the count puts on 1 March
+      const auto leapBug = serial == 60;
+      years[i] = valid * year;
+      months[i] = valid * (leapBug ? 2 : month);
+      days[i] = valid * (leapBug ? 29 : monthDay & 31);
+      nValid += valid;
+    }
+    return nValid;
+  }
+
   bool excelSerialDatetoYMDHMS(
     double serial, int &nYear, int &nMonth, int &nDay, int& nHours, int& nMins, int& nSecs, int& uSecs) noexcept
   {
@@ -64,27 +137,15 @@ namespace xloil
 
     double intpart;
     if (std::modf(serial, &intpart) != 0.0)
-    {
-      auto us = microseconds(long long((serial - intpart) * microsecsPerDay));
-      auto secs = duration_cast<seconds>(us);
-      us -= duration_cast<microseconds>(secs);
-      auto mins = duration_cast<minutes>(secs);
-      secs -= duration_cast<seconds>(mins);
-      auto hour = duration_cast<hours>(mins);
-      mins -= duration_cast<minutes>(hour);
-
-      nHours = hour.count();
-      nMins = mins.count();
-      nSecs = (int)secs.count();
-      uSecs = (int)us.count();
-    }
+      timeFromDayFraction(serial - intpart, nHours, nMins, nSecs, uSecs);
     else
       nHours = nMins = nSecs = uSecs = 0;
 
     return excelSerialDateToYMD(int(intpart), nYear, nMonth, nDay);
   }
 
-  /// Verbatim from https://www.codeproject.com/Articles/2750/Excel-Serial-Date-to-Day-Month-Year-and-Vice-Versa
+  /// Adapted from https://www.codeproject.com/Articles/2750/Excel-Serial-Date-to-Day-Month-Year-and-Vice-Versa
+  /// which gave 60 for 28-02-1900 as well as for 29-02-1900
   int excelSerialDateFromYMD(int nYear, int nMonth, int nDay) noexcept
   {
     // Excel/Lotus 123 have a bug with 29-02-1900. 1900 is not a
@@ -99,10 +160,11 @@ namespace xloil
       int((3 * (int((nYear + 4900 + int((nMonth - 14) / 12)) / 100))) / 4) +
       nDay - 2415019 - 32075;
 
-    if (nSerialDate < 60)
+    if (nSerialDate <= 60)
     {
       // Because of the 29-02-1900 bug, any serial date 
-      // under 60 is one off... Compensate.
+      // before 1 March 1900 is one off... Compensate. Without this
+      // 28-02-1900 would also give 60.
       nSerialDate--;
     }
 
@@ -146,37 +208,447 @@ namespace xloil
     }
   };
 
-  unordered_set<wstring> theDateFormats;
+  namespace detail
+  {
+    /// <summary>
+    /// A date format string compiled into a list of simple parsing steps.
+    /// Supports the common subset of `std::get_time` specifiers with
+    /// locale-independent numeric parsing and case-insensitive English 
+    /// month and day names. Formats using any other specifier are parsed
+    /// with `std::get_time` as before.
+    /// </summary>
+    class DateFormat
+    {
+    public:
+      DateFormat(const wchar_t* format)
+        : _format(format)
+        , _fallback(false)
+        , _iso(IsoKind::None)
+      {
+        compile(format);
+      }
+
+      const wstring& format() const { return _format; }
+
+      bool parse(const std::wstring_view& str, std::tm& result) const
+      {
+        memset(&result, 0, sizeof(std::tm));
+
+        if (_fallback)
+          return parseWithGetTime(str, result);
+
+        if (_iso != IsoKind::None && parseIso(str, result))
+          return true;
+
+        return parseSteps(str, result);
+      }
+
+    private:
+      enum class Op : uint8_t
+      {
+        Literal, Space, Year, Year2, Month, Day, Hour, Hour12, 
+        Minute, Second, MonthName, DayName, AmPm
+      };
+
+      enum class IsoKind : uint8_t
+      {
+        None, Date, DateTimeSpace, DateTimeT
+      };
+
+      struct Step
+      {
+        Op op;
+        wchar_t ch;
+      };
+
+      wstring _format;
+      std::vector<Step> _steps;
+      bool _fallback;
+      IsoKind _iso;
+
+      void compile(const wchar_t* f)
+      {
+        for (; *f; ++f)
+        {
+          if (iswspace(*f))
+          {
+            if (_steps.empty() || _steps.back().op != Op::Space)
+              _steps.push_back({ Op::Space, 0 });
+            continue;
+          }
+          if (*f != L'%')
+          {
+            _steps.push_back({ Op::Literal, *f });
+            continue;
+          }
+          switch (*++f)
+          {
+          case L'Y': _steps.push_back({ Op::Year, 0 }); break;
+          case L'y': _steps.push_back({ Op::Year2, 0 }); break;
+          case L'm': _steps.push_back({ Op::Month, 0 }); break;
+          case L'd':
+          case L'e': _steps.push_back({ Op::Day, 0 }); break;
+          case L'H': _steps.push_back({ Op::Hour, 0 }); break;
+          case L'I': _steps.push_back({ Op::Hour12, 0 }); break;
+          case L'M': _steps.push_back({ Op::Minute, 0 }); break;
+          case L'S': _steps.push_back({ Op::Second, 0 }); break;
+          case L'b':
+          case L'B':
+          case L'h': _steps.push_back({ Op::MonthName, 0 }); break;
+          case L'a':
+          case L'A': _steps.push_back({ Op::DayName, 0 }); break;
+          case L'p': _steps.push_back({ Op::AmPm, 0 }); break;
+          case L'%': _steps.push_back({ Op::Literal, L'%' }); break;
+          case L'n':
+          case L't': _steps.push_back({ Op::Space, 0 }); break;
+          case L'F': compile(L"%Y-%m-%d"); break;
+          case L'D': compile(L"%m/%d/%y"); break;
+          case L'T': compile(L"%H:%M:%S"); break;
+          case L'R': compile(L"%H:%M"); break;
+          default:
+            // Includes the terminating null of a trailing '%'
+            _fallback = true;
+            _steps.clear();
+            return;
+          }
+        }
+        if (_format == L"%Y-%m-%d" || _format == L"%F")
+          _iso = IsoKind::Date;
+        else if (_format == L"%Y-%m-%d %H:%M:%S" || _format == L"%F %T")
+          _iso = IsoKind::DateTimeSpace;
+        else if (_format == L"%Y-%m-%dT%H:%M:%S" || _format == L"%FT%T")
+          _iso = IsoKind::DateTimeT;
+      }
+
+      bool parseWithGetTime(const std::wstring_view& str, std::tm& result) const
+      {
+        wimemstream stream(str.data(), str.length());
+        stream >> std::get_time(&result, _format.c_str());
+        return !stream.fail();
+      }
+
+      static bool isDigit(wchar_t c)
+      {
+        return unsigned(c - L'0') < 10u;
+      }
+
+      static int digits(const wchar_t* p, size_t n)
+      {
+        int val = 0;
+        for (size_t i = 0; i < n; ++i)
+          val = val * 10 + (p[i] - L'0');
+        return val;
+      }
+
+      /// <summary>
+      /// Fixed-width fast path for YYYY-MM-DD with an optional HH:MM:SS part.
+      /// Strings which do not have exactly this layout (e.g. no leading zeros)
+      /// drop through to the general step parser.
+      /// </summary>
+      bool parseIso(const std::wstring_view& str, std::tm& result) const
+      {
+        const auto len = _iso == IsoKind::Date ? 10u : 19u;
+        if (str.length() != len)
+          return false;
+        const auto* p = str.data();
+        if (p[4] != L'-' || p[7] != L'-')
+          return false;
+        for (auto i : { 0, 1, 2, 3, 5, 6, 8, 9 })
+          if (!isDigit(p[i]))
+            return false;
+
+        const auto month = digits(p + 5, 2);
+        const auto day = digits(p + 8, 2);
+        if (month < 1 || month > 12 || day < 1 || day > 31)
+          return false;
+        result.tm_year = digits(p, 4) - 1900;
+        result.tm_mon = month - 1;
+        result.tm_mday = day;
+
+        if (_iso == IsoKind::Date)
+          return true;
+
+        if (p[10] != (_iso == IsoKind::DateTimeT ? L'T' : L' ') 
+          || p[13] != L':' || p[16] != L':')
+          return false;
+        for (auto i : { 11, 12, 14, 15, 17, 18 })
+          if (!isDigit(p[i]))
+            return false;
+
+        result.tm_hour = digits(p + 11, 2);
+        result.tm_min = digits(p + 14, 2);
+        result.tm_sec = digits(p + 17, 2);
+        return result.tm_hour < 24 && result.tm_min < 60 && result.tm_sec <= 60;
+      }
+
+      static bool readInt(const wchar_t*& p, const wchar_t* end, 
+        size_t maxDigits, int minVal, int maxVal, int& val)
+      {
+        auto start = p;
+        val = 0;
+        while (p < end && (size_t)(p - start) < maxDigits && isDigit(*p))
+          val = val * 10 + (*p++ - L'0');
+        return p != start && val >= minVal && val <= maxVal;
+      }
+
+      static bool matchName(const wchar_t*& p, const wchar_t* end, 
+        const wchar_t* const* names, size_t nNames, int& index)
+      {
+        for (size_t i = 0; i < nNames; ++i)
+        {
+          const auto* name = names[i];
+          const auto nameLen = wcslen(name);
+          size_t n = 0;
+          while (n < nameLen && p + n < end && (wchar_t)towlower(p[n]) == name[n])
+            ++n;
+          // Accept the full name or its three letter abbreviation, but not
+          // when it is followed by more letters, e.g. "Junk"
+          if ((n == nameLen || n == 3) && (p + n == end || !iswalpha(p[n])))
+          {
+            p += n;
+            index = (int)i;
+            return true;
+          }
+        }
+        return false;
+      }
+
+      bool parseSteps(const std::wstring_view& str, std::tm& result) const
+      {
+        static constexpr const wchar_t* monthNames[] = {
+          L"january", L"february", L"march", L"april", L"may", L"june", L"july",
+          L"august", L"september", L"october", L"november", L"december" };
+        static constexpr const wchar_t* dayNames[] = {
+          L"sunday", L"monday", L"tuesday", L"wednesday", L"thursday", 
+          L"friday", L"saturday" };
+
+        const auto* p = str.data();
+        const auto* end = p + str.length();
+        int pm = -1;
+        bool hour12 = false;
+
+        for (auto& step : _steps)
+        {
+          int val;
+          switch (step.op)
+          {
+          case Op::Literal:
+            if (p == end || *p != step.ch)
+              return false;
+            ++p;
+            break;
+          case Op::Space:
+            while (p < end && iswspace(*p))
+              ++p;
+            break;
+          case Op::Year:
+            if (!readInt(p, end, 4, 0, 9999, val))
+              return false;
+            result.tm_year = val - 1900;
+            break;
+          case Op::Year2:
+            if (!readInt(p, end, 2, 0, 99, val))
+              return false;
+            // POSIX convention: 69-99 are 1969-1999, 00-68 are 2000-2068
+            result.tm_year = val < 69 ? val + 100 : val;
+            break;
+          case Op::Month:
+            if (!readInt(p, end, 2, 1, 12, val))
+              return false;
+            result.tm_mon = val - 1;
+            break;
+          case Op::Day:
+            if (p < end && *p == L' ') // %e may be space padded
+              ++p;
+            if (!readInt(p, end, 2, 1, 31, result.tm_mday))
+              return false;
+            break;
+          case Op::Hour:
+            if (!readInt(p, end, 2, 0, 23, result.tm_hour))
+              return false;
+            break;
+          case Op::Hour12:
+            if (!readInt(p, end, 2, 1, 12, result.tm_hour))
+              return false;
+            hour12 = true;
+            break;
+          case Op::Minute:
+            if (!readInt(p, end, 2, 0, 59, result.tm_min))
+              return false;
+            break;
+          case Op::Second:
+            if (!readInt(p, end, 2, 0, 60, result.tm_sec))
+              return false;
+            break;
+          case Op::MonthName:
+            if (!matchName(p, end, monthNames, _countof(monthNames), result.tm_mon))
+              return false;
+            break;
+          case Op::DayName:
+            if (!matchName(p, end, dayNames, _countof(dayNames), result.tm_wday))
+              return false;
+            break;
+          case Op::AmPm:
+            if (end - p < 2 || towlower(p[1]) != L'm')
+              return false;
+            if (towlower(*p) == L'a')
+              pm = 0;
+            else if (towlower(*p) == L'p')
+              pm = 1;
+            else
+              return false;
+            p += 2;
+            break;
+          }
+        }
+
+        // Unlike get_time, we require the entire string to be consumed
+        // (trailing whitespace aside) so that a date-only format does 
+        // not match the prefix of a date-time string.
+        while (p < end && iswspace(*p))
+          ++p;
+        if (p != end)
+          return false;
+
+        if (hour12 || pm >= 0)
+          result.tm_hour = result.tm_hour % 12 + (pm == 1 ? 12 : 0);
+
+        return true;
+      }
+    };
+  }
+
+  namespace
+  {
+    std::vector<std::shared_ptr<const detail::DateFormat>> theDateFormats;
+  }
+
+  DateTimeParser::DateTimeParser(const wchar_t* format)
+    : _lastMatch(0)
+  {
+    if (format)
+      _format = std::make_shared<detail::DateFormat>(format);
+  }
+
+  bool DateTimeParser::operator()(
+    const std::wstring_view& str, 
+    std::tm& result)
+  {
+    if (_format)
+      return _format->parse(str, result);
+
+    const auto nFormats = theDateFormats.size();
+
+    // Try the format which last succeeded first: strings in a column 
+    // generally share a format.
+    if (_lastMatch < nFormats && theDateFormats[_lastMatch]->parse(str, result))
+      return true;
+
+    for (size_t i = 0; i < nFormats; ++i)
+    {
+      if (i != _lastMatch && theDateFormats[i]->parse(str, result))
+      {
+        _lastMatch = i;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  size_t DateTimeParser::parse(
+    const ExcelArray& values, 
+    std::tm* results, 
+    bool* valid)
+  {
+    // Strings are parsed as we go. Numbers are collected and converted 
+    // together with excelSerialDatesToYMD.
+    std::vector<double> numbers;
+    std::vector<size_t> numberIndex;
+
+    size_t nParsed = 0;
+    size_t i = 0;
+    for (auto p = values.begin(); p != values.end(); ++p, ++i)
+    {
+      results[i] = std::tm{};
+      bool ok = false;
+      switch (p->type())
+      {
+      case ExcelType::Str:
+        ok = (*this)(p->cast<PStringRef>().view(), results[i]);
+        break;
+      case ExcelType::Int:
+      case ExcelType::Num:
+        numbers.push_back(p->get<double>());
+        numberIndex.push_back(i);
+        continue;
+      default:
+        break;
+      }
+      if (valid)
+        valid[i] = ok;
+      if (ok)
+        ++nParsed;
+    }
+
+    const auto n = numbers.size();
+    std::vector<int> serials(n), ymd(3 * n);
+    for (size_t k = 0; k < n; ++k)
+    {
+      // Out of range serials, including NaN, give an invalid date
+      const auto x = numbers[k];
+      serials[k] = x >= 0 && x < XL_MAX_SERIAL_DATE + 1 ? (int)x : -1;
+    }
+    excelSerialDatesToYMD(serials.data(), n, ymd.data(), ymd.data() + n, ymd.data() + 2 * n);
+
+    for (size_t k = 0; k < n; ++k)
+    {
+      const auto ok = ymd[k] != 0;
+      auto& tm = results[numberIndex[k]];
+      if (ok)
+      {
+        tm.tm_year = ymd[k] - 1900;
+        tm.tm_mon = ymd[n + k] - 1;
+        tm.tm_mday = ymd[2 * n + k];
+        const auto fraction = numbers[k] - serials[k];
+        if (fraction != 0)
+        {
+          int uSecs;
+          timeFromDayFraction(fraction, tm.tm_hour, tm.tm_min, tm.tm_sec, uSecs);
+        }
+        ++nParsed;
+      }
+      if (valid)
+        valid[numberIndex[k]] = ok;
+    }
+    return nParsed;
+  }
 
   bool stringToDateTime(
     const std::wstring_view& str,
     std::tm& result, 
     const wchar_t* format)
   {
-    wimemstream stream(str.data(), str.length());
-    memset(&result, 0, sizeof(std::tm));
-
     if (format)
     {
-      stream >> std::get_time(&result, format);
-      return !stream.fail();
+      // Recompiling the format is cheap, but avoid it when the same
+      // format is used repeatedly, as it is by ParseDateVisitor
+      thread_local std::shared_ptr<const detail::DateFormat> lastFormat;
+      if (!lastFormat || lastFormat->format() != format)
+        lastFormat = std::make_shared<detail::DateFormat>(format);
+      return lastFormat->parse(str, result);
     }
     else
     {
-      for (auto& form : theDateFormats)
-      {
-        stream >> std::get_time(&result, form.c_str());
-        if (!stream.fail())
-          return true;
-        stream.clear();
-        stream.str(str.data(), str.length());
-      }
-      return false;
+      thread_local DateTimeParser parser;
+      return parser(str, result);
     }
   }
 
   void dateTimeAddFormat(const wchar_t* f)
   {
-    theDateFormats.insert(f);
+    for (auto& form : theDateFormats)
+      if (form->format() == f)
+        return;
+    theDateFormats.push_back(std::make_shared<detail::DateFormat>(f));
   }
 }
\ No newline at end of file
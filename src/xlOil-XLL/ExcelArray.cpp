@@ -40,11 +40,12 @@ namespace xloil
     if (dims() == 0)
       return ExcelObj();
 
-    size_t strLen = 0;
+    // Repeated strings, common in sub-arrays of tables, are stored once
+    ArrayStringCounter strings;
     for (auto& v : (*this))
-      strLen += v.stringLength();
+      strings.add(v);
 
-    ExcelArrayBuilder builder(nRows(), nCols(), strLen);
+    ExcelArrayBuilder builder(nRows(), nCols(), strings);
     for (auto i = 0u; i < nRows(); ++i)
       for (auto j = 0u; j < nCols(); ++j)
         builder(i, j) = at(i, j);
@@ -9,9 +9,13 @@
 #include <xloil/ArrayBuilder.h>
 #include <xloil/ExcelArray.h>
 #include <xloil/StringUtils.h>
+#include <xlOil/WindowsSlim.h>
 #include <array>
 #include <algorithm>
+#include <charconv>
+#include <clocale>
 #include <cstring>
+#include <cwctype>
 #include <vector>
 #include <string>
 
@@ -35,6 +39,73 @@ namespace
     return buf;
   }
 
+  // The longest shortest-roundtrip double, e.g. -2.2250738585072014E-308
+  constexpr size_t MAX_NUMBER_CHARS = 24;
+  // The longest error string, #GETTING_DATA
+  constexpr size_t MAX_ERROR_CHARS = 13;
+
+  /// <summary>
+  /// Appends the ASCII chars written by to_chars, upper-casing them to give
+  /// the same exponent and inf/nan style as printf's %G
+  /// </summary>
+  void appendChars(wstring& out, const char* begin, const char* end)
+  {
+    wchar_t buf[32];
+    auto* p = buf;
+    for (; begin != end; ++begin, ++p)
+      *p = *begin >= 'a' && *begin <= 'z' ? wchar_t(*begin - 0x20) : wchar_t(*begin);
+    out.append(buf, p);
+  }
+
+  void appendNumber(wstring& out, double x)
+  {
+    char buf[32];
+    // Without a format, to_chars gives the shortest string which round-trips
+    appendChars(out, buf, std::to_chars(buf, buf + sizeof(buf), x).ptr);
+  }
+
+  void appendInt(wstring& out, int x)
+  {
+    char buf[16];
+    appendChars(out, buf, std::to_chars(buf, buf + sizeof(buf), x).ptr);
+  }
+
+  /// <summary>
+  /// Bounds the length of the string written by appendStringRecursive. 
+  /// Unlike maxStringLength this is not capped. Refs are not resolved, 
+  /// so contribute nothing: the output then grows as it is written.
+  /// </summary>
+  size_t stringLengthBound(const ExcelObj& obj, size_t separatorLength)
+  {
+    switch (obj.xtype())
+    {
+    case xltypeNum:
+    case xltypeInt:
+      return MAX_NUMBER_CHARS;
+    case xltypeBool:
+      return 5;
+    case xltypeStr:
+      return obj.val.str ? obj.val.str[0] : 0;
+    case xltypeMissing:
+    case xltypeNil:
+    case xltypeSRef:
+    case xltypeRef:
+      return 0;
+    case xltypeErr:
+      return MAX_ERROR_CHARS;
+    case xltypeMulti:
+    {
+      const ExcelArray arr(obj);
+      size_t n = 0;
+      for (auto& x : arr)
+        n += stringLengthBound(x, 0);
+      return n + (arr.size() > 0 ? (arr.size() - 1) * separatorLength : 0);
+    }
+    default:
+      return 4;
+    }
+  }
+
   wchar_t* pascalWStringFromC(const char* cstr, size_t len)
   {
     assert(cstr);
@@ -297,57 +368,157 @@ namespace
     return doCompare<Compare>(left, right, caseSensitive, recursive);
   }
 
+  size_t ExcelObj::hash(const ExcelObj& value, bool caseSensitive) noexcept
+  {
+    switch (value.xtype())
+    {
+    case xltypeNum:
+      // Maps -0 to +0, which compare as equal
+      return std::hash<double>()(value.val.num == 0 ? 0.0 : value.val.num);
+    case xltypeInt:
+      return std::hash<double>()(value.val.w);
+    case xltypeBool:
+      return std::hash<double>()(value.val.xbool ? 1 : 0);
+    case xltypeStr:
+    {
+      // FNV-1a on the case-folded characters
+      const auto len = value.val.str[0];
+      const auto* c = value.val.str + 1;
+      size_t h = 14695981039346656037ull;
+      if (caseSensitive)
+        for (auto i = 0; i < len; ++i)
+          h = (h ^ c[i]) * 1099511628211ull;
+      else
+        for (auto i = 0; i < len; ++i)
+          h = (h ^ (wchar_t)towlower(c[i])) * 1099511628211ull;
+      return h;
+    }
+    case xltypeErr:
+      return boost_hash_combine(xltypeErr, value.val.err);
+    case xltypeSRef:
+    case xltypeRef:
+    {
+      // Compared by address string, so the sheet and first area identify it
+      const auto& ref = value.xtype() == xltypeSRef
+        ? value.val.sref.ref
+        : value.val.mref.lpmref->reftbl[0];
+      return boost_hash_combine(value.xtype(),
+        value.xtype() == xltypeRef ? value.val.mref.idSheet : 0,
+        ref.rwFirst, ref.rwLast, ref.colFirst, ref.colLast);
+    }
+    case xltypeMulti:
+      return boost_hash_combine(xltypeMulti, 
+        value.val.array.rows * value.val.array.columns);
+    default:
+      return value.xtype();
+    }
+  }
+
+  bool ExcelObj::stringHashMatchesCompare() noexcept
+  {
+    // In the "C" locale _wcsnicoll is _wcsnicmp, which folds case with
+    // towlower like the hash. Other collations may ignore characters
+    // or treat different characters as equal.
+    const auto* collate = setlocale(LC_COLLATE, nullptr);
+    return collate && strcmp(collate, "C") == 0;
+  }
+
+  size_t ExcelObj::collatedHash(const ExcelObj& value, bool caseSensitive) noexcept
+  {
+    // The CRT's collation locale is null in the "C" locale
+    const auto* locale = ___lc_locale_name_func()[LC_COLLATE];
+    if (value.xtype() != xltypeStr || !locale)
+      return hash(value, caseSensitive);
+
+    // Strings which _wcsncoll or _wcsnicoll find equal have equal sort keys
+    // when mapped with the same flags. Compare also requires equal lengths.
+    const auto len = value.val.str[0];
+    const auto* str = value.val.str + 1;
+    const DWORD flags = LCMAP_SORTKEY | SORT_STRINGSORT | (caseSensitive ? 0 : NORM_IGNORECASE);
+
+    std::array<BYTE, 512> buffer;
+    vector<BYTE> large;
+    auto* key = buffer.data();
+    int nBytes = 0;
+    if (len > 0)
+    {
+      nBytes = LCMapStringEx(locale, flags, str, len, 
+        (LPWSTR)key, (int)buffer.size(), nullptr, nullptr, 0);
+      if (nBytes == 0)
+      {
+        large.resize(LCMapStringEx(locale, flags, str, len, nullptr, 0, nullptr, nullptr, 0));
+        key = large.data();
+        nBytes = LCMapStringEx(locale, flags, str, len,
+          (LPWSTR)key, (int)large.size(), nullptr, nullptr, 0);
+      }
+    }
+
+    size_t h = 14695981039346656037ull;
+    for (auto i = 0; i < nBytes; ++i)
+      h = (h ^ key[i]) * 1099511628211ull;
+    return boost_hash_combine(h, len);
+  }
+
   std::wstring ExcelObj::toStringRecursive(const wchar_t* separator) const
   {
+    wstring str;
+    appendStringRecursive(str, separator);
+    return str;
+  }
+
+  void ExcelObj::appendStringRecursive(std::wstring& out, const wchar_t* separator) const
+  {
+    const size_t sepLength = separator ? wcslen(separator) : 0;
+    out.reserve(out.size() + stringLengthBound(*this, sepLength));
+
     switch (xtype())
     {
     case xltypeNum:
-      return formatStr(L"%G", val.num);
+      appendNumber(out, val.num);
+      break;
 
     case xltypeBool:
-      return wstring(val.xbool ? L"TRUE" : L"FALSE");
+      out.append(val.xbool ? L"TRUE" : L"FALSE");
+      break;
 
     case xltypeInt:
-      return std::to_wstring(val.w);
+      appendInt(out, val.w);
+      break;
 
     case xltypeStr:
-    {
-      const size_t len = val.str ? val.str[0] : 0;
-      return len == 0 ? wstring() : wstring(val.str + 1, len);
-    }
+      if (val.str)
+        out.append(val.str + 1, val.str[0]);
+      break;
 
     case xltypeMissing:
     case xltypeNil:
-      return L"";
+      break;
 
     case xltypeErr:
-      return enumAsWCString(CellError(val.err));
+      out.append(enumAsWCString(CellError(val.err)));
+      break;
 
     case xltypeSRef:
     case xltypeRef:
-      return ExcelRef(*this).value().toStringRecursive(separator);
+      ExcelRef(*this).value().appendStringRecursive(out, separator);
+      break;
 
     case xltypeMulti:
     {
       ExcelArray arr(*this); // Note that this trims the array
-      wstring str;
-      str.reserve(arr.size() * 8); // 8 is an arb choice
-      if (separator)
+      auto first = true;
+      for (auto& x : arr)
       {
-        wstring sep(separator);
-        for (ExcelArray::size_type i = 0; i < arr.size(); ++i)
-          str += arr(i).toStringRecursive() + sep;
-        if (!str.empty())
-          str.erase(str.size() - sep.length());
+        if (!first)
+          out.append(separator, sepLength);
+        first = false;
+        x.appendStringRecursive(out);
       }
-      else
-        for (ExcelArray::size_type i = 0; i < arr.size(); ++i)
-          str += arr(i).toStringRecursive();
-      return str;
+      break;
     }
 
     default:
-      return L"#???";
+      out.append(L"#???");
     }
   }
   std::wstring ExcelObj::toString() const noexcept
@@ -381,7 +552,7 @@ namespace
     {
     case xltypeInt:
     case xltypeNum:
-      return 20;
+      return MAX_NUMBER_CHARS;
 
     case xltypeBool:
       return 5;
@@ -394,7 +565,7 @@ namespace
       return 0;
 
     case xltypeErr:
-      return 8;
+      return MAX_ERROR_CHARS;
 
     case xltypeSRef:
       return XL_CELL_ADDRESS_RC_MAX_LEN + XL_SHEET_NAME_MAX_LEN;
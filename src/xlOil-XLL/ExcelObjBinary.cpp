@@ -0,0 +1,325 @@
+#include <xloil/ExcelObjBinary.h>
+#include <xloil/ArrayBuilder.h>
+#include <xloil/ExcelArray.h>
+#include <xloil/Throw.h>
+#include <algorithm>
+
+using std::vector;
+using std::wstring_view;
+using namespace msxll;
+
+namespace xloil
+{
+  namespace Binary
+  {
+    namespace
+    {
+      Tag tagFor(const ExcelObj& obj)
+      {
+        switch (obj.type())
+        {
+        case ExcelType::Nil:     return Tag::Nil;
+        case ExcelType::Num:     return Tag::Num;
+        case ExcelType::Int:     return Tag::Int;
+        case ExcelType::Bool:    return Tag::Bool;
+        case ExcelType::Err:     return Tag::Err;
+        case ExcelType::Str:     return Tag::Str;
+        case ExcelType::Missing: return Tag::Missing;
+        default:
+          XLO_THROW(L"Cannot write ExcelObj of type {0} in binary format",
+            enumAsWCString(obj.type()));
+        }
+      }
+
+      uint64_t valueBits(const ExcelObj& obj)
+      {
+        uint64_t bits = 0;
+        int32_t i;
+        switch (obj.type())
+        {
+        case ExcelType::Num:
+          memcpy(&bits, &obj.val.num, sizeof(double));
+          break;
+        case ExcelType::Int:  i = obj.val.w; memcpy(&bits, &i, sizeof(i)); break;
+        case ExcelType::Bool: i = obj.val.xbool ? 1 : 0; memcpy(&bits, &i, sizeof(i)); break;
+        case ExcelType::Err:  i = obj.val.err; memcpy(&bits, &i, sizeof(i)); break;
+        default:
+          break;
+        }
+        return bits;
+      }
+
+      /// <summary>
+      /// Gives the cells of an array or a single value as a 1x1 array
+      /// </summary>
+      struct Cells
+      {
+        Cells(const ExcelObj& obj)
+        {
+          if (obj.isType(ExcelType::Multi))
+          {
+            data = (const ExcelObj*)obj.val.array.lparray;
+            nRows = obj.val.array.rows;
+            nCols = obj.val.array.columns;
+            flags = IS_ARRAY;
+          }
+          else
+          {
+            data = &obj;
+            nRows = nCols = 1;
+            flags = 0;
+          }
+        }
+        size_t size() const { return (size_t)nRows * nCols; }
+
+        const ExcelObj* data;
+        uint32_t nRows, nCols;
+        uint16_t flags;
+      };
+
+      size_t heapLength(const Cells& cells)
+      {
+        size_t total = 0;
+        for (size_t i = 0; i < cells.size(); ++i)
+        {
+          auto& cell = cells.data[i];
+          if (tagFor(cell) == Tag::Str)
+            total += 1 + cell.cast<PStringRef>().length();
+        }
+        return total;
+      }
+
+      void writeHeader(char* buffer, uint32_t nRows, uint32_t nCols,
+        uint16_t flags, size_t heapLength, size_t size)
+      {
+        Header header{ MAGIC, VERSION, flags, nRows, nCols, heapLength, size };
+        memcpy(buffer, &header, sizeof(Header));
+      }
+    }
+
+    size_t encodedSize(const ExcelObj& obj)
+    {
+      Cells cells(obj);
+      return Layout(cells.size(), heapLength(cells)).size;
+    }
+
+    size_t encode(const ExcelObj& obj, char* buffer, size_t bufferSize)
+    {
+      Cells cells(obj);
+      const auto nCells = cells.size();
+      const auto heapLen = heapLength(cells);
+      const Layout layout(nCells, heapLen);
+      if (bufferSize < layout.size)
+        XLO_THROW("Buffer too small to write ExcelObj: need {0} bytes, have {1}",
+          layout.size, bufferSize);
+
+      // Zero the padding so the output is deterministic
+      memset(buffer, 0, layout.size);
+      writeHeader(buffer, cells.nRows, cells.nCols, cells.flags, heapLen, layout.size);
+
+      auto* tags = (uint8_t*)(buffer + layout.tags);
+      auto* values = buffer + layout.values;
+      auto* heap = (wchar_t*)(buffer + layout.heap);
+      uint64_t heapPos = 0;
+
+      for (size_t i = 0; i < nCells; ++i)
+      {
+        auto& cell = cells.data[i];
+        const auto tag = tagFor(cell);
+        tags[i] = (uint8_t)tag;
+        uint64_t bits;
+        if (tag == Tag::Str)
+        {
+          // Copy the pascal string including its length prefix
+          const auto len = cell.cast<PStringRef>().length() + 1u;
+          wmemcpy(heap + heapPos, cell.val.str, len);
+          bits = heapPos;
+          heapPos += len;
+        }
+        else
+          bits = valueBits(cell);
+        memcpy(values + i * sizeof(double), &bits, sizeof(bits));
+      }
+      return layout.size;
+    }
+
+    std::vector<char> encode(const ExcelObj& obj)
+    {
+      vector<char> result(encodedSize(obj));
+      encode(obj, result.data(), result.size());
+      return result;
+    }
+
+    ExcelObj decode(const void* data, size_t size)
+    {
+      return BinaryView(data, size).toExcelObj();
+    }
+  }
+
+  BinaryView::BinaryView(const void* data, size_t size)
+  {
+    if (size < sizeof(Binary::Header))
+      XLO_THROW("Binary ExcelObj data too short");
+
+    _header = (const Binary::Header*)data;
+    if (_header->magic != Binary::MAGIC)
+      XLO_THROW("Data is not a binary ExcelObj");
+    if (_header->version > Binary::VERSION)
+      XLO_THROW("Binary ExcelObj has version {0}, this reader supports up to {1}",
+        _header->version, Binary::VERSION);
+
+    if (!isArray() && this->size() != 1)
+      XLO_THROW("Binary ExcelObj is not an array but has {0} cells", this->size());
+
+    // Every cell takes at least a tag and a value, so a cell count or heap
+    // larger than the data is corrupt. Rejecting them first means the layout
+    // arithmetic below cannot overflow.
+    const auto available = size - sizeof(Binary::Header);
+    if (this->size() > available / (1 + sizeof(double))
+      || _header->heapLength > available / sizeof(wchar_t))
+      XLO_THROW("Binary ExcelObj data is truncated or corrupt");
+
+    const Binary::Layout layout(this->size(), (size_t)_header->heapLength);
+    if (_header->size != layout.size || size < layout.size)
+      XLO_THROW("Binary ExcelObj data is truncated or corrupt");
+
+    auto bytes = (const char*)data;
+    _tags = (const uint8_t*)(bytes + layout.tags);
+    _values = bytes + layout.values;
+    _heap = (const wchar_t*)(bytes + layout.heap);
+
+    // Check the strings lie within the heap so later reads need no checks
+    for (size_t i = 0; i < this->size(); ++i)
+    {
+      if (_tags[i] > (uint8_t)Binary::Tag::Missing)
+        XLO_THROW("Binary ExcelObj has unknown type tag {0}", _tags[i]);
+      if (tag(i) == Binary::Tag::Str)
+      {
+        uint64_t offset;
+        memcpy(&offset, _values + i * sizeof(double), sizeof(offset));
+        if (offset >= _header->heapLength
+          || offset + 1 + (uint16_t)_heap[offset] > _header->heapLength)
+          XLO_THROW("Binary ExcelObj string out of bounds");
+      }
+    }
+  }
+
+  ExcelObj BinaryView::operator[](size_t i) const
+  {
+    switch (tag(i))
+    {
+    case Binary::Tag::Num:     return ExcelObj(number(i));
+    case Binary::Tag::Int:     return ExcelObj(integer(i));
+    case Binary::Tag::Bool:    return ExcelObj(integer(i) != 0);
+    case Binary::Tag::Err:     return ExcelObj((CellError)integer(i));
+    case Binary::Tag::Str:     return ExcelObj(string(i));
+    case Binary::Tag::Missing: return ExcelObj(nullptr);
+    default:                   return ExcelObj();
+    }
+  }
+
+  ExcelObj BinaryView::toExcelObj() const
+  {
+    if (!isArray())
+      return (*this)[0];
+
+    // The heap length includes the length prefixes so is an over-estimate
+    ExcelArrayBuilder builder(nRows(), nCols(), (size_t)_header->heapLength);
+    for (size_t i = 0; i < size(); ++i)
+    {
+      switch (tag(i))
+      {
+      case Binary::Tag::Num:     builder(i) = number(i); break;
+      case Binary::Tag::Int:     builder(i) = integer(i); break;
+      case Binary::Tag::Bool:    builder(i).emplace(ExcelObj(integer(i) != 0)); break;
+      case Binary::Tag::Err:     builder(i) = (CellError)integer(i); break;
+      case Binary::Tag::Str:     builder(i) = string(i); break;
+      case Binary::Tag::Missing: builder(i).emplace(ExcelObj(nullptr)); break;
+      default:                   builder(i).emplace(ExcelObj()); break;
+      }
+    }
+    return builder.toExcelObj();
+  }
+
+  ExcelObj BinaryView::toExcelObjView() const
+  {
+    if (!isArray())
+      return (*this)[0];
+
+    // Allocate as char[] as this is how ExcelObj frees arrays. The strings
+    // are not freed as they are assumed to lie in the same block.
+    auto* cells = (ExcelObj*)new char[sizeof(ExcelObj) * size()];
+    for (size_t i = 0; i < size(); ++i)
+    {
+      if (tag(i) == Binary::Tag::Str)
+      {
+        auto* cell = new (cells + i) ExcelObj();
+        cell->xltype = xltypeStr;
+        cell->val.str = const_cast<wchar_t*>(pstr(i));
+      }
+      else
+        new (cells + i) ExcelObj((*this)[i]);
+    }
+    return ExcelObj(cells, (int)nRows(), (int)nCols());
+  }
+
+  BinaryWriter::BinaryWriter(row_t nRows, col_t nCols, size_t heapReserve)
+    : _nRows(nRows)
+    , _nCols(nCols)
+    , _tags((size_t)nRows * nCols, (uint8_t)Binary::Tag::Nil)
+    , _values((size_t)nRows * nCols, 0)
+  {
+    if (nRows == 0 || nCols == 0)
+      XLO_THROW("BinaryWriter: cannot create empty array");
+    _heap.reserve(heapReserve);
+  }
+
+  void BinaryWriter::setString(size_t i, const std::wstring_view& str)
+  {
+    const auto len = std::min<size_t>(str.size(), XL_STRING_MAX_LEN);
+    const uint64_t offset = _heap.size();
+    _heap.push_back((wchar_t)len);
+    _heap.insert(_heap.end(), str.data(), str.data() + len);
+    _tags[i] = (uint8_t)Binary::Tag::Str;
+    _values[i] = offset;
+  }
+
+  void BinaryWriter::setValue(size_t i, const ExcelObj& x)
+  {
+    const auto tag = Binary::tagFor(x);
+    if (tag == Binary::Tag::Str)
+      setString(i, x.cast<PStringRef>());
+    else
+    {
+      _tags[i] = (uint8_t)tag;
+      _values[i] = Binary::valueBits(x);
+    }
+  }
+
+  size_t BinaryWriter::byteSize() const
+  {
+    return Binary::Layout(_tags.size(), _heap.size()).size;
+  }
+
+  void BinaryWriter::writeTo(char* buffer, size_t bufferSize) const
+  {
+    const Binary::Layout layout(_tags.size(), _heap.size());
+    if (bufferSize < layout.size)
+      XLO_THROW("Buffer too small for BinaryWriter: need {0} bytes, have {1}",
+        layout.size, bufferSize);
+
+    memset(buffer, 0, layout.size);
+    Binary::writeHeader(buffer, _nRows, _nCols, Binary::IS_ARRAY, _heap.size(), layout.size);
+    memcpy(buffer + layout.tags, _tags.data(), _tags.size());
+    memcpy(buffer + layout.values, _values.data(), _values.size() * sizeof(uint64_t));
+    if (!_heap.empty())
+      memcpy(buffer + layout.heap, _heap.data(), _heap.size() * sizeof(wchar_t));
+  }
+
+  std::vector<char> BinaryWriter::toBytes() const
+  {
+    vector<char> result(byteSize());
+    writeTo(result.data(), result.size());
+    return result;
+  }
+}
@@ -0,0 +1,329 @@
+#include <xloil/Profile.h>
+#include <xloil/Events.h>
+#include <xloil/Log.h>
+#include <xloil/StringUtils.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+using std::vector;
+using std::wstring;
+using std::unique_ptr;
+using std::atomic;
+using std::memory_order_relaxed;
+using namespace std::chrono;
+
+namespace xloil
+{
+  namespace Profile
+  {
+    namespace
+    {
+      /// <summary>
+      /// Counters for one function on one thread. Only the owning thread
+      /// writes, so updates are a relaxed load and store rather than an
+      /// interlocked add. The merging thread only reads, except that a reset
+      /// zeros the maximum, which cannot be rebased like the sums. A call
+      /// recorded during the reset may be missed from the maximum.
+      /// </summary>
+      struct Counters
+      {
+        atomic<uint64_t> calls;
+        atomic<uint64_t> errors;
+        atomic<uint64_t> phaseNanos[NUM_PHASES];
+        atomic<uint64_t> maxNanos;
+        atomic<uint64_t> histogram[NUM_BUCKETS];
+      };
+
+      inline void bump(atomic<uint64_t>& x, uint64_t n = 1) noexcept
+      {
+        x.store(x.load(memory_order_relaxed) + n, memory_order_relaxed);
+      }
+
+      /// <summary>
+      /// Counters are allocated in chunks so that a thread's storage can
+      /// grow as functions are registered without moving counters which
+      /// the merging thread may be reading.
+      /// </summary>
+      constexpr size_t CHUNK_SIZE = 64;
+      constexpr size_t MAX_CHUNKS = 256;
+
+      struct ThreadCounters
+      {
+        atomic<Counters*> chunks[MAX_CHUNKS] = {};
+
+        ~ThreadCounters()
+        {
+          for (auto& chunk : chunks)
+            delete[] chunk.load();
+        }
+
+        Counters* find(unsigned id) const noexcept
+        {
+          auto* chunk = chunks[id / CHUNK_SIZE].load(std::memory_order_acquire);
+          return chunk ? chunk + id % CHUNK_SIZE : nullptr;
+        }
+
+        Counters* get(unsigned id)
+        {
+          auto& slot = chunks[id / CHUNK_SIZE];
+          auto* chunk = slot.load(memory_order_relaxed);
+          if (!chunk)
+          {
+            chunk = new Counters[CHUNK_SIZE]();
+            slot.store(chunk, std::memory_order_release);
+          }
+          return chunk + id % CHUNK_SIZE;
+        }
+      };
+
+      struct Totals
+      {
+        uint64_t calls = 0;
+        uint64_t errors = 0;
+        uint64_t phaseNanos[NUM_PHASES] = {};
+        uint64_t maxNanos = 0;
+        uint64_t histogram[NUM_BUCKETS] = {};
+      };
+
+      struct Registry
+      {
+        std::mutex lock;
+        std::unordered_map<wstring, unsigned> ids;
+        // Full names, indexed by ID
+        vector<wstring> names;
+        // Thread counters are never freed before shutdown so that counts
+        // from threads which have exited are kept
+        vector<unique_ptr<ThreadCounters>> threads;
+        // Totals at the last reset, subtracted from subsequent merges
+        vector<Totals> baseline;
+        vector<FunctionStats> snapshot;
+        seconds logInterval = seconds(0);
+        steady_clock::time_point lastLog = steady_clock::now();
+
+        static Registry& get()
+        {
+          static Registry instance;
+          return instance;
+        }
+      };
+
+      atomic<bool> theEnabled = false;
+
+      ThreadCounters& threadCounters()
+      {
+        thread_local ThreadCounters* counters = nullptr;
+        if (!counters)
+        {
+          auto& registry = Registry::get();
+          std::scoped_lock lock(registry.lock);
+          counters = registry.threads.emplace_back(new ThreadCounters()).get();
+        }
+        return *counters;
+      }
+
+      size_t bucket(uint64_t nanos) noexcept
+      {
+        auto micros = nanos / 1000;
+        size_t i = 0;
+        while (micros > 0 && i < NUM_BUCKETS - 1)
+        {
+          micros >>= 1;
+          ++i;
+        }
+        return i;
+      }
+
+      vector<Totals> sumThreads(Registry& registry)
+      {
+        vector<Totals> totals(registry.names.size());
+        for (auto& thread : registry.threads)
+        {
+          for (unsigned id = 0; id < totals.size(); ++id)
+          {
+            auto* c = thread->find(id);
+            if (!c)
+            {
+              // Skip to the next chunk
+              id = (unsigned)((id / CHUNK_SIZE + 1) * CHUNK_SIZE - 1);
+              continue;
+            }
+            auto& t = totals[id];
+            t.calls += c->calls.load(memory_order_relaxed);
+            t.errors += c->errors.load(memory_order_relaxed);
+            for (auto p = 0u; p < NUM_PHASES; ++p)
+              t.phaseNanos[p] += c->phaseNanos[p].load(memory_order_relaxed);
+            t.maxNanos = std::max(t.maxNanos, c->maxNanos.load(memory_order_relaxed));
+            for (auto b = 0u; b < NUM_BUCKETS; ++b)
+              t.histogram[b] += c->histogram[b].load(memory_order_relaxed);
+          }
+        }
+        return totals;
+      }
+
+      void writeToLog(const vector<FunctionStats>& stats)
+      {
+        constexpr size_t maxFuncs = 20;
+        XLO_INFO("Function profile: {} functions called", stats.size());
+        for (size_t i = 0; i < std::min(maxFuncs, stats.size()); ++i)
+        {
+          auto& s = stats[i];
+          XLO_INFO(L"  {0}: calls={1} errors={2} total={3:.3f}s args={4:.3f}s "
+            "body={5:.3f}s return={6:.3f}s max={7:.6f}s",
+            s.name, s.calls, s.errors, s.totalTime(),
+            s.phaseTime[0], s.phaseTime[1], s.phaseTime[2], s.maxTime);
+        }
+      }
+
+      static auto mergeHandler = Event::AfterCalculate() += []()
+      {
+        if (theEnabled)
+          merge();
+      };
+    }
+
+    double FunctionStats::quantile(double q) const
+    {
+      const auto target = (uint64_t)(q * calls);
+      uint64_t count = 0;
+      for (size_t i = 0; i < NUM_BUCKETS; ++i)
+      {
+        count += histogram[i];
+        if (count > target || count == calls)
+          return (i < NUM_BUCKETS - 1 ? double(1ull << i) : maxTime * 1e6) * 1e-6;
+      }
+      return maxTime;
+    }
+
+    bool isEnabled() noexcept
+    {
+      return theEnabled.load(memory_order_relaxed);
+    }
+
+    void setEnabled(bool enabled)
+    {
+      theEnabled = enabled;
+    }
+
+    unsigned functionId(const std::wstring_view& name)
+    {
+      const auto fullName = wstring(name);
+
+      auto& registry = Registry::get();
+      std::scoped_lock lock(registry.lock);
+      auto found = registry.ids.find(fullName);
+      if (found != registry.ids.end())
+        return found->second;
+
+      const auto id = (unsigned)registry.names.size();
+      if (id >= CHUNK_SIZE * MAX_CHUNKS)
+        XLO_THROW("Too many functions to profile");
+      registry.ids.emplace(fullName, id);
+      registry.names.push_back(fullName);
+      return id;
+    }
+
+    unsigned functionId(const char* name)
+    {
+      return functionId(utf8ToUtf16(name));
+    }
+
+    void record(
+      unsigned id,
+      const int64_t(&phaseNanos)[NUM_PHASES],
+      bool failed) noexcept
+    {
+      try
+      {
+        auto& c = *threadCounters().get(id);
+        bump(c.calls);
+        if (failed)
+          bump(c.errors);
+        uint64_t total = 0;
+        for (auto p = 0u; p < NUM_PHASES; ++p)
+        {
+          bump(c.phaseNanos[p], phaseNanos[p]);
+          total += phaseNanos[p];
+        }
+        if (total > c.maxNanos.load(memory_order_relaxed))
+          c.maxNanos.store(total, memory_order_relaxed);
+        bump(c.histogram[bucket(total)]);
+      }
+      catch (...)
+      {
+        // Only allocation can fail: never disrupt the function call
+      }
+    }
+
+    void merge()
+    {
+      auto& registry = Registry::get();
+      std::scoped_lock lock(registry.lock);
+
+      auto totals = sumThreads(registry);
+      registry.baseline.resize(totals.size());
+
+      vector<FunctionStats> result;
+      for (size_t id = 0; id < totals.size(); ++id)
+      {
+        auto& t = totals[id];
+        auto& base = registry.baseline[id];
+        if (t.calls == base.calls)
+          continue;
+
+        auto& s = result.emplace_back();
+        s.qualifiedName = registry.names[id];
+        const auto colon = s.qualifiedName.rfind(L':');
+        s.name = colon == wstring::npos ? s.qualifiedName : s.qualifiedName.substr(colon + 1);
+        s.calls = t.calls - base.calls;
+        s.errors = t.errors - base.errors;
+        for (auto p = 0u; p < NUM_PHASES; ++p)
+          s.phaseTime[p] = (t.phaseNanos[p] - base.phaseNanos[p]) * 1e-9;
+        s.maxTime = t.maxNanos * 1e-9;
+        for (auto b = 0u; b < NUM_BUCKETS; ++b)
+          s.histogram[b] = t.histogram[b] - base.histogram[b];
+      }
+
+      std::sort(result.begin(), result.end(),
+        [](auto& l, auto& r) { return l.totalTime() > r.totalTime(); });
+
+      registry.snapshot = std::move(result);
+
+      const auto now = steady_clock::now();
+      if (registry.logInterval.count() > 0 && now - registry.lastLog >= registry.logInterval)
+      {
+        registry.lastLog = now;
+        writeToLog(registry.snapshot);
+      }
+    }
+
+    vector<FunctionStats> stats()
+    {
+      auto& registry = Registry::get();
+      std::scoped_lock lock(registry.lock);
+      return registry.snapshot;
+    }
+
+    void reset()
+    {
+      auto& registry = Registry::get();
+      std::scoped_lock lock(registry.lock);
+      registry.baseline = sumThreads(registry);
+      registry.snapshot.clear();
+      for (auto& thread : registry.threads)
+        for (unsigned id = 0; id < registry.names.size(); ++id)
+          if (auto* c = thread->find(id))
+            c->maxNanos.store(0, memory_order_relaxed);
+    }
+
+    void setLogInterval(seconds interval)
+    {
+      auto& registry = Registry::get();
+      std::scoped_lock lock(registry.lock);
+      registry.logInterval = interval;
+      registry.lastLog = steady_clock::now();
+    }
+  }
+}
@@ -9,6 +9,7 @@
 #include <xloil/State.h>
 #include <xlOil-COM/Connect.h>
 #include <filesystem>
+#include <chrono>
 using std::make_pair;
 using std::wstring;
 using std::make_shared;
@@ -95,8 +96,21 @@ namespace xloil
       auto& existingFuncs = self->_functions;
       decltype(self->_functions) newFuncs;
 
+      const auto start = std::chrono::steady_clock::now();
+      size_t nAdded = 0, nChanged = 0, nUnchanged = 0;
+
       for (auto& f : specs)
       {
+        // Functions with an identical FuncInfo keep their registration and
+        // only have their context patched, so are cheap to re-register
+        auto found = existingFuncs.find(f->name());
+        if (found == existingFuncs.end())
+          ++nAdded;
+        else if (*found->second->info() == *f->info())
+          ++nUnchanged;
+        else
+          ++nChanged;
+
         // If registration succeeds, just add the function to the new map
         auto [ptr, success] = registerFunc(existingFuncs, f);
 
@@ -112,9 +126,20 @@ namespace xloil
         if (f)
           XLO_ERROR(L"Registration failed for: {0}", f->name());
 
+      size_t nRemoved = 0;
       if (append)
         newFuncs.merge(existingFuncs);
+      else
+        for (auto& [name, func] : existingFuncs)
+          if (newFuncs.find(name) == newFuncs.end())
+            ++nRemoved;
+
       self->_functions = newFuncs;
+
+      XLO_DEBUG(L"Registered functions in '{0}': {1} added, {2} changed, {3} unchanged, "
+        "{4} removed in {5} ms", self->name(), nAdded, nChanged, nUnchanged, nRemoved,
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start).count());
     }, ExcelRunQueue::XLL_API);
   }
 
@@ -256,7 +281,11 @@ namespace xloil
           case Event::FileAction::Modified:
           {
             XLO_INFO(L"Module '{0}' modified, reloading.", self->name().c_str());
+            const auto start = std::chrono::steady_clock::now();
             self->reload();
+            XLO_INFO(L"Module '{0}' reloaded in {1} ms", self->name().c_str(),
+              std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count());
             break;
           }
           case Event::FileAction::Delete:
@@ -3,6 +3,8 @@
 #include <xlOil-XLL/FuncRegistry.h>
 #include <xlOilHelpers/Settings.h>
 #include <xlOil/Date.h>
+#include <xlOil/Profile.h>
+#include <xlOil/CacheSnapshot.h>
 #include <xlOil/Loaders/PluginLoader.h>
 #include <xlOil/Log.h>
 #include <xlOil/Events.h>
@@ -67,6 +69,17 @@ namespace xloil
       for (auto& form : dateFormats)
         dateTimeAddFormat(form.c_str());
 
+      // As with the log popup level, the last addin to specify wins
+      auto [profile, profileLogInterval] = Settings::profiling(addinRoot);
+      if (profile)
+        Profile::setEnabled(true);
+      if (profileLogInterval > 0)
+        Profile::setLogInterval(std::chrono::seconds(profileLogInterval));
+
+      auto cacheSnapshotDir = Settings::cacheSnapshotDir(addinRoot);
+      if (!cacheSnapshotDir.empty())
+        CacheSnapshot::setDirectory(cacheSnapshotDir);
+
       return settings;
     }
   }
@@ -8,6 +8,7 @@
 #include <xlOil/ExcelObj.h>
 #include <xlOil/Interface.h>
 #include <xlOil/ExcelCall.h>
+#include <xlOil/Caller.h>
 #include <xlOil/ExportMacro.h>
 #include <xlOil/Log.h>
 #include <xlOil/WindowsSlim.h>
@@ -51,6 +52,8 @@ namespace xloil
 
         initMessageQueue(Environment::excelProcess().hInstance);
 
+        initFunctionWizardHook();
+
         XLO_DEBUG(L"Loaded xlOil core from: {}", Environment::coreDllPath());
 
         loggerAddPopupWindowSink(logger);
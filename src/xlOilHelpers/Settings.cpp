@@ -71,6 +71,19 @@ namespace xloil
     {
       return findVecStr(root, "DateFormats");
     }
+    std::pair<bool, unsigned> profiling(const toml::view_node& root)
+    {
+      return std::make_pair(
+        root["Profile"].value_or(false),
+        root["ProfileLogInterval"].value_or<unsigned>(0));
+    }
+    std::wstring cacheSnapshotDir(const toml::view_node& root)
+    {
+      auto dir = findStr(root, "CacheSnapshotDir", "");
+      return dir.empty()
+        ? wstring()
+        : expandEnvironmentStrings(utf8ToUtf16(dir).c_str());
+    }
     std::vector<std::pair<std::wstring, std::wstring>> 
       environmentVariables(const toml::view_node& root)
     {
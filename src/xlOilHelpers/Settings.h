@@ -31,6 +31,18 @@ namespace xloil
 
     std::vector<std::wstring> dateFormats(const toml::view_node& root);
 
+    /// <summary>
+    /// Returns whether function call profiling is enabled at startup and the
+    /// interval in seconds for writing the profile to the log (zero to disable)
+    /// </summary>
+    std::pair<bool, unsigned> profiling(const toml::view_node& root);
+
+    /// <summary>
+    /// Returns the directory for object cache snapshots, with any environment
+    /// variables expanded, or an empty string if snapshots are disabled
+    /// </summary>
+    std::wstring cacheSnapshotDir(const toml::view_node& root);
+
     std::vector<std::pair<std::wstring, std::wstring>>
       environmentVariables(const toml::view_node& root);
 
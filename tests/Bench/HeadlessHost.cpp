@@ -0,0 +1,369 @@
+#include "HeadlessHost.h"
+#include <xloil/ExcelArray.h>
+#include <xloil/ExcelCall.h>
+#include <xloil/Events.h>
+#include <xloil/Throw.h>
+#include <xlOil/WindowsSlim.h>
+#include <string>
+#include <utility>
+
+using namespace msxll;
+using std::string;
+using std::vector;
+
+typedef int(__stdcall *EXCEL12PROC) (int xlfn, int coper, LPXLOPER12 *rgpxloper12, LPXLOPER12 xloper12Res);
+
+// Defined by the Excel SDK's xlcall.cpp, compiled into xlOil
+extern "C" __declspec(dllimport) void __stdcall SetExcel12EntryPt(EXCEL12PROC pexcel12New);
+
+namespace xloil
+{
+  namespace Bench
+  {
+    namespace
+    {
+      thread_local xlref12 theCaller = { 0, 0, 0, 0 };
+
+      HeadlessHost* theHost = nullptr;
+
+      constexpr wchar_t theSheetName[] = L"[Bench.xlsx]Sheet1";
+
+      int __stdcall hostCallback(int xlfn, int count, LPXLOPER12* opers, LPXLOPER12 result)
+      {
+        return theHost->callback(xlfn, count, opers, result);
+      }
+
+      /// <summary>
+      /// Excel overwrites the result without freeing it, so we do the same
+      /// </summary>
+      template<class... Args>
+      void setResult(LPXLOPER12 result, Args&&... args)
+      {
+        if (result)
+          new (result) ExcelObj(std::forward<Args>(args)...);
+      }
+
+      ExcelObj coerce(const ExcelObj& sheetValues, const xlref12& ref)
+      {
+        ExcelArray sheet(sheetValues);
+        if ((size_t)ref.rwLast >= sheet.nRows() || (size_t)ref.colLast >= sheet.nCols())
+          return ExcelObj();
+        if (ref.rwFirst == ref.rwLast && ref.colFirst == ref.colLast)
+          return ExcelObj(sheet(ref.rwFirst, ref.colFirst));
+        return ExcelArray(sheet,
+          ref.rwFirst, ref.colFirst, ref.rwLast + 1, ref.colLast + 1).toExcelObj();
+      }
+
+      // Calls an entry point taking N ExcelObj pointers. All XLO_FUNC_START
+      // arguments are references or pointers, so have the same ABI.
+      template<size_t... I>
+      ExcelObj* invokeN(void* func, const ExcelObj** args, std::index_sequence<I...>)
+      {
+        using FuncPtr = XLOIL_XLOPER*(__stdcall*)(decltype((void)I, (const ExcelObj*)nullptr)...);
+        return (ExcelObj*)((FuncPtr)func)(args[I]...);
+      }
+
+      constexpr size_t MAX_ARGS = 16;
+
+      template<size_t... N>
+      auto makeInvokers(std::index_sequence<N...>)
+      {
+        using Invoker = ExcelObj*(*)(void*, const ExcelObj**);
+        return std::array<Invoker, sizeof...(N)> {
+          [](void* f, const ExcelObj** a) { return invokeN(f, a, std::make_index_sequence<N>()); }...
+        };
+      }
+
+      static const auto theInvokers = makeInvokers(std::make_index_sequence<MAX_ARGS + 1>());
+    }
+
+    HeadlessHost::HeadlessHost()
+      : _counts()
+    {}
+
+    HeadlessHost& HeadlessHost::install()
+    {
+      static HeadlessHost* instance = []()
+      {
+        auto* host = theHost = new HeadlessHost();
+        SetExcel12EntryPt(&hostCallback);
+        // SetExcel12EntryPt does nothing if a real Excel entry point was
+        // found, so check the callback is now ours
+        ExcelObj dummy;
+        if (callExcelRaw(xlGetHwnd, &dummy) != xlretSuccess
+          || host->callbackCount(xlGetHwnd) != 1)
+          XLO_THROW("Could not install headless host: Excel entry point already set");
+        host->resetCounts();
+        return host;
+      }();
+      return *instance;
+    }
+
+    void HeadlessHost::setCaller(int row, int col)
+    {
+      theCaller.rwFirst = theCaller.rwLast = row;
+      theCaller.colFirst = theCaller.colLast = col;
+    }
+
+    void HeadlessHost::setSheetValues(const ExcelObj& values)
+    {
+      _sheetValues = values;
+    }
+
+    void* HeadlessHost::entryPoint(
+      const wchar_t* module, const char* name, size_t nArgs)
+    {
+      auto handle = GetModuleHandle(module);
+      if (!handle)
+        handle = LoadLibrary(module);
+      if (!handle)
+        return nullptr;
+      auto func = GetProcAddress(handle, name);
+      if (!func)
+      {
+        // 32-bit stdcall names are decorated
+        const auto decorated = "_" + string(name) + "@" + std::to_string(nArgs * sizeof(void*));
+        func = GetProcAddress(handle, decorated.c_str());
+      }
+      return (void*)func;
+    }
+
+    ExcelObj HeadlessHost::call(
+      void* entryPoint, const ExcelObj** args, size_t nArgs)
+    {
+      if (nArgs > MAX_ARGS)
+        XLO_THROW("Too many arguments");
+      auto* result = theInvokers[nArgs](entryPoint, args);
+      if (!result)
+        return ExcelObj();
+
+      ExcelObj value(*result);
+      // This is what xlAutoFree12 does, we cannot call it directly as the
+      // entry point may not be in an XLL
+      if ((result->xltype & xlbitDLLFree) != 0)
+      {
+        result->xltype &= ~xlbitDLLFree;
+        delete result;
+      }
+      return value;
+    }
+
+    void HeadlessHost::waitForAsync(size_t count)
+    {
+      std::unique_lock<std::mutex> lock(_asyncLock);
+      _asyncNotify.wait(lock, [&]() { return _asyncResults.size() >= count; });
+    }
+
+    void HeadlessHost::resetAsync()
+    {
+      std::scoped_lock lock(_asyncLock);
+      _asyncResults.clear();
+      _asyncHandles.clear();
+    }
+
+    uint64_t HeadlessHost::callbackCount(int xlfn) const
+    {
+      return _counts[xlfn & 0xFFFF].load(std::memory_order_relaxed);
+    }
+
+    uint64_t HeadlessHost::callbackCount() const
+    {
+      uint64_t total = 0;
+      for (auto& c : _counts)
+        total += c.load(std::memory_order_relaxed);
+      return total;
+    }
+
+    void HeadlessHost::resetCounts()
+    {
+      for (auto& c : _counts)
+        c.store(0, std::memory_order_relaxed);
+    }
+
+    int HeadlessHost::callback(int xlfn, int count, LPXLOPER12* opers, LPXLOPER12 result)
+    {
+      _counts[xlfn & 0xFFFF].fetch_add(1, std::memory_order_relaxed);
+
+      auto arg = [&](int i) -> ExcelObj& { return *(ExcelObj*)opers[i]; };
+
+      switch (xlfn)
+      {
+      case xlFree:
+        for (auto i = 0; i < count; ++i)
+        {
+          // Anything we returned was allocated by ExcelObj, so can be freed
+          // by ExcelObj once the flag is removed
+          arg(i).xltype &= ~xlbitXLFree;
+          arg(i).reset();
+        }
+        return xlretSuccess;
+
+      case xlStack:
+        setResult(result, 32768);
+        return xlretSuccess;
+
+      case xlGetHwnd:
+      case xlGetInst:
+        setResult(result, 0);
+        return xlretSuccess;
+
+      case xlAbort:
+        setResult(result, false);
+        return xlretSuccess;
+
+      case xlfCaller:
+        setResult(result, SHEET_ID, theCaller);
+        return xlretSuccess;
+
+      case xlSheetNm:
+        setResult(result, theSheetName);
+        return xlretSuccess;
+
+      case xlSheetId:
+        if (count > 0 && arg(0).isType(ExcelType::Str) && arg(0).toString() != theSheetName)
+          return xlretFailed;
+        setResult(result, SHEET_ID, xlref12{ 0, 0, 0, 0 });
+        return xlretSuccess;
+
+      case xlCoerce:
+      {
+        if (count < 1)
+          return xlretInvCount;
+        auto& from = arg(0);
+        switch (from.type())
+        {
+        case ExcelType::SRef:
+          setResult(result, coerce(_sheetValues, from.val.sref.ref));
+          break;
+        case ExcelType::Ref:
+          setResult(result, coerce(_sheetValues, from.val.mref.lpmref->reftbl[0]));
+          break;
+        default:
+          setResult(result, from);
+        }
+        return xlretSuccess;
+      }
+
+      case xlAsyncReturn:
+      {
+        if (count != 2)
+          return xlretInvCount;
+        {
+          std::scoped_lock lock(_asyncLock);
+          // Arrays of handles and values return a batch of results
+          if (arg(0).isType(ExcelType::Multi))
+          {
+            ExcelArray handles(arg(0), false);
+            ExcelArray values(arg(1), false);
+            if (handles.size() != values.size())
+              return xlretFailed;
+            for (auto& v : values)
+            {
+              // As in Excel, a batch cannot return arrays
+              if (v.isType(ExcelType::Multi))
+                return xlretFailed;
+              _asyncResults.emplace_back(v);
+            }
+            for (auto& h : handles)
+              _asyncHandles.emplace_back(h);
+          }
+          else
+          {
+            _asyncResults.emplace_back(arg(1));
+            _asyncHandles.emplace_back(arg(0));
+          }
+        }
+        _asyncNotify.notify_all();
+        setResult(result, true);
+        return xlretSuccess;
+      }
+
+      case xlfRegister:
+      {
+        static std::atomic<int> registerId = 1;
+        setResult(result, (double)registerId++);
+        return xlretSuccess;
+      }
+
+      case xlfUnregister:
+      case xlfSetName:
+        setResult(result, true);
+        return xlretSuccess;
+
+      default:
+        return xlretInvXlfn;
+      }
+    }
+
+    Recalc::Recalc(size_t nThreads)
+      : _nextRow(0)
+    {
+      for (size_t i = 0; i < nThreads; ++i)
+        _threads.emplace_back([this]() { worker(); });
+    }
+
+    Recalc::~Recalc()
+    {
+      {
+        std::scoped_lock lock(_lock);
+        _stop = true;
+      }
+      _start.notify_all();
+      for (auto& t : _threads)
+        t.join();
+    }
+
+    void Recalc::run(int nRows, int nCols, const CellFunc& func)
+    {
+      {
+        std::unique_lock<std::mutex> lock(_lock);
+        _func = &func;
+        _nRows = nRows;
+        _nCols = nCols;
+        _nextRow = 0;
+        _finished = 0;
+        ++_generation;
+      }
+      _start.notify_all();
+      {
+        std::unique_lock<std::mutex> lock(_lock);
+        _done.wait(lock, [&]() { return _finished == _threads.size(); });
+        _func = nullptr;
+      }
+      Event::AfterCalculate().fire();
+    }
+
+    void Recalc::worker()
+    {
+      size_t seenGeneration = 0;
+      while (true)
+      {
+        const CellFunc* func;
+        int nRows, nCols;
+        {
+          std::unique_lock<std::mutex> lock(_lock);
+          _start.wait(lock, [&]() { return _stop || _generation != seenGeneration; });
+          if (_stop)
+            return;
+          seenGeneration = _generation;
+          func = _func;
+          nRows = _nRows;
+          nCols = _nCols;
+        }
+
+        for (auto row = _nextRow++; row < nRows; row = _nextRow++)
+          for (auto col = 0; col < nCols; ++col)
+          {
+            HeadlessHost::setCaller(row, col);
+            (*func)(row, col);
+          }
+
+        {
+          std::scoped_lock lock(_lock);
+          ++_finished;
+        }
+        _done.notify_one();
+      }
+    }
+  }
+}
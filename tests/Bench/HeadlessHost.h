@@ -0,0 +1,140 @@
+#pragma once
+#include <xloil/ExcelObj.h>
+#include <xloil/XlCallSlim.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xloil
+{
+  namespace Bench
+  {
+    /// <summary>
+    /// A stand-in for Excel's side of the C API, allowing worksheet function
+    /// entry points to be called outside Excel. It is installed as the target
+    /// of xlOil's Excel12v with SetExcel12EntryPt, which only takes effect
+    /// if the process is not Excel.
+    ///
+    /// The host answers the callbacks which functions make during a calc:
+    /// xlfCaller, xlSheetNm, xlSheetId, xlCoerce (of references into a
+    /// host-held grid), xlFree, xlAsyncReturn and a few others. Anything else
+    /// returns xlretInvXlfn. It counts every callback by function number, so
+    /// benchmarks can report how many Excel API calls a workload makes.
+    /// </summary>
+    class HeadlessHost
+    {
+    public:
+      static constexpr msxll::IDSHEET SHEET_ID = (msxll::IDSHEET)0x1000;
+
+      /// <summary>
+      /// Installs the host and returns it. Throws if xlOil is running inside
+      /// Excel (or the host could not be installed for another reason).
+      /// </summary>
+      static HeadlessHost& install();
+
+      /// <summary>
+      /// Sets the cell returned by xlfCaller on the current thread
+      /// </summary>
+      static void setCaller(int row, int col);
+
+      /// <summary>
+      /// Sets the values on the fake sheet which are returned when
+      /// references are coerced to values.
+      /// </summary>
+      void setSheetValues(const ExcelObj& values);
+
+      /// <summary>
+      /// Looks up an exported entry point in the given module, which is
+      /// loaded if required. Returns null if not found.
+      /// </summary>
+      static void* entryPoint(
+        const wchar_t* module, const char* name, size_t nArgs);
+
+      /// <summary>
+      /// Calls a worksheet function entry point as Excel would: the result
+      /// is copied and then freed if the function set xlbitDLLFree.
+      /// </summary>
+      static ExcelObj call(
+        void* entryPoint, const ExcelObj** args, size_t nArgs);
+
+      template <class... Args>
+      static ExcelObj call(void* entryPoint, const Args&... args)
+      {
+        const ExcelObj* argPtrs[] = { &args..., nullptr };
+        return call(entryPoint, argPtrs, sizeof...(Args));
+      }
+
+      /// <summary>
+      /// Blocks until the given number of xlAsyncReturn callbacks have
+      /// been received since the last <see cref="resetAsync"/>.
+      /// </summary>
+      void waitForAsync(size_t count);
+      void resetAsync();
+      const std::vector<ExcelObj>& asyncResults() const { return _asyncResults; }
+      /// <summary>
+      /// The handle passed with each of <see cref="asyncResults"/>
+      /// </summary>
+      const std::vector<ExcelObj>& asyncHandles() const { return _asyncHandles; }
+
+      /// <summary>
+      /// Number of callbacks received for the given function number,
+      /// e.g. msxll::xlfCaller, since the last <see cref="resetCounts"/>
+      /// </summary>
+      uint64_t callbackCount(int xlfn) const;
+      uint64_t callbackCount() const;
+      void resetCounts();
+
+      int callback(int xlfn, int count, msxll::LPXLOPER12* opers, msxll::LPXLOPER12 result);
+
+    private:
+      HeadlessHost();
+
+      std::array<std::atomic<uint64_t>, 0x10000> _counts;
+      ExcelObj _sheetValues;
+      std::mutex _asyncLock;
+      std::condition_variable _asyncNotify;
+      std::vector<ExcelObj> _asyncResults;
+      std::vector<ExcelObj> _asyncHandles;
+    };
+
+    /// <summary>
+    /// Fakes Excel's multi-threaded recalc: a persistent pool of threads
+    /// evaluates a grid of cells, setting the caller for each cell before
+    /// invoking the cell function. Threads take rows from a shared counter
+    /// so the work is balanced dynamically, as in Excel. The AfterCalculate
+    /// event is fired once all cells are done.
+    /// </summary>
+    class Recalc
+    {
+    public:
+      using CellFunc = std::function<void(int row, int col)>;
+
+      Recalc(size_t nThreads);
+      ~Recalc();
+
+      size_t nThreads() const { return _threads.size(); }
+
+      void run(int nRows, int nCols, const CellFunc& func);
+
+    private:
+      void worker();
+
+      std::vector<std::thread> _threads;
+      std::mutex _lock;
+      std::condition_variable _start;
+      std::condition_variable _done;
+      const CellFunc* _func = nullptr;
+      int _nRows = 0;
+      int _nCols = 0;
+      std::atomic<int> _nextRow;
+      size_t _generation = 0;
+      size_t _finished = 0;
+      bool _stop = false;
+    };
+  }
+}
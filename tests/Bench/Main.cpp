@@ -0,0 +1,205 @@
+// Runs reproducible calculation workloads against xlOil outside Excel using
+// a headless stand-in for the Excel C API. Writes one JSON object per
+// scenario to stdout (and optionally a file) for tracking results over time.
+//
+// Usage:
+//   xlOil_Bench [--threads N] [--rows N] [--cols N] [--repeat N] [--seed N]
+//               [--scenario NAME]... [--out FILE]
+//
+// The worker-pool scenarios start copies of this executable with
+//   xlOil_Bench --worker CHANNEL PARENT_PID
+//
+
+#include "HeadlessHost.h"
+#include "Scenarios.h"
+#include <xloil/Version.h>
+#include <xlOil/XlCallSlim.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using std::string;
+using std::vector;
+using namespace xloil;
+using namespace xloil::Bench;
+
+namespace
+{
+  void usage()
+  {
+    std::cerr <<
+      "Usage: xlOil_Bench [--threads N] [--rows N] [--cols N] [--repeat N] [--seed N]\n"
+      "                   [--scenario NAME]... [--out FILE]\n"
+      "Scenarios: ";
+    for (auto& s : createScenarios())
+      std::cerr << s->name() << " ";
+    std::cerr << "\n";
+  }
+
+  struct Result
+  {
+    string scenario;
+    string skipped;
+    size_t calls = 0;
+    vector<double> seconds;
+    uint64_t callbacks = 0;
+    uint64_t callerCallbacks = 0;
+    uint64_t sheetCallbacks = 0;
+    uint64_t coerceCallbacks = 0;
+    size_t resultBytes = 0;
+  };
+
+  string toJson(const Options& opts, const Result& r)
+  {
+    std::ostringstream out;
+    out << "{\"scenario\":\"" << r.scenario << "\""
+      << ",\"version\":\"" << XLOIL_MAJOR_VERSION << "." << XLOIL_MINOR_VERSION
+      << "." << XLOIL_PATCH_VERSION << "\""
+      << ",\"threads\":" << opts.threads
+      << ",\"rows\":" << opts.rows
+      << ",\"cols\":" << opts.cols
+      << ",\"seed\":" << opts.seed;
+
+    if (!r.skipped.empty())
+    {
+      out << ",\"skipped\":\"" << r.skipped << "\"}";
+      return out.str();
+    }
+
+    auto sorted = r.seconds;
+    std::sort(sorted.begin(), sorted.end());
+    const auto best = sorted.front();
+    const auto median = sorted[sorted.size() / 2];
+
+    out << ",\"repeat\":" << sorted.size()
+      << ",\"calls\":" << r.calls
+      << ",\"best_s\":" << best
+      << ",\"median_s\":" << median
+      << ",\"worst_s\":" << sorted.back()
+      << ",\"calls_per_s\":" << (best > 0 ? r.calls / best : 0)
+      // Callbacks into the Excel API per recalc
+      << ",\"api_callbacks\":" << r.callbacks / sorted.size()
+      << ",\"api_caller_callbacks\":" << r.callerCallbacks / sorted.size()
+      << ",\"api_sheet_callbacks\":" << r.sheetCallbacks / sorted.size()
+      << ",\"api_coerce_callbacks\":" << r.coerceCallbacks / sorted.size();
+    if (r.resultBytes > 0)
+      out << ",\"result_bytes\":" << r.resultBytes;
+    out << "}";
+    return out.str();
+  }
+
+  Result runScenario(
+    Scenario& scenario, HeadlessHost& host, Recalc& recalc, const Options& opts)
+  {
+    Result result;
+    result.scenario = scenario.name();
+    result.skipped = scenario.setup(host, opts);
+    if (!result.skipped.empty())
+      return result;
+
+    // Warm up: the first recalc populates caches and thread-local state
+    scenario.run(recalc);
+
+    host.resetCounts();
+    for (size_t i = 0; i < opts.repeat; ++i)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      result.calls = scenario.run(recalc);
+      const auto end = std::chrono::steady_clock::now();
+      result.seconds.push_back(std::chrono::duration<double>(end - start).count());
+    }
+    result.callbacks = host.callbackCount();
+    result.callerCallbacks = host.callbackCount(msxll::xlfCaller);
+    result.sheetCallbacks = host.callbackCount(msxll::xlSheetNm)
+      + host.callbackCount(msxll::xlSheetId);
+    result.coerceCallbacks = host.callbackCount(msxll::xlCoerce);
+    result.resultBytes = scenario.resultBytes();
+
+    scenario.teardown();
+    return result;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc == 4 && string(argv[1]) == "--worker")
+  {
+    try
+    {
+      return serveWorker(argv[2], strtoul(argv[3], nullptr, 10));
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  Options opts;
+  vector<string> selected;
+  string outFile;
+
+  for (auto i = 1; i < argc; ++i)
+  {
+    const auto arg = string(argv[i]);
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (arg == "--help" || arg == "-h" || !value)
+    {
+      usage();
+      return arg == "--help" || arg == "-h" ? 0 : 1;
+    }
+    ++i;
+    if (arg == "--threads")       opts.threads = std::max(1, atoi(value));
+    else if (arg == "--rows")     opts.rows = std::max(1, atoi(value));
+    else if (arg == "--cols")     opts.cols = std::max(1, atoi(value));
+    else if (arg == "--repeat")   opts.repeat = std::max(1, atoi(value));
+    else if (arg == "--seed")     opts.seed = (unsigned)strtoul(value, nullptr, 10);
+    else if (arg == "--scenario") selected.push_back(value);
+    else if (arg == "--out")      outFile = value;
+    else
+    {
+      usage();
+      return 1;
+    }
+  }
+
+  try
+  {
+    auto& host = HeadlessHost::install();
+    Recalc recalc(opts.threads);
+
+    std::ofstream out;
+    if (!outFile.empty())
+      out.open(outFile, std::ios::app);
+
+    int failures = 0;
+    for (auto& scenario : createScenarios())
+    {
+      if (!selected.empty()
+        && std::find(selected.begin(), selected.end(), scenario->name()) == selected.end())
+        continue;
+      try
+      {
+        const auto json = toJson(opts, runScenario(*scenario, host, recalc, opts));
+        std::cout << json << std::endl;
+        if (out.is_open())
+          out << json << "\n";
+      }
+      catch (const std::exception& e)
+      {
+        std::cerr << scenario->name() << " failed: " << e.what() << std::endl;
+        ++failures;
+      }
+    }
+    return failures;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
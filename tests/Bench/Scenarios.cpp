@@ -0,0 +1,1598 @@
+#include "Scenarios.h"
+#include "HeadlessHost.h"
+#include <xloil/ArrayBuilder.h>
+#include <xloil/ExcelArray.h>
+#include <xloil/Async.h>
+#include <xloil/Caller.h>
+#include <xloil/ColumnKeys.h>
+#include <xloil/Date.h>
+#include <xloil/ExcelObj.h>
+#include <xloil/ExcelObjBinary.h>
+#include <xloil/ExcelCall.h>
+#include <xloil/Throw.h>
+#include <xlOil-COM/MainThreadQueue.h>
+#include "../../libs/xlOil_Python/PyWorkerProtocol.h"
+#include <CTPL/ctpl_stl.h>
+#include <chrono>
+#include <cmath>
+#include <cwctype>
+#include <filesystem>
+#include <future>
+#include <random>
+#include <thread>
+
+using std::string;
+using std::vector;
+using std::wstring;
+using std::unique_ptr;
+using std::make_unique;
+
+namespace xloil
+{
+  namespace Bench
+  {
+    namespace
+    {
+      constexpr const wchar_t* CORE_DLL = L"xlOil.dll";
+      constexpr const wchar_t* UTILS_DLL = L"xlOil_Utils.dll";
+      constexpr const wchar_t* SQL_DLL = L"xlOil_SQL.dll";
+
+      wstring randomString(std::mt19937& rng, size_t minLen, size_t maxLen)
+      {
+        std::uniform_int_distribution<size_t> len(minLen, maxLen);
+        std::uniform_int_distribution<int> chr(L'a', L'z');
+        wstring result(len(rng), L' ');
+        for (auto& c : result)
+          c = (wchar_t)chr(rng);
+        return result;
+      }
+
+      ExcelObj randomNumbers(std::mt19937& rng, int nRows, int nCols)
+      {
+        std::uniform_real_distribution<double> value(-1000, 1000);
+        ExcelArrayBuilder builder(nRows, nCols);
+        for (auto i = 0; i < nRows; ++i)
+          for (auto j = 0; j < nCols; ++j)
+            builder(i, j) = value(rng);
+        return builder.toExcelObj();
+      }
+
+      ExcelObj randomMixed(std::mt19937& rng, int nRows, int nCols, size_t maxLen)
+      {
+        std::uniform_real_distribution<double> value(-1000, 1000);
+        vector<wstring> strings;
+        size_t totalLen = 0;
+        for (auto i = 0; i < nRows * nCols; i += 3)
+        {
+          strings.push_back(randomString(rng, 1, maxLen));
+          totalLen += strings.back().size();
+        }
+        ExcelArrayBuilder builder(nRows, nCols, totalLen);
+        for (auto k = 0; k < nRows * nCols; ++k)
+        {
+          switch (k % 3)
+          {
+          case 0: builder(k) = std::wstring_view(strings[k / 3]); break;
+          case 1: builder(k) = value(rng); break;
+          default: builder(k) = CellError::NA;
+          }
+        }
+        return builder.toExcelObj();
+      }
+
+      ExcelObj randomStrings(std::mt19937& rng, int nRows, int nCols, size_t maxLen)
+      {
+        vector<wstring> strings;
+        size_t totalLen = 0;
+        for (auto i = 0; i < nRows * nCols; ++i)
+        {
+          strings.push_back(randomString(rng, 1, maxLen));
+          totalLen += strings.back().size();
+        }
+        ExcelArrayBuilder builder(nRows, nCols, totalLen);
+        for (auto i = 0; i < nRows; ++i)
+          for (auto j = 0; j < nCols; ++j)
+            builder(i, j) = std::wstring_view(strings[i * nCols + j]);
+        return builder.toExcelObj();
+      }
+
+      void* requireEntryPoint(const wchar_t* module, const char* name, size_t nArgs)
+      {
+        auto func = HeadlessHost::entryPoint(module, name, nArgs);
+        if (!func)
+          XLO_THROW("Entry point {} not found", name);
+        return func;
+      }
+
+      void check(bool condition, const char* what)
+      {
+        if (!condition)
+          XLO_THROW("Unexpected result from {}", what);
+      }
+
+      uint64_t now()
+      {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+
+      /// <summary>
+      /// Base for scenarios which call a function for every cell in the grid
+      /// with per-cell generated arguments
+      /// </summary>
+      class GridScenario : public Scenario
+      {
+      protected:
+        int _rows = 0, _cols = 0;
+        std::mt19937 _rng;
+
+        void setupGrid(const Options& opts)
+        {
+          _rows = opts.rows;
+          _cols = opts.cols;
+          _rng.seed(opts.seed);
+        }
+
+        size_t nCells() const { return (size_t)_rows * _cols; }
+        size_t cellIndex(int row, int col) const { return (size_t)row * _cols + col; }
+      };
+
+      /// <summary>
+      /// Each cell stores a small mixed array in the object cache with xloRef,
+      /// then retrieves it with xloVal. Exercises ObjectCache, CallerInfo and
+      /// the cache key writer.
+      /// </summary>
+      class CacheScenario : public GridScenario
+      {
+        void* _xloRef = nullptr;
+        void* _xloVal = nullptr;
+        vector<ExcelObj> _inputs;
+
+      public:
+        const char* name() const override { return "cache"; }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _xloRef = requireEntryPoint(CORE_DLL, "xloRef", 1);
+          _xloVal = requireEntryPoint(CORE_DLL, "xloVal", 1);
+          _inputs.clear();
+          for (size_t i = 0; i < nCells(); ++i)
+            _inputs.push_back(i % 2 == 0
+              ? randomNumbers(_rng, 8, 4)
+              : randomStrings(_rng, 8, 4, 12));
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          recalc.run(_rows, _cols, [this](int row, int col)
+          {
+            auto& input = _inputs[cellIndex(row, col)];
+            auto ref = HeadlessHost::call(_xloRef, input);
+            check(ref.isType(ExcelType::Str), "xloRef");
+            auto val = HeadlessHost::call(_xloVal, ref);
+            check(val.isType(ExcelType::Multi), "xloVal");
+          });
+          return 2 * nCells();
+        }
+
+        void teardown() override { _inputs.clear(); }
+      };
+
+      /// <summary>
+      /// Each cell sorts a numeric array with xloSort then takes a block of
+      /// it with xloIndex. Exercises ExcelArray, ExcelArrayBuilder and array
+      /// copying.
+      /// </summary>
+      class ArrayScenario : public GridScenario
+      {
+        void* _xloSort = nullptr;
+        void* _xloIndex = nullptr;
+        vector<ExcelObj> _inputs;
+
+      public:
+        const char* name() const override { return "array"; }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _xloSort = HeadlessHost::entryPoint(UTILS_DLL, "xloSort", 10);
+          _xloIndex = HeadlessHost::entryPoint(UTILS_DLL, "xloIndex", 5);
+          if (!_xloSort || !_xloIndex)
+            return "xlOil_Utils not found";
+          _inputs.clear();
+          for (size_t i = 0; i < nCells(); ++i)
+            _inputs.push_back(randomNumbers(_rng, 200, 4));
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          const ExcelObj order(L"da");
+          const ExcelObj from(2), to(-2);
+          const auto& missing = Const::Missing();
+
+          recalc.run(_rows, _cols, [&](int row, int col)
+          {
+            // xloSort sorts its argument in-place, so pass it a copy
+            ExcelObj input(_inputs[cellIndex(row, col)]);
+            const ExcelObj* sortArgs[] = { &input, &order,
+              &missing, &missing, &missing, &missing, &missing, &missing, &missing, &missing };
+            auto sorted = HeadlessHost::call(_xloSort, sortArgs, _countof(sortArgs));
+            check(sorted.isType(ExcelType::Multi), "xloSort");
+            auto block = HeadlessHost::call(_xloIndex, sorted, from, from, to, to);
+            check(block.isType(ExcelType::Multi), "xloIndex");
+          });
+          return 2 * nCells();
+        }
+
+        void teardown() override { _inputs.clear(); }
+      };
+
+      /// <summary>
+      /// Each cell joins a row of strings with xloConcat then splits the
+      /// result with xloSplit. Exercises string conversion and allocation.
+      /// </summary>
+      class StringScenario : public GridScenario
+      {
+        void* _xloConcat = nullptr;
+        void* _xloSplit = nullptr;
+        vector<ExcelObj> _inputs;
+
+      public:
+        const char* name() const override { return "string"; }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _xloConcat = HeadlessHost::entryPoint(UTILS_DLL, "xloConcat", 11);
+          _xloSplit = HeadlessHost::entryPoint(UTILS_DLL, "xloSplit", 3);
+          if (!_xloConcat || !_xloSplit)
+            return "xlOil_Utils not found";
+          _inputs.clear();
+          for (size_t i = 0; i < nCells(); ++i)
+            _inputs.push_back(randomStrings(_rng, 1, 40, 20));
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          const ExcelObj separator(L",");
+          const auto& missing = Const::Missing();
+
+          recalc.run(_rows, _cols, [&](int row, int col)
+          {
+            const ExcelObj* concatArgs[] = { &separator, &_inputs[cellIndex(row, col)],
+              &missing, &missing, &missing, &missing, &missing, &missing, &missing, &missing, &missing };
+            auto joined = HeadlessHost::call(_xloConcat, concatArgs, _countof(concatArgs));
+            check(joined.isType(ExcelType::Str), "xloConcat");
+            auto split = HeadlessHost::call(_xloSplit, joined, separator, missing);
+            check(split.isType(ExcelType::Multi), "xloSplit");
+          });
+          return 2 * nCells();
+        }
+
+        void teardown() override { _inputs.clear(); }
+      };
+
+      /// <summary>
+      /// Each cell writes an array in the binary ExcelObj format then reads it
+      /// back, both as an independent copy and as a view over the encoded data.
+      /// Run separately for numeric, string and mixed arrays.
+      /// </summary>
+      class BinaryScenario : public GridScenario
+      {
+      public:
+        enum Kind { Numeric, String, Mixed };
+
+        BinaryScenario(Kind kind) : _kind(kind) {}
+
+        const char* name() const override
+        {
+          switch (_kind)
+          {
+          case Numeric: return "binary-num";
+          case String:  return "binary-str";
+          default:      return "binary-mixed";
+          }
+        }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _inputs.clear();
+          for (size_t i = 0; i < nCells(); ++i)
+          {
+            switch (_kind)
+            {
+            case Numeric: _inputs.push_back(randomNumbers(_rng, 200, 10)); break;
+            case String:  _inputs.push_back(randomStrings(_rng, 200, 10, 20)); break;
+            default:      _inputs.push_back(randomMixed(_rng, 200, 10, 20));
+            }
+          }
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          recalc.run(_rows, _cols, [this](int row, int col)
+          {
+            auto& input = _inputs[cellIndex(row, col)];
+            const auto bytes = Binary::encode(input);
+            BinaryView view(bytes.data(), bytes.size());
+            check(view.toExcelObj() == input, "Binary::decode");
+            check(view.toExcelObjView() == input, "BinaryView::toExcelObjView");
+          });
+          return 3 * nCells();
+        }
+
+        void teardown() override { _inputs.clear(); }
+
+      private:
+        Kind _kind;
+        vector<ExcelObj> _inputs;
+      };
+
+      /// <summary>
+      /// Each cell starts a native async function which computes its result
+      /// on a worker pool and returns it with xlAsyncReturn. The recalc is
+      /// complete when all results have been returned.
+      /// </summary>
+      class AsyncScenario : public GridScenario
+      {
+        HeadlessHost* _host = nullptr;
+        unique_ptr<ctpl::thread_pool> _workers;
+        vector<ExcelObj> _inputs;
+
+      public:
+        const char* name() const override { return "async"; }
+
+        string setup(HeadlessHost& host, const Options& opts) override
+        {
+          setupGrid(opts);
+          _host = &host;
+          _workers = make_unique<ctpl::thread_pool>((int)opts.threads);
+          _inputs.clear();
+          for (size_t i = 0; i < nCells(); ++i)
+            _inputs.push_back(randomNumbers(_rng, 20, 1));
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          _host->resetAsync();
+          recalc.run(_rows, _cols, [this](int row, int col)
+          {
+            const auto index = cellIndex(row, col);
+            // The handle is opaque to xlOil, so any value will do
+            _workers->push([this, index](int)
+            {
+              double total = 0;
+              ExcelArray values(_inputs[index]);
+              for (auto& v : values)
+                total += v.get<double>();
+              asyncReturn(ExcelObj((int)index), ExcelObj(total));
+            });
+          });
+          _host->waitForAsync(nCells());
+          return nCells();
+        }
+
+        void teardown() override
+        {
+          _workers.reset();
+          _inputs.clear();
+        }
+      };
+
+      /// <summary>
+      /// Returns the results for each row of the grid with one batched
+      /// asyncReturn, as python's async functions do. Every third cell's
+      /// result is an array, which must be returned individually, and every
+      /// fifth cell also has a stale result earlier in the batch, which must
+      /// be dropped.
+      /// </summary>
+      class AsyncBatchScenario : public GridScenario
+      {
+        HeadlessHost* _host = nullptr;
+        vector<ExcelObj> _inputs;
+
+      public:
+        const char* name() const override { return "async-batch"; }
+
+        string setup(HeadlessHost& host, const Options& opts) override
+        {
+          setupGrid(opts);
+          _host = &host;
+          _inputs.clear();
+          for (size_t i = 0; i < nCells(); ++i)
+            _inputs.push_back(i % 3 == 0
+              ? randomMixed(_rng, 3, 2, 8)
+              : ExcelObj(randomString(_rng, 1, 8)));
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          _host->resetAsync();
+          recalc.run(_rows, 1, [this](int row, int)
+          {
+            vector<ExcelObj> handles, values;
+            for (auto col = 0; col < _cols; ++col)
+            {
+              const auto index = (int)cellIndex(row, col);
+              if (index % 5 == 0)
+              {
+                handles.emplace_back(index);
+                values.emplace_back(CellError::NA);
+              }
+            }
+            for (auto col = 0; col < _cols; ++col)
+            {
+              const auto index = (int)cellIndex(row, col);
+              handles.emplace_back(index);
+              values.push_back(_inputs[index]);
+            }
+            asyncReturn(handles.data(), values.data(), handles.size());
+          });
+
+          // The host answers xlAsyncReturn synchronously, so a rejected
+          // batch shows as missing results rather than a wait which hangs
+
+          auto& results = _host->asyncResults();
+          auto& handles = _host->asyncHandles();
+          check(results.size() == nCells(), "asyncReturn batch size");
+          vector<bool> seen(nCells());
+          for (size_t i = 0; i < results.size(); ++i)
+          {
+            const auto index = (size_t)handles[i].get<int>();
+            check(index < nCells() && !seen[index], "asyncReturn batch handle");
+            seen[index] = true;
+            check(results[i] == _inputs[index], "asyncReturn batch value");
+          }
+          return nCells();
+        }
+
+        void teardown() override { _inputs.clear(); }
+      };
+
+      /// <summary>
+      /// Each cell pushes jobs to the main thread queue, as RTD notifications
+      /// and COM calls from worker threads do, while a consumer thread drains
+      /// it on a millisecond clock. A mix of priorities, short delays and
+      /// jobs which fail once and retry exercises the timer wheel.
+      /// </summary>
+      class MainQueueScenario : public GridScenario
+      {
+        static constexpr size_t JOBS_PER_CELL = 20;
+
+        std::unique_ptr<MainThreadQueue> _queue;
+        std::atomic<size_t> _done{ 0 };
+
+      public:
+        const char* name() const override { return "main-queue"; }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _queue = make_unique<MainThreadQueue>();
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          _done = 0;
+          const auto total = nCells() * JOBS_PER_CELL;
+          std::thread consumer([this, total]()
+          {
+            while (_done < total)
+            {
+              _queue->run(now(), [](MainThreadQueue::Job& job)
+              {
+                // Fail the first attempt of jobs with a retry wait of 1
+                if (job.retryWait == 1)
+                {
+                  job.retryWait = 0;
+                  return false;
+                }
+                job.task();
+                return true;
+              });
+              std::this_thread::yield();
+            }
+          });
+
+          recalc.run(_rows, _cols, [this](int row, int col)
+          {
+            const auto index = cellIndex(row, col);
+            for (auto i = 0u; i < JOBS_PER_CELL; ++i)
+            {
+              const auto kind = (index + i) % 10;
+              const int flags = kind == 0 ? ExcelRunQueue::HIGH_PRIORITY
+                : kind == 1 ? ExcelRunQueue::LOW_PRIORITY : 0;
+              const unsigned delay = kind == 2 ? 5 : 0;
+              const unsigned retryWait = kind == 3 ? 1 : 0;
+              _queue->push([this]() { ++_done; }, flags, delay, retryWait, now());
+            }
+          });
+
+          consumer.join();
+          check(_queue->depth() == 0, "MainThreadQueue::run");
+          return total;
+        }
+
+        void teardown() override { _queue.reset(); }
+      };
+
+      /// <summary>
+      /// Each cell makes a number of Excel API calls via the main thread
+      /// queue, as xloil.call_async and xloil.call_batch_async do from Python
+      /// worker threads, and waits for the results. Run either with one queue 
+      /// item and future per call or with one for the cell's whole batch, to 
+      /// compare the cost of the trips to the main thread. A consumer thread 
+      /// stands in for Excel's main thread.
+      /// </summary>
+      class XllCallScenario : public GridScenario
+      {
+        static constexpr size_t CALLS_PER_CELL = 50;
+
+        bool _batch;
+        std::unique_ptr<MainThreadQueue> _queue;
+
+        static ExcelObj callExcel()
+        {
+          ExcelObj result;
+          callExcelRaw(msxll::xlGetHwnd, &result);
+          return result;
+        }
+
+        template<class F>
+        auto runOnConsumer(F&& func)
+        {
+          auto task = std::make_shared<std::packaged_task<decltype(func())()>>(std::forward<F>(func));
+          _queue->push([task]() { (*task)(); }, ExcelRunQueue::XLL_API, 0, 0, now());
+          return task->get_future();
+        }
+
+      public:
+        XllCallScenario(bool batch) : _batch(batch) {}
+
+        const char* name() const override { return _batch ? "xlcall-batch" : "xlcall-each"; }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _queue = make_unique<MainThreadQueue>();
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          std::atomic<bool> stop{ false };
+          std::thread consumer([&]()
+          {
+            while (!stop)
+            {
+              _queue->run(now(), [](MainThreadQueue::Job& job)
+              {
+                job.task();
+                return true;
+              });
+              std::this_thread::yield();
+            }
+          });
+
+          recalc.run(_rows, _cols, [this](int, int)
+          {
+            if (_batch)
+            {
+              auto results = runOnConsumer([]()
+              {
+                vector<ExcelObj> values;
+                values.reserve(CALLS_PER_CELL);
+                for (auto i = 0u; i < CALLS_PER_CELL; ++i)
+                  values.emplace_back(callExcel());
+                return values;
+              }).get();
+              check(results.size() == CALLS_PER_CELL, "batched call");
+            }
+            else
+            {
+              vector<std::future<ExcelObj>> futures;
+              futures.reserve(CALLS_PER_CELL);
+              for (auto i = 0u; i < CALLS_PER_CELL; ++i)
+                futures.emplace_back(runOnConsumer(&callExcel));
+              for (auto& f : futures)
+                f.get();
+            }
+          });
+
+          stop = true;
+          consumer.join();
+          return nCells() * CALLS_PER_CELL;
+        }
+
+        void teardown() override { _queue.reset(); }
+      };
+
+      /// <summary>
+      /// Each cell in the first column of the grid creates a database and 
+      /// reads a table from a range on the host's sheet with xloSqlTable.
+      /// The table is scanned by a query, so this shows how many xlCoerce
+      /// callbacks reading a large range takes.
+      /// </summary>
+      class SqlRangeScenario : public GridScenario
+      {
+        static constexpr int TABLE_ROWS = 20000;
+        static constexpr int TABLE_COLS = 4;
+
+        void* _xloSqlDB = nullptr;
+        void* _xloSqlTable = nullptr;
+
+      public:
+        const char* name() const override { return "sql-range"; }
+
+        string setup(HeadlessHost& host, const Options& opts) override
+        {
+          setupGrid(opts);
+          _xloSqlDB = HeadlessHost::entryPoint(SQL_DLL, "xloSqlDB", 1);
+          _xloSqlTable = HeadlessHost::entryPoint(SQL_DLL, "xloSqlTable", 5);
+          if (!_xloSqlDB || !_xloSqlTable)
+            return "xlOil_SQL not found";
+
+          // A heading row followed by numbers
+          const wchar_t* headings[TABLE_COLS] = { L"c0", L"c1", L"c2", L"c3" };
+          std::uniform_real_distribution<double> value(-1000, 1000);
+          ExcelArrayBuilder builder(TABLE_ROWS + 1, TABLE_COLS, 2 * TABLE_COLS);
+          for (auto j = 0; j < TABLE_COLS; ++j)
+            builder(0, j) = std::wstring_view(headings[j]);
+          for (auto i = 1; i <= TABLE_ROWS; ++i)
+            for (auto j = 0; j < TABLE_COLS; ++j)
+              builder(i, j) = value(_rng);
+          host.setSheetValues(builder.toExcelObj());
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          const ExcelObj range(HeadlessHost::SHEET_ID, 
+            msxll::xlref12{ 0, TABLE_ROWS, 0, TABLE_COLS - 1 });
+          const ExcelObj tableName(L"T");
+          const ExcelObj query(L"SELECT c0, SUM(c1), MAX(c2) FROM T GROUP BY c3 > 0");
+          const auto& missing = Const::Missing();
+
+          recalc.run(_rows, 1, [&](int, int)
+          {
+            auto db = HeadlessHost::call(_xloSqlDB, missing);
+            check(db.isType(ExcelType::Str), "xloSqlDB");
+            auto result = HeadlessHost::call(_xloSqlTable, db, range, tableName, missing, query);
+            check(result == db, "xloSqlTable");
+          });
+          return _rows;
+        }
+      };
+
+      /// <summary>
+      /// Every cell runs a read-only query on one database created in setup,
+      /// either in memory, where queries run one at a time, or in a WAL-mode
+      /// file, where each calc thread reads through its own connection.
+      /// Compare the two to see the throughput gain from parallel readers.
+      /// </summary>
+      class SqlQueryScenario : public GridScenario
+      {
+        static constexpr int TABLE_ROWS = 20000;
+
+        bool _file;
+        void* _xloSqlQuery = nullptr;
+        ExcelObj _db;
+
+      public:
+        SqlQueryScenario(bool file) : _file(file) {}
+
+        const char* name() const override { return _file ? "sql-query-file" : "sql-query-mem"; }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          auto xloSqlDB = HeadlessHost::entryPoint(SQL_DLL, "xloSqlDB", 1);
+          auto xloSqlTable = HeadlessHost::entryPoint(SQL_DLL, "xloSqlTable", 5);
+          _xloSqlQuery = HeadlessHost::entryPoint(SQL_DLL, "xloSqlQuery", 2);
+          if (!xloSqlDB || !xloSqlTable || !_xloSqlQuery)
+            return "xlOil_SQL not found";
+
+          const auto& missing = Const::Missing();
+          ExcelObj path;
+          if (_file)
+          {
+            const auto file = std::filesystem::temp_directory_path() / L"xloil_bench.db";
+            std::error_code ignored;
+            std::filesystem::remove(file, ignored);
+            path = ExcelObj(file.wstring());
+          }
+          _db = HeadlessHost::call(xloSqlDB, _file ? path : missing);
+          check(_db.isType(ExcelType::Str), "xloSqlDB");
+
+          auto data = randomNumbers(_rng, TABLE_ROWS, 4);
+          ExcelArrayBuilder headingArray(1, 4, 8);
+          for (auto j = 0; j < 4; ++j)
+            headingArray(0, j) = std::wstring_view(L"c0c1c2c3" + 2 * j, 2);
+          auto result = HeadlessHost::call(xloSqlTable, 
+            _db, data, ExcelObj(L"T"), headingArray.toExcelObj(), missing);
+          check(result == _db, "xloSqlTable");
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          const ExcelObj query(
+            L"SELECT c3 > 0, COUNT(*), SUM(c1), MAX(c2) FROM T WHERE c0 > -500 GROUP BY c3 > 0");
+          recalc.run(_rows, _cols, [&](int, int)
+          {
+            auto result = HeadlessHost::call(_xloSqlQuery, _db, query);
+            check(result.isType(ExcelType::Multi), "xloSqlQuery");
+          });
+          return nCells();
+        }
+
+        void teardown() override { _db.reset(); }
+      };
+
+      /// <summary>
+      /// Every cell runs a one-off xloSql query joining two small arrays.
+      /// When warm, all cells pass arrays of the same shape so the thread's 
+      /// pooled database and its tables and prepared statement are reused.
+      /// When cold, the number of columns alternates between cells, so the
+      /// tables are recreated and the query prepared on each call, which 
+      /// approximates the cost without the pool other than opening the 
+      /// database.
+      /// </summary>
+      class SqlOneShotScenario : public GridScenario
+      {
+        static constexpr int TABLE_ROWS = 50;
+
+        bool _warm;
+        void* _xloSql = nullptr;
+        ExcelObj _tables[2][2];
+
+      public:
+        SqlOneShotScenario(bool warm) : _warm(warm) {}
+
+        const char* name() const override { return _warm ? "sql-oneshot-warm" : "sql-oneshot-cold"; }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _xloSql = HeadlessHost::entryPoint(SQL_DLL, "xloSql", 12);
+          if (!_xloSql)
+            return "xlOil_SQL not found";
+
+          // A heading row followed by numbers, with 3 or 4 columns
+          for (auto k = 0; k < 2; ++k)
+          {
+            const auto nCols = 3 + k;
+            for (auto t = 0; t < 2; ++t)
+            {
+              std::uniform_real_distribution<double> value(-1000, 1000);
+              ExcelArrayBuilder builder(TABLE_ROWS + 1, nCols, 2 * nCols);
+              for (auto j = 0; j < nCols; ++j)
+                builder(0, j) = std::wstring_view(L"c0c1c2c3" + 2 * j, 2);
+              for (auto i = 1; i <= TABLE_ROWS; ++i)
+              {
+                builder(i, 0) = i;
+                for (auto j = 1; j < nCols; ++j)
+                  builder(i, j) = value(_rng);
+              }
+              _tables[k][t] = builder.toExcelObj();
+            }
+          }
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          const ExcelObj query(
+            L"SELECT COUNT(*), SUM(A.c1 * B.c2) FROM Table1 A JOIN Table2 B ON A.c0 = B.c0 WHERE A.c2 > 0");
+          const auto& missing = Const::Missing();
+
+          recalc.run(_rows, _cols, [&](int i, int j)
+          {
+            const auto k = _warm ? 0 : (i + j) % 2;
+            auto result = HeadlessHost::call(_xloSql, query, missing, 
+              _tables[k][0], _tables[k][1], 
+              missing, missing, missing, missing, missing, missing, missing, missing);
+            check(result.isType(ExcelType::Multi), "xloSql");
+          });
+          return nCells();
+        }
+
+        void teardown() override
+        {
+          for (auto& tables : _tables)
+            for (auto& table : tables)
+              table.reset();
+        }
+      };
+
+      /// <summary>
+      /// Each cell looks up a random key in a table of a million rows. When
+      /// indexed, the table is indexed once with xloIndexBuild and each cell
+      /// calls xloLookup. Otherwise each cell scans the key column as 
+      /// VLOOKUP or MATCH does, so the two show the cost of a recalc with and
+      /// without the index.
+      /// </summary>
+      class LookupScenario : public GridScenario
+      {
+        static constexpr int TABLE_ROWS = 1000000;
+
+        bool _indexed;
+        void* _xloLookup = nullptr;
+        ExcelObj _table;
+        ExcelObj _index;
+        vector<ExcelObj> _keys;
+
+        static wstring key(int i, bool upper)
+        {
+          return (upper ? L"K" : L"k") + std::to_wstring(i);
+        }
+
+      public:
+        LookupScenario(bool indexed) : _indexed(indexed) {}
+
+        const char* name() const override { return _indexed ? "lookup-index" : "lookup-scan"; }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          auto xloIndexBuild = HeadlessHost::entryPoint(UTILS_DLL, "xloIndexBuild", 4);
+          _xloLookup = HeadlessHost::entryPoint(UTILS_DLL, "xloLookup", 4);
+          if (!xloIndexBuild || !_xloLookup)
+            return "xlOil_Utils not found";
+
+          // String keys in the first column, numbers in the second
+          ExcelArrayBuilder builder(TABLE_ROWS, 2, TABLE_ROWS * 8);
+          for (auto i = 0; i < TABLE_ROWS; ++i)
+          {
+            builder(i, 0) = key(i, true);
+            builder(i, 1) = i;
+          }
+          _table = builder.toExcelObj();
+
+          // Lookups differ in case from the keys
+          std::uniform_int_distribution<int> row(0, TABLE_ROWS - 1);
+          _keys.clear();
+          for (size_t i = 0; i < nCells(); ++i)
+            _keys.emplace_back(key(row(_rng), false));
+
+          if (_indexed)
+          {
+            const auto& missing = Const::Missing();
+            _index = HeadlessHost::call(xloIndexBuild, _table, missing, missing, missing);
+            check(_index.isType(ExcelType::Str), "xloIndexBuild");
+          }
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          const ExcelObj returnCol(2);
+          const auto& missing = Const::Missing();
+          const ExcelArray table(_table);
+
+          recalc.run(_rows, _cols, [&](int row, int col)
+          {
+            const auto& lookup = _keys[cellIndex(row, col)];
+            if (_indexed)
+            {
+              auto result = HeadlessHost::call(_xloLookup, _index, lookup, returnCol, missing);
+              check(result.isType(ExcelType::Int) || result.isType(ExcelType::Num), "xloLookup");
+            }
+            else
+            {
+              bool found = false;
+              for (ExcelArray::row_t i = 0; i < table.nRows() && !found; ++i)
+                found = ExcelObj::compare(table.at(i, 0), lookup) == 0;
+              check(found, "scan");
+            }
+          });
+          return nCells();
+        }
+
+        void teardown() override
+        {
+          _index.reset();
+          _table.reset();
+          _keys.clear();
+        }
+      };
+
+      /// <summary>
+      /// Joins or groups a table of a million rows in a single call, either
+      /// with xloJoin and xloGroupBy or the equivalent xloSql query. The SQL
+      /// join scans the right table for every left row, so its right table
+      /// is kept small.
+      /// </summary>
+      class RelationalScenario : public GridScenario
+      {
+        static constexpr int TABLE_ROWS = 1000000;
+        static constexpr int RIGHT_ROWS = 100;
+        static constexpr int N_GROUPS = 1000;
+
+      public:
+        enum Operation { Join, GroupBy };
+
+      private:
+        Operation _op;
+        bool _sql;
+        void* _func = nullptr;
+        ExcelObj _left;
+        ExcelObj _right;
+
+        static ExcelObj makeTable(std::mt19937& rng, int nRows, int nKeys, bool uniqueKeys)
+        {
+          std::uniform_int_distribution<int> key(0, nKeys - 1);
+          std::uniform_real_distribution<double> value(-1000, 1000);
+          ExcelArrayBuilder builder(nRows + 1, 2, 2);
+          builder(0, 0) = std::wstring_view(L"k");
+          builder(0, 1) = std::wstring_view(L"v");
+          for (auto i = 1; i <= nRows; ++i)
+          {
+            builder(i, 0) = uniqueKeys ? i - 1 : key(rng);
+            builder(i, 1) = value(rng);
+          }
+          return builder.toExcelObj();
+        }
+
+      public:
+        RelationalScenario(Operation op, bool sql) : _op(op), _sql(sql) {}
+
+        const char* name() const override
+        {
+          return _op == Join
+            ? (_sql ? "join-sql" : "join-native")
+            : (_sql ? "groupby-sql" : "groupby-native");
+        }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _func = _sql
+            ? HeadlessHost::entryPoint(SQL_DLL, "xloSql", 12)
+            : _op == Join
+              ? HeadlessHost::entryPoint(UTILS_DLL, "xloJoin", 6)
+              : HeadlessHost::entryPoint(UTILS_DLL, "xloGroupBy", 5);
+          if (!_func)
+            return _sql ? "xlOil_SQL not found" : "xlOil_Utils not found";
+
+          if (_op == Join)
+          {
+            _left = makeTable(_rng, TABLE_ROWS, RIGHT_ROWS, false);
+            _right = makeTable(_rng, RIGHT_ROWS, RIGHT_ROWS, true);
+          }
+          else
+            _left = makeTable(_rng, TABLE_ROWS, N_GROUPS, false);
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          const auto& missing = Const::Missing();
+          recalc.run(1, 1, [&](int, int)
+          {
+            ExcelObj result;
+            if (_op == Join)
+            {
+              result = _sql
+                ? HeadlessHost::call(_func,
+                    ExcelObj(L"SELECT Table1.k, Table1.v, Table2.v FROM Table1 JOIN Table2 ON Table1.k = Table2.k"),
+                    missing, _left, _right, 
+                    missing, missing, missing, missing, missing, missing, missing, missing)
+                : HeadlessHost::call(_func, _left, _right, ExcelObj(L"k"), missing, missing, missing);
+              check(result.isType(ExcelType::Multi)
+                && result.val.array.rows == TABLE_ROWS + 1, "join");
+            }
+            else
+            {
+              result = _sql
+                ? HeadlessHost::call(_func,
+                    ExcelObj(L"SELECT k, SUM(v), COUNT(v), MAX(v) FROM Table1 GROUP BY k"),
+                    missing, _left, 
+                    missing, missing, missing, missing, missing, missing, missing, missing, missing)
+                : HeadlessHost::call(_func, _left, ExcelObj(L"k"), 
+                    ExcelObj{ L"v", L"v", L"v" }, ExcelObj{ L"sum", L"count", L"max" }, missing);
+              check(result.isType(ExcelType::Multi)
+                && result.val.array.rows == N_GROUPS + 1, "group by");
+            }
+          });
+          return 1;
+        }
+
+        void teardown() override
+        {
+          _left.reset();
+          _right.reset();
+        }
+      };
+
+      /// <summary>
+      /// Compares a mixed column of a million rows, mostly short strings of
+      /// varying case, with each of a set of values, either one pair at a 
+      /// time with ExcelObj::compare, as a filter or MATCH would, or with 
+      /// the batched ColumnKeys comparison. Also sorts the column with 
+      /// xloSort, whose comparisons use ColumnKeys.
+      /// </summary>
+      class CompareScenario : public GridScenario
+      {
+        static constexpr int N_ROWS = 1000000;
+        static constexpr int N_VALUES = 10;
+
+      public:
+        enum Mode { Scalar, Batched, Sort };
+
+      private:
+        Mode _mode;
+        void* _xloSort = nullptr;
+        ExcelObj _column;
+        vector<ExcelObj> _values;
+
+      public:
+        CompareScenario(Mode mode) : _mode(mode) {}
+
+        const char* name() const override
+        {
+          return _mode == Scalar ? "compare-scalar"
+            : _mode == Batched ? "compare-batched" : "sort-strings";
+        }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _xloSort = HeadlessHost::entryPoint(UTILS_DLL, "xloSort", 10);
+          if (_mode == Sort && !_xloSort)
+            return "xlOil_Utils not found";
+
+          std::uniform_int_distribution<int> kind(0, 9);
+          std::uniform_real_distribution<double> number(-1000, 1000);
+          vector<wstring> strings;
+          size_t strLen = 0;
+          for (auto i = 0; i < N_ROWS; ++i)
+          {
+            strings.push_back(randomString(_rng, 4, 16));
+            if (kind(_rng) == 0)
+              strings.back()[0] = towupper(strings.back()[0]);
+            strLen += strings.back().size();
+          }
+          ExcelArrayBuilder builder(N_ROWS, 1, strLen);
+          for (auto i = 0; i < N_ROWS; ++i)
+          {
+            // One in ten values is a number
+            if (kind(_rng) == 0)
+              builder(i, 0) = number(_rng);
+            else
+              builder(i, 0) = strings[i];
+          }
+          _column = builder.toExcelObj();
+
+          _values.clear();
+          for (auto i = 0; i < N_VALUES; ++i)
+            _values.emplace_back(randomString(_rng, 4, 16));
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          const auto& missing = Const::Missing();
+          size_t nCalls = 0;
+          recalc.run(1, 1, [&](int, int)
+          {
+            const ExcelArray column(_column);
+            switch (_mode)
+            {
+            case Scalar:
+            {
+              vector<int> results(N_ROWS);
+              for (auto& value : _values)
+                for (auto i = 0; i < N_ROWS; ++i)
+                  results[i] = ExcelObj::compare(column(i), value);
+              nCalls = _values.size();
+              break;
+            }
+            case Batched:
+            {
+              vector<int> results(N_ROWS);
+              const ColumnKeys keys(column, 0);
+              for (auto& value : _values)
+                keys.compare(value, results.data());
+              nCalls = _values.size();
+              break;
+            }
+            case Sort:
+            {
+              // xloSort sorts its argument in-place, so pass it a copy
+              ExcelObj input(_column);
+              const ExcelObj order(L"a");
+              const ExcelObj* sortArgs[] = { &input, &order,
+                &missing, &missing, &missing, &missing, &missing, &missing, &missing, &missing };
+              auto sorted = HeadlessHost::call(_xloSort, sortArgs, _countof(sortArgs));
+              check(sorted.isType(ExcelType::Multi), "xloSort");
+              nCalls = 1;
+              break;
+            }
+            }
+          });
+          return nCalls;
+        }
+
+        void teardown() override
+        {
+          _column.reset();
+          _values.clear();
+        }
+      };
+
+      /// <summary>
+      /// Builds a string column of a million rows, as sqlQueryToArray and 
+      /// the numpy converters do, with and without string interning. The 
+      /// column is low cardinality, like a column of currency codes, or high 
+      /// cardinality, where every string is distinct. Reports the size of the
+      /// array block.
+      /// </summary>
+      class StringStoreScenario : public GridScenario
+      {
+        static constexpr int N_ROWS = 1000000;
+        static constexpr int N_CATEGORIES = 20;
+
+        bool _lowCardinality;
+        bool _intern;
+        vector<wstring> _values;
+        size_t _bytes = 0;
+
+      public:
+        StringStoreScenario(bool lowCardinality, bool intern)
+          : _lowCardinality(lowCardinality), _intern(intern)
+        {}
+
+        const char* name() const override
+        {
+          return _lowCardinality
+            ? (_intern ? "strings-low-interned" : "strings-low")
+            : (_intern ? "strings-high-interned" : "strings-high");
+        }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          vector<wstring> categories;
+          for (auto i = 0; i < N_CATEGORIES; ++i)
+            categories.push_back(randomString(_rng, 3, 3));
+          std::uniform_int_distribution<int> category(0, N_CATEGORIES - 1);
+
+          _values.clear();
+          for (auto i = 0; i < N_ROWS; ++i)
+            _values.push_back(_lowCardinality
+              ? categories[category(_rng)]
+              : randomString(_rng, 3, 3) + std::to_wstring(i));
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          recalc.run(1, 1, [&](int, int)
+          {
+            ArrayStringCounter strings(_intern);
+            for (auto& v : _values)
+              strings.add(v);
+
+            ExcelArrayBuilder builder(N_ROWS, 1, strings);
+            for (auto i = 0; i < N_ROWS; ++i)
+              builder(i, 0) = _values[i];
+            auto result = builder.toExcelObj();
+            check(result.val.array.rows == N_ROWS, "string store");
+            _bytes = sizeof(ExcelObj) * N_ROWS + sizeof(wchar_t) * strings.length();
+          });
+          return 1;
+        }
+
+        void teardown() override { _values.clear(); }
+
+        size_t resultBytes() const override { return _bytes; }
+      };
+
+      /// <summary>
+      /// Concatenates a 100k-cell array of numbers, strings or a mix of types
+      /// with xloConcat. Exercises the toStringRecursive writer and the number
+      /// formatter. Excel truncates the result, but the whole array is written.
+      /// </summary>
+      class ConcatScenario : public GridScenario
+      {
+      public:
+        enum Content { Numbers, Strings, Mixed };
+
+      private:
+        static constexpr int N_ROWS = 1000;
+        static constexpr int N_COLS = 100;
+
+        Content _content;
+        void* _xloConcat = nullptr;
+        ExcelObj _array;
+
+      public:
+        ConcatScenario(Content content) : _content(content) {}
+
+        const char* name() const override
+        {
+          switch (_content)
+          {
+          case Numbers: return "concat-numbers";
+          case Strings: return "concat-strings";
+          default:      return "concat-mixed";
+          }
+        }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _xloConcat = HeadlessHost::entryPoint(UTILS_DLL, "xloConcat", 11);
+          if (!_xloConcat)
+            return "xlOil_Utils not found";
+
+          std::uniform_real_distribution<double> number(-1e6, 1e6);
+          vector<ExcelObj> values;
+          size_t strLen = 0;
+          for (auto i = 0; i < N_ROWS * N_COLS; ++i)
+          {
+            const auto kind = _content == Mixed ? i % 3 : (int)_content;
+            if (kind == Numbers)
+              values.emplace_back(number(_rng));
+            else if (kind == Strings)
+              values.emplace_back(randomString(_rng, 1, 12));
+            else
+              values.emplace_back(i);
+            strLen += values.back().stringLength();
+          }
+          ExcelArrayBuilder builder(N_ROWS, N_COLS, strLen);
+          for (auto i = 0; i < N_ROWS * N_COLS; ++i)
+            builder(i / N_COLS, i % N_COLS) = values[i];
+          _array = builder.toExcelObj();
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          const ExcelObj separator(L",");
+          const auto& missing = Const::Missing();
+
+          recalc.run(1, 1, [&](int, int)
+          {
+            const ExcelObj* concatArgs[] = { &separator, &_array,
+              &missing, &missing, &missing, &missing, &missing, &missing, &missing, &missing, &missing };
+            auto joined = HeadlessHost::call(_xloConcat, concatArgs, _countof(concatArgs));
+            check(joined.isType(ExcelType::Str), "xloConcat");
+          });
+          return (size_t)N_ROWS * N_COLS;
+        }
+
+        void teardown() override { _array.reset(); }
+      };
+
+      /// <summary>
+      /// Converts a million Excel serial dates, spread over the whole Excel
+      /// date range, to year, month and day, one at a time with 
+      /// excelSerialDateToYMD or as a column with excelSerialDatesToYMD.
+      /// </summary>
+      class DateScenario : public GridScenario
+      {
+        static constexpr int N_DATES = 1000000;
+
+        bool _batched;
+        vector<int> _serials, _years, _months, _days;
+
+      public:
+        DateScenario(bool batched) : _batched(batched) {}
+
+        const char* name() const override
+        {
+          return _batched ? "dates-batched" : "dates-scalar";
+        }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          std::uniform_int_distribution<int> serial(1, XL_MAX_SERIAL_DATE);
+          _serials.resize(N_DATES);
+          for (auto& s : _serials)
+            s = serial(_rng);
+          _years.resize(N_DATES);
+          _months.resize(N_DATES);
+          _days.resize(N_DATES);
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          recalc.run(1, 1, [&](int, int)
+          {
+            size_t nValid = 0;
+            if (_batched)
+              nValid = excelSerialDatesToYMD(_serials.data(), N_DATES,
+                _years.data(), _months.data(), _days.data());
+            else
+              for (auto i = 0; i < N_DATES; ++i)
+                nValid += excelSerialDateToYMD(_serials[i], _years[i], _months[i], _days[i]);
+            check(nValid == N_DATES, "date conversion");
+          });
+          return N_DATES;
+        }
+
+        void teardown() override
+        {
+          _serials.clear();
+          _years.clear();
+          _months.clear();
+          _days.clear();
+        }
+      };
+
+      /// <summary>
+      /// Each cell determines its caller, sheet ID and address, as functions
+      /// which key state on the calling cell do. Shows how many xlSheetNm and
+      /// xlSheetId callbacks are made per recalc.
+      /// </summary>
+      class CallerScenario : public GridScenario
+      {
+      public:
+        const char* name() const override { return "caller-info"; }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          recalc.run(_rows, _cols, [](int, int)
+          {
+            CallerInfo caller;
+            check(caller.sheetName() == L"Sheet1", "CallerInfo::sheetName");
+            check(caller.sheetId() == HeadlessHost::SHEET_ID, "CallerInfo::sheetId");
+            check(!caller.writeAddress().empty(), "CallerInfo::writeAddress");
+          });
+          return nCells();
+        }
+      };
+
+      using namespace Python::WorkerPool::Protocol;
+
+      /// <summary>
+      /// Iterations of the worker kernel, about half a millisecond of work
+      /// </summary>
+      constexpr int KERNEL_STEPS = 100000;
+
+      /// <summary>
+      /// A CPU-bound stand-in for a python function. It's deterministic, so
+      /// results from the workers can be checked against an in-process run.
+      /// </summary>
+      double kernel(int seed, int steps)
+      {
+        std::mt19937 rng((unsigned)seed);
+        std::uniform_real_distribution<double> value(0, 1);
+        double total = 0;
+        for (auto i = 0; i < steps; ++i)
+          total += std::sqrt(value(rng)) * std::sin(i * 1e-3);
+        return total;
+      }
+
+      /// <summary>
+      /// Each cell sends a CPU-bound call to a pool of worker processes over
+      /// the python worker pool's channel protocol, blocking until a worker
+      /// is free. The workers are copies of this executable started with
+      /// --worker. Runs with one worker, and with one per recalc thread, to
+      /// show how the pool scales.
+      /// </summary>
+      class WorkerPoolScenario : public GridScenario
+      {
+        struct Worker
+        {
+          unique_ptr<Channel> channel;
+          HANDLE process = nullptr;
+        };
+
+        bool _scaled;
+        unsigned _seed = 0;
+        vector<Worker> _workers;
+        vector<Worker*> _idle;
+        vector<double> _expected;
+        std::mutex _lock;
+        std::condition_variable _available;
+
+        Worker& acquire()
+        {
+          std::unique_lock<std::mutex> lock(_lock);
+          _available.wait(lock, [&]() { return !_idle.empty(); });
+          auto* worker = _idle.back();
+          _idle.pop_back();
+          return *worker;
+        }
+
+        void release(Worker& worker)
+        {
+          {
+            std::scoped_lock lock(_lock);
+            _idle.push_back(&worker);
+          }
+          _available.notify_one();
+        }
+
+        double call(int seed)
+        {
+          auto& worker = acquire();
+          auto& channel = *worker.channel;
+
+          auto writer = channel.writer();
+          BinaryWriter callHeader(1, 3);
+          callHeader(0) = std::wstring_view(L"kernel");
+          callHeader(1) = std::wstring_view();
+          callHeader(2) = 2;
+          writer.write(callHeader);
+          writer.write(ExcelObj(seed));
+          writer.write(ExcelObj(KERNEL_STEPS));
+          channel.send(Message::Call, writer);
+
+          channel.signalRequest();
+          const auto alive = channel.waitResponse(worker.process);
+          const auto ok = alive && channel.header().message == Message::Ok;
+          const auto result = ok ? channel.reader().read() : ExcelObj();
+          // Other cells may be waiting for this worker, so release it before
+          // any check throws
+          release(worker);
+          if (!alive)
+            XLO_THROW("Bench worker process exited");
+          check(result.isType(ExcelType::Num), "worker");
+          return result.get<double>();
+        }
+
+      public:
+        WorkerPoolScenario(bool scaled) : _scaled(scaled) {}
+
+        const char* name() const override
+        {
+          return _scaled ? "worker-pool-n" : "worker-pool-1";
+        }
+
+        string setup(HeadlessHost&, const Options& opts) override
+        {
+          setupGrid(opts);
+          _seed = opts.seed;
+
+          wchar_t exePath[MAX_PATH];
+          if (GetModuleFileNameW(nullptr, exePath, MAX_PATH) == 0)
+            return "cannot locate bench executable";
+
+          const auto nWorkers = _scaled ? opts.threads : 1;
+          _workers.resize(nWorkers);
+          for (size_t i = 0; i < nWorkers; ++i)
+          {
+            auto& worker = _workers[i];
+            const auto channelName = formatStr(L"Local\\xlOil_Bench_Worker_%d_%d",
+              (int)GetCurrentProcessId(), (int)i);
+            worker.channel = make_unique<Channel>(channelName, 4096);
+
+            auto cmdLine = formatStr(L"\"%s\" --worker %s %d",
+              exePath, channelName.c_str(), (int)GetCurrentProcessId());
+            STARTUPINFOW startup = { sizeof(startup) };
+            PROCESS_INFORMATION info;
+            if (!CreateProcessW(exePath, cmdLine.data(), nullptr, nullptr, FALSE,
+                0, nullptr, nullptr, &startup, &info))
+            {
+              teardown();
+              return "failed to start worker process";
+            }
+            CloseHandle(info.hThread);
+            worker.process = info.hProcess;
+            _idle.push_back(&worker);
+          }
+
+          // Untimed: the same kernel in-process gives the expected results
+          _expected.clear();
+          for (size_t i = 0; i < nCells(); ++i)
+            _expected.push_back(kernel((int)(_seed + i), KERNEL_STEPS));
+          return string();
+        }
+
+        size_t run(Recalc& recalc) override
+        {
+          recalc.run(_rows, _cols, [this](int row, int col)
+          {
+            const auto index = cellIndex(row, col);
+            const auto seed = (int)(_seed + index);
+            check(call(seed) == _expected[index], "worker kernel");
+          });
+          return nCells();
+        }
+
+        void teardown() override
+        {
+          for (auto& worker : _workers)
+          {
+            if (!worker.process)
+              continue;
+            worker.channel->header().message = Message::Exit;
+            worker.channel->signalRequest();
+            WaitForSingleObject(worker.process, 5000);
+            CloseHandle(worker.process);
+          }
+          _workers.clear();
+          _idle.clear();
+          _expected.clear();
+        }
+      };
+    }
+
+    int serveWorker(const string& channelName, unsigned long parentPid)
+    {
+      Channel channel(wstring(channelName.begin(), channelName.end()));
+      auto parent = OpenProcess(SYNCHRONIZE, FALSE, parentPid);
+      if (!parent)
+        return 1;
+
+      while (channel.waitRequest(parent) && channel.header().message == Message::Call)
+      {
+        auto reader = channel.reader();
+        reader.next();
+        const auto seed = reader.next().integer(0);
+        const auto steps = reader.next().integer(0);
+
+        auto writer = channel.writer();
+        writer.write(ExcelObj(kernel(seed, steps)));
+        channel.send(Message::Ok, writer);
+        channel.signalResponse();
+      }
+      CloseHandle(parent);
+      return 0;
+    }
+
+    std::vector<std::unique_ptr<Scenario>> createScenarios()
+    {
+      std::vector<std::unique_ptr<Scenario>> result;
+      result.emplace_back(new CacheScenario());
+      result.emplace_back(new ArrayScenario());
+      result.emplace_back(new StringScenario());
+      result.emplace_back(new AsyncScenario());
+      result.emplace_back(new AsyncBatchScenario());
+      result.emplace_back(new BinaryScenario(BinaryScenario::Numeric));
+      result.emplace_back(new BinaryScenario(BinaryScenario::String));
+      result.emplace_back(new BinaryScenario(BinaryScenario::Mixed));
+      result.emplace_back(new MainQueueScenario());
+      result.emplace_back(new XllCallScenario(false));
+      result.emplace_back(new XllCallScenario(true));
+      result.emplace_back(new CallerScenario());
+      result.emplace_back(new SqlRangeScenario());
+      result.emplace_back(new SqlQueryScenario(false));
+      result.emplace_back(new SqlQueryScenario(true));
+      result.emplace_back(new SqlOneShotScenario(false));
+      result.emplace_back(new SqlOneShotScenario(true));
+      result.emplace_back(new LookupScenario(true));
+      result.emplace_back(new LookupScenario(false));
+      result.emplace_back(new RelationalScenario(RelationalScenario::Join, false));
+      result.emplace_back(new RelationalScenario(RelationalScenario::Join, true));
+      result.emplace_back(new RelationalScenario(RelationalScenario::GroupBy, false));
+      result.emplace_back(new RelationalScenario(RelationalScenario::GroupBy, true));
+      result.emplace_back(new CompareScenario(CompareScenario::Scalar));
+      result.emplace_back(new CompareScenario(CompareScenario::Batched));
+      result.emplace_back(new CompareScenario(CompareScenario::Sort));
+      result.emplace_back(new StringStoreScenario(true, false));
+      result.emplace_back(new StringStoreScenario(true, true));
+      result.emplace_back(new StringStoreScenario(false, false));
+      result.emplace_back(new StringStoreScenario(false, true));
+      result.emplace_back(new ConcatScenario(ConcatScenario::Numbers));
+      result.emplace_back(new ConcatScenario(ConcatScenario::Strings));
+      result.emplace_back(new ConcatScenario(ConcatScenario::Mixed));
+      result.emplace_back(new DateScenario(false));
+      result.emplace_back(new DateScenario(true));
+      result.emplace_back(new WorkerPoolScenario(false));
+      result.emplace_back(new WorkerPoolScenario(true));
+      return result;
+    }
+  }
+}
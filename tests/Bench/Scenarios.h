@@ -0,0 +1,68 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xloil
+{
+  namespace Bench
+  {
+    class HeadlessHost;
+    class Recalc;
+
+    struct Options
+    {
+      size_t threads = 4;
+      /// <summary>
+      /// Size of the grid of calling cells
+      /// </summary>
+      int rows = 100;
+      int cols = 10;
+      size_t repeat = 5;
+      /// <summary>
+      /// Seed for generated arguments, so runs are reproducible
+      /// </summary>
+      unsigned seed = 1234;
+    };
+
+    /// <summary>
+    /// A calculation workload. Arguments are generated in setup, outside
+    /// of the timed section, then each call to run is one timed recalc.
+    /// </summary>
+    class Scenario
+    {
+    public:
+      virtual ~Scenario() {}
+
+      virtual const char* name() const = 0;
+
+      /// <summary>
+      /// Returns a reason why the scenario cannot run, e.g. a plugin could
+      /// not be loaded, or an empty string if it's ready.
+      /// </summary>
+      virtual std::string setup(HeadlessHost& host, const Options& opts) = 0;
+
+      /// <summary>
+      /// Performs one recalc, returning the number of worksheet function
+      /// calls made. Throws if any result was not as expected.
+      /// </summary>
+      virtual size_t run(Recalc& recalc) = 0;
+
+      virtual void teardown() {}
+
+      /// <summary>
+      /// Bytes allocated for the results of the last recalc, for scenarios
+      /// which measure memory, otherwise zero.
+      /// </summary>
+      virtual size_t resultBytes() const { return 0; }
+    };
+
+    std::vector<std::unique_ptr<Scenario>> createScenarios();
+
+    /// <summary>
+    /// Runs this process as a worker for the worker-pool scenarios, serving
+    /// calls on the named channel until asked to exit or the parent exits.
+    /// </summary>
+    int serveWorker(const std::string& channelName, unsigned long parentPid);
+  }
+}
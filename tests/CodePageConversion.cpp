@@ -113,5 +113,52 @@ namespace Tests
         Assert::AreEqual(source, utf16.c_str());
       }
     }
+
+    TEST_METHOD(Utf8RoundTrip)
+    {
+      // Mixes ASCII runs long enough to take the block path with 2, 3 
+      // and 4 byte UTF-8 characters
+      auto source = wstring(L"Hello world, this is ASCII \u4f60\u597d_z\u00df\u6c34 \U0001f34c and more ASCII text");
+      auto utf8 = utf16ToUtf8(source);
+      Assert::AreEqual(To_UTF16(utf8).c_str(), source.c_str());
+      Assert::AreEqual(utf8.size(), xloil::utf8Length(
+        (const char16_t*)source.data(), (const char16_t*)source.data() + source.size()));
+
+      auto utf16 = xloil::utf8ToUtf16(utf8);
+      Assert::AreEqual(source.c_str(), utf16.c_str());
+      Assert::AreEqual(source.size(), xloil::utf16Length(utf8.data(), utf8.data() + utf8.size()));
+    }
+
+    TEST_METHOD(Utf8IntoBuffer)
+    {
+      const string utf8 = u8"abc\u00df\U0001f34c";
+      wchar_t buffer[8];
+      // Truncates at a character boundary but returns the required length
+      auto nChars = xloil::ConvertUTF8ToUTF16()(buffer, 5, utf8.data(), utf8.data() + utf8.size());
+      Assert::AreEqual<size_t>(6, nChars);
+      Assert::AreEqual(L'\u00df', buffer[3]);
+
+      nChars = xloil::ConvertUTF8ToUTF16()(buffer, _countof(buffer), utf8.data(), utf8.data() + utf8.size());
+      Assert::AreEqual(wstring(L"abc\u00df\U0001f34c"), wstring(buffer, nChars));
+    }
+
+    TEST_METHOD(Utf8Invalid)
+    {
+      // Stray continuation, truncated sequence, overlong encoding
+      const string utf8 = "a\x80\xC3 \xC0\xAFz";
+      auto utf16 = xloil::utf8ToUtf16(utf8);
+      Assert::AreEqual(wstring(L"a\uFFFD\uFFFD \uFFFDz"), utf16);
+
+      // Stray continuations in and across SSE blocks are each replaced, and
+      // the length remains an upper bound
+      const auto strays = string(15, 'x') + "\xC3\xA9\xA9" + string(14, '\x80') + "\xE4\xBD";
+      utf16 = xloil::utf8ToUtf16(strays);
+      Assert::AreEqual(wstring(15, L'x') + L"\u00E9" + wstring(15, L'\uFFFD') + L"\uFFFD", utf16);
+      Assert::IsTrue(utf16.size() <= xloil::utf16Length(strays.data(), strays.data() + strays.size()));
+
+      // Unpaired surrogate
+      auto utf8Out = utf16ToUtf8(wstring(L"a") + wchar_t(0xD800) + L"b");
+      Assert::AreEqual(string("a\xEF\xBF\xBD" "b"), utf8Out);
+    }
 	};
 }
@@ -1,11 +1,19 @@
 #include "CppUnitTest.h"
 #include <xlOil/Date.h>
 #include <xloil/ExcelObj.h>
+#include <xloil/ExcelArray.h>
+#include <xloil/ArrayBuilder.h>
+#include <xloil/StringUtils.h>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <vector>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 using namespace xloil;
 using std::wstring;
+using std::vector;
 
 namespace Tests
 {
@@ -48,6 +56,51 @@ namespace Tests
       }
     }
 
+    TEST_METHOD(Test_BatchedDateConversion)
+    {
+      // Every Excel date plus some out of range values
+      vector<int> serials(XL_MAX_SERIAL_DATE + 1);
+      for (auto i = 0; i <= XL_MAX_SERIAL_DATE; ++i)
+        serials[i] = i;
+      serials.push_back(-1);
+      serials.push_back(XL_MAX_SERIAL_DATE + 1);
+
+      const auto n = serials.size();
+      vector<int> years(n), months(n), days(n);
+      Assert::AreEqual<size_t>(XL_MAX_SERIAL_DATE + 1,
+        excelSerialDatesToYMD(serials.data(), n, years.data(), months.data(), days.data()));
+
+      for (auto i = 0; i <= XL_MAX_SERIAL_DATE; ++i)
+      {
+        int year, month, day;
+        excelSerialDateToYMD(i, year, month, day);
+        Assert::AreEqual(year, years[i]);
+        Assert::AreEqual(month, months[i]);
+        Assert::AreEqual(day, days[i]);
+        if (i > 0)
+          Assert::AreEqual(i, excelSerialDateFromYMD(year, month, day));
+        // Excel's 29 February 1900 has no day count of its own
+        if (i != 60)
+          Assert::AreEqual(i, excelSerialDateFromUnixDays(excelSerialDateToUnixDays(i)));
+      }
+      Assert::AreEqual(0, years[n - 2]);
+      Assert::AreEqual(0, days[n - 1]);
+
+      // Excel thinks 1900 was a leap year
+      Assert::AreEqual(1900, years[60]);
+      Assert::AreEqual(2, months[60]);
+      Assert::AreEqual(29, days[60]);
+      Assert::AreEqual(3, months[61]);
+      Assert::AreEqual(1, days[61]);
+
+      Assert::AreEqual(0, excelSerialDateToUnixDays(XL_SERIAL_UNIX_EPOCH));
+      Assert::AreEqual(-25567, excelSerialDateToUnixDays(1));  // 1 January 1900
+      Assert::AreEqual(-25509, excelSerialDateToUnixDays(59)); // 28 February 1900
+      Assert::AreEqual(-25508, excelSerialDateToUnixDays(60));
+      Assert::AreEqual(-25508, excelSerialDateToUnixDays(61)); // 1 March 1900
+      Assert::AreEqual(2932896, excelSerialDateToUnixDays(XL_MAX_SERIAL_DATE));
+    }
+
     void checkTMValues(const std::tm& tm, int year, int month, int day)
     {
       Assert::AreEqual(tm.tm_year + 1900, year);
@@ -77,5 +130,120 @@ namespace Tests
       testVisitorRoundTrip(L"2017-01-01", 2017, 1, 1);
       testVisitorRoundTrip(L"1914-02-28", 1914, 2, 28);
     }
+
+    TEST_METHOD(Test_CompiledFormats)
+    {
+      std::tm result;
+      Assert::IsTrue(stringToDateTime(L"2010-2-3", result, L"%Y-%m-%d"));
+      checkTMValues(result, 2010, 2, 3);
+      
+      Assert::IsTrue(stringToDateTime(L"03 FEBRUARY 2010", result, L"%d %B %Y"));
+      checkTMValues(result, 2010, 2, 3);
+
+      Assert::IsTrue(stringToDateTime(L"12/31/99 1:05 pm", result, L"%D %I:%M %p"));
+      checkTMValues(result, 1999, 12, 31);
+      Assert::AreEqual(13, result.tm_hour);
+      Assert::AreEqual(5, result.tm_min);
+
+      Assert::IsTrue(stringToDateTime(L"2010-02-03T04:05:06", result, L"%Y-%m-%dT%H:%M:%S"));
+      checkTMValues(result, 2010, 2, 3);
+      Assert::AreEqual(6, result.tm_sec);
+
+      Assert::IsTrue(stringToDateTime(L"3 Jun 2010", result, L"%d %b %Y"));
+      checkTMValues(result, 2010, 6, 3);
+      Assert::IsTrue(stringToDateTime(L"03Jun2010", result, L"%d%b%Y"));
+      checkTMValues(result, 2010, 6, 3);
+
+      // Names must not be followed by other letters
+      Assert::IsFalse(stringToDateTime(L"3 Junk 2010", result, L"%d %b %Y"));
+      Assert::IsFalse(stringToDateTime(L"3 Marx 2010", result, L"%d %B %Y"));
+      Assert::IsFalse(stringToDateTime(L"3 Janu 2010", result, L"%d %b %Y"));
+      Assert::IsFalse(stringToDateTime(L"Monx 3 Jun 2010", result, L"%a %d %b %Y"));
+
+      // The whole string must be consumed
+      Assert::IsFalse(stringToDateTime(L"2010-02-03 04:05", result, L"%Y-%m-%d"));
+      Assert::IsFalse(stringToDateTime(L"2010-13-03", result, L"%Y-%m-%d"));
+    }
+
+    TEST_METHOD(Test_ParseColumn)
+    {
+      dateTimeAddFormat(L"%Y-%m-%d");
+      dateTimeAddFormat(L"%d/%m/%Y");
+
+      ExcelArrayBuilder builder(7, 1, 30);
+      builder(0, 0) = L"2010-02-03";
+      builder(1, 0) = L"04/05/2011";
+      builder(2, 0) = excelSerialDateFromYMD(2012, 6, 7);
+      builder(3, 0) = L"Not a date";
+      builder(4, 0) = excelSerialDateFromYMDHMS(2013, 7, 8, 12, 30, 15, 0);
+      builder(5, 0) = -5.0;
+      builder(6, 0) = 60;
+      auto arrayObj = builder.toExcelObj();
+      ExcelArray arr(arrayObj);
+
+      std::tm results[7];
+      bool valid[7];
+      DateTimeParser parser;
+      Assert::AreEqual<size_t>(5, parser.parse(arr, results, valid));
+      checkTMValues(results[0], 2010, 2, 3);
+      checkTMValues(results[1], 2011, 5, 4);
+      checkTMValues(results[2], 2012, 6, 7);
+      Assert::IsFalse(valid[3]);
+      checkTMValues(results[4], 2013, 7, 8);
+      Assert::AreEqual(12, results[4].tm_hour);
+      Assert::AreEqual(30, results[4].tm_min);
+      Assert::IsFalse(valid[5]);
+      checkTMValues(results[6], 1900, 2, 29);
+    }
+
+    TEST_METHOD(Test_DateParseSpeed)
+    {
+      using std::chrono::high_resolution_clock;
+      using std::chrono::duration_cast;
+      using std::chrono::milliseconds;
+
+      dateTimeAddFormat(L"%Y%b%d");
+      dateTimeAddFormat(L"%d %B %Y");
+      dateTimeAddFormat(L"%Y-%m-%d");
+
+      constexpr int N = 100000;
+      ExcelArrayBuilder builder(N, 1, N * 10);
+      for (auto i = 0; i < N; ++i)
+      {
+        int year, month, day;
+        excelSerialDateToYMD(40000 + i % 10000, year, month, day);
+        auto str = formatStr(L"%04d-%02d-%02d", year, month, day);
+        builder(i, 0) = std::wstring_view(str);
+      }
+      auto arrayObj = builder.toExcelObj();
+      ExcelArray arr(arrayObj);
+
+      vector<std::tm> results(N);
+      auto t1 = high_resolution_clock::now();
+
+      DateTimeParser parser;
+      Assert::AreEqual<size_t>(N, parser.parse(arr, results.data()));
+
+      auto t2 = high_resolution_clock::now();
+
+      wimemstreamBaseline(arr, results.data());
+
+      auto t3 = high_resolution_clock::now();
+
+      Logger::WriteMessage(formatStr("DateParseSpeed - Parser: %dms,  get_time: %dms",
+        (int)duration_cast<milliseconds>(t2 - t1).count(),
+        (int)duration_cast<milliseconds>(t3 - t2).count()).c_str());
+    }
+
+    // The previous implementation: parse with std::get_time 
+    void wimemstreamBaseline(const ExcelArray& arr, std::tm* results)
+    {
+      for (auto& val : arr)
+      {
+        std::wistringstream stream(val.toString());
+        stream >> std::get_time(results++, L"%Y-%m-%d");
+        Assert::IsFalse(stream.fail());
+      }
+    }
   };
 }
\ No newline at end of file
@@ -129,5 +129,78 @@ namespace Tests
         Assert::IsTrue(sub(0) == array(n < 0 ? R + n : n, 1));
       }
     }
+
+    TEST_METHOD(StringStoreAllocations)
+    {
+      // Strings allocated from the builder must not overlap
+      ExcelArrayBuilder builder(2, 1, 10);
+      auto first = builder.string(5);
+      auto second = builder.string(5);
+      wmemcpy(first.pstr(), L"Hello", 5);
+      wmemcpy(second.pstr(), L"World", 5);
+      builder(0).emplace_pstr(first.release());
+      builder(1).emplace_pstr(second.release());
+
+      auto arrayData = builder.toExcelObj();
+      ExcelArray array(arrayData);
+      Assert::AreEqual(wstring(L"Hello"), array(0).toString());
+      Assert::AreEqual(wstring(L"World"), array(1).toString());
+    }
+
+    TEST_METHOD(InternedStrings)
+    {
+      const wchar_t* values[] = { L"GBP", L"USD", L"", L"GBP", L"EUR", L"USD", L"GBP" };
+      constexpr auto N = _countof(values);
+
+      ArrayStringCounter strings;
+      for (auto v : values)
+        strings.add(v);
+      Assert::IsTrue(strings.interning());
+      // Three distinct non-empty strings with a count char, plus space for a repeat
+      Assert::AreEqual<size_t>(3 * 4 + 4, strings.length());
+
+      ExcelArrayBuilder builder(N, 2, strings);
+      Assert::IsTrue(builder.interning());
+      for (auto i = 0u; i < N; ++i)
+      {
+        builder(i, 0) = values[i];
+        builder(i, 1) = (int)i;
+      }
+
+      auto arrayData = builder.toExcelObj();
+      ExcelArray array(arrayData);
+      for (auto i = 0u; i < N; ++i)
+      {
+        Assert::AreEqual(wstring(values[i]), array(i, 0).toString());
+        Assert::AreEqual((int)i, array(i, 1).get<int>());
+      }
+      // Identical strings share a buffer
+      Assert::IsTrue(array(0, 0).val.str == array(3, 0).val.str);
+      Assert::IsTrue(array(0, 0).val.str == array(6, 0).val.str);
+      Assert::IsTrue(array(1, 0).val.str == array(5, 0).val.str);
+      Assert::IsTrue(array(0, 0).val.str != array(1, 0).val.str);
+    }
+
+    TEST_METHOD(InternedStringsAbandonedForDistinctData)
+    {
+      vector<wstring> values;
+      for (auto i = 0; i < 2000; ++i)
+        values.push_back(std::to_wstring(i));
+
+      ArrayStringCounter strings;
+      for (auto& v : values)
+        strings.add(v);
+      Assert::IsFalse(strings.interning());
+
+      ExcelArrayBuilder builder((ExcelObj::row_t)values.size(), 1, strings);
+      Assert::IsFalse(builder.interning());
+      for (auto i = 0u; i < values.size(); ++i)
+        builder(i, 0) = values[i];
+
+      auto arrayData = builder.toExcelObj();
+      ExcelArray array(arrayData);
+      for (auto i = 0u; i < values.size(); ++i)
+        Assert::AreEqual(values[i], array(i, 0).toString());
+    }
   };
 }
\ No newline at end of file
@@ -1,6 +1,12 @@
 #include "CppUnitTest.h"
 #include <xloil/ExcelObjCache.h>
+#include <xloil/CacheSnapshot.h>
+#include <xloil/ArrayBuilder.h>
+#include <xloil/Events.h>
+#include <xloil/Caller.h>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 using namespace xloil;
@@ -9,6 +15,7 @@ using std::make_unique;
 using fmt::format;
 using std::vector;
 using std::unique_ptr;
+namespace fs = std::filesystem;
 
 namespace Tests
 {
@@ -41,6 +48,113 @@ namespace Tests
       }
     }
 
+    TEST_METHOD(RestoreObjects)
+    {
+      auto cache = ObjectCache<
+        std::unique_ptr<int>,
+        CacheUniquifier<std::unique_ptr<int>>>::create();
+
+      auto caller = ExcelObj(L"[Book]Sheet!R1C1");
+      auto ref = wstring(cache->add(make_unique<int>(1), CallerInfo(caller)).asStringView());
+      auto cacheKey = ref.substr(0, ref.size() - 2);
+      Assert::IsFalse(*cache->isRestored(cacheKey));
+
+      vector<unique_ptr<int>> objects;
+      objects.emplace_back(make_unique<int>(2));
+      objects.emplace_back(make_unique<int>(3));
+      cache->restore(cacheKey, std::move(objects));
+      Assert::IsTrue(*cache->isRestored(cacheKey));
+      Assert::AreEqual(2, **cache->fetch(ref));
+      Assert::AreEqual(3, **cache->fetch(cacheKey + L",B"));
+
+      // The next add from the cell replaces the restored objects
+      auto newRef = cache->add(make_unique<int>(4), CallerInfo(caller));
+      Assert::AreEqual(ref, wstring(newRef.asStringView()));
+      Assert::IsFalse(*cache->isRestored(cacheKey));
+      Assert::AreEqual(4, **cache->fetch(ref));
+      Assert::IsNull(cache->fetch(cacheKey + L",B"));
+
+      // A miss handler can restore unknown keys
+      auto* rawCache = cache.get();
+      cache->setMissHandler([rawCache](const std::wstring_view& key)
+      {
+        vector<unique_ptr<int>> restored;
+        restored.emplace_back(make_unique<int>(5));
+        rawCache->restore(key, std::move(restored));
+        return true;
+      });
+      auto otherRef = wstring(1, ref[0]) + L"[Book]Sheet!R2C1,A";
+      Assert::IsFalse(cache->isRestored(otherRef.substr(0, otherRef.size() - 2)).has_value());
+      Assert::AreEqual(5, **cache->fetch(otherRef));
+    }
+
+    TEST_METHOD(SnapshotRoundTrip)
+    {
+      const auto dir = fs::temp_directory_path() / L"xlOilTestCacheSnapshot";
+      CacheSnapshot::setDirectory(dir.wstring());
+
+      ExcelArrayBuilder builder(2, 1, 5);
+      builder(0, 0) = 1.5;
+      builder(1, 0) = L"Hello";
+      const auto value = builder.toExcelObj();
+
+      auto& cache = ObjectCacheFactory<unique_ptr<const ExcelObj>>::cache();
+      auto ref = cache.add(
+        make_unique<ExcelObj>(value), CallerInfo(ExcelObj(L"[Snap.xlsx]Sheet1!R1C1")));
+
+      bool cancel = false;
+      Event::WorkbookBeforeClose().fire(L"Snap.xlsx", cancel);
+      cache.onWorkbookClose(L"Snap.xlsx");
+      Assert::IsTrue(fs::exists(dir / L"Snap.xlsx.xlcache"));
+
+      // The reference is missing from the cache so is read from the snapshot
+      auto* restored = getCached<ExcelObj>(ref.asStringView());
+      Assert::IsNotNull(restored);
+      Assert::IsTrue(*restored == value);
+
+      CacheSnapshot::setDirectory(L"");
+      std::error_code err;
+      fs::remove_all(dir, err);
+    }
+
+    TEST_METHOD(SnapshotCorruptBlobSize)
+    {
+      const auto dir = fs::temp_directory_path() / L"xlOilTestCacheSnapshotCorrupt";
+      CacheSnapshot::setDirectory(dir.wstring());
+
+      auto& cache = ObjectCacheFactory<unique_ptr<const ExcelObj>>::cache();
+      auto ref = cache.add(
+        make_unique<ExcelObj>(1.5), CallerInfo(ExcelObj(L"[Corrupt.xlsx]Sheet1!R1C1")));
+
+      bool cancel = false;
+      Event::WorkbookBeforeClose().fire(L"Corrupt.xlsx", cancel);
+      cache.onWorkbookClose(L"Corrupt.xlsx");
+      const auto path = dir / L"Corrupt.xlsx.xlcache";
+      Assert::IsTrue(fs::exists(path));
+
+      // Give the first blob a size which wraps to zero when aligned: the
+      // file header is 24 bytes and the record header 16, then the key
+      vector<char> bytes(fs::file_size(path));
+      {
+        std::ifstream in(path, std::ios::binary);
+        in.read(bytes.data(), bytes.size());
+      }
+      const auto keyLength = *(const uint32_t*)(bytes.data() + 24 + 8);
+      const auto blobOffset = 24 + 16 + ((keyLength * sizeof(wchar_t) + 7) & ~size_t(7));
+      *(uint64_t*)(bytes.data() + blobOffset) = UINT64_MAX - 3;
+      {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), bytes.size());
+      }
+
+      // The snapshot is rejected rather than read out of bounds
+      Assert::IsNull(getCached<ExcelObj>(ref.asStringView()));
+
+      CacheSnapshot::setDirectory(L"");
+      std::error_code err;
+      fs::remove_all(dir, err);
+    }
+
     TEST_METHOD(CallerAddressTypes)
     {
       auto F3 = ExcelObj(msxll::xlref12{ 2, 3, 5, 6 });
@@ -51,6 +165,16 @@ namespace Tests
       Assert::AreEqual(sheetName + L"!R3C6:R4C7", caller.writeAddress(AddressStyle::RC | AddressStyle::NOQUOTE));
       Assert::AreEqual(sheetName + L"!F3:G4", caller.writeAddress(AddressStyle::A1 | AddressStyle::NOQUOTE));
     }
+
+    TEST_METHOD(UnknownSheetAddress)
+    {
+      // Outside Excel no sheet name can be found, so only the local
+      // address is written
+      const msxll::XLREF12 ref{ 2, 3, 5, 6 };
+      const auto sheet = (msxll::IDSHEET)0x1234;
+      Assert::AreEqual(wstring(L"F3:G4"), xlrefToWorkbookAddress(sheet, ref));
+      Assert::AreEqual(wstring(L"R3C6:R4C7"), xlrefToWorkbookAddress(sheet, ref, false));
+    }
     TEST_METHOD(CacheSpeedTest1)
     {
       auto& cache = ObjectCacheFactory<std::unique_ptr<int>>::cache();
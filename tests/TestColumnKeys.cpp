@@ -0,0 +1,168 @@
+#include "CppUnitTest.h"
+#include <xlOil/ColumnKeys.h>
+#include <xlOil/ArrayBuilder.h>
+#include <xlOil/ExcelArray.h>
+#include <xlOil/ExcelObj.h>
+#include <clocale>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace xloil;
+using std::wstring;
+using std::vector;
+
+namespace Tests
+{
+  namespace
+  {
+    int sign(int x) { return (x > 0) - (x < 0); }
+
+    /// <summary>
+    /// Random values of every type which can be compared. Strings share
+    /// prefixes and vary in case and length around the SIMD block size.
+    /// </summary>
+    ExcelObj randomValue(std::mt19937& rng)
+    {
+      const wchar_t* stems[] = { L"", L"a", L"abcdefghijklmnop", L"ABCDEFGHIJKLMNOP", L"_[]" };
+      switch (std::uniform_int_distribution<int>(0, 9)(rng))
+      {
+      case 0: return ExcelObj(std::uniform_int_distribution<int>(-3, 3)(rng));
+      case 1: return ExcelObj(std::uniform_int_distribution<int>(-3, 3)(rng) * 0.5);
+      case 2: return ExcelObj(std::uniform_int_distribution<int>(0, 1)(rng) == 1);
+      case 3: return ExcelObj(CellError::NA);
+      case 4: return ExcelObj(ExcelType::Nil);
+      case 5: return ExcelObj(L"\u00C9t\u00E9");
+      default:
+      {
+        wstring str(stems[std::uniform_int_distribution<int>(0, _countof(stems) - 1)(rng)]);
+        const auto nExtra = std::uniform_int_distribution<int>(0, 20)(rng);
+        for (auto i = 0; i < nExtra; ++i)
+          str += L"aAzZ0_ "[std::uniform_int_distribution<int>(0, 6)(rng)];
+        return ExcelObj(str);
+      }
+      }
+    }
+
+    ExcelObj randomColumn(std::mt19937& rng, int nRows)
+    {
+      vector<ExcelObj> values;
+      size_t strLen = 0;
+      for (auto i = 0; i < nRows; ++i)
+      {
+        values.push_back(randomValue(rng));
+        strLen += values.back().stringLength();
+      }
+      ExcelArrayBuilder builder(nRows, 1, strLen);
+      for (auto i = 0; i < nRows; ++i)
+        builder(i, 0) = values[i];
+      return builder.toExcelObj();
+    }
+  }
+
+  TEST_CLASS(TestColumnKeys)
+  {
+  public:
+    // Checks the batched comparisons and hashes agree with ExcelObj::compare
+    // and ExcelObj::hash on random data
+    TEST_METHOD(MatchesScalarCompare)
+    {
+      constexpr int N = 300;
+      std::mt19937 rng(42);
+
+      for (auto cased : { false, true })
+      {
+        const auto leftData = randomColumn(rng, N);
+        const auto rightData = randomColumn(rng, N);
+        const ExcelArray left(leftData, false), right(rightData, false);
+        ColumnKeys leftKeys(left, 0, cased), rightKeys(right, 0, cased);
+
+        for (auto i = 0; i < N; ++i)
+          for (auto j = 0; j < N; ++j)
+            Assert::AreEqual(
+              sign(ExcelObj::compare(left(i), left(j), cased)),
+              leftKeys.compare(i, j));
+
+        vector<int> results(N);
+        for (auto j = 0; j < N; ++j)
+        {
+          leftKeys.compare(right(j), results.data());
+          for (auto i = 0; i < N; ++i)
+            Assert::AreEqual(sign(ExcelObj::compare(left(i), right(j), cased)), results[i]);
+        }
+
+        leftKeys.compare(rightKeys, results.data());
+        for (auto i = 0; i < N; ++i)
+          Assert::AreEqual(sign(ExcelObj::compare(left(i), right(i), cased)), results[i]);
+
+        vector<size_t> hashes(N);
+        leftKeys.hash(hashes.data());
+        for (auto i = 0; i < N; ++i)
+          Assert::AreEqual(ExcelObj::hash(left(i), cased), hashes[i]);
+      }
+    }
+
+    // The process LC_CTYPE is commonly set to the user's locale to get wide
+    // char conversions, which should not disable the ASCII keys
+    TEST_METHOD(NonCTypeLocale)
+    {
+      struct RestoreLocale
+      {
+        std::string previous = setlocale(LC_CTYPE, nullptr);
+        ~RestoreLocale() { setlocale(LC_CTYPE, previous.c_str()); }
+      } restore;
+      if (!setlocale(LC_CTYPE, "en-US"))
+        return;
+
+      const wstring strings[] = { L"abc", L"ABD", L"ab", L"_x", L"Zz", L"abc" };
+      ExcelArrayBuilder builder(_countof(strings), 1, 20);
+      for (auto i = 0u; i < _countof(strings); ++i)
+        builder(i, 0) = strings[i];
+      const auto data = builder.toExcelObj();
+      const ExcelArray array(data);
+
+      for (auto cased : { false, true })
+      {
+        ColumnKeys keys(array, 0, cased);
+        Assert::AreEqual<size_t>(_countof(strings), keys.asciiKeyCount());
+        for (auto i = 0u; i < _countof(strings); ++i)
+          for (auto j = 0u; j < _countof(strings); ++j)
+            Assert::AreEqual(
+              sign(ExcelObj::compare(array(i), array(j), cased)),
+              keys.compare(i, j));
+      }
+    }
+
+    TEST_METHOD(LongStrings)
+    {
+      // Differences before, at and after 16 char boundaries
+      const wstring base(40, L'x');
+      vector<wstring> values = { base, base + L"y", base.substr(0, 16), base.substr(0, 15) };
+      for (auto k : { 0, 14, 15, 16, 17, 31, 32, 39 })
+      {
+        values.push_back(base);
+        values.back()[k] = L'Y';
+        values.push_back(base);
+        values.back()[k] = L'a';
+      }
+
+      ExcelArrayBuilder builder((ExcelObj::row_t)values.size(), 1, values.size() * 41);
+      for (auto i = 0u; i < values.size(); ++i)
+        builder(i, 0) = values[i];
+      const auto data = builder.toExcelObj();
+      const ExcelArray array(data);
+
+      for (auto cased : { false, true })
+      {
+        ColumnKeys keys(array, 0, cased);
+        for (auto i = 0u; i < values.size(); ++i)
+          for (auto j = 0u; j < values.size(); ++j)
+            Assert::AreEqual(
+              sign(ExcelObj::compare(array(i), array(j), cased)),
+              keys.compare(i, j));
+      }
+    }
+  };
+}
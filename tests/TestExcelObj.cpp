@@ -5,6 +5,8 @@
 #include <xlOil/Date.h>
 
 #include <vector>
+#include <clocale>
+#include <string>
 
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -40,6 +42,53 @@ namespace Tests
         true, true));
     }
 
+    TEST_METHOD(TestHashMatchesCompare)
+    {
+      const ExcelObj values[] = {
+        ExcelObj(1), ExcelObj(1.0), ExcelObj(true), ExcelObj(0.0), ExcelObj(-0.0),
+        ExcelObj(false), ExcelObj(2.5), ExcelObj(L"Hello"), ExcelObj(L"hELLo"),
+        ExcelObj(L"Hello "), ExcelObj(L""), ExcelObj(CellError::NA), 
+        ExcelObj(CellError::Value), ExcelObj(), ExcelObj(nullptr)
+      };
+      for (auto& left : values)
+        for (auto& right : values)
+        {
+          if (ExcelObj::compare(left, right) == 0)
+            Assert::AreEqual(ExcelObj::hash(left), ExcelObj::hash(right));
+          if (ExcelObj::compare(left, right, true) == 0)
+            Assert::AreEqual(ExcelObj::hash(left, true), ExcelObj::hash(right, true));
+        }
+      Assert::AreNotEqual(
+        ExcelObj::hash(ExcelObj(L"Hello"), true), 
+        ExcelObj::hash(ExcelObj(L"hello"), true));
+
+      Assert::IsTrue(ExcelObj::stringHashMatchesCompare());
+      const std::string previous = setlocale(LC_COLLATE, nullptr);
+      if (setlocale(LC_COLLATE, "en-US"))
+      {
+        const auto matches = ExcelObj::stringHashMatchesCompare();
+        // Strings which the collation finds equal have equal collated hashes
+        const ExcelObj strings[] = {
+          ExcelObj(L"Hello"), ExcelObj(L"hello"), ExcelObj(L"HELLO"), ExcelObj(L"Hellp"),
+          ExcelObj(L"co\u00f6p"), ExcelObj(L"CO\u00d6P"), ExcelObj(L"coop"), ExcelObj(L"")
+        };
+        vector<std::pair<bool, bool>> results;
+        for (auto& a : strings)
+          for (auto& b : strings)
+            results.emplace_back(ExcelObj::compare(a, b) == 0, 
+              ExcelObj::collatedHash(a) == ExcelObj::collatedHash(b));
+        const auto distinct = ExcelObj::collatedHash(strings[0]) != ExcelObj::collatedHash(strings[3]);
+        setlocale(LC_COLLATE, previous.c_str());
+
+        Assert::IsFalse(matches);
+        for (auto [equal, sameHash] : results)
+          Assert::IsTrue(!equal || sameHash);
+        Assert::IsTrue(distinct);
+      }
+      // In the "C" locale, the collated hash is the plain hash
+      Assert::AreEqual(ExcelObj::hash(ExcelObj(L"Hello")), ExcelObj::collatedHash(ExcelObj(L"Hello")));
+    }
+
     TEST_METHOD(TestStrings)
     {
       {
@@ -84,6 +133,40 @@ namespace Tests
       // Out-of-bounds slice
       Assert::ExpectException<std::out_of_range>([&]() { arr.slice(3, 0, 5, 0); });
     }
+
+    TEST_METHOD(TestToStringRecursive)
+    {
+      Assert::AreEqual(wstring(L"1.5"), ExcelObj(1.5).toStringRecursive());
+      Assert::AreEqual(wstring(L"0.1"), ExcelObj(0.1).toStringRecursive());
+      Assert::AreEqual(wstring(L"1234567"), ExcelObj(1234567.0).toStringRecursive());
+      Assert::AreEqual(wstring(L"1E+300"), ExcelObj(1e300).toStringRecursive());
+      Assert::AreEqual(wstring(L"-42"), ExcelObj(-42).toStringRecursive());
+      Assert::AreEqual(wstring(L"TRUE"), ExcelObj(true).toStringRecursive());
+      Assert::AreEqual(wstring(L"#N/A"), ExcelObj(CellError::NA).toStringRecursive());
+
+      // Numbers round-trip
+      for (auto x : { 0.1 + 0.2, 1 / 3.0, -2.2250738585072014e-308, 123456789.125 })
+      {
+        const auto str = ExcelObj(x).toStringRecursive();
+        Assert::AreEqual(x, std::stod(str));
+        Assert::IsTrue(str.size() <= ExcelObj(x).maxStringLength());
+      }
+
+      ExcelArrayBuilder builder(2, 3, 1);
+      builder(0, 0) = 1;
+      builder(0, 1) = 2.5;
+      builder(0, 2) = L"x";
+      builder(1, 0) = L"";
+      builder(1, 1) = true;
+      builder(1, 2) = CellError::Div0;
+      const auto obj = builder.toExcelObj();
+      Assert::AreEqual(wstring(L"12.5xTRUE#DIV/0"), obj.toStringRecursive());
+      Assert::AreEqual(wstring(L"1, 2.5, x, , TRUE, #DIV/0"), obj.toStringRecursive(L", "));
+
+      wstring str(L"prefix:");
+      obj.appendStringRecursive(str, L";");
+      Assert::AreEqual(wstring(L"prefix:1;2.5;x;;TRUE;#DIV/0"), str);
+    }
     TEST_METHOD(TestCreateFromDate)
     {
       {
@@ -0,0 +1,175 @@
+#include "CppUnitTest.h"
+#include <xlOil/ArrayBuilder.h>
+#include <xlOil/ExcelArray.h>
+#include <xlOil/ExcelObj.h>
+#include <xlOil/ExcelObjBinary.h>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace xloil;
+using std::wstring;
+using std::vector;
+
+namespace Tests
+{
+  TEST_CLASS(TestExcelObjBinary)
+  {
+  public:
+
+    static ExcelObj mixedArray()
+    {
+      ExcelArrayBuilder builder(3, 3, 20);
+      builder(0, 0) = 1.5;
+      builder(0, 1) = 7;
+      builder(0, 2) = L"Hello";
+      builder(1, 0) = CellError::NA;
+      builder(1, 1).emplace(ExcelObj(true));
+      builder(1, 2) = L"";
+      builder(2, 0).emplace(ExcelObj());
+      builder(2, 1) = L"World";
+      builder(2, 2) = -1e300;
+      return builder.toExcelObj();
+    }
+
+    TEST_METHOD(ScalarRoundTrip)
+    {
+      const ExcelObj values[] = {
+        ExcelObj(3.25), ExcelObj(42), ExcelObj(false), ExcelObj(CellError::Div0),
+        ExcelObj(L"Some text"), ExcelObj(), ExcelObj(nullptr)
+      };
+      for (auto& value : values)
+      {
+        auto bytes = Binary::encode(value);
+        Assert::AreEqual(Binary::encodedSize(value), bytes.size());
+        auto decoded = Binary::decode(bytes.data(), bytes.size());
+        Assert::IsTrue(decoded.type() == value.type());
+        Assert::IsTrue(decoded == value);
+        Assert::IsFalse(BinaryView(bytes.data(), bytes.size()).isArray());
+      }
+    }
+
+    TEST_METHOD(NumericArrayRoundTrip)
+    {
+      ExcelArrayBuilder builder(100, 5);
+      for (auto i = 0u; i < builder.nRows(); ++i)
+        for (auto j = 0u; j < builder.nCols(); ++j)
+          builder(i, j) = i * 0.5 + j;
+      auto array = builder.toExcelObj();
+
+      auto bytes = Binary::encode(array);
+      BinaryView view(bytes.data(), bytes.size());
+      Assert::AreEqual(100u, view.nRows());
+      Assert::AreEqual(5u, view.nCols());
+      Assert::AreEqual(2.5 + 3, view.number(5 * 5 + 3));
+      Assert::IsTrue(view.toExcelObj() == array);
+    }
+
+    TEST_METHOD(MixedArrayRoundTrip)
+    {
+      auto array = mixedArray();
+      auto bytes = Binary::encode(array);
+      BinaryView view(bytes.data(), bytes.size());
+
+      Assert::IsTrue(view.isArray());
+      Assert::IsTrue(view.tag(0, 2) == Binary::Tag::Str);
+      Assert::AreEqual(wstring(L"World"), wstring(view.string(7)));
+      Assert::IsTrue(view(1, 1) == ExcelObj(true));
+      Assert::IsTrue(view.toExcelObj() == array);
+    }
+
+    TEST_METHOD(ZeroCopyView)
+    {
+      auto array = mixedArray();
+      auto bytes = Binary::encode(array);
+      BinaryView view(bytes.data(), bytes.size());
+
+      auto obj = view.toExcelObjView();
+      ExcelArray arr(obj);
+      Assert::AreEqual(3u, arr.nRows());
+      // Strings should point into the encoded data
+      auto str = arr(0, 2).val.str;
+      Assert::IsTrue((const char*)str >= bytes.data()
+        && (const char*)str < bytes.data() + bytes.size());
+      Assert::IsTrue(obj == array);
+
+      // A copy must own its strings
+      ExcelObj copy(obj);
+      obj.reset();
+      vector<char>().swap(bytes);
+      Assert::AreEqual(wstring(L"Hello"), ExcelArray(copy)(0, 2).toString());
+    }
+
+    TEST_METHOD(StreamingWriter)
+    {
+      BinaryWriter writer(2, 3);
+      writer(0, 0) = 1.5;
+      writer(0, 1) = 7;
+      writer(0, 2) = L"Hello";
+      writer(1, 0) = CellError::NA;
+      writer(1, 1) = true;
+      // (1, 2) is left as Nil
+
+      auto bytes = writer.toBytes();
+      Assert::AreEqual(writer.byteSize(), bytes.size());
+
+      ExcelArrayBuilder builder(2, 3, 5);
+      builder(0, 0) = 1.5;
+      builder(0, 1) = 7;
+      builder(0, 2) = L"Hello";
+      builder(1, 0) = CellError::NA;
+      builder(1, 1).emplace(ExcelObj(true));
+      builder(1, 2).emplace(ExcelObj());
+
+      Assert::IsTrue(Binary::decode(bytes.data(), bytes.size()) == builder.toExcelObj());
+    }
+
+    TEST_METHOD(RejectsInvalidData)
+    {
+      auto bytes = Binary::encode(mixedArray());
+
+      Assert::ExpectException<std::exception>([&]() {
+        BinaryView(bytes.data(), bytes.size() - 8);
+      });
+
+      auto badMagic = bytes;
+      badMagic[0] = 'Z';
+      Assert::ExpectException<std::exception>([&]() {
+        BinaryView(badMagic.data(), badMagic.size());
+      });
+
+      auto laterVersion = bytes;
+      ((Binary::Header*)laterVersion.data())->version = Binary::VERSION + 1;
+      Assert::ExpectException<std::exception>([&]() {
+        BinaryView(laterVersion.data(), laterVersion.size());
+      });
+
+      // A scalar header must describe a single cell
+      auto scalar = Binary::encode(ExcelObj(1.5));
+      ((Binary::Header*)scalar.data())->nCols = 2;
+      Assert::ExpectException<std::exception>([&]() {
+        BinaryView(scalar.data(), scalar.size());
+      });
+
+      // Dimensions whose layout size wraps around to the real size
+      auto huge = bytes;
+      auto* header = (Binary::Header*)huge.data();
+      header->heapLength = (1ull << 63) + 1;
+      header->size = Binary::Layout(
+        (size_t)header->nRows * header->nCols, (size_t)header->heapLength).size;
+      Assert::ExpectException<std::exception>([&]() {
+        BinaryView(huge.data(), huge.size());
+      });
+
+      header->heapLength = 0;
+      header->nRows = header->nCols = 0xFFFFFFFF;
+      Assert::ExpectException<std::exception>([&]() {
+        BinaryView(huge.data(), huge.size());
+      });
+
+      Assert::ExpectException<std::exception>([&]() {
+        Binary::encode(ExcelObj(msxll::xlref12{ 0, 0, 0, 0 }));
+      });
+    }
+  };
+}
@@ -0,0 +1,197 @@
+#include "CppUnitTest.h"
+#include <xlOil-COM/MainThreadQueue.h>
+#include <algorithm>
+#include <future>
+#include <random>
+#include <thread>
+#include <vector>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace xloil;
+using std::vector;
+
+namespace Tests
+{
+  TEST_CLASS(TestMainThreadQueue)
+  {
+  public:
+
+    struct Node
+    {
+      Node* next;
+      uint64_t due;
+    };
+
+    static bool runAll(MainThreadQueue::Job& job)
+    {
+      job.task();
+      return true;
+    }
+
+    TEST_METHOD(WheelExpiresAtDueTime)
+    {
+      std::mt19937_64 rng(1234);
+      TimerWheel<Node> wheel(1000);
+      // Spread over all levels and the overflow list
+      vector<Node> nodes(500);
+      for (auto& node : nodes)
+      {
+        const auto range = uint64_t(1) << (rng() % 28);
+        node.due = 1000 + 1 + rng() % range;
+        wheel.insert(&node);
+      }
+
+      size_t expired = 0;
+      uint64_t now = 1000;
+      while (!wheel.empty())
+      {
+        const auto next = *wheel.nextDue();
+        Assert::IsTrue(next > now);
+        now = next;
+        wheel.advance(now, [&](Node* node)
+        {
+          Assert::AreEqual(now, node->due);
+          ++expired;
+        });
+      }
+      Assert::AreEqual(nodes.size(), expired);
+    }
+
+    TEST_METHOD(WheelExpiresInOrder)
+    {
+      TimerWheel<Node> wheel;
+      vector<Node> nodes(1000);
+      for (auto i = 0u; i < nodes.size(); ++i)
+      {
+        nodes[i].due = (i * 7919) % 100000 + 1;
+        wheel.insert(&nodes[i]);
+      }
+      // A node which is already due expires on the next advance
+      Node late{ nullptr, 0 };
+      wheel.insert(&late);
+
+      vector<uint64_t> dues;
+      wheel.advance(200000, [&](Node* node) { dues.push_back(node->due); });
+      Assert::AreEqual(nodes.size() + 1, dues.size());
+      Assert::IsTrue(std::is_sorted(dues.begin(), dues.end()));
+      Assert::IsFalse(wheel.nextDue().has_value());
+    }
+
+    TEST_METHOD(SmallTasksAreInline)
+    {
+      int result = 0;
+      QueueTask small([&result]() { result = 1; });
+      Assert::IsTrue(small.isInline());
+
+      std::function<void()> func = [&result]() { result = 2; };
+      QueueTask wrapped(std::move(func));
+      Assert::IsTrue(wrapped.isInline());
+
+      char padding[100] = { 3 };
+      QueueTask large([&result, padding]() { result = padding[0]; });
+      Assert::IsFalse(large.isInline());
+
+      QueueTask moved(std::move(large));
+      Assert::IsFalse((bool)large);
+      moved();
+      Assert::AreEqual(3, result);
+      small();
+      Assert::AreEqual(1, result);
+
+      // As built by runExcelThread: the promise and a small callable fit
+      std::promise<int> promise;
+      auto future = promise.get_future();
+      QueueTask withPromise(
+        [promise = std::move(promise), f = [&result]() { return result; }]() mutable
+        {
+          promise.set_value(f());
+        });
+      Assert::IsTrue(withPromise.isInline());
+      withPromise();
+      Assert::AreEqual(1, future.get());
+    }
+
+    TEST_METHOD(NodesAreReused)
+    {
+      MainThreadQueue queue;
+      int calls = 0;
+      for (auto round = 0; round < 5; ++round)
+      {
+        for (auto i = 0; i < 10; ++i)
+          queue.push([&]() { ++calls; }, 0, 0, 10, 100);
+        queue.run(100, runAll);
+      }
+      Assert::AreEqual(50, calls);
+      Assert::AreEqual<uint64_t>(10, queue.nodesAllocated());
+    }
+
+    TEST_METHOD(PriorityAndDelay)
+    {
+      MainThreadQueue queue;
+      vector<int> order;
+
+      Assert::IsTrue(queue.push([&]() { order.push_back(1); }, 0, 0, 10, 100));
+      // Only the first push needs to wake the consumer
+      Assert::IsFalse(queue.push([&]() { order.push_back(2); }, ExcelRunQueue::LOW_PRIORITY, 0, 10, 100));
+      queue.push([&]() { order.push_back(3); }, ExcelRunQueue::HIGH_PRIORITY, 0, 10, 100);
+      queue.push([&]() { order.push_back(4); }, 0, 50, 10, 100);
+
+      Assert::AreEqual<size_t>(3, queue.run(100, runAll));
+      Assert::IsTrue(vector<int>{ 3, 1, 2 } == order);
+      Assert::AreEqual<uint64_t>(150, *queue.nextDue());
+      Assert::AreEqual<uint64_t>(1, queue.depth());
+
+      Assert::AreEqual<size_t>(0, queue.run(149, runAll));
+      Assert::AreEqual<size_t>(1, queue.run(150, runAll));
+      Assert::AreEqual(4, order.back());
+      Assert::IsFalse(queue.nextDue().has_value());
+    }
+
+    TEST_METHOD(RetriesAndStats)
+    {
+      MainThreadQueue queue;
+      int calls = 0;
+      queue.push([&]() { ++calls; }, 0, 0, 20, 100);
+      queue.push([&]() { ++calls; }, ExcelRunQueue::NO_RETRY, 0, 20, 100);
+
+      // Simulate COM being unavailable
+      auto unavailable = [](MainThreadQueue::Job&) { return false; };
+      Assert::AreEqual<size_t>(0, queue.run(100, unavailable));
+      Assert::AreEqual<uint64_t>(120, *queue.nextDue());
+      queue.run(120, unavailable);
+      Assert::AreEqual<size_t>(1, queue.run(140, runAll));
+      Assert::AreEqual(1, calls);
+
+      const auto stats = queue.stats();
+      Assert::AreEqual<uint64_t>(2, stats.queued);
+      Assert::AreEqual<uint64_t>(2, stats.retried);
+      Assert::AreEqual<uint64_t>(0, stats.depth);
+      Assert::AreEqual<uint64_t>(2, stats.maxDepth);
+      Assert::AreEqual<uint64_t>(1, stats.lanes[MainThreadQueue::NORMAL].run);
+      Assert::AreEqual<uint64_t>(40, stats.lanes[MainThreadQueue::NORMAL].maxWaitMs);
+    }
+
+    TEST_METHOD(ManyProducers)
+    {
+      MainThreadQueue queue;
+      const size_t nThreads = 4, nPerThread = 10000;
+      std::atomic<size_t> total{ 0 };
+      vector<std::thread> producers;
+      for (auto i = 0u; i < nThreads; ++i)
+        producers.emplace_back([&]()
+        {
+          for (auto j = 0u; j < nPerThread; ++j)
+            queue.push([&]() { ++total; }, 0, 0, 0, 0);
+        });
+
+      size_t nRun = 0;
+      while (nRun < nThreads * nPerThread)
+        nRun += queue.run(0, runAll);
+      for (auto& t : producers)
+        t.join();
+
+      Assert::AreEqual(nThreads * nPerThread, total.load());
+      Assert::AreEqual<uint64_t>(0, queue.depth());
+    }
+  };
+}
@@ -0,0 +1,133 @@
+#include "CppUnitTest.h"
+#include <xloil/Profile.h>
+#include <algorithm>
+#include <thread>
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace xloil;
+using std::vector;
+
+namespace Tests
+{
+  TEST_CLASS(TestProfile)
+  {
+  public:
+
+    static const Profile::FunctionStats* find(
+      const vector<Profile::FunctionStats>& stats, const wchar_t* name)
+    {
+      auto found = std::find_if(stats.begin(), stats.end(),
+        [&](auto& s) { return s.name == name; });
+      return found == stats.end() ? nullptr : &*found;
+    }
+
+    TEST_METHOD(RecordAndMerge)
+    {
+      Profile::setEnabled(true);
+      Profile::reset();
+
+      const auto fast = Profile::functionId(L"TestProfile_fast");
+      const auto slow = Profile::functionId("Tests::TestProfile_slow");
+      Assert::AreEqual(fast, Profile::functionId(L"TestProfile_fast"));
+
+      for (auto i = 0; i < 100; ++i)
+      {
+        const int64_t nanos[] = { 100, 200, 100 };
+        Profile::record(fast, nanos, i % 10 == 0);
+      }
+
+      // Calls on another thread should be merged with this thread
+      std::thread([=]()
+      {
+        const int64_t nanos[] = { 1000, 3'000'000, 1000 };
+        Profile::record(slow, nanos, false);
+      }).join();
+
+      Profile::merge();
+      auto stats = Profile::stats();
+
+      auto* fastStats = find(stats, L"TestProfile_fast");
+      auto* slowStats = find(stats, L"TestProfile_slow");
+      Assert::IsNotNull(fastStats);
+      Assert::IsNotNull(slowStats);
+
+      Assert::AreEqual<uint64_t>(100, fastStats->calls);
+      Assert::AreEqual<uint64_t>(10, fastStats->errors);
+      Assert::AreEqual(100 * 200e-9, fastStats->phaseTime[1], 1e-12);
+      Assert::AreEqual<uint64_t>(100, fastStats->histogram[0]);
+
+      // Sorted by descending total time
+      Assert::IsTrue(slowStats < fastStats);
+      Assert::AreEqual(3.002e-3, slowStats->totalTime(), 1e-9);
+      // 3002us lies in [2048, 4096)
+      Assert::AreEqual<uint64_t>(1, slowStats->histogram[12]);
+      Assert::AreEqual(4096e-6, slowStats->quantile(0.5), 1e-12);
+
+      Profile::reset();
+      Profile::merge();
+      Assert::IsNull(find(Profile::stats(), L"TestProfile_fast"));
+
+      Profile::setEnabled(false);
+    }
+
+    TEST_METHOD(QualifiedNamesAndReset)
+    {
+      Profile::setEnabled(true);
+      Profile::reset();
+
+      // Same short name in different namespaces are separate functions
+      const auto first = Profile::functionId("A::TestProfile_same");
+      const auto second = Profile::functionId("B::TestProfile_same");
+      Assert::AreNotEqual(first, second);
+
+      const int64_t slow[] = { 0, 5'000'000, 0 };
+      const int64_t fast[] = { 0, 1000, 0 };
+      Profile::record(first, slow, false);
+      Profile::reset();
+      Profile::record(first, fast, false);
+      Profile::record(second, fast, false);
+      Profile::merge();
+
+      const auto stats = Profile::stats();
+      auto found = std::find_if(stats.begin(), stats.end(),
+        [](auto& s) { return s.qualifiedName == L"A::TestProfile_same"; });
+      Assert::IsTrue(found != stats.end());
+      Assert::AreEqual(std::wstring(L"TestProfile_same"), found->name);
+      Assert::AreEqual<uint64_t>(1, found->calls);
+      // The maximum does not include the call before the reset
+      Assert::AreEqual(1e-6, found->maxTime, 1e-12);
+
+      Assert::AreEqual<ptrdiff_t>(2, std::count_if(stats.begin(), stats.end(),
+        [](auto& s) { return s.name == L"TestProfile_same"; }));
+
+      Profile::setEnabled(false);
+    }
+
+    TEST_METHOD(CallTimerPhases)
+    {
+      Profile::setEnabled(true);
+      Profile::reset();
+      const auto id = Profile::functionId(L"TestProfile_timer");
+      {
+        Profile::CallTimer timer(id);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        timer.phaseEnd(Profile::Phase::Args);
+        timer.failed();
+      }
+      Profile::setEnabled(false);
+      {
+        // Not recorded when disabled
+        Profile::CallTimer timer(id);
+      }
+
+      Profile::merge();
+      const auto allStats = Profile::stats();
+      auto* stats = find(allStats, L"TestProfile_timer");
+      Assert::IsNotNull(stats);
+      Assert::AreEqual<uint64_t>(1, stats->calls);
+      Assert::AreEqual<uint64_t>(1, stats->errors);
+      Assert::IsTrue(stats->phaseTime[0] >= 2e-3);
+      Assert::IsTrue(stats->phaseTime[0] > stats->phaseTime[1]);
+    }
+  };
+}
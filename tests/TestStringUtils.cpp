@@ -1,5 +1,8 @@
 #include "CppUnitTest.h"
 #include <xlOil/StringUtils.h>
+#include <chrono>
+#include <codecvt>
+#include <locale>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -47,5 +50,38 @@ namespace Tests
         parseRoundTrip<32>(i);
       }
     }
+
+    TEST_METHOD(TestTranscodingSpeed)
+    {
+      using std::chrono::high_resolution_clock;
+      using std::chrono::duration_cast;
+      using std::chrono::microseconds;
+
+      constexpr size_t NRepeats = 1000;
+      const wstring ascii(L"The quick brown fox jumps over the lazy dog. 0123456789");
+      const wstring mixed(L"Gr\u00fc\u00dfe aus K\u00f6ln, \u4f60\u597d \u6c34 \U0001f34c ok");
+
+      for (auto* source : { &ascii, &mixed })
+      {
+        size_t total = 0;
+
+        auto t1 = high_resolution_clock::now();
+        for (auto i = 0; i < NRepeats; ++i)
+          total += utf8ToUtf16(utf16ToUtf8(*source)).size();
+
+        auto t2 = high_resolution_clock::now();
+        for (auto i = 0; i < NRepeats; ++i)
+        {
+          std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+          total += converter.from_bytes(converter.to_bytes(*source)).size();
+        }
+        auto t3 = high_resolution_clock::now();
+
+        Assert::AreEqual(2 * NRepeats * source->size(), total);
+        Logger::WriteMessage(formatStr("TranscodingSpeed - xlOil: %dus,  wstring_convert: %dus",
+          (int)duration_cast<microseconds>(t2 - t1).count(),
+          (int)duration_cast<microseconds>(t3 - t2).count()).c_str());
+      }
+    }
   };
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "CppUnitTest.h"
+#include "../libs/xlOil_Python/PyWorkerProtocol.h"
+#include <xlOil/ArrayBuilder.h>
+#include <xlOil/ExcelObj.h>
+#include <xlOil/ExcelObjBinary.h>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+using namespace xloil;
+using namespace xloil::Python::WorkerPool::Protocol;
+using std::wstring;
+using std::vector;
+
+namespace Tests
+{
+  TEST_CLASS(TestWorkerProtocol)
+  {
+  public:
+
+    static ExcelObj mixedArray()
+    {
+      ExcelArrayBuilder builder(2, 3, 10);
+      builder(0, 0) = 1.5;
+      builder(0, 1) = 7;
+      builder(0, 2) = L"Hello";
+      builder(1, 0) = CellError::NA;
+      builder(1, 1).emplace(ExcelObj(true));
+      builder(1, 2) = L"World";
+      return builder.toExcelObj();
+    }
+
+    TEST_METHOD(MessageRoundTrip)
+    {
+      const ExcelObj values[] = {
+        ExcelObj(3.25), ExcelObj(42), ExcelObj(false), ExcelObj(CellError::Div0),
+        ExcelObj(L"Some text"), ExcelObj(L""), ExcelObj(), ExcelObj(ExcelType::Missing),
+        mixedArray()
+      };
+
+      vector<char> buffer(4096);
+      MessageWriter writer(buffer.data(), buffer.size());
+      BinaryWriter header(1, 3);
+      header(0) = std::wstring_view(L"func");
+      header(1) = std::wstring_view(L"c:\\module.py");
+      header(2) = (int)std::size(values);
+      writer.write(header);
+      for (auto& value : values)
+        writer.write(value);
+
+      MessageReader reader(buffer.data(), writer.size());
+      const auto callHeader = reader.next();
+      Assert::AreEqual(wstring(L"func"), wstring(callHeader.string(0)));
+      Assert::AreEqual(wstring(L"c:\\module.py"), wstring(callHeader.string(1)));
+      Assert::AreEqual((int)std::size(values), callHeader.integer(2));
+      for (auto& value : values)
+      {
+        auto decoded = reader.read();
+        Assert::IsTrue(decoded.type() == value.type());
+        Assert::IsTrue(decoded == value);
+      }
+      Assert::ExpectException<std::exception>([&]() { reader.next(); });
+    }
+
+    TEST_METHOD(BufferTooSmall)
+    {
+      vector<char> buffer(64);
+      MessageWriter writer(buffer.data(), buffer.size());
+      writer.write(ExcelObj(1.5));
+      Assert::ExpectException<std::exception>([&]() { writer.write(mixedArray()); });
+    }
+
+    TEST_METHOD(UnencodableValues)
+    {
+      // These make the worker send a Fallback so the call runs in Excel
+      Assert::ExpectException<std::exception>([]() {
+        Binary::encodedSize(ExcelObj(msxll::xlref12{ 0, 0, 0, 0 }));
+      });
+
+      ExcelArrayBuilder inner(1, 2);
+      inner(0, 0) = 1;
+      inner(0, 1) = 2;
+      ExcelArrayBuilder outer(1, 2);
+      outer(0, 0) = 1;
+      outer(0, 1).emplace(inner.toExcelObj());
+      const auto nested = outer.toExcelObj();
+      Assert::ExpectException<std::exception>([&]() { Binary::encodedSize(nested); });
+
+      // Arguments which refer into Excel's process are never sent to a worker
+      Assert::IsFalse(dispatchableArgType("range"));
+      Assert::IsFalse(dispatchableArgType("Array"));
+      Assert::IsTrue(dispatchableArgType(""));
+      Assert::IsTrue(dispatchableArgType("float"));
+    }
+
+    TEST_METHOD(RejectsInvalidData)
+    {
+      vector<char> buffer(256);
+      MessageWriter writer(buffer.data(), buffer.size());
+      writer.write(ExcelObj(L"Some text"));
+
+      Assert::ExpectException<std::exception>([&]() {
+        MessageReader(buffer.data(), writer.size() - 8).next();
+      });
+
+      auto number = buffer;
+      MessageWriter(number.data(), number.size()).write(ExcelObj(1.5));
+      Assert::ExpectException<std::exception>([&]() {
+        MessageReader(number.data(), number.size()).readString();
+      });
+
+      buffer[0] = 'Z';
+      Assert::ExpectException<std::exception>([&]() {
+        MessageReader(buffer.data(), buffer.size()).next();
+      });
+    }
+
+    TEST_METHOD(ChannelDetectsExitedProcess)
+    {
+      const auto name = L"xlOil_TestWorkerProtocol_" + std::to_wstring(GetCurrentProcessId());
+      Channel server(name, 1024);
+      Channel client(name);
+
+      auto value = mixedArray();
+      auto writer = client.writer();
+      writer.write(value);
+      client.send(Message::Ok, writer);
+      client.signalResponse();
+
+      // Our own process handle is never signalled whilst we are running
+      Assert::IsTrue(server.waitResponse(GetCurrentProcess()));
+      Assert::IsTrue(server.header().message == Message::Ok);
+      Assert::IsTrue(server.reader().read() == value);
+
+      // A thread handle stands in for a worker process which has exited
+      auto thread = CreateThread(nullptr, 0, [](void*) -> DWORD { return 0; }, nullptr, 0, nullptr);
+      WaitForSingleObject(thread, INFINITE);
+      Assert::IsFalse(server.waitResponse(thread));
+      CloseHandle(thread);
+    }
+  };
+}